@@ -0,0 +1,314 @@
+/*
+ * fuse_wronly_test.c - partial page writes through write-only opens
+ *
+ * With FUSE_WRITEBACK_CACHE, a write that covers only part of a page
+ * inside the file reads the page in first, through the file being
+ * written to, and the whole page is written back later.  This mounts a
+ * minimal daemon serving a single file that, like most real ones,
+ * refuses to READ through a handle opened O_WRONLY and appends every
+ * WRITE to a handle opened O_APPEND.  It then writes two bytes through
+ * an O_WRONLY open and one byte through an O_WRONLY | O_APPEND open,
+ * both into the last, partial page, and checks what reached the daemon.
+ *
+ * Needs root.  Usage: fuse_wronly_test [mountpoint]
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/mount.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include <linux/fuse.h>
+
+#define FILE_NAME	"file"
+#define FILE_INO	2
+#define FILE_SIZE	8000	/* ends inside a page */
+#define MAX_SIZE	(4 * FILE_SIZE)
+#define MAX_FH		64
+#define BUF_SIZE	(256 * 1024 + 4096)
+
+/* Shared with the parent, so that it can check what the daemon got */
+struct state {
+	size_t size;
+	int read_refused;
+	unsigned char data[MAX_SIZE];
+};
+
+static struct state *st;
+static int open_flags[MAX_FH];
+static int nr_fh;
+
+static void reply(int fd, struct fuse_in_header *in, int error,
+		  const void *arg, size_t size)
+{
+	static char buf[BUF_SIZE];
+	struct fuse_out_header *out = (struct fuse_out_header *)buf;
+
+	if (error)
+		size = 0;
+	out->len = sizeof(*out) + size;
+	out->error = error;
+	out->unique = in->unique;
+	memcpy(buf + sizeof(*out), arg, size);
+	if (write(fd, buf, out->len) < 0 && errno != ENOENT)
+		perror("reply");
+}
+
+static void fill_attr(struct fuse_attr *attr, __u64 ino)
+{
+	memset(attr, 0, sizeof(*attr));
+	attr->ino = ino;
+	attr->nlink = 1;
+	attr->blksize = 4096;
+	if (ino == FUSE_ROOT_ID) {
+		attr->mode = S_IFDIR | 0755;
+		attr->nlink = 2;
+	} else {
+		attr->mode = S_IFREG | 0644;
+		attr->size = st->size;
+		attr->blocks = (st->size + 511) / 512;
+	}
+}
+
+static void serve(int fd)
+{
+	static char buf[BUF_SIZE];
+
+	for (;;) {
+		struct fuse_in_header *in = (struct fuse_in_header *)buf;
+		void *arg = buf + sizeof(*in);
+		ssize_t n = read(fd, buf, sizeof(buf));
+
+		if (n < 0 && (errno == EINTR || errno == ENOENT))
+			continue;
+		if (n < (ssize_t)sizeof(*in))
+			return;
+
+		switch (in->opcode) {
+		case FUSE_INIT: {
+			struct fuse_init_in *init = arg;
+			struct fuse_init_out out;
+
+			memset(&out, 0, sizeof(out));
+			out.major = FUSE_KERNEL_VERSION;
+			out.minor = FUSE_KERNEL_MINOR_VERSION;
+			out.max_readahead = init->max_readahead;
+			out.flags = FUSE_BIG_WRITES | FUSE_WRITEBACK_CACHE;
+			out.max_write = 65536;
+			reply(fd, in, 0, &out, sizeof(out));
+			break;
+		}
+		case FUSE_LOOKUP: {
+			struct fuse_entry_out out;
+
+			if (in->nodeid != FUSE_ROOT_ID ||
+			    strcmp(arg, FILE_NAME)) {
+				reply(fd, in, -ENOENT, NULL, 0);
+				break;
+			}
+			memset(&out, 0, sizeof(out));
+			out.nodeid = FILE_INO;
+			fill_attr(&out.attr, FILE_INO);
+			reply(fd, in, 0, &out, sizeof(out));
+			break;
+		}
+		case FUSE_SETATTR:
+		case FUSE_GETATTR: {
+			struct fuse_setattr_in *sa = arg;
+			struct fuse_attr_out out;
+
+			if (in->opcode == FUSE_SETATTR &&
+			    (sa->valid & FATTR_SIZE) && sa->size <= MAX_SIZE)
+				st->size = sa->size;
+			memset(&out, 0, sizeof(out));
+			fill_attr(&out.attr, in->nodeid);
+			reply(fd, in, 0, &out, sizeof(out));
+			break;
+		}
+		case FUSE_OPEN: {
+			struct fuse_open_in *oi = arg;
+			struct fuse_open_out out;
+
+			if (nr_fh == MAX_FH) {
+				reply(fd, in, -EMFILE, NULL, 0);
+				break;
+			}
+			memset(&out, 0, sizeof(out));
+			out.fh = nr_fh;
+			open_flags[nr_fh++] = oi->flags;
+			reply(fd, in, 0, &out, sizeof(out));
+			break;
+		}
+		case FUSE_READ: {
+			struct fuse_read_in *ri = arg;
+			size_t size = 0;
+
+			if (ri->fh >= nr_fh ||
+			    (open_flags[ri->fh] & O_ACCMODE) == O_WRONLY) {
+				st->read_refused++;
+				reply(fd, in, -EBADF, NULL, 0);
+				break;
+			}
+			if (ri->offset < st->size)
+				size = st->size - ri->offset;
+			if (size > ri->size)
+				size = ri->size;
+			reply(fd, in, 0, st->data + ri->offset, size);
+			break;
+		}
+		case FUSE_WRITE: {
+			struct fuse_write_in *wi = arg;
+			struct fuse_write_out out;
+			__u64 off = wi->offset;
+
+			if (wi->fh >= nr_fh ||
+			    (open_flags[wi->fh] & O_ACCMODE) == O_RDONLY) {
+				reply(fd, in, -EBADF, NULL, 0);
+				break;
+			}
+			/* What pwrite() does on a file opened O_APPEND */
+			if (open_flags[wi->fh] & O_APPEND)
+				off = st->size;
+			if (off + wi->size > MAX_SIZE) {
+				reply(fd, in, -EFBIG, NULL, 0);
+				break;
+			}
+			memcpy(st->data + off, wi + 1, wi->size);
+			if (off + wi->size > st->size)
+				st->size = off + wi->size;
+			memset(&out, 0, sizeof(out));
+			out.size = wi->size;
+			reply(fd, in, 0, &out, sizeof(out));
+			break;
+		}
+		case FUSE_FORGET:
+			break;
+		case FUSE_FLUSH:
+		case FUSE_RELEASE:
+		case FUSE_FSYNC:
+		case FUSE_OPENDIR:
+		case FUSE_RELEASEDIR:
+			reply(fd, in, 0, NULL, 0);
+			break;
+		default:
+			reply(fd, in, -ENOSYS, NULL, 0);
+			break;
+		}
+	}
+}
+
+/* Returns the number of failed checks */
+static int run(const char *mnt)
+{
+	unsigned char expect[MAX_SIZE];
+	char path[4096];
+	int failed = 0;
+	int fd;
+
+	snprintf(path, sizeof(path), "%s/" FILE_NAME, mnt);
+	memcpy(expect, st->data, FILE_SIZE);
+
+	fd = open(path, O_WRONLY);
+	if (fd < 0) {
+		perror("open O_WRONLY");
+		return 1;
+	}
+	if (pwrite(fd, "XY", 2, 4096 + 100) != 2) {
+		printf("FAIL: partial page write through O_WRONLY: %s\n",
+		       strerror(errno));
+		failed++;
+	}
+	if (fsync(fd))
+		perror("fsync");
+	close(fd);
+	memcpy(expect + 4096 + 100, "XY", 2);
+
+	fd = open(path, O_WRONLY | O_APPEND);
+	if (fd < 0) {
+		perror("open O_WRONLY | O_APPEND");
+		return failed + 1;
+	}
+	if (write(fd, "Z", 1) != 1) {
+		printf("FAIL: append through O_WRONLY | O_APPEND: %s\n",
+		       strerror(errno));
+		failed++;
+	}
+	if (fsync(fd))
+		perror("fsync");
+	close(fd);
+	expect[FILE_SIZE] = 'Z';
+
+	if (st->read_refused) {
+		printf("FAIL: %d READs sent through write-only opens\n",
+		       st->read_refused);
+		failed++;
+	}
+	if (st->size != FILE_SIZE + 1 ||
+	    memcmp(st->data, expect, FILE_SIZE + 1)) {
+		printf("FAIL: the daemon holds %zu bytes, not the %d "
+		       "expected\n", st->size, FILE_SIZE + 1);
+		failed++;
+	}
+	return failed;
+}
+
+int main(int argc, char **argv)
+{
+	char tmp[] = "/tmp/fuse_wronly_test.XXXXXX";
+	const char *mnt = argc > 1 ? argv[1] : mkdtemp(tmp);
+	char opts[128];
+	int fd, failed, i;
+	pid_t pid;
+
+	st = mmap(NULL, sizeof(*st), PROT_READ | PROT_WRITE,
+		  MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (st == MAP_FAILED || mnt == NULL) {
+		perror("setup");
+		return 1;
+	}
+	st->size = FILE_SIZE;
+	for (i = 0; i < FILE_SIZE; i++)
+		st->data[i] = i % 251;
+
+	fd = open("/dev/fuse", O_RDWR);
+	if (fd < 0) {
+		perror("/dev/fuse");
+		return 1;
+	}
+	snprintf(opts, sizeof(opts),
+		 "fd=%d,rootmode=40000,user_id=0,group_id=0", fd);
+	if (mount("fuse_wronly_test", mnt, "fuse", MS_NOSUID | MS_NODEV,
+		  opts)) {
+		perror("mount");
+		return 1;
+	}
+
+	pid = fork();
+	if (pid < 0) {
+		perror("fork");
+		umount2(mnt, MNT_DETACH);
+		return 1;
+	}
+	if (pid == 0) {
+		serve(fd);
+		_exit(0);
+	}
+	close(fd);
+
+	failed = run(mnt);
+
+	umount2(mnt, MNT_DETACH);
+	kill(pid, SIGTERM);
+	waitpid(pid, NULL, 0);
+	if (argc < 2)
+		rmdir(mnt);
+
+	printf("%s\n", failed ? "FAILED" : "PASSED");
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,34 @@
+/*
+ *  linux/arch/arm/include/asm/neon.h
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#ifndef __ASM_ARM_NEON_H
+#define __ASM_ARM_NEON_H
+
+#include <asm/hwcap.h>
+
+/* memcpy hands copies of at least this many bytes to NEON, see memcpy.S */
+#define NEON_MEMCPY_MIN		1024
+
+#ifndef __ASSEMBLY__
+
+#define cpu_has_neon()		(!!(elf_hwcap & HWCAP_NEON))
+
+#ifdef CONFIG_KERNEL_MODE_NEON
+/*
+ * Kernel code may only use the NEON/VFP registers between
+ * kernel_neon_begin() and kernel_neon_end(), in process context.
+ * Any task state held in the registers is saved first and gets
+ * reloaded lazily by the VFP trap handler. Preemption is disabled
+ * in between.
+ */
+void kernel_neon_begin(void);
+void kernel_neon_end(void);
+#endif
+
+#endif /* __ASSEMBLY__ */
+
+#endif
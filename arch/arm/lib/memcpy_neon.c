@@ -0,0 +1,84 @@
+/*
+ *  linux/arch/arm/lib/memcpy_neon.c
+ *
+ *  Select NEON for large memcpy/copy_page at boot.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  memcpy (and memmove, when it can copy forwards) branches here for
+ *  copies of NEON_MEMCPY_MIN bytes and more, see memcpy.S. copy_page
+ *  is wholly defined here, the ARM version being __copy_page_arm.
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/hardirq.h>
+#include <linux/irqflags.h>
+#include <linux/string.h>
+#include <asm/page.h>
+#include <asm/neon.h>
+
+extern void *__memcpy_arm(void *dest, const void *src, size_t n);
+extern void __memcpy_neon(void *dest, const void *src, size_t n,
+			  unsigned int pld);
+extern void __copy_page_arm(void *to, const void *from);
+
+void *__memcpy_large(void *dest, const void *src, size_t n);
+
+static int neon_usable __read_mostly;
+
+static int enable = 1;
+module_param(enable, bool, 0644);
+MODULE_PARM_DESC(enable, "Use NEON for large copies if the CPU has it");
+
+static unsigned int pld_distance = 192;
+module_param(pld_distance, uint, 0644);
+MODULE_PARM_DESC(pld_distance, "Prefetch distance in bytes ahead of the source");
+
+static inline int neon_copy_allowed(void)
+{
+	return neon_usable && enable && !in_interrupt() && !irqs_disabled();
+}
+
+void *__memcpy_large(void *dest, const void *src, size_t n)
+{
+	size_t blocks = n & ~(size_t)63;
+
+	if (!neon_copy_allowed())
+		return __memcpy_arm(dest, src, n);
+
+	kernel_neon_begin();
+	__memcpy_neon(dest, src, blocks, pld_distance);
+	kernel_neon_end();
+
+	if (n != blocks)
+		__memcpy_arm(dest + blocks, src + blocks, n - blocks);
+
+	return dest;
+}
+
+void copy_page(void *to, const void *from)
+{
+	if (!neon_copy_allowed()) {
+		__copy_page_arm(to, from);
+		return;
+	}
+
+	kernel_neon_begin();
+	__memcpy_neon(to, from, PAGE_SIZE, pld_distance);
+	kernel_neon_end();
+}
+
+/* HWCAP_NEON is only known once vfp_init() has run */
+static int __init memcpy_neon_init(void)
+{
+	neon_usable = cpu_has_neon();
+
+	printk(KERN_INFO "memcpy: NEON %s for copies of %d bytes and more\n",
+	       neon_usable && enable ? "used" : "not used", NEON_MEMCPY_MIN);
+
+	return 0;
+}
+late_initcall_sync(memcpy_neon_init);
@@ -14,9 +14,11 @@
 #include <linux/signal.h>
 #include <linux/sched.h>
 #include <linux/init.h>
+#include <linux/hardirq.h>
 
 #include <asm/thread_notify.h>
 #include <asm/vfp.h>
+#include <asm/neon.h>
 
 #include "vfpinstr.h"
 #include "vfp.h"
@@ -606,3 +608,28 @@ static int __init vfp_init(void)
 }
 
 late_initcall(vfp_init);
+
+#ifdef CONFIG_KERNEL_MODE_NEON
+
+void kernel_neon_begin(void)
+{
+	BUG_ON(in_interrupt());
+
+	preempt_disable();
+
+	/* Save any task state out of the registers and leave them unowned */
+	vfp_flush_context();
+
+	fmxr(FPEXC, fmrx(FPEXC) | FPEXC_EN);
+	isb();
+}
+EXPORT_SYMBOL(kernel_neon_begin);
+
+void kernel_neon_end(void)
+{
+	fmxr(FPEXC, fmrx(FPEXC) & ~FPEXC_EN);
+	preempt_enable();
+}
+EXPORT_SYMBOL(kernel_neon_end);
+
+#endif
@@ -66,14 +66,17 @@ static int lz4_decompress_crypto(struct crypto_tfm *tfm, const u8 *src,
 {
 	int err;
 	size_t tmp_len = *dlen;
-	size_t __slen = slen;
 
-	err = lz4_decompress(src, &__slen, dst, tmp_len);
+	/*
+	 * *dlen is the room in @dst, not the size of the data, which e.g.
+	 * UBIFS does not know, so bound both the input and the output.
+	 */
+	err = lz4_decompress_unknownoutputsize(src, slen, dst, &tmp_len);
 	if (err < 0)
 		return -EINVAL;
 
 	*dlen = tmp_len;
-	return err;
+	return 0;
 }
 
 static struct crypto_alg alg_lz4 = {
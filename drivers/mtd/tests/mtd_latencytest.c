@@ -0,0 +1,601 @@
+/*
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; see the file COPYING. If not, write to the Free Software
+ * Foundation, 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * Measure the latency of the individual operations of a MTD device.
+ *
+ * The test first erases, programs and reads the eraseblocks one by one,
+ * then programs them by sub-page, and finally runs a mixed workload of
+ * reads, page programs and erasures from several threads at once. Every
+ * operation is timed, and the results are printed as "key=value" lines
+ * which are easy to parse, e.g.:
+ *
+ *   mtd_latencytest: phase=seq op=read count=4096 min_us=25 avg_us=27 ...
+ *   mtd_latencytest: phase=seq op=read hist_us=32 count=4090
+ *
+ * where a "hist_us=N" line counts the operations which took less than N
+ * microseconds (and at least N/2). It works on nandsim as well as on real
+ * flash.
+ */
+
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/err.h>
+#include <linux/mtd/mtd.h>
+#include <linux/slab.h>
+#include <linux/sched.h>
+#include <linux/kthread.h>
+#include <linux/completion.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+
+#define PRINT_PREF KERN_INFO "mtd_latencytest: "
+
+#define MAX_THREADS 16
+#define LAT_BUCKETS 24
+
+static int dev;
+module_param(dev, int, S_IRUGO);
+MODULE_PARM_DESC(dev, "MTD device number to use");
+
+static int count;
+module_param(count, int, S_IRUGO);
+MODULE_PARM_DESC(count, "Number of eraseblocks to use (default: all)");
+
+static int threads = 4;
+module_param(threads, int, S_IRUGO);
+MODULE_PARM_DESC(threads, "Number of threads of the mixed workload "
+			  "(default: 4)");
+
+static int ops = 10000;
+module_param(ops, int, S_IRUGO);
+MODULE_PARM_DESC(ops, "Number of operations of the mixed workload, per "
+		      "thread (default: 10000)");
+
+static int read_pct = 70;
+module_param(read_pct, int, S_IRUGO);
+MODULE_PARM_DESC(read_pct, "Percentage of reads in the mixed workload "
+			   "(default: 70)");
+
+static int write_pct = 28;
+module_param(write_pct, int, S_IRUGO);
+MODULE_PARM_DESC(write_pct, "Percentage of page programs in the mixed "
+			    "workload, the rest are erasures (default: 28)");
+
+enum {
+	OP_READ,
+	OP_WRITE,
+	OP_SUBPAGE,
+	OP_ERASE,
+	OP_CNT,
+};
+
+static const char * const op_names[OP_CNT] = {
+	[OP_READ]    = "read",
+	[OP_WRITE]   = "write",
+	[OP_SUBPAGE] = "subpage_write",
+	[OP_ERASE]   = "erase",
+};
+
+struct lat_stats {
+	unsigned long long count;
+	u64 total_ns;
+	u64 min_ns;
+	u64 max_ns;
+	unsigned long hist[LAT_BUCKETS];
+};
+
+/*
+ * A thread of the mixed workload. Thread number @id owns every @threads-th
+ * good eraseblock, so that the threads never program the same eraseblock.
+ */
+struct bench_thread {
+	int id;
+	int err;
+	unsigned long next;
+	unsigned char *readbuf;
+	struct task_struct *task;
+	struct completion done;
+	struct lat_stats lat[OP_CNT];
+};
+
+static struct mtd_info *mtd;
+static unsigned char *writebuf;
+static int *goodebs;
+static int *wpos;
+static struct bench_thread *bench;
+
+static int pgsize;
+static int subpgsize;
+static int ebcnt;
+static int pgcnt;
+static int goodebcnt;
+
+static inline unsigned int simple_rand(unsigned long *next)
+{
+	*next = *next * 1103515245 + 12345;
+	return (unsigned int)((*next / 65536) % 32768);
+}
+
+static unsigned int rand_below(unsigned long *next, unsigned int n)
+{
+	unsigned int r = (simple_rand(next) << 15) | simple_rand(next);
+
+	return r % n;
+}
+
+static void lat_add(struct lat_stats *st, ktime_t start)
+{
+	u64 ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	u64 us = div_u64(ns, NSEC_PER_USEC);
+	int bucket;
+
+	bucket = us >> 31 ? LAT_BUCKETS - 1 : fls(us);
+	if (bucket >= LAT_BUCKETS)
+		bucket = LAT_BUCKETS - 1;
+
+	if (!st->count || ns < st->min_ns)
+		st->min_ns = ns;
+	if (ns > st->max_ns)
+		st->max_ns = ns;
+	st->count += 1;
+	st->total_ns += ns;
+	st->hist[bucket] += 1;
+}
+
+static void lat_merge(struct lat_stats *to, const struct lat_stats *from)
+{
+	int i;
+
+	if (!from->count)
+		return;
+	if (!to->count || from->min_ns < to->min_ns)
+		to->min_ns = from->min_ns;
+	if (from->max_ns > to->max_ns)
+		to->max_ns = from->max_ns;
+	to->count += from->count;
+	to->total_ns += from->total_ns;
+	for (i = 0; i < LAT_BUCKETS; i++)
+		to->hist[i] += from->hist[i];
+}
+
+/* The upper bound of the histogram bucket @pct percent fall into, in us */
+static unsigned long percentile(const struct lat_stats *st, int pct)
+{
+	unsigned long long want, seen = 0;
+	int i;
+
+	want = div_u64(st->count * pct + 99, 100);
+	for (i = 0; i < LAT_BUCKETS - 1; i++) {
+		seen += st->hist[i];
+		if (seen >= want)
+			break;
+	}
+	return 1UL << i;
+}
+
+static void print_stats(const char *phase, int op, const struct lat_stats *st)
+{
+	int i;
+
+	if (!st->count)
+		return;
+
+	printk(PRINT_PREF "phase=%s op=%s count=%llu min_us=%llu avg_us=%llu "
+	       "p50_us=%lu p99_us=%lu max_us=%llu\n", phase, op_names[op],
+	       st->count, div_u64(st->min_ns, NSEC_PER_USEC),
+	       div64_u64(st->total_ns, st->count * NSEC_PER_USEC),
+	       percentile(st, 50), percentile(st, 99),
+	       div_u64(st->max_ns, NSEC_PER_USEC));
+	for (i = 0; i < LAT_BUCKETS; i++) {
+		if (!st->hist[i])
+			continue;
+		if (i < LAT_BUCKETS - 1)
+			printk(PRINT_PREF "phase=%s op=%s hist_us=%lu "
+			       "count=%lu\n", phase, op_names[op], 1UL << i,
+			       st->hist[i]);
+		else
+			printk(PRINT_PREF "phase=%s op=%s hist_us=inf "
+			       "count=%lu\n", phase, op_names[op], st->hist[i]);
+	}
+}
+
+static int erase_eraseblock(int ebnum, struct lat_stats *st)
+{
+	int err;
+	struct erase_info ei;
+	loff_t addr = (loff_t)ebnum * mtd->erasesize;
+	ktime_t start;
+
+	memset(&ei, 0, sizeof(struct erase_info));
+	ei.mtd  = mtd;
+	ei.addr = addr;
+	ei.len  = mtd->erasesize;
+
+	start = ktime_get();
+	err = mtd->erase(mtd, &ei);
+	if (st)
+		lat_add(st, start);
+	if (err) {
+		printk(PRINT_PREF "error %d while erasing EB %d\n", err, ebnum);
+		return err;
+	}
+
+	if (ei.state == MTD_ERASE_FAILED) {
+		printk(PRINT_PREF "some erase error occurred at EB %d\n",
+		       ebnum);
+		return -EIO;
+	}
+
+	return 0;
+}
+
+static int write_chunk(loff_t addr, int len, const void *buf,
+		       struct lat_stats *st)
+{
+	size_t written = 0;
+	ktime_t start;
+	int err;
+
+	start = ktime_get();
+	err = mtd->write(mtd, addr, len, &written, buf);
+	lat_add(st, start);
+	if (err || written != len) {
+		printk(PRINT_PREF "error: write failed at %#llx\n", addr);
+		if (!err)
+			err = -EINVAL;
+	}
+
+	return err;
+}
+
+static int read_page(loff_t addr, void *buf, struct lat_stats *st)
+{
+	size_t read = 0;
+	ktime_t start;
+	int err;
+
+	start = ktime_get();
+	err = mtd->read(mtd, addr, pgsize, &read, buf);
+	lat_add(st, start);
+	/* Ignore corrected ECC errors */
+	if (err == -EUCLEAN)
+		err = 0;
+	if (err || read != pgsize) {
+		printk(PRINT_PREF "error: read failed at %#llx\n", addr);
+		if (!err)
+			err = -EINVAL;
+	}
+
+	return err;
+}
+
+static int erase_all(struct lat_stats *st)
+{
+	int i, err;
+
+	for (i = 0; i < goodebcnt; i++) {
+		err = erase_eraseblock(goodebs[i], st);
+		if (err)
+			return err;
+		wpos[i] = 0;
+		cond_resched();
+	}
+	return 0;
+}
+
+/* Erase, program and read all eraseblocks one after the other */
+static int run_seq(struct lat_stats *lat, unsigned char *readbuf)
+{
+	int i, j, err;
+	loff_t addr;
+
+	printk(PRINT_PREF "sequential erase\n");
+	err = erase_all(&lat[OP_ERASE]);
+	if (err)
+		return err;
+
+	printk(PRINT_PREF "sequential page write\n");
+	for (i = 0; i < goodebcnt; i++) {
+		addr = (loff_t)goodebs[i] * mtd->erasesize;
+		for (j = 0; j < pgcnt; j++, addr += pgsize) {
+			err = write_chunk(addr, pgsize, writebuf + j * pgsize,
+					  &lat[OP_WRITE]);
+			if (err)
+				return err;
+		}
+		cond_resched();
+	}
+
+	printk(PRINT_PREF "sequential page read\n");
+	for (i = 0; i < goodebcnt; i++) {
+		addr = (loff_t)goodebs[i] * mtd->erasesize;
+		for (j = 0; j < pgcnt; j++, addr += pgsize) {
+			err = read_page(addr, readbuf, &lat[OP_READ]);
+			if (err)
+				return err;
+		}
+		cond_resched();
+	}
+
+	if (subpgsize == pgsize) {
+		printk(PRINT_PREF "no sub-pages, skip sub-page write\n");
+		return 0;
+	}
+
+	printk(PRINT_PREF "sequential sub-page write\n");
+	err = erase_all(NULL);
+	if (err)
+		return err;
+	for (i = 0; i < goodebcnt; i++) {
+		addr = (loff_t)goodebs[i] * mtd->erasesize;
+		for (j = 0; j < mtd->erasesize / subpgsize;
+		     j++, addr += subpgsize) {
+			err = write_chunk(addr, subpgsize,
+					  writebuf + j * subpgsize,
+					  &lat[OP_SUBPAGE]);
+			if (err)
+				return err;
+		}
+		cond_resched();
+	}
+	return 0;
+}
+
+/* One operation of the mixed workload on eraseblock number @idx */
+static int mixed_op(struct bench_thread *t, int idx)
+{
+	loff_t addr = (loff_t)goodebs[idx] * mtd->erasesize;
+	unsigned int r = rand_below(&t->next, 100);
+	int err, page;
+
+	if (r < read_pct) {
+		/* Read what was programmed, or anything if nothing was */
+		page = rand_below(&t->next, wpos[idx] ? wpos[idx] : pgcnt);
+		return read_page(addr + page * pgsize, t->readbuf,
+				 &t->lat[OP_READ]);
+	}
+
+	if (r < read_pct + write_pct) {
+		if (wpos[idx] == pgcnt) {
+			err = erase_eraseblock(goodebs[idx], &t->lat[OP_ERASE]);
+			if (err)
+				return err;
+			wpos[idx] = 0;
+		}
+		page = wpos[idx]++;
+		return write_chunk(addr + page * pgsize, pgsize,
+				   writebuf + page * pgsize, &t->lat[OP_WRITE]);
+	}
+
+	wpos[idx] = 0;
+	return erase_eraseblock(goodebs[idx], &t->lat[OP_ERASE]);
+}
+
+static int mixed_thread(void *arg)
+{
+	struct bench_thread *t = arg;
+	int i, idx, owned;
+
+	owned = (goodebcnt - t->id + threads - 1) / threads;
+	for (i = 0; i < ops && owned; i++) {
+		idx = rand_below(&t->next, owned) * threads + t->id;
+		t->err = mixed_op(t, idx);
+		if (t->err)
+			break;
+		cond_resched();
+	}
+	complete(&t->done);
+
+	/* Returning before kthread_stop() would let the task be freed */
+	set_current_state(TASK_INTERRUPTIBLE);
+	while (!kthread_should_stop()) {
+		schedule();
+		set_current_state(TASK_INTERRUPTIBLE);
+	}
+	__set_current_state(TASK_RUNNING);
+	return 0;
+}
+
+static int run_mixed(void)
+{
+	struct lat_stats lat[OP_CNT];
+	unsigned long long total = 0;
+	ktime_t start;
+	s64 ms;
+	int i, k, err = 0, started;
+
+	err = erase_all(NULL);
+	if (err)
+		return err;
+
+	printk(PRINT_PREF "mixed workload: %d threads, %d%% reads, %d%% page "
+	       "writes, %d%% erasures\n", threads, read_pct, write_pct,
+	       100 - read_pct - write_pct);
+
+	start = ktime_get();
+	for (started = 0; started < threads; started++) {
+		struct bench_thread *t = &bench[started];
+
+		t->task = kthread_run(mixed_thread, t, "mtd_latency%d",
+				      started);
+		if (IS_ERR(t->task)) {
+			err = PTR_ERR(t->task);
+			printk(PRINT_PREF "error: cannot start thread %d\n",
+			       started);
+			break;
+		}
+	}
+	for (i = 0; i < started; i++) {
+		wait_for_completion(&bench[i].done);
+		kthread_stop(bench[i].task);
+		if (bench[i].err && !err)
+			err = bench[i].err;
+	}
+	ms = ktime_to_ms(ktime_sub(ktime_get(), start));
+	if (err)
+		return err;
+
+	memset(lat, 0, sizeof(lat));
+	for (i = 0; i < threads; i++)
+		for (k = 0; k < OP_CNT; k++)
+			lat_merge(&lat[k], &bench[i].lat[k]);
+	for (k = 0; k < OP_CNT; k++) {
+		total += lat[k].count;
+		print_stats("mixed", k, &lat[k]);
+	}
+	printk(PRINT_PREF "phase=mixed threads=%d ops=%llu time_ms=%lld "
+	       "ops_per_sec=%llu\n", threads, total, ms,
+	       ms ? div64_u64(total * 1000, ms) : 0);
+	return 0;
+}
+
+static int scan_for_bad_eraseblocks(void)
+{
+	int i, bad = 0;
+
+	goodebs = kmalloc(ebcnt * sizeof(int), GFP_KERNEL);
+	wpos = kzalloc(ebcnt * sizeof(int), GFP_KERNEL);
+	if (!goodebs || !wpos) {
+		printk(PRINT_PREF "error: cannot allocate memory\n");
+		return -ENOMEM;
+	}
+
+	printk(PRINT_PREF "scanning for bad eraseblocks\n");
+	for (i = 0; i < ebcnt; ++i) {
+		/* NOR flash does not implement block_isbad */
+		if (mtd->block_isbad &&
+		    mtd->block_isbad(mtd, (loff_t)i * mtd->erasesize)) {
+			printk(PRINT_PREF "block %d is bad\n", i);
+			bad += 1;
+			continue;
+		}
+		goodebs[goodebcnt++] = i;
+		cond_resched();
+	}
+	printk(PRINT_PREF "scanned %d eraseblocks, %d are bad\n", i, bad);
+	return 0;
+}
+
+static int __init mtd_latencytest_init(void)
+{
+	struct lat_stats lat[OP_CNT];
+	int err, i, k;
+	uint64_t tmp;
+
+	printk(KERN_INFO "\n");
+	printk(KERN_INFO "=================================================\n");
+	printk(PRINT_PREF "MTD device: %d\n", dev);
+
+	if (threads < 1 || threads > MAX_THREADS || ops < 0 ||
+	    read_pct < 0 || write_pct < 0 || read_pct + write_pct > 100) {
+		printk(PRINT_PREF "error: invalid parameters\n");
+		return -EINVAL;
+	}
+
+	mtd = get_mtd_device(NULL, dev);
+	if (IS_ERR(mtd)) {
+		err = PTR_ERR(mtd);
+		printk(PRINT_PREF "error: cannot get MTD device\n");
+		return err;
+	}
+
+	if (mtd->writesize == 1) {
+		printk(PRINT_PREF "not NAND flash, assume page size is 512 "
+		       "bytes.\n");
+		pgsize = 512;
+	} else
+		pgsize = mtd->writesize;
+	subpgsize = pgsize >> mtd->subpage_sft;
+
+	tmp = mtd->size;
+	do_div(tmp, mtd->erasesize);
+	ebcnt = tmp;
+	if (count > 0 && count < ebcnt)
+		ebcnt = count;
+	pgcnt = mtd->erasesize / pgsize;
+
+	printk(PRINT_PREF "MTD device size %llu, eraseblock size %u, "
+	       "page size %u, sub-page size %u, count of eraseblocks %u, "
+	       "pages per eraseblock %u, OOB size %u\n",
+	       (unsigned long long)mtd->size, mtd->erasesize, pgsize,
+	       subpgsize, ebcnt, pgcnt, mtd->oobsize);
+
+	err = -ENOMEM;
+	writebuf = kmalloc(mtd->erasesize, GFP_KERNEL);
+	bench = kzalloc(threads * sizeof(struct bench_thread), GFP_KERNEL);
+	if (!writebuf || !bench)
+		goto out_nomem;
+	for (i = 0; i < threads; i++) {
+		bench[i].id = i;
+		bench[i].next = i + 1;
+		init_completion(&bench[i].done);
+		bench[i].readbuf = kmalloc(pgsize, GFP_KERNEL);
+		if (!bench[i].readbuf)
+			goto out_nomem;
+	}
+
+	for (i = 0; i < mtd->erasesize; i++)
+		writebuf[i] = simple_rand(&bench[0].next);
+
+	err = scan_for_bad_eraseblocks();
+	if (err)
+		goto out;
+	if (goodebcnt < threads) {
+		printk(PRINT_PREF "error: fewer good eraseblocks than "
+		       "threads\n");
+		err = -EINVAL;
+		goto out;
+	}
+
+	memset(lat, 0, sizeof(lat));
+	err = run_seq(lat, bench[0].readbuf);
+	if (err)
+		goto out;
+	for (k = 0; k < OP_CNT; k++)
+		print_stats("seq", k, &lat[k]);
+
+	err = run_mixed();
+	if (err)
+		goto out;
+
+	printk(PRINT_PREF "finished\n");
+	goto out;
+
+out_nomem:
+	printk(PRINT_PREF "error: cannot allocate memory\n");
+out:
+	if (bench)
+		for (i = 0; i < threads; i++)
+			kfree(bench[i].readbuf);
+	kfree(bench);
+	kfree(writebuf);
+	kfree(goodebs);
+	kfree(wpos);
+	put_mtd_device(mtd);
+	if (err)
+		printk(PRINT_PREF "error %d occurred\n", err);
+	printk(KERN_INFO "=================================================\n");
+	return err;
+}
+module_init(mtd_latencytest_init);
+
+static void __exit mtd_latencytest_exit(void)
+{
+	return;
+}
+module_exit(mtd_latencytest_exit);
+
+MODULE_DESCRIPTION("Latency test module");
+MODULE_LICENSE("GPL");
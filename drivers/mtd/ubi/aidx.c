@@ -0,0 +1,865 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See
+ * the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+/*
+ * UBI attach index sub-system.
+ *
+ * Attaching an MTD device by scanning reads the EC and VID headers of all its
+ * physical eraseblocks, which takes long on large NAND flashes. The attach
+ * index is a snapshot of what scanning would find: for each PEB, its erase
+ * counter and the LEB it is mapped to, or whether it is free, has to be
+ * erased or is bad. It is stored in the data areas of a few PEBs belonging to
+ * the %UBI_AIDX_VOLUME_ID internal volume (see &struct ubi_aidx_hdr). LEB 0
+ * of this volume, the anchor, is always one of the first
+ * %UBI_AIDX_ANCHOR_PEBS PEBs, so attaching only has to read the VID headers
+ * of these and then the index.
+ *
+ * The attach index describes the flash only as long as nothing changes. The
+ * tasks which change the flash do it between 'ubi_aidx_begin()' and
+ * 'ubi_aidx_end()', and the first of them after the index was written
+ * invalidates it by programming the last min. I/O unit of the anchor. The
+ * index is written again by a work once the device has been idle for
+ * %AIDX_WRITE_DELAY, at reboot and when the device is detached. The writer
+ * takes @ubi->aidx_sem in write mode, which excludes all changes meanwhile.
+ *
+ * The PEBs of the attach index are not known to the wear-leveling trees, so
+ * the wear-leveling worker never moves them. Each time the index is written,
+ * the old PEBs are erased and new ones are taken from the free ones with the
+ * lowest erase counters.
+ *
+ * When the attach index is missing or invalid, UBI attaches by scanning as
+ * usual. The scanning sub-system then invalidates the stale anchor if there
+ * is one, and puts the index PEBs to the erase list.
+ */
+
+#include <linux/crc32.h>
+#include <linux/err.h>
+#include <linux/jiffies.h>
+#include <linux/reboot.h>
+#include "ubi.h"
+
+/* How long the device has to be idle before the attach index is written */
+#define AIDX_WRITE_DELAY (5 * HZ)
+
+/*
+ * aidx_room - the room for the attach index in one PEB.
+ * @ubi: UBI device description object
+ *
+ * The last min. I/O unit of the data area is the invalidation marker.
+ */
+static int aidx_room(const struct ubi_device *ubi)
+{
+	return ubi->leb_size - ubi->min_io_size;
+}
+
+/*
+ * aidx_max_size - the maximum size of the attach index.
+ * @ubi: UBI device description object
+ */
+static int aidx_max_size(const struct ubi_device *ubi)
+{
+	return UBI_AIDX_HDR_SIZE +
+	       (ubi->vtbl_slots + UBI_INT_VOL_COUNT) * UBI_AIDX_VOL_SIZE +
+	       ubi->peb_count * UBI_AIDX_PEB_SIZE;
+}
+
+/**
+ * release_pebs - give back all the PEBs held by the attach index.
+ * @ubi: UBI device description object
+ * @erase: if the PEBs have to be erased
+ *
+ * The anchor goes first. This function returns zero in case of success and
+ * the error code of the first PEB which could not be erased in case of
+ * failure. The PEBs are given back anyway.
+ */
+static int release_pebs(struct ubi_device *ubi, int erase)
+{
+	int err, i, ret = 0;
+
+	for (i = 0; i < ubi->aidx_cnt; i++) {
+		err = ubi_wl_put_aidx_peb(ubi, ubi->aidx_pebs[i], erase);
+		if (err && !ret)
+			ret = err;
+	}
+	ubi->aidx_cnt = 0;
+	return ret;
+}
+
+/**
+ * ubi_aidx_invalidate - invalidate the attach index on the flash.
+ * @ubi: UBI device description object
+ *
+ * This function has to be called before the flash is changed. If the
+ * invalidation marker cannot be programmed, the anchor is erased instead.
+ * Returns zero in case of success and a negative error code in case of
+ * failure, in which case UBI is switched to read-only mode.
+ */
+int ubi_aidx_invalidate(struct ubi_device *ubi)
+{
+	int err = 0;
+	void *buf;
+
+	if (!ubi->aidx_valid)
+		return 0;
+
+	mutex_lock(&ubi->aidx_mutex);
+	if (!ubi->aidx_valid)
+		goto out_unlock;
+
+	err = -EROFS;
+	if (ubi->ro_mode)
+		goto out_unlock;
+
+	err = -ENOMEM;
+	buf = kzalloc(ubi->min_io_size, GFP_NOFS);
+	if (!buf)
+		goto out_unlock;
+
+	dbg_msg("invalidate the attach index at PEB %d", ubi->aidx_pebs[0]);
+	err = ubi_io_write_data(ubi, buf, ubi->aidx_pebs[0], aidx_room(ubi),
+				ubi->min_io_size);
+	kfree(buf);
+	if (err) {
+		ubi_warn("cannot invalidate the attach index, error %d, "
+			 "erase it", err);
+		err = release_pebs(ubi, 1);
+		if (err) {
+			ubi_ro_mode(ubi);
+			goto out_unlock;
+		}
+	}
+	ubi->aidx_valid = 0;
+
+out_unlock:
+	mutex_unlock(&ubi->aidx_mutex);
+	return err;
+}
+
+/**
+ * ubi_aidx_begin - start changing the flash.
+ * @ubi: UBI device description object
+ *
+ * This function invalidates the attach index if needed and excludes the
+ * writer until 'ubi_aidx_end()' is called. Returns zero in case of success
+ * and a negative error code in case of failure.
+ */
+int ubi_aidx_begin(struct ubi_device *ubi)
+{
+	int err;
+
+	down_read(&ubi->aidx_sem);
+	err = ubi_aidx_invalidate(ubi);
+	if (err) {
+		up_read(&ubi->aidx_sem);
+		return err;
+	}
+
+	ubi->aidx_changed = jiffies;
+	if (ubi->aidx_enabled && !test_and_set_bit(0, &ubi->aidx_dirty))
+		schedule_delayed_work(&ubi->aidx_work, AIDX_WRITE_DELAY);
+	return 0;
+}
+
+/**
+ * ubi_aidx_end - done changing the flash.
+ * @ubi: UBI device description object
+ */
+void ubi_aidx_end(struct ubi_device *ubi)
+{
+	ubi->aidx_changed = jiffies;
+	up_read(&ubi->aidx_sem);
+}
+
+/**
+ * fill_vols - fill the volume records of the attach index.
+ * @ubi: UBI device description object
+ * @avol: the first volume record
+ *
+ * This function returns the number of volume records.
+ */
+static int fill_vols(struct ubi_device *ubi, struct ubi_aidx_vol *avol)
+{
+	int i, vol_count = 0;
+
+	for (i = 0; i < ubi->vtbl_slots + UBI_INT_VOL_COUNT; i++) {
+		struct ubi_volume *vol = ubi->volumes[i];
+
+		if (!vol)
+			continue;
+
+		avol->vol_id = cpu_to_be32(vol->vol_id);
+		avol->data_pad = cpu_to_be32(vol->data_pad);
+		if (vol->vol_type == UBI_STATIC_VOLUME) {
+			avol->vol_type = UBI_VID_STATIC;
+			avol->used_ebs = cpu_to_be32(vol->used_ebs);
+			avol->last_data_size = cpu_to_be32(vol->last_eb_bytes);
+		} else
+			avol->vol_type = UBI_VID_DYNAMIC;
+		if (vol->vol_id == UBI_LAYOUT_VOLUME_ID)
+			avol->compat = UBI_LAYOUT_VOLUME_COMPAT;
+
+		avol += 1;
+		vol_count += 1;
+	}
+
+	return vol_count;
+}
+
+/**
+ * fill_pebs - fill the PEB records of the attach index.
+ * @ubi: UBI device description object
+ * @apeb: the PEB records
+ *
+ * This function returns the number of bad PEBs in case of success and a
+ * negative error code in case of failure.
+ */
+static int fill_pebs(struct ubi_device *ubi, struct ubi_aidx_peb *apeb)
+{
+	int err, i, lnum, pnum, bad = 0;
+	struct ubi_wl_entry *e;
+	struct rb_node *rb;
+
+	/* What is not free, mapped or the index is pending erasure */
+	for (pnum = 0; pnum < ubi->peb_count; pnum++) {
+		err = ubi_io_is_bad(ubi, pnum);
+		if (err < 0)
+			return err;
+		if (err) {
+			apeb[pnum].vol_id = cpu_to_be32(UBI_AIDX_PEB_BAD);
+			bad += 1;
+			continue;
+		}
+
+		apeb[pnum].vol_id = cpu_to_be32(UBI_AIDX_PEB_ERASE);
+		spin_lock(&ubi->wl_lock);
+		e = ubi->lookuptbl[pnum];
+		apeb[pnum].ec = cpu_to_be32(e ? e->ec : ubi->mean_ec);
+		spin_unlock(&ubi->wl_lock);
+	}
+
+	spin_lock(&ubi->wl_lock);
+	ubi_rb_for_each_entry(rb, e, &ubi->free, u.rb)
+		apeb[e->pnum].vol_id = cpu_to_be32(UBI_AIDX_PEB_FREE);
+	spin_unlock(&ubi->wl_lock);
+
+	for (i = 0; i < ubi->aidx_cnt; i++) {
+		pnum = ubi->aidx_pebs[i];
+		apeb[pnum].vol_id = cpu_to_be32(UBI_AIDX_VOLUME_ID);
+		apeb[pnum].lnum = cpu_to_be32(i);
+	}
+
+	for (i = 0; i < ubi->vtbl_slots + UBI_INT_VOL_COUNT; i++) {
+		struct ubi_volume *vol = ubi->volumes[i];
+
+		if (!vol)
+			continue;
+
+		for (lnum = 0; lnum < vol->reserved_pebs; lnum++) {
+			pnum = vol->eba_tbl[lnum];
+			if (pnum < 0)
+				continue;
+			apeb[pnum].vol_id = cpu_to_be32(vol->vol_id);
+			apeb[pnum].lnum = cpu_to_be32(lnum);
+		}
+	}
+
+	return bad;
+}
+
+/**
+ * aidx_write - write the attach index.
+ * @ubi: UBI device description object
+ *
+ * The caller has to hold @ubi->aidx_sem in write mode. This function returns
+ * zero in case of success and a negative error code in case of failure.
+ */
+static int aidx_write(struct ubi_device *ubi)
+{
+	int err, i, nr, size, vol_count, room = aidx_room(ubi);
+	unsigned long long sqnum[UBI_AIDX_MAX_PEBS];
+	struct ubi_vid_hdr *vid_hdr;
+	struct ubi_aidx_hdr *hdr;
+	struct ubi_aidx_vol *avol;
+	void *buf;
+
+	if (ubi->ro_mode)
+		return -EROFS;
+
+	buf = vmalloc(UBI_AIDX_MAX_PEBS * room);
+	if (!buf)
+		return -ENOMEM;
+	memset(buf, 0, UBI_AIDX_MAX_PEBS * room);
+
+	err = -ENOMEM;
+	vid_hdr = ubi_zalloc_vid_hdr(ubi, GFP_NOFS);
+	if (!vid_hdr)
+		goto out_free;
+
+	/* The old index is invalid, give its PEBs back */
+	release_pebs(ubi, 1);
+
+	hdr = buf;
+	avol = buf + UBI_AIDX_HDR_SIZE;
+	vol_count = fill_vols(ubi, avol);
+	size = UBI_AIDX_HDR_SIZE + vol_count * UBI_AIDX_VOL_SIZE +
+	       ubi->peb_count * UBI_AIDX_PEB_SIZE;
+	nr = DIV_ROUND_UP(size, room);
+	ubi_assert(nr <= UBI_AIDX_MAX_PEBS);
+
+	/* The anchor has to be one of the first PEBs */
+	for (i = 0; i < nr; i++) {
+		int pnum;
+
+		pnum = ubi_wl_get_aidx_peb(ubi, i ? ubi->peb_count :
+					   UBI_AIDX_ANCHOR_PEBS);
+		if (pnum < 0) {
+			err = pnum;
+			if (err == -ENOSPC)
+				ubi_warn("no free PEB for the attach index");
+			goto out_vid_hdr;
+		}
+		ubi->aidx_pebs[ubi->aidx_cnt++] = pnum;
+	}
+
+	err = fill_pebs(ubi, (void *)(avol + vol_count));
+	if (err < 0)
+		goto out_vid_hdr;
+
+	/* The anchor is written last, so it gets the highest sequence number */
+	for (i = nr - 1; i >= 0; i--)
+		sqnum[i] = ubi_next_sqnum(ubi);
+
+	hdr->magic = cpu_to_be32(UBI_AIDX_MAGIC);
+	hdr->version = UBI_AIDX_VERSION;
+	hdr->peb_count = cpu_to_be32(ubi->peb_count);
+	hdr->bad_peb_count = cpu_to_be32(err);
+	hdr->vol_count = cpu_to_be32(vol_count);
+	hdr->image_seq = cpu_to_be32(ubi->image_seq);
+	hdr->max_sqnum = cpu_to_be64(sqnum[0]);
+	hdr->data_size = cpu_to_be32(size - UBI_AIDX_HDR_SIZE);
+	hdr->data_crc = cpu_to_be32(crc32(UBI_CRC32_INIT,
+					  buf + UBI_AIDX_HDR_SIZE,
+					  size - UBI_AIDX_HDR_SIZE));
+	hdr->nr_pebs = cpu_to_be32(nr);
+	for (i = 0; i < nr; i++)
+		hdr->pebs[i] = cpu_to_be32(ubi->aidx_pebs[i]);
+	hdr->hdr_crc = cpu_to_be32(crc32(UBI_CRC32_INIT, hdr,
+					 UBI_AIDX_HDR_SIZE_CRC));
+
+	vid_hdr->vol_type = UBI_AIDX_VOLUME_TYPE;
+	vid_hdr->vol_id = cpu_to_be32(UBI_AIDX_VOLUME_ID);
+	vid_hdr->compat = UBI_AIDX_VOLUME_COMPAT;
+
+	for (i = nr - 1; i >= 0; i--) {
+		int pnum = ubi->aidx_pebs[i];
+		int len = min(room, size - i * room);
+
+		vid_hdr->lnum = cpu_to_be32(i);
+		vid_hdr->sqnum = cpu_to_be64(sqnum[i]);
+		err = ubi_io_write_vid_hdr(ubi, pnum, vid_hdr);
+		if (err)
+			goto out_vid_hdr;
+
+		err = ubi_io_write_data(ubi, buf + i * room, pnum, 0,
+					ALIGN(len, ubi->min_io_size));
+		if (err)
+			goto out_vid_hdr;
+	}
+
+	mutex_lock(&ubi->aidx_mutex);
+	ubi->aidx_valid = 1;
+	mutex_unlock(&ubi->aidx_mutex);
+	dbg_msg("attach index written to %d PEBs, anchor at PEB %d", nr,
+		ubi->aidx_pebs[0]);
+
+out_vid_hdr:
+	ubi_free_vid_hdr(ubi, vid_hdr);
+out_free:
+	vfree(buf);
+	return err;
+}
+
+/**
+ * ubi_aidx_sync - write the attach index if it is not valid.
+ * @ubi: UBI device description object
+ */
+void ubi_aidx_sync(struct ubi_device *ubi)
+{
+	int err;
+
+	if (!ubi->aidx_enabled)
+		return;
+
+	mutex_lock(&ubi->device_mutex);
+	down_write(&ubi->aidx_sem);
+	if (!ubi->aidx_valid) {
+		err = aidx_write(ubi);
+		if (err && err != -EROFS)
+			ubi_warn("cannot write the attach index, error %d",
+				 err);
+	}
+	up_write(&ubi->aidx_sem);
+	mutex_unlock(&ubi->device_mutex);
+}
+
+/* Writes the attach index once the device has been idle long enough */
+static void aidx_work_fn(struct work_struct *work)
+{
+	struct ubi_device *ubi = container_of(work, struct ubi_device,
+					      aidx_work.work);
+	unsigned long idle_end = ubi->aidx_changed + AIDX_WRITE_DELAY;
+
+	if (time_before(jiffies, idle_end)) {
+		schedule_delayed_work(&ubi->aidx_work, idle_end - jiffies);
+		return;
+	}
+
+	clear_bit(0, &ubi->aidx_dirty);
+	ubi_aidx_sync(ubi);
+}
+
+static int aidx_reboot_notify(struct notifier_block *nb, unsigned long event,
+			      void *unused)
+{
+	struct ubi_device *ubi = container_of(nb, struct ubi_device,
+					      aidx_reboot_nb);
+
+	ubi_aidx_sync(ubi);
+	return NOTIFY_DONE;
+}
+
+/**
+ * find_vol - find a volume record of the attach index.
+ * @avol: the volume records
+ * @vol_count: count of volume records
+ * @vol_id: the volume to look for
+ * @hint: the record found last time, checked first
+ */
+static struct ubi_aidx_vol *find_vol(struct ubi_aidx_vol *avol, int vol_count,
+				     int vol_id, struct ubi_aidx_vol *hint)
+{
+	int i;
+
+	if (hint && be32_to_cpu(hint->vol_id) == vol_id)
+		return hint;
+
+	for (i = 0; i < vol_count; i++)
+		if (be32_to_cpu(avol[i].vol_id) == vol_id)
+			return &avol[i];
+	return NULL;
+}
+
+/**
+ * check_vol - check a volume record of the attach index.
+ * @avol: the volume record
+ *
+ * This function returns zero if the record is fine and %-EINVAL if not.
+ */
+static int check_vol(const struct ubi_aidx_vol *avol)
+{
+	int vol_id = be32_to_cpu(avol->vol_id);
+
+	if ((vol_id < 0 || vol_id >= UBI_MAX_VOLUMES) &&
+	    vol_id != UBI_LAYOUT_VOLUME_ID)
+		return -EINVAL;
+	if (avol->vol_type != UBI_VID_DYNAMIC &&
+	    avol->vol_type != UBI_VID_STATIC)
+		return -EINVAL;
+	if ((int)be32_to_cpu(avol->used_ebs) < 0 ||
+	    (int)be32_to_cpu(avol->data_pad) < 0 ||
+	    (int)be32_to_cpu(avol->last_data_size) < 0)
+		return -EINVAL;
+	return 0;
+}
+
+/**
+ * scan_info - build the scanning information from the attach index.
+ * @ubi: UBI device description object
+ * @hdr: the attach index
+ * @si: the scanning information to fill
+ *
+ * This function returns zero in case of success, %-EINVAL if the attach index
+ * is inconsistent, and another negative error code in case of failure.
+ */
+static int scan_info(struct ubi_device *ubi, struct ubi_aidx_hdr *hdr,
+		     struct ubi_scan_info *si)
+{
+	int err, i, pnum, nr = be32_to_cpu(hdr->nr_pebs);
+	int vol_count = be32_to_cpu(hdr->vol_count), found = 0;
+	struct ubi_aidx_vol *avol = (void *)hdr + UBI_AIDX_HDR_SIZE, *v = NULL;
+	struct ubi_aidx_peb *apeb = (void *)(avol + vol_count);
+	struct ubi_vid_hdr vid_hdr;
+
+	for (i = 0; i < vol_count; i++)
+		if (check_vol(&avol[i]))
+			return -EINVAL;
+
+	memset(&vid_hdr, 0, sizeof(struct ubi_vid_hdr));
+	for (pnum = 0; pnum < ubi->peb_count; pnum++) {
+		int vol_id = be32_to_cpu(apeb[pnum].vol_id);
+		int lnum = be32_to_cpu(apeb[pnum].lnum);
+		int ec = be32_to_cpu(apeb[pnum].ec);
+
+		if (vol_id == UBI_AIDX_PEB_BAD) {
+			si->bad_peb_count += 1;
+			continue;
+		}
+
+		if (ec < 0 || ec > UBI_MAX_ERASECOUNTER)
+			return -EINVAL;
+
+		if (vol_id == UBI_AIDX_PEB_FREE)
+			err = ubi_scan_add_to_list(si, pnum, ec, &si->free);
+		else if (vol_id == UBI_AIDX_PEB_ERASE)
+			err = ubi_scan_add_to_list(si, pnum, ec, &si->erase);
+		else if (vol_id == UBI_AIDX_VOLUME_ID) {
+			/* The index itself */
+			if (lnum < 0 || lnum >= nr ||
+			    be32_to_cpu(hdr->pebs[lnum]) != pnum)
+				return -EINVAL;
+			ubi->aidx_ec[lnum] = ec;
+			found |= 1 << lnum;
+			err = 0;
+		} else {
+			v = find_vol(avol, vol_count, vol_id, v);
+			if (!v || lnum < 0)
+				return -EINVAL;
+
+			vid_hdr.vol_type = v->vol_type;
+			vid_hdr.compat = v->compat;
+			vid_hdr.vol_id = v->vol_id;
+			vid_hdr.lnum = apeb[pnum].lnum;
+			vid_hdr.data_size = v->last_data_size;
+			vid_hdr.used_ebs = v->used_ebs;
+			vid_hdr.data_pad = v->data_pad;
+			err = ubi_scan_add_used(ubi, si, pnum, ec, &vid_hdr, 0);
+		}
+		if (err)
+			return err;
+
+		si->ec_sum += ec;
+		si->ec_count += 1;
+		if (ec > si->max_ec)
+			si->max_ec = ec;
+		if (ec < si->min_ec)
+			si->min_ec = ec;
+	}
+
+	if (found != (1 << nr) - 1 ||
+	    si->bad_peb_count != be32_to_cpu(hdr->bad_peb_count))
+		return -EINVAL;
+
+	if (si->ec_count)
+		si->mean_ec = div_u64(si->ec_sum, si->ec_count);
+	si->max_sqnum = be64_to_cpu(hdr->max_sqnum);
+	return 0;
+}
+
+/**
+ * find_anchor - find the anchor of the attach index.
+ * @ubi: UBI device description object
+ * @vid_hdr: buffer for the VID headers
+ *
+ * This function returns the anchor PEB number, or %-ENOENT if there is none
+ * or more than one.
+ */
+static int find_anchor(struct ubi_device *ubi, struct ubi_vid_hdr *vid_hdr)
+{
+	int err, pnum, anchor = -ENOENT;
+
+	for (pnum = 0; pnum < min(ubi->peb_count, UBI_AIDX_ANCHOR_PEBS);
+	     pnum++) {
+		if (ubi_io_is_bad(ubi, pnum))
+			continue;
+
+		/* Bit-flips are not tolerated, scanning will scrub them */
+		err = ubi_io_read_vid_hdr(ubi, pnum, vid_hdr, 0);
+		if (err)
+			continue;
+		if (be32_to_cpu(vid_hdr->vol_id) != UBI_AIDX_VOLUME_ID ||
+		    be32_to_cpu(vid_hdr->lnum) != 0)
+			continue;
+
+		if (anchor >= 0) {
+			ubi_warn("attach index anchors at PEBs %d and %d",
+				 anchor, pnum);
+			return -ENOENT;
+		}
+		anchor = pnum;
+	}
+
+	return anchor;
+}
+
+/**
+ * check_hdr - check the attach index header.
+ * @ubi: UBI device description object
+ * @hdr: the header
+ * @anchor: the PEB the header was read from
+ *
+ * This function returns zero if the header is fine and %-EINVAL if not.
+ */
+static int check_hdr(const struct ubi_device *ubi,
+		     const struct ubi_aidx_hdr *hdr, int anchor)
+{
+	int i, nr, vol_count, size;
+	uint32_t crc;
+
+	crc = crc32(UBI_CRC32_INIT, hdr, UBI_AIDX_HDR_SIZE_CRC);
+	if (be32_to_cpu(hdr->magic) != UBI_AIDX_MAGIC ||
+	    hdr->version != UBI_AIDX_VERSION ||
+	    be32_to_cpu(hdr->hdr_crc) != crc)
+		return -EINVAL;
+
+	nr = be32_to_cpu(hdr->nr_pebs);
+	vol_count = be32_to_cpu(hdr->vol_count);
+	if (be32_to_cpu(hdr->peb_count) != ubi->peb_count ||
+	    nr < 1 || nr > UBI_AIDX_MAX_PEBS ||
+	    vol_count < 0 || vol_count > UBI_MAX_VOLUMES + UBI_INT_VOL_COUNT ||
+	    be32_to_cpu(hdr->pebs[0]) != anchor)
+		return -EINVAL;
+
+	size = vol_count * UBI_AIDX_VOL_SIZE +
+	       ubi->peb_count * UBI_AIDX_PEB_SIZE;
+	if (be32_to_cpu(hdr->data_size) != size ||
+	    DIV_ROUND_UP(UBI_AIDX_HDR_SIZE + size, aidx_room(ubi)) != nr)
+		return -EINVAL;
+
+	for (i = 1; i < nr; i++)
+		if (be32_to_cpu(hdr->pebs[i]) >= ubi->peb_count)
+			return -EINVAL;
+	return 0;
+}
+
+/**
+ * read_aidx - read and check the attach index.
+ * @ubi: UBI device description object
+ * @anchor: the anchor PEB
+ * @vid_hdr: buffer for the VID headers
+ *
+ * This function returns the attach index in a vmalloc'ed buffer in case of
+ * success, %NULL if it is not valid, and %ERR_PTR(-ENOMEM) if memory is
+ * short.
+ */
+static void *read_aidx(struct ubi_device *ubi, int anchor,
+		       struct ubi_vid_hdr *vid_hdr)
+{
+	int err, i, nr, size, room = aidx_room(ubi);
+	struct ubi_aidx_hdr *hdr;
+	void *buf;
+	uint32_t crc;
+
+	buf = vmalloc(UBI_AIDX_MAX_PEBS * room);
+	if (!buf)
+		return ERR_PTR(-ENOMEM);
+	hdr = buf;
+
+	/* Is the invalidation marker still erased? */
+	err = ubi_io_read_data(ubi, buf, anchor, room, ubi->min_io_size);
+	if (err || !ubi_check_pattern(buf, 0xFF, ubi->min_io_size)) {
+		dbg_bld("attach index at PEB %d was invalidated", anchor);
+		goto out_invalid;
+	}
+
+	err = ubi_io_read_data(ubi, hdr, anchor, 0, UBI_AIDX_HDR_SIZE);
+	if (err || check_hdr(ubi, hdr, anchor)) {
+		ubi_warn("bad attach index header at PEB %d", anchor);
+		goto out_invalid;
+	}
+
+	nr = be32_to_cpu(hdr->nr_pebs);
+	size = UBI_AIDX_HDR_SIZE + be32_to_cpu(hdr->data_size);
+	for (i = 0; i < nr; i++) {
+		int pnum = be32_to_cpu(hdr->pebs[i]);
+
+		if (i) {
+			err = ubi_io_read_vid_hdr(ubi, pnum, vid_hdr, 0);
+			if (err ||
+			    be32_to_cpu(vid_hdr->vol_id) != UBI_AIDX_VOLUME_ID ||
+			    be32_to_cpu(vid_hdr->lnum) != i) {
+				ubi_warn("bad attach index PEB %d", pnum);
+				goto out_invalid;
+			}
+		}
+
+		err = ubi_io_read_data(ubi, buf + i * room, pnum, 0,
+				       min(room, size - i * room));
+		if (err) {
+			ubi_warn("cannot read attach index PEB %d, error %d",
+				 pnum, err);
+			goto out_invalid;
+		}
+	}
+
+	crc = crc32(UBI_CRC32_INIT, buf + UBI_AIDX_HDR_SIZE,
+		    size - UBI_AIDX_HDR_SIZE);
+	if (be32_to_cpu(hdr->data_crc) != crc) {
+		ubi_warn("bad attach index data CRC");
+		goto out_invalid;
+	}
+
+	return buf;
+
+out_invalid:
+	vfree(buf);
+	return NULL;
+}
+
+/**
+ * ubi_aidx_attach - get the scanning information from the attach index.
+ * @ubi: UBI device description object
+ *
+ * This function returns the scanning information in case of success, %NULL
+ * if there is no valid attach index, in which case the device has to be
+ * scanned, and an error pointer in case of failure.
+ */
+struct ubi_scan_info *ubi_aidx_attach(struct ubi_device *ubi)
+{
+	int err, i, anchor;
+	struct ubi_vid_hdr *vid_hdr;
+	struct ubi_aidx_hdr *hdr;
+	struct ubi_scan_info *si = NULL;
+
+	vid_hdr = ubi_zalloc_vid_hdr(ubi, GFP_KERNEL);
+	if (!vid_hdr)
+		return ERR_PTR(-ENOMEM);
+
+	anchor = find_anchor(ubi, vid_hdr);
+	if (anchor < 0) {
+		ubi_msg("no attach index found, scan the device");
+		goto out_vid_hdr;
+	}
+
+	hdr = read_aidx(ubi, anchor, vid_hdr);
+	if (IS_ERR_OR_NULL(hdr)) {
+		si = ERR_CAST(hdr);
+		if (!si)
+			ubi_msg("the attach index is invalid, scan the device");
+		goto out_vid_hdr;
+	}
+
+	si = ubi_scan_alloc_si();
+	if (!si) {
+		si = ERR_PTR(-ENOMEM);
+		goto out_hdr;
+	}
+
+	err = scan_info(ubi, hdr, si);
+	if (err) {
+		ubi_scan_destroy_si(si);
+		if (err == -ENOMEM) {
+			si = ERR_PTR(err);
+			goto out_hdr;
+		}
+		ubi_warn("inconsistent attach index, scan the device");
+		si = NULL;
+		goto out_hdr;
+	}
+
+	ubi->image_seq = be32_to_cpu(hdr->image_seq);
+	ubi->aidx_cnt = be32_to_cpu(hdr->nr_pebs);
+	for (i = 0; i < ubi->aidx_cnt; i++)
+		ubi->aidx_pebs[i] = be32_to_cpu(hdr->pebs[i]);
+	ubi->aidx_valid = 1;
+	ubi_msg("attach by means of the attach index at PEB %d", anchor);
+
+out_hdr:
+	vfree(hdr);
+out_vid_hdr:
+	ubi_free_vid_hdr(ubi, vid_hdr);
+	return si;
+}
+
+/**
+ * ubi_aidx_init - initialize the attach index sub-system.
+ * @ubi: UBI device description object
+ * @si: scanning information
+ *
+ * This function is called once the WL and EBA sub-systems are initialized.
+ * It reserves the PEBs the attach index needs, or disables it if it cannot be
+ * maintained for this device. Returns zero in case of success and a negative
+ * error code in case of failure.
+ */
+int ubi_aidx_init(struct ubi_device *ubi, struct ubi_scan_info *si)
+{
+	int err, i, nr;
+
+	INIT_DELAYED_WORK(&ubi->aidx_work, aidx_work_fn);
+
+	/* Take over the PEBs of the index UBI was attached from */
+	for (i = 0; i < ubi->aidx_cnt; i++) {
+		err = ubi_wl_add_aidx_peb(ubi, ubi->aidx_pebs[i],
+					  ubi->aidx_ec[i]);
+		if (err) {
+			ubi->aidx_cnt = i;
+			release_pebs(ubi, 0);
+			return err;
+		}
+	}
+
+	nr = DIV_ROUND_UP(aidx_max_size(ubi), aidx_room(ubi));
+	if (nr > UBI_AIDX_MAX_PEBS) {
+		ubi_warn("the attach index would need %d PEBs, disable it", nr);
+		goto out_disable;
+	}
+	if (si->alien_peb_count) {
+		ubi_warn("alien PEBs found, disable the attach index");
+		goto out_disable;
+	}
+	if (ubi->avail_pebs < nr) {
+		ubi_warn("no enough PEBs for the attach index (%d, need %d), "
+			 "disable it", ubi->avail_pebs, nr);
+		goto out_disable;
+	}
+	ubi->avail_pebs -= nr;
+	ubi->rsvd_pebs += nr;
+	ubi->aidx_enabled = 1;
+
+	ubi->aidx_reboot_nb.notifier_call = aidx_reboot_notify;
+	register_reboot_notifier(&ubi->aidx_reboot_nb);
+
+	/* Write it soon if UBI was attached by scanning */
+	if (!ubi->aidx_valid) {
+		ubi->aidx_changed = jiffies;
+		set_bit(0, &ubi->aidx_dirty);
+		schedule_delayed_work(&ubi->aidx_work, AIDX_WRITE_DELAY);
+	}
+
+	ubi_msg("attach index of %d PEBs enabled", nr);
+	return 0;
+
+out_disable:
+	ubi->aidx_valid = 0;
+	release_pebs(ubi, !ubi->ro_mode);
+	return 0;
+}
+
+/**
+ * ubi_aidx_close - close the attach index sub-system.
+ * @ubi: UBI device description object
+ *
+ * This function has to be called before the WL sub-system is closed. It does
+ * not write the attach index, see 'ubi_aidx_sync()'.
+ */
+void ubi_aidx_close(struct ubi_device *ubi)
+{
+	if (ubi->aidx_enabled) {
+		unregister_reboot_notifier(&ubi->aidx_reboot_nb);
+		cancel_delayed_work_sync(&ubi->aidx_work);
+		ubi->aidx_enabled = 0;
+	}
+	release_pebs(ubi, 0);
+}
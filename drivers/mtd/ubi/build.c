@@ -44,6 +44,7 @@
 #include <linux/kthread.h>
 #include <linux/kernel.h>
 #include <linux/slab.h>
+#include <linux/ktime.h>
 #include "ubi.h"
 
 /* Maximum length of the 'mtd=' parameter */
@@ -575,19 +576,22 @@ static void free_internal_volumes(struct ubi_device *ubi)
  * This function returns zero in case of success and a negative error code in
  * case of failure.
  *
- * Note, currently this is the only method to attach UBI devices. Hopefully in
- * the future we'll have more scalable attaching methods and avoid full media
- * scanning. But even in this case scanning will be needed as a fall-back
- * attaching method if there are some on-flash table corruptions.
+ * The scanning information comes from the attach index if there is a valid
+ * one (see aidx.c), and from full media scanning otherwise.
  */
 static int attach_by_scanning(struct ubi_device *ubi)
 {
 	int err;
 	struct ubi_scan_info *si;
+	ktime_t start = ktime_get();
 
-	si = ubi_scan(ubi);
+	si = ubi_aidx_attach(ubi);
+	if (!si)
+		si = ubi_scan(ubi);
 	if (IS_ERR(si))
 		return PTR_ERR(si);
+	ubi_msg("scanning information gathered in %lld ms",
+		ktime_to_ms(ktime_sub(ktime_get(), start)));
 
 	ubi->bad_peb_count = si->bad_peb_count;
 	ubi->good_peb_count = ubi->peb_count - ubi->bad_peb_count;
@@ -606,6 +610,10 @@ static int attach_by_scanning(struct ubi_device *ubi)
 	if (err)
 		goto out_wl;
 
+	err = ubi_aidx_init(ubi, si);
+	if (err)
+		goto out_wl;
+
 	ubi_scan_destroy_si(si);
 	return 0;
 
@@ -942,6 +950,14 @@ int ubi_attach_mtd_dev(struct mtd_info *mtd, int ubi_num, int vid_hdr_offset)
 		goto out_free;
 #endif
 
+#ifdef CONFIG_MTD_UBI_ATTACH_INDEX
+	init_rwsem(&ubi->aidx_sem);
+	mutex_init(&ubi->aidx_mutex);
+#endif
+#ifdef CONFIG_MTD_UBI_STATS
+	spin_lock_init(&ubi->stats_lock);
+#endif
+
 	err = attach_by_scanning(ubi);
 	if (err) {
 		dbg_err("failed to attach by scanning, error %d", err);
@@ -993,6 +1009,7 @@ int ubi_attach_mtd_dev(struct mtd_info *mtd, int ubi_num, int vid_hdr_offset)
 	wake_up_process(ubi->bgt_thread);
 	spin_unlock(&ubi->wl_lock);
 
+	ubi_stats_dev_init(ubi);
 	ubi_devices[ubi_num] = ubi;
 	ubi_notify_all(ubi, UBI_VOLUME_ADDED, NULL);
 	return ubi_num;
@@ -1000,6 +1017,7 @@ int ubi_attach_mtd_dev(struct mtd_info *mtd, int ubi_num, int vid_hdr_offset)
 out_uif:
 	uif_close(ubi);
 out_detach:
+	ubi_aidx_close(ubi);
 	ubi_wl_close(ubi);
 	free_internal_volumes(ubi);
 	vfree(ubi->vtbl);
@@ -1065,6 +1083,7 @@ int ubi_detach_mtd_dev(int ubi_num, int anyway)
 	 */
 	if (ubi->bgt_thread)
 		kthread_stop(ubi->bgt_thread);
+	ubi_stats_dev_exit(ubi);
 
 	/*
 	 * Get a reference to the device in order to prevent 'dev_release()'
@@ -1072,7 +1091,9 @@ int ubi_detach_mtd_dev(int ubi_num, int anyway)
 	 */
 	get_device(&ubi->dev);
 
+	ubi_aidx_sync(ubi);
 	uif_close(ubi);
+	ubi_aidx_close(ubi);
 	ubi_wl_close(ubi);
 	free_internal_volumes(ubi);
 	vfree(ubi->vtbl);
@@ -1194,6 +1215,8 @@ static int __init ubi_init(void)
 	if (!ubi_wl_entry_slab)
 		goto out_dev_unreg;
 
+	ubi_stats_init();
+
 	/* Attach MTD devices */
 	for (i = 0; i < mtd_devs; i++) {
 		struct mtd_dev_param *p = &mtd_dev_param[i];
@@ -1242,6 +1265,7 @@ out_detach:
 			ubi_detach_mtd_dev(ubi_devices[k]->ubi_num, 1);
 			mutex_unlock(&ubi_devices_mutex);
 		}
+	ubi_stats_exit();
 	kmem_cache_destroy(ubi_wl_entry_slab);
 out_dev_unreg:
 	misc_deregister(&ubi_ctrl_cdev);
@@ -1265,6 +1289,7 @@ static void __exit ubi_exit(void)
 			ubi_detach_mtd_dev(ubi_devices[i]->ubi_num, 1);
 			mutex_unlock(&ubi_devices_mutex);
 		}
+	ubi_stats_exit();
 	kmem_cache_destroy(ubi_wl_entry_slab);
 	misc_deregister(&ubi_ctrl_cdev);
 	class_remove_file(ubi_class, &ubi_version);
@@ -375,7 +375,7 @@ retry:
 }
 
 /**
- * check_pattern - check if buffer contains only a certain byte pattern.
+ * ubi_check_pattern - check if buffer contains only a certain byte pattern.
  * @buf: buffer to check
  * @patt: the pattern to check
  * @size: buffer size in bytes
@@ -383,7 +383,7 @@ retry:
  * This function returns %1 in there are only @patt bytes in @buf, and %0 if
  * something else was also found.
  */
-static int check_pattern(const void *buf, uint8_t patt, int size)
+int ubi_check_pattern(const void *buf, uint8_t patt, int size)
 {
 	int i;
 
@@ -424,7 +424,7 @@ static int torture_peb(struct ubi_device *ubi, int pnum)
 		if (err)
 			goto out;
 
-		err = check_pattern(ubi->peb_buf1, 0xFF, ubi->peb_size);
+		err = ubi_check_pattern(ubi->peb_buf1, 0xFF, ubi->peb_size);
 		if (err == 0) {
 			ubi_err("erased PEB %d, but a non-0xFF byte found",
 				pnum);
@@ -443,7 +443,8 @@ static int torture_peb(struct ubi_device *ubi, int pnum)
 		if (err)
 			goto out;
 
-		err = check_pattern(ubi->peb_buf1, patterns[i], ubi->peb_size);
+		err = ubi_check_pattern(ubi->peb_buf1, patterns[i],
+					ubi->peb_size);
 		if (err == 0) {
 			ubi_err("pattern %x checking failed for PEB %d",
 				patterns[i], pnum);
@@ -752,7 +753,7 @@ int ubi_io_read_ec_hdr(struct ubi_device *ubi, int pnum,
 		 * eraseblock and we anyway cannot treat it as empty.
 		 */
 		if (read_err != -EBADMSG &&
-		    check_pattern(ec_hdr, 0xFF, UBI_EC_HDR_SIZE)) {
+		    ubi_check_pattern(ec_hdr, 0xFF, UBI_EC_HDR_SIZE)) {
 			/* The physical eraseblock is supposedly empty */
 			if (verbose)
 				ubi_warn("no EC header found at PEB %d, "
@@ -1023,7 +1024,7 @@ int ubi_io_read_vid_hdr(struct ubi_device *ubi, int pnum,
 		 * eraseblock and it cannot be regarded as free.
 		 */
 		if (read_err != -EBADMSG &&
-		    check_pattern(vid_hdr, 0xFF, UBI_VID_HDR_SIZE)) {
+		    ubi_check_pattern(vid_hdr, 0xFF, UBI_VID_HDR_SIZE)) {
 			/* The physical eraseblock is supposedly free */
 			if (verbose)
 				ubi_warn("no VID header found at PEB %d, "
@@ -1377,7 +1378,7 @@ int ubi_dbg_check_all_ff(struct ubi_device *ubi, int pnum, int offset, int len)
 		goto error;
 	}
 
-	err = check_pattern(ubi->dbg_peb_buf, 0xFF, len);
+	err = ubi_check_pattern(ubi->dbg_peb_buf, 0xFF, len);
 	if (err == 0) {
 		ubi_err("flash region at PEB %d:%d, length %d does not "
 			"contain all 0xFF bytes", pnum, offset, len);
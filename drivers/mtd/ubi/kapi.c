@@ -385,6 +385,7 @@ int ubi_leb_read(struct ubi_volume_desc *desc, int lnum, char *buf, int offset,
 	struct ubi_volume *vol = desc->vol;
 	struct ubi_device *ubi = vol->ubi;
 	int err, vol_id = vol->vol_id;
+	ktime_t start;
 
 	dbg_gen("read %d bytes from LEB %d:%d:%d", len, vol_id, lnum, offset);
 
@@ -407,7 +408,9 @@ int ubi_leb_read(struct ubi_volume_desc *desc, int lnum, char *buf, int offset,
 	if (len == 0)
 		return 0;
 
+	start = ubi_fg_io_start(ubi);
 	err = ubi_eba_read_leb(ubi, vol, lnum, buf, offset, len, check);
+	ubi_fg_io_end(ubi, UBI_STAT_READ, start);
 	if (err && err == -EBADMSG && vol->vol_type == UBI_STATIC_VOLUME) {
 		ubi_warn("mark volume %d as corrupted", vol_id);
 		vol->corrupted = 1;
@@ -449,7 +452,8 @@ int ubi_leb_write(struct ubi_volume_desc *desc, int lnum, const void *buf,
 {
 	struct ubi_volume *vol = desc->vol;
 	struct ubi_device *ubi = vol->ubi;
-	int vol_id = vol->vol_id;
+	int err, vol_id = vol->vol_id;
+	ktime_t start;
 
 	dbg_gen("write %d bytes to LEB %d:%d:%d", len, vol_id, lnum, offset);
 
@@ -474,7 +478,10 @@ int ubi_leb_write(struct ubi_volume_desc *desc, int lnum, const void *buf,
 	if (len == 0)
 		return 0;
 
-	return ubi_eba_write_leb(ubi, vol, lnum, buf, offset, len, dtype);
+	start = ubi_fg_io_start(ubi);
+	err = ubi_eba_write_leb(ubi, vol, lnum, buf, offset, len, dtype);
+	ubi_fg_io_end(ubi, UBI_STAT_WRITE, start);
+	return err;
 }
 EXPORT_SYMBOL_GPL(ubi_leb_write);
 
@@ -499,7 +506,8 @@ int ubi_leb_change(struct ubi_volume_desc *desc, int lnum, const void *buf,
 {
 	struct ubi_volume *vol = desc->vol;
 	struct ubi_device *ubi = vol->ubi;
-	int vol_id = vol->vol_id;
+	int err, vol_id = vol->vol_id;
+	ktime_t start;
 
 	dbg_gen("atomically write %d bytes to LEB %d:%d", len, vol_id, lnum);
 
@@ -523,7 +531,10 @@ int ubi_leb_change(struct ubi_volume_desc *desc, int lnum, const void *buf,
 	if (len == 0)
 		return 0;
 
-	return ubi_eba_atomic_leb_change(ubi, vol, lnum, buf, len, dtype);
+	start = ubi_fg_io_start(ubi);
+	err = ubi_eba_atomic_leb_change(ubi, vol, lnum, buf, len, dtype);
+	ubi_fg_io_end(ubi, UBI_STAT_CHANGE, start);
+	return err;
 }
 EXPORT_SYMBOL_GPL(ubi_leb_change);
 
@@ -641,6 +652,8 @@ int ubi_leb_map(struct ubi_volume_desc *desc, int lnum, int dtype)
 {
 	struct ubi_volume *vol = desc->vol;
 	struct ubi_device *ubi = vol->ubi;
+	ktime_t start;
+	int err;
 
 	dbg_gen("unmap LEB %d:%d", vol->vol_id, lnum);
 
@@ -660,7 +673,10 @@ int ubi_leb_map(struct ubi_volume_desc *desc, int lnum, int dtype)
 	if (vol->eba_tbl[lnum] >= 0)
 		return -EBADMSG;
 
-	return ubi_eba_write_leb(ubi, vol, lnum, NULL, 0, 0, dtype);
+	start = ubi_fg_io_start(ubi);
+	err = ubi_eba_write_leb(ubi, vol, lnum, NULL, 0, 0, dtype);
+	ubi_fg_io_end(ubi, UBI_STAT_WRITE, start);
+	return err;
 }
 EXPORT_SYMBOL_GPL(ubi_leb_map);
 
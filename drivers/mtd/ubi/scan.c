@@ -38,12 +38,19 @@
  * Corrupted physical eraseblocks are put to the @corr list, free physical
  * eraseblocks are put to the @free list and the physical eraseblock to be
  * erased are put to the @erase list.
+ *
+ * The headers are read by up to @scan_threads threads, a chunk of PEBs at a
+ * time, which helps when the flash can serve several reads at once (e.g.,
+ * multi-plane NAND). They are then processed in PEB order by the calling
+ * task, so the result does not depend on the number of threads.
  */
 
 #include <linux/err.h>
 #include <linux/slab.h>
 #include <linux/crc32.h>
 #include <linux/math64.h>
+#include <linux/async.h>
+#include <linux/moduleparam.h>
 #include "ubi.h"
 
 #ifdef CONFIG_MTD_UBI_DEBUG_PARANOID
@@ -52,12 +59,59 @@ static int paranoid_check_si(struct ubi_device *ubi, struct ubi_scan_info *si);
 #define paranoid_check_si(ubi, si) 0
 #endif
 
-/* Temporary variables used during scanning */
-static struct ubi_ec_hdr *ech;
-static struct ubi_vid_hdr *vidh;
+/* Maximum number of threads reading the headers */
+#define SCAN_MAX_THREADS 16
+
+/* Number of PEBs whose headers are read in one go */
+#define SCAN_CHUNK 256
+
+static int scan_threads = CONFIG_MTD_UBI_SCAN_THREADS;
+module_param(scan_threads, int, 0644);
+MODULE_PARM_DESC(scan_threads, "number of threads reading the UBI headers "
+		 "when scanning (1-" __stringify(SCAN_MAX_THREADS) ")");
+
+/**
+ * struct scan_peb - the headers of a physical eraseblock.
+ * @bad: if the physical eraseblock is bad
+ * @ec_err: what 'ubi_io_read_ec_hdr()' returned
+ * @vid_err: what 'ubi_io_read_vid_hdr()' returned
+ * @ech: the erase counter header
+ * @vidh: the volume identifier header
+ */
+struct scan_peb {
+	int bad;
+	int ec_err;
+	int vid_err;
+	struct ubi_ec_hdr ech;
+	struct ubi_vid_hdr vidh;
+};
 
 /**
- * add_to_list - add physical eraseblock to a list.
+ * struct scan_reader - a thread reading the headers of a chunk of PEBs.
+ * @ubi: UBI device description object
+ * @sp: the headers of the chunk
+ * @first: the physical eraseblock number of @sp[0]
+ * @count: count of physical eraseblocks in the chunk
+ * @start: the first @sp index this thread reads
+ * @stride: the distance between the @sp indexes this thread reads
+ * @ech: buffer for the erase counter headers
+ * @vidh: buffer for the volume identifier headers
+ * @err: the error code the thread stopped at, or zero
+ */
+struct scan_reader {
+	struct ubi_device *ubi;
+	struct scan_peb *sp;
+	int first;
+	int count;
+	int start;
+	int stride;
+	struct ubi_ec_hdr *ech;
+	struct ubi_vid_hdr *vidh;
+	int err;
+};
+
+/**
+ * ubi_scan_add_to_list - add physical eraseblock to a list.
  * @si: scanning information
  * @pnum: physical eraseblock number to add
  * @ec: erase counter of the physical eraseblock
@@ -67,8 +121,8 @@ static struct ubi_vid_hdr *vidh;
  * alien lists. Returns zero in case of success and a negative error code in
  * case of failure.
  */
-static int add_to_list(struct ubi_scan_info *si, int pnum, int ec,
-		       struct list_head *list)
+int ubi_scan_add_to_list(struct ubi_scan_info *si, int pnum, int ec,
+			 struct list_head *list)
 {
 	struct ubi_scan_leb *seb;
 
@@ -460,11 +514,11 @@ int ubi_scan_add_used(struct ubi_device *ubi, struct ubi_scan_info *si,
 				return err;
 
 			if (cmp_res & 4)
-				err = add_to_list(si, seb->pnum, seb->ec,
-						  &si->corr);
+				err = ubi_scan_add_to_list(si, seb->pnum,
+							   seb->ec, &si->corr);
 			else
-				err = add_to_list(si, seb->pnum, seb->ec,
-						  &si->erase);
+				err = ubi_scan_add_to_list(si, seb->pnum,
+							   seb->ec, &si->erase);
 			if (err)
 				return err;
 
@@ -484,9 +538,11 @@ int ubi_scan_add_used(struct ubi_device *ubi, struct ubi_scan_info *si,
 			 * previously.
 			 */
 			if (cmp_res & 4)
-				return add_to_list(si, pnum, ec, &si->corr);
+				return ubi_scan_add_to_list(si, pnum, ec,
+							    &si->corr);
 			else
-				return add_to_list(si, pnum, ec, &si->erase);
+				return ubi_scan_add_to_list(si, pnum, ec,
+							    &si->erase);
 		}
 	}
 
@@ -708,27 +764,153 @@ struct ubi_scan_leb *ubi_scan_get_free_peb(struct ubi_device *ubi,
 }
 
 /**
- * process_eb - read, check UBI headers, and add them to scanning information.
+ * read_pebs - read the headers of a chunk of physical eraseblocks.
+ * @r: the reader
+ *
+ * This function reads the headers of every @r->stride-th physical eraseblock
+ * of the chunk, starting with @r->start. On failure it stops and sets
+ * @r->err.
+ */
+static void read_pebs(struct scan_reader *r)
+{
+	struct ubi_device *ubi = r->ubi;
+	int i, err;
+
+	for (i = r->start; i < r->count; i += r->stride) {
+		struct scan_peb *sp = &r->sp[i];
+		int pnum = r->first + i;
+
+		cond_resched();
+
+		err = ubi_io_is_bad(ubi, pnum);
+		if (err < 0)
+			goto out_err;
+		sp->bad = err;
+		if (sp->bad)
+			continue;
+
+		err = ubi_io_read_ec_hdr(ubi, pnum, r->ech, 0);
+		if (err < 0)
+			goto out_err;
+		sp->ec_err = err;
+		if (err == UBI_IO_PEB_EMPTY)
+			continue;
+		memcpy(&sp->ech, r->ech, UBI_EC_HDR_SIZE);
+
+		err = ubi_io_read_vid_hdr(ubi, pnum, r->vidh, 0);
+		if (err < 0)
+			goto out_err;
+		sp->vid_err = err;
+		memcpy(&sp->vidh, r->vidh, UBI_VID_HDR_SIZE);
+	}
+	return;
+
+out_err:
+	r->err = err;
+}
+
+static void read_pebs_async(void *data, async_cookie_t cookie)
+{
+	read_pebs(data);
+}
+
+/**
+ * read_chunk - read the headers of a chunk of physical eraseblocks.
+ * @readers: the readers to use
+ * @threads: count of @readers
+ * @sp: where to store the headers
+ * @first: the first physical eraseblock of the chunk
+ * @count: count of physical eraseblocks in the chunk
+ *
+ * The calling task is one of the readers, the others run as asynchronous
+ * function calls. This function returns zero in case of success and a
+ * negative error code in case of failure.
+ */
+static int read_chunk(struct scan_reader *readers, int threads,
+		      struct scan_peb *sp, int first, int count)
+{
+	LIST_HEAD(domain);
+	int i;
+
+	for (i = 0; i < threads; i++) {
+		readers[i].sp = sp;
+		readers[i].first = first;
+		readers[i].count = count;
+		readers[i].start = i;
+		readers[i].stride = threads;
+		readers[i].err = 0;
+	}
+
+	for (i = 1; i < threads; i++)
+		async_schedule_domain(read_pebs_async, &readers[i], &domain);
+	read_pebs(&readers[0]);
+	async_synchronize_full_domain(&domain);
+
+	for (i = 0; i < threads; i++)
+		if (readers[i].err)
+			return readers[i].err;
+	return 0;
+}
+
+/**
+ * drop_aidx_anchor - invalidate a stale attach index.
+ * @ubi: UBI device description object
+ * @pnum: the physical eraseblock of the anchor
+ *
+ * Once attached by scanning, UBI changes the flash without invalidating the
+ * attach index, whose physical eraseblocks are only erased later on. So the
+ * anchor is invalidated right away, the way the attach index sub-system does
+ * it (see aidx.c): by programming its last min. I/O unit, unless this has
+ * been done already. Failures are not fatal, the anchor is then handled as
+ * if it was corrupted.
+ */
+static int drop_aidx_anchor(struct ubi_device *ubi, int pnum)
+{
+	int err, offs = ubi->leb_size - ubi->min_io_size;
+	void *buf;
+
+	buf = kmalloc(ubi->min_io_size, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	err = ubi_io_read_data(ubi, buf, pnum, offs, ubi->min_io_size);
+	if ((err && err != UBI_IO_BITFLIPS) ||
+	    !ubi_check_pattern(buf, 0xFF, ubi->min_io_size))
+		goto out_free;
+
+	ubi_msg("invalidate the attach index at PEB %d", pnum);
+	memset(buf, 0, ubi->min_io_size);
+	err = ubi_io_write_data(ubi, buf, pnum, offs, ubi->min_io_size);
+	if (err)
+		ubi_warn("cannot invalidate the attach index, error %d", err);
+
+out_free:
+	kfree(buf);
+	return 0;
+}
+
+/**
+ * process_eb - check UBI headers, and add them to scanning information.
  * @ubi: UBI device description object
  * @si: scanning information
  * @pnum: the physical eraseblock number
+ * @sp: the headers of the physical eraseblock
  *
  * This function returns a zero if the physical eraseblock was successfully
  * handled and a negative error code in case of failure.
  */
 static int process_eb(struct ubi_device *ubi, struct ubi_scan_info *si,
-		      int pnum)
+		      int pnum, struct scan_peb *sp)
 {
 	long long uninitialized_var(ec);
 	int err, bitflips = 0, vol_id, ec_corr = 0;
+	struct ubi_ec_hdr *ech = &sp->ech;
+	struct ubi_vid_hdr *vidh = &sp->vidh;
 
 	dbg_bld("scan PEB %d", pnum);
 
 	/* Skip bad physical eraseblocks */
-	err = ubi_io_is_bad(ubi, pnum);
-	if (err < 0)
-		return err;
-	else if (err) {
+	if (sp->bad) {
 		/*
 		 * FIXME: this is actually duty of the I/O sub-system to
 		 * initialize this, but MTD does not provide enough
@@ -738,13 +920,12 @@ static int process_eb(struct ubi_device *ubi, struct ubi_scan_info *si,
 		return 0;
 	}
 
-	err = ubi_io_read_ec_hdr(ubi, pnum, ech, 0);
-	if (err < 0)
-		return err;
-	else if (err == UBI_IO_BITFLIPS)
+	err = sp->ec_err;
+	if (err == UBI_IO_BITFLIPS)
 		bitflips = 1;
 	else if (err == UBI_IO_PEB_EMPTY)
-		return add_to_list(si, pnum, UBI_SCAN_UNKNOWN_EC, &si->erase);
+		return ubi_scan_add_to_list(si, pnum, UBI_SCAN_UNKNOWN_EC,
+					    &si->erase);
 	else if (err == UBI_IO_BAD_EC_HDR) {
 		/*
 		 * We have to also look at the VID header, possibly it is not
@@ -808,27 +989,38 @@ static int process_eb(struct ubi_device *ubi, struct ubi_scan_info *si,
 
 	/* OK, we've done with the EC header, let's look at the VID header */
 
-	err = ubi_io_read_vid_hdr(ubi, pnum, vidh, 0);
-	if (err < 0)
-		return err;
-	else if (err == UBI_IO_BITFLIPS)
+	err = sp->vid_err;
+	if (err == UBI_IO_BITFLIPS)
 		bitflips = 1;
 	else if (err == UBI_IO_BAD_VID_HDR ||
 		 (err == UBI_IO_PEB_FREE && ec_corr)) {
 		/* VID header is corrupted */
-		err = add_to_list(si, pnum, ec, &si->corr);
+		err = ubi_scan_add_to_list(si, pnum, ec, &si->corr);
 		if (err)
 			return err;
 		goto adjust_mean_ec;
 	} else if (err == UBI_IO_PEB_FREE) {
 		/* No VID header - the physical eraseblock is free */
-		err = add_to_list(si, pnum, ec, &si->free);
+		err = ubi_scan_add_to_list(si, pnum, ec, &si->free);
 		if (err)
 			return err;
 		goto adjust_mean_ec;
 	}
 
 	vol_id = be32_to_cpu(vidh->vol_id);
+	if (vol_id == UBI_AIDX_VOLUME_ID) {
+		/* The attach index is written anew once attached */
+		if (be32_to_cpu(vidh->lnum) == 0) {
+			err = drop_aidx_anchor(ubi, pnum);
+			if (err)
+				return err;
+		}
+		err = ubi_scan_add_to_list(si, pnum, ec, &si->erase);
+		if (err)
+			return err;
+		goto adjust_mean_ec;
+	}
+
 	if (vol_id > UBI_MAX_VOLUMES && vol_id != UBI_LAYOUT_VOLUME_ID) {
 		int lnum = be32_to_cpu(vidh->lnum);
 
@@ -837,7 +1029,7 @@ static int process_eb(struct ubi_device *ubi, struct ubi_scan_info *si,
 		case UBI_COMPAT_DELETE:
 			ubi_msg("\"delete\" compatible internal volume %d:%d"
 				" found, remove it", vol_id, lnum);
-			err = add_to_list(si, pnum, ec, &si->corr);
+			err = ubi_scan_add_to_list(si, pnum, ec, &si->corr);
 			if (err)
 				return err;
 			break;
@@ -852,7 +1044,7 @@ static int process_eb(struct ubi_device *ubi, struct ubi_scan_info *si,
 		case UBI_COMPAT_PRESERVE:
 			ubi_msg("\"preserve\" compatible internal volume %d:%d"
 				" found", vol_id, lnum);
-			err = add_to_list(si, pnum, ec, &si->alien);
+			err = ubi_scan_add_to_list(si, pnum, ec, &si->alien);
 			if (err)
 				return err;
 			si->alien_peb_count += 1;
@@ -885,6 +1077,46 @@ adjust_mean_ec:
 	return 0;
 }
 
+/**
+ * ubi_scan_alloc_si - allocate empty scanning information.
+ *
+ * This function returns the new scanning information in case of success and
+ * %NULL in case of failure.
+ */
+struct ubi_scan_info *ubi_scan_alloc_si(void)
+{
+	struct ubi_scan_info *si;
+
+	si = kzalloc(sizeof(struct ubi_scan_info), GFP_KERNEL);
+	if (!si)
+		return NULL;
+
+	INIT_LIST_HEAD(&si->corr);
+	INIT_LIST_HEAD(&si->free);
+	INIT_LIST_HEAD(&si->erase);
+	INIT_LIST_HEAD(&si->alien);
+	si->volumes = RB_ROOT;
+	return si;
+}
+
+/**
+ * free_readers - free the readers allocated by 'ubi_scan()'.
+ * @ubi: UBI device description object
+ * @readers: the readers
+ * @threads: count of @readers
+ */
+static void free_readers(struct ubi_device *ubi, struct scan_reader *readers,
+			 int threads)
+{
+	int i;
+
+	for (i = 0; i < threads; i++) {
+		ubi_free_vid_hdr(ubi, readers[i].vidh);
+		kfree(readers[i].ech);
+	}
+	kfree(readers);
+}
+
 /**
  * ubi_scan - scan an MTD device.
  * @ubi: UBI device description object
@@ -894,39 +1126,56 @@ adjust_mean_ec:
  */
 struct ubi_scan_info *ubi_scan(struct ubi_device *ubi)
 {
-	int err, pnum;
+	int err, i, pnum, first, count, threads;
 	struct rb_node *rb1, *rb2;
 	struct ubi_scan_volume *sv;
 	struct ubi_scan_leb *seb;
 	struct ubi_scan_info *si;
+	struct scan_reader *readers;
+	struct scan_peb *sp;
 
-	si = kzalloc(sizeof(struct ubi_scan_info), GFP_KERNEL);
+	si = ubi_scan_alloc_si();
 	if (!si)
 		return ERR_PTR(-ENOMEM);
-
-	INIT_LIST_HEAD(&si->corr);
-	INIT_LIST_HEAD(&si->free);
-	INIT_LIST_HEAD(&si->erase);
-	INIT_LIST_HEAD(&si->alien);
-	si->volumes = RB_ROOT;
 	si->is_empty = 1;
 
+	threads = clamp(scan_threads, 1, SCAN_MAX_THREADS);
+	dbg_msg("scan with %d threads", threads);
+
 	err = -ENOMEM;
-	ech = kzalloc(ubi->ec_hdr_alsize, GFP_KERNEL);
-	if (!ech)
+	readers = kcalloc(threads, sizeof(struct scan_reader), GFP_KERNEL);
+	if (!readers)
 		goto out_si;
 
-	vidh = ubi_zalloc_vid_hdr(ubi, GFP_KERNEL);
-	if (!vidh)
-		goto out_ech;
+	for (i = 0; i < threads; i++) {
+		readers[i].ubi = ubi;
+		readers[i].ech = kzalloc(ubi->ec_hdr_alsize, GFP_KERNEL);
+		if (!readers[i].ech)
+			goto out_readers;
+		readers[i].vidh = ubi_zalloc_vid_hdr(ubi, GFP_KERNEL);
+		if (!readers[i].vidh)
+			goto out_readers;
+	}
 
-	for (pnum = 0; pnum < ubi->peb_count; pnum++) {
-		cond_resched();
+	sp = vmalloc(SCAN_CHUNK * sizeof(struct scan_peb));
+	if (!sp)
+		goto out_readers;
 
-		dbg_gen("process PEB %d", pnum);
-		err = process_eb(ubi, si, pnum);
-		if (err < 0)
-			goto out_vidh;
+	for (first = 0; first < ubi->peb_count; first += SCAN_CHUNK) {
+		count = min_t(int, SCAN_CHUNK, ubi->peb_count - first);
+		err = read_chunk(readers, threads, sp, first, count);
+		if (err)
+			goto out_sp;
+
+		for (i = 0; i < count; i++) {
+			cond_resched();
+
+			pnum = first + i;
+			dbg_gen("process PEB %d", pnum);
+			err = process_eb(ubi, si, pnum, &sp[i]);
+			if (err < 0)
+				goto out_sp;
+		}
 	}
 
 	dbg_msg("scanning is finished");
@@ -976,17 +1225,17 @@ struct ubi_scan_info *ubi_scan(struct ubi_device *ubi)
 
 	err = paranoid_check_si(ubi, si);
 	if (err)
-		goto out_vidh;
+		goto out_sp;
 
-	ubi_free_vid_hdr(ubi, vidh);
-	kfree(ech);
+	vfree(sp);
+	free_readers(ubi, readers, threads);
 
 	return si;
 
-out_vidh:
-	ubi_free_vid_hdr(ubi, vidh);
-out_ech:
-	kfree(ech);
+out_sp:
+	vfree(sp);
+out_readers:
+	free_readers(ubi, readers, threads);
 out_si:
 	ubi_scan_destroy_si(si);
 	return ERR_PTR(err);
@@ -0,0 +1,227 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See
+ * the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+/*
+ * Latency statistics.
+ *
+ * UBI accounts how long the reads, writes and atomic changes requested
+ * through the kernel API take, as well as the erasures and the moves done
+ * by the WL sub-system, and how the background thread batched and deferred
+ * its works. They are shown in the "latency" file of the device directory
+ * in debugfs, e.g. /sys/kernel/debug/ubi/ubi0/latency. Writing anything to
+ * this file resets them.
+ *
+ * The percentiles are upper bounds, derived from the power of 2 histogram.
+ */
+
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/uaccess.h>
+#include <linux/math64.h>
+#include "ubi.h"
+
+static const char * const stat_names[UBI_STAT_KINDS] = {
+	[UBI_STAT_READ]   = "read",
+	[UBI_STAT_WRITE]  = "write",
+	[UBI_STAT_CHANGE] = "change",
+	[UBI_STAT_ERASE]  = "erase",
+	[UBI_STAT_MOVE]   = "move",
+};
+
+static struct dentry *dbg_root;
+
+/**
+ * ubi_stats_add - account an operation.
+ * @ubi: UBI device description object
+ * @kind: kind of operation (%UBI_STAT_READ, etc)
+ * @start: time the operation started
+ */
+void ubi_stats_add(struct ubi_device *ubi, int kind, ktime_t start)
+{
+	struct ubi_op_stats *st = &ubi->stats[kind];
+	u64 ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	u64 us = div_u64(ns, NSEC_PER_USEC);
+	int bucket;
+
+	bucket = us >> 31 ? UBI_STAT_BUCKETS - 1 : fls(us);
+	if (bucket >= UBI_STAT_BUCKETS)
+		bucket = UBI_STAT_BUCKETS - 1;
+
+	spin_lock(&ubi->stats_lock);
+	st->count += 1;
+	st->total_ns += ns;
+	if (ns > st->max_ns)
+		st->max_ns = ns;
+	st->hist[bucket] += 1;
+	spin_unlock(&ubi->stats_lock);
+}
+
+/**
+ * percentile - find the histogram bucket a percentile falls into.
+ * @st: the statistics
+ * @pct: the percentile
+ *
+ * This function returns the upper bound of the bucket in microseconds.
+ */
+static unsigned long percentile(const struct ubi_op_stats *st, int pct)
+{
+	unsigned long long want, seen = 0;
+	int i;
+
+	want = div_u64(st->count * pct + 99, 100);
+	for (i = 0; i < UBI_STAT_BUCKETS - 1; i++) {
+		seen += st->hist[i];
+		if (seen >= want)
+			break;
+	}
+	return 1UL << i;
+}
+
+static int latency_show(struct seq_file *m, void *v)
+{
+	struct ubi_device *ubi = m->private;
+	struct ubi_op_stats st[UBI_STAT_KINDS];
+	int i, k;
+
+	spin_lock(&ubi->stats_lock);
+	memcpy(st, ubi->stats, sizeof(st));
+	spin_unlock(&ubi->stats_lock);
+
+	seq_printf(m, "%-6s %10s %8s %8s %8s %8s\n", "op", "count", "avg_us",
+		   "p50_us", "p99_us", "max_us");
+	for (k = 0; k < UBI_STAT_KINDS; k++) {
+		if (!st[k].count) {
+			seq_printf(m, "%-6s %10d\n", stat_names[k], 0);
+			continue;
+		}
+		seq_printf(m, "%-6s %10llu %8llu %8lu %8lu %8llu\n",
+			   stat_names[k], st[k].count,
+			   div64_u64(st[k].total_ns,
+				     st[k].count * NSEC_PER_USEC),
+			   percentile(&st[k], 50), percentile(&st[k], 99),
+			   div_u64(st[k].max_ns, NSEC_PER_USEC));
+	}
+
+	seq_printf(m, "\nhistogram, operations which took less than N us:\n");
+	seq_printf(m, "%-8s", "N");
+	for (k = 0; k < UBI_STAT_KINDS; k++)
+		seq_printf(m, " %10s", stat_names[k]);
+	seq_putc(m, '\n');
+	for (i = 0; i < UBI_STAT_BUCKETS; i++) {
+		if (i < UBI_STAT_BUCKETS - 1)
+			seq_printf(m, "%-8lu", 1UL << i);
+		else
+			seq_printf(m, "%-8s", "more");
+		for (k = 0; k < UBI_STAT_KINDS; k++)
+			seq_printf(m, " %10lu", st[k].hist[i]);
+		seq_putc(m, '\n');
+	}
+
+	seq_printf(m, "\nwear-leveling deferrals: %lu\n", ubi->wl_deferrals);
+	seq_printf(m, "erasure batches:        %lu (%lu erasures, %lu cut "
+		   "short)\n", ubi->erase_batches, ubi->erase_batched,
+		   ubi->erase_yields);
+	seq_printf(m, "pending works:          %d\n", ubi->works_count);
+	return 0;
+}
+
+static int latency_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, latency_show, inode->i_private);
+}
+
+static ssize_t latency_write(struct file *file, const char __user *buf,
+			     size_t count, loff_t *ppos)
+{
+	struct ubi_device *ubi = ((struct seq_file *)file->private_data)->private;
+
+	spin_lock(&ubi->stats_lock);
+	memset(ubi->stats, 0, sizeof(ubi->stats));
+	ubi->wl_deferrals = ubi->erase_batches = 0;
+	ubi->erase_batched = ubi->erase_yields = 0;
+	spin_unlock(&ubi->stats_lock);
+	return count;
+}
+
+static const struct file_operations latency_fops = {
+	.owner   = THIS_MODULE,
+	.open    = latency_open,
+	.read    = seq_read,
+	.write   = latency_write,
+	.llseek  = seq_lseek,
+	.release = single_release,
+};
+
+/**
+ * ubi_stats_dev_init - create the debugfs files of an UBI device.
+ * @ubi: UBI device description object
+ *
+ * Failures are not fatal, the statistics are just not shown then.
+ */
+void ubi_stats_dev_init(struct ubi_device *ubi)
+{
+	struct dentry *dent;
+
+	if (!dbg_root)
+		return;
+
+	dent = debugfs_create_dir(ubi->ubi_name, dbg_root);
+	if (IS_ERR_OR_NULL(dent))
+		goto out;
+	ubi->dbg_stats = dent;
+
+	dent = debugfs_create_file("latency", S_IRUSR | S_IWUSR,
+				   ubi->dbg_stats, ubi, &latency_fops);
+	if (IS_ERR_OR_NULL(dent))
+		goto out_remove;
+	return;
+
+out_remove:
+	debugfs_remove_recursive(ubi->dbg_stats);
+	ubi->dbg_stats = NULL;
+out:
+	ubi_warn("cannot create debugfs files for %s", ubi->ubi_name);
+}
+
+/**
+ * ubi_stats_dev_exit - remove the debugfs files of an UBI device.
+ * @ubi: UBI device description object
+ */
+void ubi_stats_dev_exit(struct ubi_device *ubi)
+{
+	debugfs_remove_recursive(ubi->dbg_stats);
+	ubi->dbg_stats = NULL;
+}
+
+/**
+ * ubi_stats_init - create the UBI debugfs directory.
+ */
+void ubi_stats_init(void)
+{
+	dbg_root = debugfs_create_dir(UBI_NAME_STR, NULL);
+	if (IS_ERR_OR_NULL(dbg_root)) {
+		ubi_warn("cannot create debugfs directory");
+		dbg_root = NULL;
+	}
+}
+
+/**
+ * ubi_stats_exit - remove the UBI debugfs directory.
+ */
+void ubi_stats_exit(void)
+{
+	debugfs_remove_recursive(dbg_root);
+}
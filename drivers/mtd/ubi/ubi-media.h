@@ -375,4 +375,115 @@ struct ubi_vtbl_record {
 	__be32  crc;
 } __attribute__ ((packed));
 
+/*
+ * The attach index internal volume. Its PEBs hold a snapshot of the scanning
+ * information, which lets UBI attach without reading the headers of every
+ * PEB (see aidx.c). It is only an accelerator, so implementations which do
+ * not know it just delete it.
+ */
+
+#define UBI_AIDX_VOLUME_ID     (UBI_LAYOUT_VOLUME_ID + 1)
+#define UBI_AIDX_VOLUME_TYPE   UBI_VID_DYNAMIC
+#define UBI_AIDX_VOLUME_COMPAT UBI_COMPAT_DELETE
+
+/* Attach index header magic number (ASCII "UBIX") */
+#define UBI_AIDX_MAGIC 0x55424958
+
+/* The version of the attach index format */
+#define UBI_AIDX_VERSION 1
+
+/* The anchor PEB is always one of this many first PEBs */
+#define UBI_AIDX_ANCHOR_PEBS 64
+
+/* The maximum number of PEBs an attach index may occupy */
+#define UBI_AIDX_MAX_PEBS 8
+
+/* Values of @vol_id in &struct ubi_aidx_peb for PEBs which hold no LEB */
+#define UBI_AIDX_PEB_FREE  -1
+#define UBI_AIDX_PEB_ERASE -2
+#define UBI_AIDX_PEB_BAD   -3
+
+/* Sizes of the attach index structures */
+#define UBI_AIDX_HDR_SIZE      sizeof(struct ubi_aidx_hdr)
+#define UBI_AIDX_HDR_SIZE_CRC  (UBI_AIDX_HDR_SIZE - sizeof(__be32))
+#define UBI_AIDX_VOL_SIZE      sizeof(struct ubi_aidx_vol)
+#define UBI_AIDX_PEB_SIZE      sizeof(struct ubi_aidx_peb)
+
+/**
+ * struct ubi_aidx_hdr - attach index header.
+ * @magic: attach index magic number (%UBI_AIDX_MAGIC)
+ * @version: attach index format version (%UBI_AIDX_VERSION)
+ * @padding1: reserved for future, zeroes
+ * @peb_count: count of PEBs of the MTD device the index describes
+ * @bad_peb_count: count of bad PEBs
+ * @vol_count: count of &struct ubi_aidx_vol records
+ * @image_seq: image sequence number
+ * @max_sqnum: highest sequence number used when the index was written
+ * @data_size: size of the records following the header
+ * @data_crc: CRC32 checksum of the records following the header
+ * @nr_pebs: count of PEBs the index occupies, including the anchor
+ * @pebs: the PEBs the index occupies, the anchor first
+ * @padding2: reserved for future, zeroes
+ * @hdr_crc: attach index header CRC checksum
+ *
+ * The attach index is stored in the data areas of @nr_pebs PEBs, LEB @i of
+ * the %UBI_AIDX_VOLUME_ID volume in PEB @pebs[@i]. It starts with this
+ * header, which is followed by @vol_count &struct ubi_aidx_vol records and
+ * then by one &struct ubi_aidx_peb record per PEB, indexed by PEB number.
+ *
+ * The last min. I/O unit of each index PEB is left erased. Programming it in
+ * the anchor invalidates the index, which is done before anything else is
+ * written to the flash.
+ */
+struct ubi_aidx_hdr {
+	__be32  magic;
+	__u8    version;
+	__u8    padding1[3];
+	__be32  peb_count;
+	__be32  bad_peb_count;
+	__be32  vol_count;
+	__be32  image_seq;
+	__be64  max_sqnum;
+	__be32  data_size;
+	__be32  data_crc;
+	__be32  nr_pebs;
+	__be32  pebs[UBI_AIDX_MAX_PEBS];
+	__u8    padding2[48];
+	__be32  hdr_crc;
+} __attribute__ ((packed));
+
+/**
+ * struct ubi_aidx_vol - a volume record in the attach index.
+ * @vol_id: volume ID
+ * @used_ebs: @used_ebs of the VID headers of this volume
+ * @data_pad: @data_pad of the VID headers of this volume
+ * @last_data_size: @data_size of the VID header of the highest LEB
+ * @vol_type: volume type (%UBI_VID_DYNAMIC or %UBI_VID_STATIC)
+ * @compat: compatibility flags of this volume
+ * @padding: reserved for future, zeroes
+ */
+struct ubi_aidx_vol {
+	__be32  vol_id;
+	__be32  used_ebs;
+	__be32  data_pad;
+	__be32  last_data_size;
+	__u8    vol_type;
+	__u8    compat;
+	__u8    padding[6];
+} __attribute__ ((packed));
+
+/**
+ * struct ubi_aidx_peb - a PEB record in the attach index.
+ * @ec: erase counter
+ * @vol_id: ID of the volume the PEB belongs to, or one of the
+ *          %UBI_AIDX_PEB_FREE, %UBI_AIDX_PEB_ERASE and %UBI_AIDX_PEB_BAD
+ *          values
+ * @lnum: the LEB the PEB is mapped to
+ */
+struct ubi_aidx_peb {
+	__be32  ec;
+	__be32  vol_id;
+	__be32  lnum;
+} __attribute__ ((packed));
+
 #endif /* !__UBI_MEDIA_H__ */
@@ -38,6 +38,8 @@
 #include <linux/string.h>
 #include <linux/vmalloc.h>
 #include <linux/notifier.h>
+#include <linux/workqueue.h>
+#include <linux/ktime.h>
 #include <linux/mtd/mtd.h>
 #include <linux/mtd/ubi.h>
 
@@ -124,6 +126,44 @@ enum {
 	MOVE_CANCEL_BITFLIPS,
 };
 
+/*
+ * Kinds of operations UBI keeps latency statistics for.
+ *
+ * UBI_STAT_READ: LEB reads requested through the kernel API
+ * UBI_STAT_WRITE: LEB writes and maps requested through the kernel API
+ * UBI_STAT_CHANGE: atomic LEB changes requested through the kernel API
+ * UBI_STAT_ERASE: PEB erasures
+ * UBI_STAT_MOVE: PEB moves done by wear-leveling or scrubbing
+ */
+enum {
+	UBI_STAT_READ,
+	UBI_STAT_WRITE,
+	UBI_STAT_CHANGE,
+	UBI_STAT_ERASE,
+	UBI_STAT_MOVE,
+	UBI_STAT_KINDS
+};
+
+/*
+ * Latencies are accounted in power of 2 microsecond buckets, the last one
+ * collecting everything from about a quarter of a second up.
+ */
+#define UBI_STAT_BUCKETS 20
+
+/**
+ * struct ubi_op_stats - latency statistics of one kind of operation.
+ * @count: how many operations were done
+ * @total_ns: their total duration in nanoseconds
+ * @max_ns: the longest of them in nanoseconds
+ * @hist: how many of them took less than 1, 2, 4, ... microseconds
+ */
+struct ubi_op_stats {
+	unsigned long long count;
+	u64 total_ns;
+	u64 max_ns;
+	unsigned long hist[UBI_STAT_BUCKETS];
+};
+
 /**
  * struct ubi_wl_entry - wear-leveling entry.
  * @u.rb: link in the corresponding (free/used) RB-tree
@@ -350,6 +390,10 @@ struct ubi_wl_entry;
  * @bgt_thread: background thread description object
  * @thread_enabled: if the background thread is enabled
  * @bgt_name: background thread name
+ * @fg_io: count of foreground reads and writes in progress
+ * @fg_io_last: time (in jiffies) the last foreground read or write finished
+ * @wl_defer_start: time (in jiffies) the background thread started deferring
+ *                  wear-leveling, zero if it is not
  *
  * @flash_size: underlying MTD device size (in bytes)
  * @peb_count: count of physical eraseblocks on the MTD device
@@ -382,6 +426,27 @@ struct ubi_wl_entry;
  * @ckvol_mutex: serializes static volume checking when opening
  * @dbg_peb_buf: buffer of PEB size used for debugging
  * @dbg_buf_mutex: protects @dbg_peb_buf
+ *
+ * @aidx_enabled: if the attach index is maintained for this device
+ * @aidx_valid: if the attach index on the flash describes the flash
+ * @aidx_cnt: count of physical eraseblocks held by the attach index
+ * @aidx_pebs: physical eraseblocks held by the attach index, anchor first
+ * @aidx_ec: erase counters of @aidx_pebs, only used at attach time
+ * @aidx_sem: taken in read mode by the tasks which change the flash and in
+ *            write mode by the attach index writer
+ * @aidx_mutex: protects @aidx_valid
+ * @aidx_work: writes the attach index once the device is idle
+ * @aidx_dirty: bit 0 is set when @aidx_work is scheduled
+ * @aidx_changed: time (in jiffies) of the last change of the flash
+ * @aidx_reboot_nb: writes the attach index at reboot
+ *
+ * @stats_lock: protects @stats
+ * @stats: latency statistics of each kind of operation
+ * @wl_deferrals: how many times wear-leveling was deferred
+ * @erase_batches: count of erasure batches done by the background thread
+ * @erase_batched: count of erasures done in these batches
+ * @erase_yields: count of these batches cut short by foreground I/O
+ * @dbg_stats: debugfs directory of this device
  */
 struct ubi_device {
 	struct cdev cdev;
@@ -435,6 +500,9 @@ struct ubi_device {
 	struct task_struct *bgt_thread;
 	int thread_enabled;
 	char bgt_name[sizeof(UBI_BGT_NAME_PATTERN)+2];
+	atomic_t fg_io;
+	unsigned long fg_io_last;
+	unsigned long wl_defer_start;
 
 	/* I/O sub-system's stuff */
 	long long flash_size;
@@ -466,6 +534,30 @@ struct ubi_device {
 	void *dbg_peb_buf;
 	struct mutex dbg_buf_mutex;
 #endif
+
+#ifdef CONFIG_MTD_UBI_ATTACH_INDEX
+	int aidx_enabled;
+	int aidx_valid;
+	int aidx_cnt;
+	int aidx_pebs[UBI_AIDX_MAX_PEBS];
+	int aidx_ec[UBI_AIDX_MAX_PEBS];
+	struct rw_semaphore aidx_sem;
+	struct mutex aidx_mutex;
+	struct delayed_work aidx_work;
+	unsigned long aidx_dirty;
+	unsigned long aidx_changed;
+	struct notifier_block aidx_reboot_nb;
+#endif
+
+#ifdef CONFIG_MTD_UBI_STATS
+	spinlock_t stats_lock;
+	struct ubi_op_stats stats[UBI_STAT_KINDS];
+	unsigned long wl_deferrals;
+	unsigned long erase_batches;
+	unsigned long erase_batched;
+	unsigned long erase_yields;
+	struct dentry *dbg_stats;
+#endif
 };
 
 extern struct kmem_cache *ubi_wl_entry_slab;
@@ -522,6 +614,7 @@ int ubi_eba_atomic_leb_change(struct ubi_device *ubi, struct ubi_volume *vol,
 int ubi_eba_copy_leb(struct ubi_device *ubi, int from, int to,
 		     struct ubi_vid_hdr *vid_hdr);
 int ubi_eba_init_scan(struct ubi_device *ubi, struct ubi_scan_info *si);
+unsigned long long ubi_next_sqnum(struct ubi_device *ubi);
 
 /* wl.c */
 int ubi_wl_get_peb(struct ubi_device *ubi, int dtype);
@@ -531,6 +624,9 @@ int ubi_wl_scrub_peb(struct ubi_device *ubi, int pnum);
 int ubi_wl_init_scan(struct ubi_device *ubi, struct ubi_scan_info *si);
 void ubi_wl_close(struct ubi_device *ubi);
 int ubi_thread(void *u);
+int ubi_wl_get_aidx_peb(struct ubi_device *ubi, int max_pnum);
+int ubi_wl_put_aidx_peb(struct ubi_device *ubi, int pnum, int erase);
+int ubi_wl_add_aidx_peb(struct ubi_device *ubi, int pnum, int ec);
 
 /* io.c */
 int ubi_io_read(const struct ubi_device *ubi, void *buf, int pnum, int offset,
@@ -548,6 +644,7 @@ int ubi_io_read_vid_hdr(struct ubi_device *ubi, int pnum,
 			struct ubi_vid_hdr *vid_hdr, int verbose);
 int ubi_io_write_vid_hdr(struct ubi_device *ubi, int pnum,
 			 struct ubi_vid_hdr *vid_hdr);
+int ubi_check_pattern(const void *buf, uint8_t patt, int size);
 
 /* build.c */
 int ubi_attach_mtd_dev(struct mtd_info *mtd, int ubi_num, int vid_hdr_offset);
@@ -562,6 +659,52 @@ int ubi_notify_all(struct ubi_device *ubi, int ntype,
 		   struct notifier_block *nb);
 int ubi_enumerate_volumes(struct notifier_block *nb);
 
+/* aidx.c */
+#ifdef CONFIG_MTD_UBI_ATTACH_INDEX
+struct ubi_scan_info *ubi_aidx_attach(struct ubi_device *ubi);
+int ubi_aidx_init(struct ubi_device *ubi, struct ubi_scan_info *si);
+void ubi_aidx_sync(struct ubi_device *ubi);
+void ubi_aidx_close(struct ubi_device *ubi);
+int ubi_aidx_invalidate(struct ubi_device *ubi);
+int ubi_aidx_begin(struct ubi_device *ubi);
+void ubi_aidx_end(struct ubi_device *ubi);
+#else
+static inline struct ubi_scan_info *ubi_aidx_attach(struct ubi_device *ubi)
+{
+	return NULL;
+}
+static inline int ubi_aidx_init(struct ubi_device *ubi,
+				struct ubi_scan_info *si)
+{
+	return 0;
+}
+static inline void ubi_aidx_sync(struct ubi_device *ubi) {}
+static inline void ubi_aidx_close(struct ubi_device *ubi) {}
+static inline int ubi_aidx_invalidate(struct ubi_device *ubi) { return 0; }
+static inline int ubi_aidx_begin(struct ubi_device *ubi) { return 0; }
+static inline void ubi_aidx_end(struct ubi_device *ubi) {}
+#endif
+
+/* stats.c */
+#ifdef CONFIG_MTD_UBI_STATS
+void ubi_stats_init(void);
+void ubi_stats_exit(void);
+void ubi_stats_dev_init(struct ubi_device *ubi);
+void ubi_stats_dev_exit(struct ubi_device *ubi);
+void ubi_stats_add(struct ubi_device *ubi, int kind, ktime_t start);
+#define ubi_stats_start() ktime_get()
+#define ubi_stats_count(ubi, counter, n) ((ubi)->counter += (n))
+#else
+static inline void ubi_stats_init(void) {}
+static inline void ubi_stats_exit(void) {}
+static inline void ubi_stats_dev_init(struct ubi_device *ubi) {}
+static inline void ubi_stats_dev_exit(struct ubi_device *ubi) {}
+static inline void ubi_stats_add(struct ubi_device *ubi, int kind,
+				 ktime_t start) {}
+#define ubi_stats_start() ktime_set(0, 0)
+#define ubi_stats_count(ubi, counter, n) do { } while (0)
+#endif
+
 /* kapi.c */
 void ubi_do_get_device_info(struct ubi_device *ubi, struct ubi_device_info *di);
 void ubi_do_get_volume_info(struct ubi_device *ubi, struct ubi_volume *vol,
@@ -684,4 +827,32 @@ static inline int idx2vol_id(const struct ubi_device *ubi, int idx)
 		return idx;
 }
 
+/**
+ * ubi_fg_io_start - note the start of a foreground read or write.
+ * @ubi: UBI device description object
+ *
+ * The background thread defers wear-leveling while there are foreground
+ * reads and writes. Returns the start time for 'ubi_fg_io_end()'.
+ */
+static inline ktime_t ubi_fg_io_start(struct ubi_device *ubi)
+{
+	atomic_inc(&ubi->fg_io);
+	return ubi_stats_start();
+}
+
+/**
+ * ubi_fg_io_end - note the end of a foreground read or write.
+ * @ubi: UBI device description object
+ * @kind: kind of operation (%UBI_STAT_READ, etc)
+ * @start: what 'ubi_fg_io_start()' returned
+ */
+static inline void ubi_fg_io_end(struct ubi_device *ubi, int kind,
+				 ktime_t start)
+{
+	ubi->fg_io_last = jiffies;
+	smp_mb__before_atomic_dec();
+	atomic_dec(&ubi->fg_io);
+	ubi_stats_add(ubi, kind, start);
+}
+
 #endif /* !__UBI_UBI_H__ */
@@ -312,6 +312,10 @@ static int create_vtbl(struct ubi_device *ubi, struct ubi_scan_info *si,
 
 	ubi_msg("create volume table (copy #%d)", copy + 1);
 
+	err = ubi_aidx_invalidate(ubi);
+	if (err)
+		return err;
+
 	vid_hdr = ubi_zalloc_vid_hdr(ubi, GFP_KERNEL);
 	if (!vid_hdr)
 		return -ENOMEM;
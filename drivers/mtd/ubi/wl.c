@@ -91,6 +91,11 @@
  * Depending on the sub-state, wear-leveling entries of the used physical
  * eraseblocks may be kept in one of those structures.
  *
+ * The background thread does not do the pending works strictly in order.
+ * Erasures go first, since they are what produces free physical eraseblocks
+ * for the writers, and wear-leveling waits while there is foreground I/O,
+ * which it would otherwise slow down (see 'do_bg_work()').
+ *
  * Note, in this implementation, we keep a small in-RAM object for each physical
  * eraseblock. This is surely not a scalable solution. But it appears to be good
  * enough for moderately large flashes and it is simple. In future, one may
@@ -109,6 +114,7 @@
 #include <linux/crc32.h>
 #include <linux/freezer.h>
 #include <linux/kthread.h>
+#include <linux/moduleparam.h>
 #include "ubi.h"
 
 /* Number of physical eraseblocks reserved for wear-leveling purposes */
@@ -141,6 +147,23 @@
  */
 #define WL_MAX_FAILURES 32
 
+/*
+ * The background thread does up to @erase_batch erasures in a row, and
+ * defers wear-leveling until there has been no foreground I/O for
+ * @wl_defer_ms milliseconds, but for not longer than %WL_MAX_DEFER.
+ */
+static unsigned int erase_batch = 8;
+module_param(erase_batch, uint, 0644);
+MODULE_PARM_DESC(erase_batch, "Max. erasures the background thread does in "
+		 "a row (default: 8)");
+
+static unsigned int wl_defer_ms = 100;
+module_param(wl_defer_ms, uint, 0644);
+MODULE_PARM_DESC(wl_defer_ms, "Defer wear-leveling until there was no "
+		 "foreground I/O for this long (default: 100, 0 - do not)");
+
+#define WL_MAX_DEFER (10*HZ)
+
 /**
  * struct ubi_work - UBI work description data structure.
  * @list: a link in the list of pending works
@@ -172,6 +195,9 @@ static int paranoid_check_in_pq(struct ubi_device *ubi, struct ubi_wl_entry *e);
 #define paranoid_check_in_pq(ubi, e) 0
 #endif
 
+static int erase_worker(struct ubi_device *ubi, struct ubi_work *wl_wrk,
+			int cancel);
+
 /**
  * wl_tree_add - add a wear-leveling entry to a WL RB-tree.
  * @e: the wear-leveling entry to add
@@ -208,12 +234,57 @@ static void wl_tree_add(struct ubi_wl_entry *e, struct rb_root *root)
 	rb_insert_color(&e->u.rb, root);
 }
 
+/**
+ * erase_pending - check if an erasure is pending.
+ * @ubi: UBI device description object
+ *
+ * Has to be called with @ubi->wl_lock locked.
+ */
+static int erase_pending(struct ubi_device *ubi)
+{
+	struct ubi_work *wrk;
+
+	list_for_each_entry(wrk, &ubi->works, list)
+		if (wrk->func == &erase_worker)
+			return 1;
+	return 0;
+}
+
+/**
+ * take_work - take a pending work off the list.
+ * @ubi: UBI device description object
+ * @erase_only: only take erasure works
+ *
+ * This function takes the first pending erasure work, or if there is none and
+ * @erase_only is zero, the first pending work. Returns %NULL if there is no
+ * such work. Has to be called with @ubi->wl_lock locked.
+ */
+static struct ubi_work *take_work(struct ubi_device *ubi, int erase_only)
+{
+	struct ubi_work *wrk;
+
+	list_for_each_entry(wrk, &ubi->works, list)
+		if (wrk->func == &erase_worker)
+			goto found;
+
+	if (erase_only || list_empty(&ubi->works))
+		return NULL;
+	wrk = list_entry(ubi->works.next, struct ubi_work, list);
+
+found:
+	list_del(&wrk->list);
+	ubi->works_count -= 1;
+	ubi_assert(ubi->works_count >= 0);
+	return wrk;
+}
+
 /**
  * do_work - do one pending work.
  * @ubi: UBI device description object
  *
- * This function returns zero in case of success and a negative error code in
- * case of failure.
+ * Erasures are done before the other works, since a task which waits for a
+ * free PEB may be calling this function. This function returns zero in case
+ * of success and a negative error code in case of failure.
  */
 static int do_work(struct ubi_device *ubi)
 {
@@ -230,18 +301,13 @@ static int do_work(struct ubi_device *ubi)
 	 */
 	down_read(&ubi->work_sem);
 	spin_lock(&ubi->wl_lock);
-	if (list_empty(&ubi->works)) {
-		spin_unlock(&ubi->wl_lock);
+	wrk = take_work(ubi, 0);
+	spin_unlock(&ubi->wl_lock);
+	if (!wrk) {
 		up_read(&ubi->work_sem);
 		return 0;
 	}
 
-	wrk = list_entry(ubi->works.next, struct ubi_work, list);
-	list_del(&wrk->list);
-	ubi->works_count -= 1;
-	ubi_assert(ubi->works_count >= 0);
-	spin_unlock(&ubi->wl_lock);
-
 	/*
 	 * Call the worker function. Do not touch the work structure
 	 * after this call as it will have been freed or reused by that
@@ -284,6 +350,132 @@ static int produce_free_peb(struct ubi_device *ubi)
 	return 0;
 }
 
+/**
+ * do_change_work - do one pending work on behalf of a task which does not
+ * change the flash otherwise.
+ * @ubi: UBI device description object
+ *
+ * Works change the flash, so the attach index sub-system is told about it
+ * first. This is not needed in 'produce_free_peb()', which is only called by
+ * the EBA sub-system when it already did this. Returns zero in case of
+ * success and a negative error code in case of failure.
+ */
+static int do_change_work(struct ubi_device *ubi)
+{
+	int err;
+
+	err = ubi_aidx_begin(ubi);
+	if (err)
+		return err;
+	err = do_work(ubi);
+	ubi_aidx_end(ubi);
+	return err;
+}
+
+/**
+ * wl_may_wait - check if wear-leveling should be deferred.
+ * @ubi: UBI device description object
+ *
+ * This function returns non-zero if there is foreground I/O, or there was
+ * some less than @wl_defer_ms milliseconds ago, unless wear-leveling has
+ * already been deferred for %WL_MAX_DEFER. Has to be called with
+ * @ubi->wl_lock locked.
+ */
+static int wl_may_wait(struct ubi_device *ubi)
+{
+	unsigned long idle = ubi->fg_io_last + msecs_to_jiffies(wl_defer_ms);
+
+	if (!wl_defer_ms ||
+	    (!atomic_read(&ubi->fg_io) && time_after_eq(jiffies, idle))) {
+		ubi->wl_defer_start = 0;
+		return 0;
+	}
+
+	if (!ubi->wl_defer_start) {
+		ubi->wl_defer_start = jiffies ?: 1;
+		ubi_stats_count(ubi, wl_deferrals, 1);
+	} else if (time_after(jiffies, ubi->wl_defer_start + WL_MAX_DEFER)) {
+		dbg_wl("wear-leveling deferred for too long");
+		ubi->wl_defer_start = 0;
+		return 0;
+	}
+
+	return 1;
+}
+
+/**
+ * do_bg_work - do pending works on behalf of the background thread.
+ * @ubi: UBI device description object
+ *
+ * This function does a batch of up to @erase_batch pending erasures, which
+ * ends early if a foreground read or write starts meanwhile. If there are no
+ * erasures pending, it does one other work, but wear-leveling is deferred for
+ * as long as 'wl_may_wait()' says so. Returns the number of works done, and a
+ * negative error code in case of failure.
+ */
+static int do_bg_work(struct ubi_device *ubi)
+{
+	int err, done = 0, other = 0;
+	struct ubi_work *wrk;
+
+	/*
+	 * The attach index sub-system has to be told before @ubi->work_sem is
+	 * taken, but only if a work is going to be done. So decide that here,
+	 * and take the works off the queue below.
+	 */
+	spin_lock(&ubi->wl_lock);
+	if (!erase_pending(ubi)) {
+		other = !list_empty(&ubi->works) && !wl_may_wait(ubi);
+		if (!other) {
+			spin_unlock(&ubi->wl_lock);
+			return 0;
+		}
+	}
+	spin_unlock(&ubi->wl_lock);
+
+	err = ubi_aidx_begin(ubi);
+	if (err)
+		return err;
+
+	down_read(&ubi->work_sem);
+	while (1) {
+		int erase;
+
+		spin_lock(&ubi->wl_lock);
+		wrk = take_work(ubi, 1);
+		if (!wrk && !done && other)
+			wrk = take_work(ubi, 0);
+		spin_unlock(&ubi->wl_lock);
+		if (!wrk)
+			break;
+
+		/* The work structure must not be touched after the call */
+		erase = wrk->func == &erase_worker;
+		err = wrk->func(ubi, wrk, 0);
+		if (err) {
+			ubi_err("work failed with error code %d", err);
+			break;
+		}
+
+		done += 1;
+		if (!erase || done >= erase_batch)
+			break;
+		if (atomic_read(&ubi->fg_io)) {
+			ubi_stats_count(ubi, erase_yields, 1);
+			break;
+		}
+		cond_resched();
+	}
+	up_read(&ubi->work_sem);
+	ubi_aidx_end(ubi);
+
+	if (done > 1) {
+		ubi_stats_count(ubi, erase_batches, 1);
+		ubi_stats_count(ubi, erase_batched, done);
+	}
+	return err ? err : done;
+}
+
 /**
  * in_wl_tree - check if wear-leveling entry is present in a WL RB-tree.
  * @e: the wear-leveling entry to check
@@ -618,9 +810,6 @@ static void schedule_ubi_work(struct ubi_device *ubi, struct ubi_work *wrk)
 	spin_unlock(&ubi->wl_lock);
 }
 
-static int erase_worker(struct ubi_device *ubi, struct ubi_work *wl_wrk,
-			int cancel);
-
 /**
  * schedule_erase - schedule an erase work.
  * @ubi: UBI device description object
@@ -667,11 +856,14 @@ static int wear_leveling_worker(struct ubi_device *ubi, struct ubi_work *wrk,
 	int vol_id = -1, uninitialized_var(lnum);
 	struct ubi_wl_entry *e1, *e2;
 	struct ubi_vid_hdr *vid_hdr;
+	ktime_t start;
 
 	kfree(wrk);
 	if (cancel)
 		return 0;
 
+	start = ubi_stats_start();
+
 	vid_hdr = ubi_zalloc_vid_hdr(ubi, GFP_NOFS);
 	if (!vid_hdr)
 		return -ENOMEM;
@@ -817,6 +1009,7 @@ static int wear_leveling_worker(struct ubi_device *ubi, struct ubi_work *wrk,
 	}
 
 	/* The PEB has been successfully moved */
+	ubi_stats_add(ubi, UBI_STAT_MOVE, start);
 	if (scrubbing)
 		ubi_msg("scrubbed PEB %d (LEB %d:%d), data moved to PEB %d",
 			e1->pnum, vol_id, lnum, e2->pnum);
@@ -1004,6 +1197,7 @@ static int erase_worker(struct ubi_device *ubi, struct ubi_work *wl_wrk,
 {
 	struct ubi_wl_entry *e = wl_wrk->e;
 	int pnum = e->pnum, err, need;
+	ktime_t start;
 
 	if (cancel) {
 		dbg_wl("cancel erasure of PEB %d EC %d", pnum, e->ec);
@@ -1014,9 +1208,11 @@ static int erase_worker(struct ubi_device *ubi, struct ubi_work *wl_wrk,
 
 	dbg_wl("erase PEB %d EC %d", pnum, e->ec);
 
+	start = ubi_stats_start();
 	err = sync_erase(ubi, e, wl_wrk->torture);
 	if (!err) {
 		/* Fine, we've erased it successfully */
+		ubi_stats_add(ubi, UBI_STAT_ERASE, start);
 		kfree(wl_wrk);
 
 		spin_lock(&ubi->wl_lock);
@@ -1193,6 +1389,124 @@ retry:
 	return err;
 }
 
+#ifdef CONFIG_MTD_UBI_ATTACH_INDEX
+
+/**
+ * ubi_wl_get_aidx_peb - get a physical eraseblock for the attach index.
+ * @ubi: UBI device description object
+ * @max_pnum: the physical eraseblock has to be below this number
+ *
+ * This function takes the free physical eraseblock with the lowest erase
+ * counter below @max_pnum. Unlike the ones returned by 'ubi_wl_get_peb()', it
+ * is kept out of all the WL trees and queues until it is given back with
+ * 'ubi_wl_put_aidx_peb()', so the wear-leveling worker never moves it.
+ * Returns the physical eraseblock number in case of success and a negative
+ * error code in case of failure.
+ */
+int ubi_wl_get_aidx_peb(struct ubi_device *ubi, int max_pnum)
+{
+	int err;
+	struct rb_node *rb;
+	struct ubi_wl_entry *e = NULL;
+
+	spin_lock(&ubi->wl_lock);
+	for (rb = rb_first(&ubi->free); rb; rb = rb_next(rb)) {
+		e = rb_entry(rb, struct ubi_wl_entry, u.rb);
+		if (e->pnum < max_pnum)
+			break;
+	}
+	if (!rb) {
+		spin_unlock(&ubi->wl_lock);
+		return -ENOSPC;
+	}
+	rb_erase(&e->u.rb, &ubi->free);
+	dbg_wl("PEB %d EC %d", e->pnum, e->ec);
+	spin_unlock(&ubi->wl_lock);
+
+	err = ubi_dbg_check_all_ff(ubi, e->pnum, ubi->vid_hdr_aloffset,
+				   ubi->peb_size - ubi->vid_hdr_aloffset);
+	if (err) {
+		ubi_err("new PEB %d does not contain all 0xFF bytes", e->pnum);
+		return err;
+	}
+
+	return e->pnum;
+}
+
+/**
+ * ubi_wl_put_aidx_peb - return a PEB of the attach index.
+ * @ubi: UBI device description object
+ * @pnum: physical eraseblock to return
+ * @erase: if the physical eraseblock has to be erased
+ *
+ * This function returns physical eraseblock @pnum taken with
+ * 'ubi_wl_get_aidx_peb()' or added with 'ubi_wl_add_aidx_peb()'. If @erase
+ * is set, it is erased synchronously and becomes free, so the caller may take
+ * it again. Otherwise it is put to the used tree, which is only good for
+ * closing the WL sub-system. Returns zero in case of success and a negative
+ * error code in case of failure. Even if erasure fails, the PEB is not held
+ * by the attach index anymore: it is then tortured by the background thread.
+ */
+int ubi_wl_put_aidx_peb(struct ubi_device *ubi, int pnum, int erase)
+{
+	int err;
+	struct ubi_wl_entry *e;
+
+	dbg_wl("PEB %d", pnum);
+	e = ubi->lookuptbl[pnum];
+	ubi_assert(e);
+
+	if (!erase) {
+		spin_lock(&ubi->wl_lock);
+		wl_tree_add(e, &ubi->used);
+		spin_unlock(&ubi->wl_lock);
+		return 0;
+	}
+
+	err = sync_erase(ubi, e, 0);
+	if (err) {
+		ubi_warn("cannot erase attach index PEB %d, error %d",
+			 pnum, err);
+		if (schedule_erase(ubi, e, 1))
+			ubi_err("PEB %d is lost", pnum);
+		return err;
+	}
+
+	spin_lock(&ubi->wl_lock);
+	wl_tree_add(e, &ubi->free);
+	spin_unlock(&ubi->wl_lock);
+	return 0;
+}
+
+/**
+ * ubi_wl_add_aidx_peb - add a PEB of the attach index.
+ * @ubi: UBI device description object
+ * @pnum: the physical eraseblock
+ * @ec: its erase counter
+ *
+ * This function is used when UBI is attached by means of the attach index,
+ * whose own physical eraseblocks are not part of the scanning information.
+ * They are handled as if they were taken with 'ubi_wl_get_aidx_peb()'.
+ * Returns zero in case of success and %-ENOMEM in case of failure.
+ */
+int ubi_wl_add_aidx_peb(struct ubi_device *ubi, int pnum, int ec)
+{
+	struct ubi_wl_entry *e;
+
+	e = kmem_cache_alloc(ubi_wl_entry_slab, GFP_KERNEL);
+	if (!e)
+		return -ENOMEM;
+
+	e->pnum = pnum;
+	e->ec = ec;
+	ubi->lookuptbl[pnum] = e;
+	if (ubi->max_ec < ec)
+		ubi->max_ec = ec;
+	return 0;
+}
+
+#endif /* CONFIG_MTD_UBI_ATTACH_INDEX */
+
 /**
  * ubi_wl_scrub_peb - schedule a physical eraseblock for scrubbing.
  * @ubi: UBI device description object
@@ -1272,7 +1586,7 @@ int ubi_wl_flush(struct ubi_device *ubi)
 	 */
 	dbg_wl("flush (%d pending works)", ubi->works_count);
 	while (ubi->works_count) {
-		err = do_work(ubi);
+		err = do_change_work(ubi);
 		if (err)
 			return err;
 	}
@@ -1290,7 +1604,7 @@ int ubi_wl_flush(struct ubi_device *ubi)
 	 */
 	while (ubi->works_count) {
 		dbg_wl("flush more (%d pending works)", ubi->works_count);
-		err = do_work(ubi);
+		err = do_change_work(ubi);
 		if (err)
 			return err;
 	}
@@ -1361,8 +1675,8 @@ int ubi_thread(void *u)
 		}
 		spin_unlock(&ubi->wl_lock);
 
-		err = do_work(ubi);
-		if (err) {
+		err = do_bg_work(ubi);
+		if (err < 0) {
 			ubi_err("%s: work failed with error code %d",
 				ubi->bgt_name, err);
 			if (failures++ > WL_MAX_FAILURES) {
@@ -1376,8 +1690,13 @@ int ubi_thread(void *u)
 				ubi->thread_enabled = 0;
 				continue;
 			}
-		} else
+		} else {
 			failures = 0;
+			if (!err)
+				/* Wear-leveling is deferred, check back later */
+				schedule_timeout_interruptible(
+					msecs_to_jiffies(wl_defer_ms ?: 1));
+		}
 
 		cond_resched();
 	}
@@ -1425,6 +1744,8 @@ int ubi_wl_init_scan(struct ubi_device *ubi, struct ubi_scan_info *si)
 	init_rwsem(&ubi->work_sem);
 	ubi->max_ec = si->max_ec;
 	INIT_LIST_HEAD(&ubi->works);
+	atomic_set(&ubi->fg_io, 0);
+	ubi->fg_io_last = jiffies;
 
 	sprintf(ubi->bgt_name, UBI_BGT_NAME_PATTERN, ubi->ubi_num);
 
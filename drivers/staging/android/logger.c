@@ -700,6 +700,48 @@ static struct logger_log *get_log_from_minor(int minor)
 	return NULL;
 }
 
+#ifdef CONFIG_ANDROID_RAM_CONSOLE_LOGGER_TAIL
+/*
+ * logger_copy_tail - copies the newest whole entries of the log named 'name',
+ * at most 'len' bytes of them, to 'buf'. Returns the number of bytes copied.
+ *
+ * This is for crash dumps, so log->mutex is not taken: an entry written at
+ * the same time may come out torn, and users of the copy must check the
+ * lengths of the entries.
+ */
+size_t logger_copy_tail(const char *name, void *buf, size_t len)
+{
+	struct logger_log *log;
+	size_t off, used, n;
+
+	if (!strcmp(name, LOGGER_LOG_MAIN))
+		log = &log_main;
+	else if (!strcmp(name, LOGGER_LOG_SYSTEM))
+		log = &log_system;
+	else if (!strcmp(name, LOGGER_LOG_RADIO))
+		log = &log_radio;
+	else if (!strcmp(name, LOGGER_LOG_EVENTS))
+		log = &log_events;
+	else
+		return 0;
+
+	off = log->head;
+	used = logger_offset(log->w_off - off);
+	while (used > len) {
+		n = get_entry_len(log, off);
+		if (n > used)
+			return 0;
+		off = logger_offset(off + n);
+		used -= n;
+	}
+
+	n = min(used, log->size - off);
+	memcpy(buf, log->buffer + off, n);
+	memcpy(buf + n, log->buffer, used - n);
+	return used;
+}
+#endif
+
 static int __init init_log(struct logger_log *log)
 {
 	int ret;
@@ -46,4 +46,6 @@ struct logger_entry {
 #define LOGGER_GET_NEXT_ENTRY_LEN	_IO(__LOGGERIO, 3) /* next entry len */
 #define LOGGER_FLUSH_LOG		_IO(__LOGGERIO, 4) /* flush log */
 
+size_t logger_copy_tail(const char *name, void *buf, size_t len);
+
 #endif /* _LINUX_LOGGER_H */
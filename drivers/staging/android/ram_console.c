@@ -25,6 +25,19 @@
 #ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION
 #include <linux/rslib.h>
 #endif
+#ifdef CONFIG_ANDROID_RAM_CONSOLE_RECORDS
+#include <linux/kmsg_dump.h>
+#include <linux/lzo.h>
+#include <linux/reboot.h>
+#include <linux/mutex.h>
+#include <linux/spinlock.h>
+#include <linux/timer.h>
+#include <linux/vmalloc.h>
+#include <linux/workqueue.h>
+#endif
+#ifdef CONFIG_ANDROID_RAM_CONSOLE_LOGGER_TAIL
+#include "logger.h"
+#endif
 
 struct ram_console_buffer {
 	uint32_t    sig;
@@ -221,12 +234,865 @@ ram_console_save_old(struct ram_console_buffer *buffer, char *dest)
 #endif
 }
 
+#ifdef CONFIG_ANDROID_RAM_CONSOLE_RECORDS
+/*
+ * In record mode the buffer holds, in this order: a header, the two live
+ * blocks console output is copied to, the oops slots, the copies of the
+ * Android logs and a ring of records.  Once a live block is full, output
+ * goes to the other one, and a work item compresses the full block, gives
+ * it its parity and appends it to the ring as a single record, evicting
+ * the oldest records to make room.  Only if the other block is still
+ * waiting for the work item does printk store it itself, uncompressed.
+ * The live blocks only get parity when the kernel oopses, panics or
+ * reboots: output is only ever appended to them, so that parity still
+ * covers the beginning of a block if more is printed afterwards.
+ */
+#define RAM_LOG_SIG		(0x52474244) /* DBGR */
+#define RAM_LOG_REC_MAGIC	(0x43455244) /* DREC */
+#define RAM_LOG_WRAP		(0x50525744) /* DWRP */
+#define RAM_LOG_OOPS_MAGIC	(0x504f4f44) /* DOOP */
+#define RAM_LOG_TAIL_MAGIC	(0x4c415444) /* DTAL */
+
+#define RAM_LOG_BLOCK_SIZE	CONFIG_ANDROID_RAM_CONSOLE_RECORDS_BLOCK_SIZE
+#define RAM_LOG_OOPS_COUNT	CONFIG_ANDROID_RAM_CONSOLE_OOPS_COUNT
+#define RAM_LOG_OOPS_SIZE	CONFIG_ANDROID_RAM_CONSOLE_OOPS_SIZE
+
+#ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION
+#define RAM_LOG_PAR_SIZE(len)	(DIV_ROUND_UP(len, ECC_BLOCK_SIZE) * ECC_SIZE)
+#else
+#define RAM_LOG_PAR_SIZE(len)	0
+#endif
+
+struct ram_log_header {
+	uint32_t    sig;
+	uint32_t    block_size;
+	uint32_t    ring_size;
+	uint32_t    head;	/* where the next record goes */
+	uint32_t    tail;	/* oldest record */
+	uint32_t    count;	/* records in the ring */
+};
+
+struct ram_log_live {
+	uint32_t    seq;
+	uint32_t    len;
+	uint32_t    len_check;	/* ~len */
+	uint32_t    ecc_len;	/* bytes covered by the parity */
+	uint8_t     data[RAM_LOG_BLOCK_SIZE];
+};
+
+/*
+ * A record is this header and its parity, then the data and its parity,
+ * padded to a multiple of 4 bytes.
+ */
+struct ram_log_record {
+	uint32_t    magic;
+	uint32_t    seq;
+	uint16_t    len;	/* stored length */
+	uint16_t    flags;
+	uint32_t    ulen;	/* uncompressed length */
+};
+
+#define RAM_LOG_REC_LZO		0x1
+
+#define RAM_LOG_REC_DATA	(sizeof(struct ram_log_record) + \
+				 RAM_LOG_PAR_SIZE(sizeof(struct ram_log_record)))
+#define RAM_LOG_REC_SIZE(len)	ALIGN(RAM_LOG_REC_DATA + (len) + \
+				      RAM_LOG_PAR_SIZE(len), 4)
+
+struct ram_log_oops {
+	uint32_t    magic;
+	uint32_t    seq;
+	uint32_t    reason;
+	uint32_t    len;
+	uint8_t     data[RAM_LOG_OOPS_SIZE];
+};
+
+#ifdef CONFIG_ANDROID_RAM_CONSOLE_LOGGER_TAIL
+#define RAM_LOG_TAIL_SIZE	CONFIG_ANDROID_RAM_CONSOLE_LOGGER_TAIL_SIZE
+
+/* The events log is binary, it is not worth the space */
+static const char *ram_log_tail_names[] = {
+	LOGGER_LOG_MAIN,
+	LOGGER_LOG_SYSTEM,
+	LOGGER_LOG_RADIO,
+};
+
+#define RAM_LOG_TAILS		ARRAY_SIZE(ram_log_tail_names)
+
+struct ram_log_tail {
+	uint32_t    magic;
+	uint32_t    len;
+	uint8_t     data[RAM_LOG_TAIL_SIZE];
+};
+
+static struct ram_log_tail *ram_log_tail[RAM_LOG_TAILS];
+static uint8_t *ram_log_tail_par[RAM_LOG_TAILS];
+#endif
+
+static struct ram_log_header *ram_log_header;
+static uint8_t *ram_log_header_par;
+static struct ram_log_live *ram_log_live[2];
+static uint8_t *ram_log_live_par[2];
+static int ram_log_cur;		/* live block output is copied to */
+static uint32_t ram_log_seq;	/* seq of the next live block */
+static struct ram_log_oops *ram_log_oops[RAM_LOG_OOPS_COUNT];
+static uint8_t *ram_log_oops_par[RAM_LOG_OOPS_COUNT];
+static unsigned int ram_log_oops_seen;
+static uint8_t *ram_log_ring;
+static size_t ram_log_ring_size;
+
+static DEFINE_SPINLOCK(ram_log_lock);
+
+/* Used by the work item only, or before the console is registered */
+static DEFINE_MUTEX(ram_log_seal_mutex);
+static void *ram_log_lzo_wrkmem;
+static uint8_t ram_log_seal_buf[RAM_LOG_BLOCK_SIZE];
+static uint8_t ram_log_rec_buf[RAM_LOG_REC_SIZE(
+			lzo1x_worst_compress(RAM_LOG_BLOCK_SIZE))];
+
+static void ram_log_encode(void *data, size_t len, uint8_t *par)
+{
+#ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION
+	uint8_t *block = data;
+
+	while (len) {
+		size_t size = min_t(size_t, len, ECC_BLOCK_SIZE);
+
+		ram_console_encode_rs8(block, size, par);
+		block += size;
+		par += ECC_SIZE;
+		len -= size;
+	}
+#endif
+}
+
+/* Returns the number of uncorrectable blocks */
+static int __init ram_log_decode(void *data, size_t len, uint8_t *par)
+{
+	int bad = 0;
+#ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION
+	uint8_t *block = data;
+
+	while (len) {
+		size_t size = min_t(size_t, len, ECC_BLOCK_SIZE);
+		int numerr = ram_console_decode_rs8(block, size, par);
+
+		if (numerr > 0)
+			ram_console_corrected_bytes += numerr;
+		else if (numerr < 0)
+			bad++;
+		block += size;
+		par += ECC_SIZE;
+		len -= size;
+	}
+	ram_console_bad_blocks += bad;
+#endif
+	return bad;
+}
+
+static void ram_log_update_header(void)
+{
+	ram_log_encode(ram_log_header, sizeof(*ram_log_header),
+		       ram_log_header_par);
+}
+
+/*
+ * Moves the tail to the start of the ring if the lap ends there: at the
+ * end of the ring, at a wrap marker or with no room left for a record.
+ */
+static void ram_log_wrap_tail(void)
+{
+	struct ram_log_header *header = ram_log_header;
+
+	if (header->tail + RAM_LOG_REC_DATA > ram_log_ring_size ||
+	    *(uint32_t *)(ram_log_ring + header->tail) == RAM_LOG_WRAP)
+		header->tail = 0;
+}
+
+/* Drops the records that start in [start, end) */
+static void ram_log_evict(uint32_t start, uint32_t end)
+{
+	struct ram_log_header *header = ram_log_header;
+
+	while (header->count) {
+		struct ram_log_record *rec;
+
+		ram_log_wrap_tail();
+		if (header->tail < start || header->tail >= end)
+			break;
+		rec = (struct ram_log_record *)(ram_log_ring + header->tail);
+		if (rec->magic != RAM_LOG_REC_MAGIC ||
+		    header->tail + RAM_LOG_REC_SIZE(rec->len) >
+		    ram_log_ring_size) {
+			header->count = 0;
+			break;
+		}
+		header->tail += RAM_LOG_REC_SIZE(rec->len);
+		header->count--;
+	}
+}
+
+/*
+ * Makes room for a record of len bytes at the head of the ring and returns
+ * where it goes.  Called with ram_log_lock held.
+ */
+static uint32_t ram_log_reserve(size_t len)
+{
+	struct ram_log_header *header = ram_log_header;
+	uint32_t pos = header->head;
+	int wrap;
+
+	/* Commit the evictions before overwriting what they freed */
+	wrap = pos + len > ram_log_ring_size;
+	if (wrap) {
+		ram_log_evict(pos, ram_log_ring_size);
+		pos = 0;
+	}
+	ram_log_evict(pos, pos + len);
+	if (!header->count)
+		header->tail = pos;
+	ram_log_update_header();
+
+	if (wrap && header->head + sizeof(uint32_t) <= ram_log_ring_size)
+		*(uint32_t *)(ram_log_ring + header->head) = RAM_LOG_WRAP;
+	return pos;
+}
+
+/* Commits the record written at pos.  Called with ram_log_lock held. */
+static void ram_log_append(uint32_t pos, size_t len)
+{
+	struct ram_log_header *header = ram_log_header;
+
+	header->head = pos + len;
+	header->count++;
+	ram_log_update_header();
+}
+
+static void ram_log_reset(struct ram_log_live *live)
+{
+	live->ecc_len = ~0;
+	live->len = 0;
+	live->len_check = ~0;
+}
+
+/*
+ * Compresses a full block into a record in ram_log_rec_buf and returns its
+ * size.  Called with ram_log_seal_mutex held, or before the console is
+ * registered.
+ */
+static size_t ram_log_build(const uint8_t *block, uint32_t seq)
+{
+	struct ram_log_record *rec = (struct ram_log_record *)ram_log_rec_buf;
+	uint8_t *data = ram_log_rec_buf + RAM_LOG_REC_DATA;
+	size_t len = lzo1x_worst_compress(RAM_LOG_BLOCK_SIZE);
+
+	rec->flags = 0;
+	if (ram_log_lzo_wrkmem &&
+	    lzo1x_1_compress(block, RAM_LOG_BLOCK_SIZE, data, &len,
+			     ram_log_lzo_wrkmem) == LZO_E_OK &&
+	    len < RAM_LOG_BLOCK_SIZE) {
+		rec->flags |= RAM_LOG_REC_LZO;
+	} else {
+		len = RAM_LOG_BLOCK_SIZE;
+		memcpy(data, block, len);
+	}
+	rec->magic = RAM_LOG_REC_MAGIC;
+	rec->seq = seq;
+	rec->len = len;
+	rec->ulen = RAM_LOG_BLOCK_SIZE;
+	ram_log_encode(rec, sizeof(*rec), ram_log_rec_buf + sizeof(*rec));
+	ram_log_encode(data, len, data + len);
+	return RAM_LOG_REC_SIZE(len);
+}
+
+/* Appends the record in ram_log_rec_buf.  Called with ram_log_lock held. */
+static void ram_log_add(size_t len)
+{
+	uint32_t pos = ram_log_reserve(len);
+
+	memcpy(ram_log_ring + pos, ram_log_rec_buf, len);
+	ram_log_append(pos, len);
+}
+
+/*
+ * Stores a full block as an uncompressed record, straight into the ring.
+ * Called with ram_log_lock held, from printk when the work item is a whole
+ * block behind.
+ */
+static void ram_log_store(struct ram_log_live *live)
+{
+	struct ram_log_record rec = {
+		.magic	= RAM_LOG_REC_MAGIC,
+		.seq	= live->seq,
+		.len	= RAM_LOG_BLOCK_SIZE,
+		.flags	= 0,
+		.ulen	= RAM_LOG_BLOCK_SIZE,
+	};
+	size_t len = RAM_LOG_REC_SIZE(RAM_LOG_BLOCK_SIZE);
+	uint32_t pos = ram_log_reserve(len);
+	uint8_t *dest = ram_log_ring + pos;
+
+	memcpy(dest, &rec, sizeof(rec));
+	ram_log_encode(dest, sizeof(rec), dest + sizeof(rec));
+	dest += RAM_LOG_REC_DATA;
+	memcpy(dest, live->data, RAM_LOG_BLOCK_SIZE);
+	ram_log_encode(dest, RAM_LOG_BLOCK_SIZE, dest + RAM_LOG_BLOCK_SIZE);
+	ram_log_append(pos, len);
+	ram_log_reset(live);
+}
+
+/* Seals the full live block, if there is one */
+static void ram_log_seal_fn(struct work_struct *work)
+{
+	struct ram_log_live *live;
+	unsigned long flags;
+	uint32_t seq;
+	size_t len;
+
+	mutex_lock(&ram_log_seal_mutex);
+
+	spin_lock_irqsave(&ram_log_lock, flags);
+	live = ram_log_live[ram_log_cur ^ 1];
+	seq = live->seq;
+	len = live->len;
+	if (len == RAM_LOG_BLOCK_SIZE)
+		memcpy(ram_log_seal_buf, live->data, RAM_LOG_BLOCK_SIZE);
+	spin_unlock_irqrestore(&ram_log_lock, flags);
+	if (len != RAM_LOG_BLOCK_SIZE)
+		goto out;
+
+	len = ram_log_build(ram_log_seal_buf, seq);
+
+	spin_lock_irqsave(&ram_log_lock, flags);
+	/* printk stores the block itself if the other one fills up first */
+	if (live->len == RAM_LOG_BLOCK_SIZE && live->seq == seq) {
+		ram_log_add(len);
+		ram_log_reset(live);
+	}
+	spin_unlock_irqrestore(&ram_log_lock, flags);
+out:
+	mutex_unlock(&ram_log_seal_mutex);
+}
+
+static DECLARE_WORK(ram_log_seal_work, ram_log_seal_fn);
+
+/* Queueing work from printk could wake a task under the runqueue lock */
+static void ram_log_seal_kick(unsigned long data)
+{
+	schedule_work(&ram_log_seal_work);
+}
+
+static DEFINE_TIMER(ram_log_seal_timer, ram_log_seal_kick, 0, 0);
+
+/*
+ * Moves console output to the other live block once the current one is
+ * full, and has the work item seal the full one.
+ */
+static void ram_log_next_block(void)
+{
+	int next = ram_log_cur ^ 1;
+	struct ram_log_live *live = ram_log_live[next];
+
+	if (live->len)
+		ram_log_store(live);
+	live->seq = ram_log_seq++;
+	ram_log_cur = next;
+	if (!timer_pending(&ram_log_seal_timer))
+		mod_timer(&ram_log_seal_timer, jiffies + 1);
+}
+
+static void
+ram_log_write(struct console *console, const char *s, unsigned int count)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&ram_log_lock, flags);
+	while (count) {
+		struct ram_log_live *live = ram_log_live[ram_log_cur];
+		size_t n = min_t(size_t, count, RAM_LOG_BLOCK_SIZE - live->len);
+
+		memcpy(live->data + live->len, s, n);
+		live->len += n;
+		live->len_check = ~live->len;
+		s += n;
+		count -= n;
+		if (live->len == RAM_LOG_BLOCK_SIZE)
+			ram_log_next_block();
+	}
+	spin_unlock_irqrestore(&ram_log_lock, flags);
+}
+
+static void ram_log_flush(void)
+{
+	int i;
+
+	for (i = 0; i < 2; i++) {
+		struct ram_log_live *live = ram_log_live[i];
+
+		ram_log_encode(live->data, live->len, ram_log_live_par[i]);
+		live->ecc_len = live->len;
+	}
+}
+
+static void ram_log_dump(struct kmsg_dumper *dumper,
+			 enum kmsg_dump_reason reason,
+			 const char *s1, unsigned long l1,
+			 const char *s2, unsigned long l2)
+{
+	unsigned int slot = ram_log_oops_seen % RAM_LOG_OOPS_COUNT;
+	struct ram_log_oops *oops = ram_log_oops[slot];
+	unsigned long n1, n2;
+	unsigned long flags;
+	int locked;
+#ifdef CONFIG_ANDROID_RAM_CONSOLE_LOGGER_TAIL
+	int i;
+#endif
+
+	if (reason != KMSG_DUMP_OOPS && reason != KMSG_DUMP_PANIC)
+		return;
+
+	/* Don't wait for a console write this cpu may have died in */
+	locked = spin_trylock_irqsave(&ram_log_lock, flags);
+
+	n2 = min_t(unsigned long, l2, RAM_LOG_OOPS_SIZE);
+	n1 = min_t(unsigned long, l1, RAM_LOG_OOPS_SIZE - n2);
+	memcpy(oops->data, s1 + l1 - n1, n1);
+	memcpy(oops->data + n1, s2 + l2 - n2, n2);
+	oops->magic = RAM_LOG_OOPS_MAGIC;
+	oops->seq = ram_log_oops_seen++;
+	oops->reason = reason;
+	oops->len = n1 + n2;
+	ram_log_encode(oops, sizeof(*oops), ram_log_oops_par[slot]);
+
+#ifdef CONFIG_ANDROID_RAM_CONSOLE_LOGGER_TAIL
+	for (i = 0; i < RAM_LOG_TAILS; i++) {
+		struct ram_log_tail *tail = ram_log_tail[i];
+
+		tail->magic = RAM_LOG_TAIL_MAGIC;
+		tail->len = logger_copy_tail(ram_log_tail_names[i],
+					     tail->data, RAM_LOG_TAIL_SIZE);
+		ram_log_encode(tail, sizeof(*tail), ram_log_tail_par[i]);
+	}
+#endif
+
+	ram_log_flush();
+	if (locked)
+		spin_unlock_irqrestore(&ram_log_lock, flags);
+}
+
+static struct kmsg_dumper ram_log_dumper = {
+	.dump = ram_log_dump,
+};
+
+static int ram_log_reboot(struct notifier_block *nb, unsigned long event,
+			  void *unused)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&ram_log_lock, flags);
+	ram_log_flush();
+	spin_unlock_irqrestore(&ram_log_lock, flags);
+	return NOTIFY_DONE;
+}
+
+static struct notifier_block ram_log_reboot_nb = {
+	.notifier_call = ram_log_reboot,
+};
+
+/* Set to the seq after the last record saved, to leave out a live block */
+static int ram_log_saved_any __initdata;
+static uint32_t ram_log_saved_seq __initdata;
+
+static size_t __init ram_log_save_records(char *dest)
+{
+	struct ram_log_header *header = ram_log_header;
+	size_t pos = 0;
+	uint32_t off = header->tail;
+	uint32_t i;
+
+	for (i = 0; i < header->count; i++) {
+		struct ram_log_record *rec;
+		uint8_t *data;
+		size_t len;
+
+		/* Correct the header before trusting its length */
+		if (off + RAM_LOG_REC_DATA > ram_log_ring_size ||
+		    *(uint32_t *)(ram_log_ring + off) == RAM_LOG_WRAP)
+			off = 0;
+		rec = (struct ram_log_record *)(ram_log_ring + off);
+		if (ram_log_decode(rec, sizeof(*rec),
+				   (uint8_t *)rec + sizeof(*rec)) ||
+		    rec->magic != RAM_LOG_REC_MAGIC ||
+		    rec->ulen > RAM_LOG_BLOCK_SIZE ||
+		    off + RAM_LOG_REC_SIZE(rec->len) > ram_log_ring_size) {
+			pos += sprintf(dest + pos, "\n[%u records lost]\n",
+				       header->count - i);
+			break;
+		}
+
+		data = (uint8_t *)rec + RAM_LOG_REC_DATA;
+		ram_log_decode(data, rec->len, data + rec->len);
+		len = RAM_LOG_BLOCK_SIZE;
+		if (!(rec->flags & RAM_LOG_REC_LZO)) {
+			len = min_t(size_t, rec->len, RAM_LOG_BLOCK_SIZE);
+			memcpy(dest + pos, data, len);
+		} else if (lzo1x_decompress_safe(data, rec->len, dest + pos,
+						 &len) != LZO_E_OK) {
+			len = sprintf(dest + pos, "\n[record %u damaged]\n",
+				      rec->seq);
+		}
+		pos += len;
+		off += RAM_LOG_REC_SIZE(rec->len);
+		ram_log_saved_any = 1;
+		ram_log_saved_seq = rec->seq + 1;
+	}
+	return pos;
+}
+
+/*
+ * Saves the live blocks, oldest first.  A full block may have been stored
+ * as a record just before the kernel died, without being emptied.
+ */
+static size_t __init ram_log_save_live(char *dest)
+{
+	int first = (int32_t)(ram_log_live[1]->seq - ram_log_live[0]->seq) < 0;
+	size_t pos = 0;
+	int i;
+
+	for (i = 0; i < 2; i++) {
+		struct ram_log_live *live = ram_log_live[first ^ i];
+		size_t len = live->len;
+
+		if (ram_log_saved_any &&
+		    (int32_t)(live->seq - ram_log_saved_seq) < 0)
+			continue;
+		/* len may be torn if the kernel died while it was updated */
+		if (len > RAM_LOG_BLOCK_SIZE)
+			len = ~live->len_check;
+		if (len > RAM_LOG_BLOCK_SIZE)
+			continue;
+		if (live->ecc_len <= len)
+			ram_log_decode(live->data, live->ecc_len,
+				       ram_log_live_par[first ^ i]);
+		memcpy(dest + pos, live->data, len);
+		pos += len;
+	}
+	return pos;
+}
+
+static size_t __init ram_log_save_oopses(char *dest)
+{
+	static const char *reasons[] = { "oops", "panic" };
+	size_t pos = 0;
+	unsigned int last = 0;
+	int valid[RAM_LOG_OOPS_COUNT];
+	int i;
+
+	for (i = 0; i < RAM_LOG_OOPS_COUNT; i++) {
+		struct ram_log_oops *oops = ram_log_oops[i];
+
+		ram_log_decode(oops, sizeof(*oops), ram_log_oops_par[i]);
+		valid[i] = oops->magic == RAM_LOG_OOPS_MAGIC &&
+			   oops->len <= RAM_LOG_OOPS_SIZE &&
+			   oops->reason < ARRAY_SIZE(reasons);
+		if (valid[i] && oops->seq >= last)
+			last = oops->seq;
+	}
+
+	/* Oldest first: the slot after the newest one is the oldest */
+	for (i = 1; i <= RAM_LOG_OOPS_COUNT; i++) {
+		int slot = (last + i) % RAM_LOG_OOPS_COUNT;
+		struct ram_log_oops *oops = ram_log_oops[slot];
+
+		if (!valid[slot])
+			continue;
+		pos += sprintf(dest + pos, "\n--- %s %u ---\n",
+			       reasons[oops->reason], oops->seq);
+		memcpy(dest + pos, oops->data, oops->len);
+		pos += oops->len;
+	}
+	return pos;
+}
+
+#ifdef CONFIG_ANDROID_RAM_CONSOLE_LOGGER_TAIL
+/* Room needed to print a log tail: the entries grow by the prefix */
+#define RAM_LOG_TAIL_PRINT_SIZE	(RAM_LOG_TAIL_SIZE * 3 + 64)
+
+static size_t __init ram_log_save_tail(char *dest, int i)
+{
+	struct ram_log_tail *tail = ram_log_tail[i];
+	size_t size = RAM_LOG_TAIL_PRINT_SIZE;
+	size_t pos, off = 0;
+
+	ram_log_decode(tail, sizeof(*tail), ram_log_tail_par[i]);
+	if (tail->magic != RAM_LOG_TAIL_MAGIC ||
+	    tail->len > RAM_LOG_TAIL_SIZE)
+		return 0;
+
+	pos = scnprintf(dest, size, "\n--- %s ---\n", ram_log_tail_names[i]);
+	while (off + sizeof(struct logger_entry) <= tail->len) {
+		static const char prios[] = "??VDIWEFS";
+		struct logger_entry entry;
+		const char *tag, *msg;
+		size_t tag_len, msg_len;
+
+		/* Entries are packed, so they are not aligned */
+		memcpy(&entry, tail->data + off, sizeof(entry));
+		off += sizeof(entry);
+		if (entry.len < 1 || off + entry.len > tail->len)
+			break;
+
+		tag = (const char *)tail->data + off + 1;
+		tag_len = strnlen(tag, entry.len - 1);
+		msg = tag + tag_len + 1;
+		msg_len = tag_len + 1 < entry.len - 1 ?
+			  strnlen(msg, entry.len - 2 - tag_len) : 0;
+		while (msg_len && msg[msg_len - 1] == '\n')
+			msg_len--;
+
+		pos += scnprintf(dest + pos, size - pos,
+				 "%d.%03d %5d %5d %c %.*s: %.*s\n",
+				 entry.sec, (int)(entry.nsec / NSEC_PER_MSEC),
+				 entry.pid, entry.tid,
+				 prios[min_t(unsigned int,
+					     tail->data[off], sizeof(prios) - 2)],
+				 (int)tag_len, tag, (int)msg_len, msg);
+		off += entry.len;
+	}
+	return pos;
+}
+#endif
+
+static void __init ram_log_save_old(void)
+{
+	size_t size, pos;
+	char *dest;
+#ifdef CONFIG_ANDROID_RAM_CONSOLE_LOGGER_TAIL
+	int i;
+#endif
+
+	size = (ram_log_header->count + 2) * RAM_LOG_BLOCK_SIZE +
+	       RAM_LOG_OOPS_COUNT * (RAM_LOG_OOPS_SIZE + 64) + 256;
+#ifdef CONFIG_ANDROID_RAM_CONSOLE_LOGGER_TAIL
+	size += RAM_LOG_TAILS * RAM_LOG_TAIL_PRINT_SIZE;
+#endif
+	dest = vmalloc(size);
+	if (dest == NULL) {
+		printk(KERN_ERR "ram_console: failed to allocate buffer\n");
+		return;
+	}
+
+	pos = ram_log_save_records(dest);
+	pos += ram_log_save_live(dest + pos);
+	pos += ram_log_save_oopses(dest + pos);
+#ifdef CONFIG_ANDROID_RAM_CONSOLE_LOGGER_TAIL
+	for (i = 0; i < RAM_LOG_TAILS; i++)
+		pos += ram_log_save_tail(dest + pos, i);
+#endif
+#ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION
+	if (ram_console_corrected_bytes || ram_console_bad_blocks)
+		pos += sprintf(dest + pos,
+			"\n%d Corrected bytes, %d unrecoverable blocks\n",
+			ram_console_corrected_bytes, ram_console_bad_blocks);
+	else
+		pos += sprintf(dest + pos, "\nNo errors detected\n");
+#endif
+
+	ram_console_old_log = dest;
+	ram_console_old_log_size = pos;
+}
+
+/* Carves an area and its parity out of the buffer */
+static void * __init ram_log_carve(uint8_t **next, size_t len, uint8_t **par)
+{
+	void *area = *next;
+
+	*par = *next + len;
+	*next += ALIGN(len + RAM_LOG_PAR_SIZE(len), 4);
+	return area;
+}
+
+#ifdef CONFIG_ANDROID_RAM_CONSOLE_RECORDS_SELFTEST
+#define RAM_LOG_TEST_RECORDS	3
+#define RAM_LOG_TEST_SEALS	(4 * RAM_LOG_TEST_RECORDS)
+
+/*
+ * Seals blocks into a scratch ring that holds exactly three uncompressed
+ * records, so that every lap ends right at the end of the ring, and
+ * checks after each one that the ring holds the newest records in order.
+ * Runs before compression is set up, so the records are stored as is.
+ */
+static void __init ram_log_selftest(void)
+{
+	struct ram_log_header *header = ram_log_header;
+	uint8_t *header_par = ram_log_header_par;
+	uint8_t *ring = ram_log_ring;
+	size_t ring_size = ram_log_ring_size;
+	size_t rec_size = RAM_LOG_REC_SIZE(RAM_LOG_BLOCK_SIZE);
+	uint8_t *scratch, *next;
+	int i, j, failed = -1;
+
+	scratch = vmalloc(sizeof(*ram_log_header) +
+			  RAM_LOG_PAR_SIZE(sizeof(*ram_log_header)) + 4 +
+			  RAM_LOG_TEST_RECORDS * rec_size);
+	if (scratch == NULL) {
+		printk(KERN_ERR "ram_console: no memory for self test\n");
+		return;
+	}
+
+	next = scratch;
+	ram_log_header = ram_log_carve(&next, sizeof(*ram_log_header),
+				       &ram_log_header_par);
+	ram_log_ring = next;
+	ram_log_ring_size = RAM_LOG_TEST_RECORDS * rec_size;
+	memset(ram_log_header, 0, sizeof(*ram_log_header));
+
+	for (i = 0; i < RAM_LOG_TEST_SEALS && failed < 0; i++) {
+		uint32_t count = min(i + 1, RAM_LOG_TEST_RECORDS);
+		uint32_t off;
+
+		memset(ram_log_seal_buf, i, RAM_LOG_BLOCK_SIZE);
+		ram_log_add(ram_log_build(ram_log_seal_buf, i));
+
+		if (ram_log_header->count != count ||
+		    ram_log_header->head > ram_log_ring_size ||
+		    ram_log_header->tail > ram_log_ring_size)
+			failed = i;
+		off = ram_log_header->tail;
+		for (j = 0; j < count && failed < 0; j++) {
+			struct ram_log_record *rec;
+
+			if (off + RAM_LOG_REC_DATA > ram_log_ring_size)
+				off = 0;
+			rec = (struct ram_log_record *)(ram_log_ring + off);
+			if (rec->magic != RAM_LOG_REC_MAGIC ||
+			    rec->seq != i + 1 - count + j ||
+			    rec->len != RAM_LOG_BLOCK_SIZE ||
+			    ram_log_ring[off + RAM_LOG_REC_DATA] != (uint8_t)rec->seq)
+				failed = i;
+			off += rec_size;
+		}
+	}
+
+	ram_log_header = header;
+	ram_log_header_par = header_par;
+	ram_log_ring = ring;
+	ram_log_ring_size = ring_size;
+	vfree(scratch);
+
+	if (failed >= 0)
+		printk(KERN_ERR "ram_console: self test failed at record %d\n",
+		       failed);
+	else
+		printk(KERN_INFO "ram_console: self test passed, %d records\n",
+		       RAM_LOG_TEST_SEALS);
+}
+#endif
+
+static int __init ram_log_init(void *buffer, size_t buffer_size)
+{
+	struct ram_log_header *header;
+	uint8_t *next = buffer;
+	int i;
+
+	ram_log_header = ram_log_carve(&next, sizeof(*ram_log_header),
+				       &ram_log_header_par);
+	for (i = 0; i < 2; i++)
+		ram_log_live[i] = ram_log_carve(&next, sizeof(struct ram_log_live),
+						&ram_log_live_par[i]);
+	for (i = 0; i < RAM_LOG_OOPS_COUNT; i++)
+		ram_log_oops[i] = ram_log_carve(&next, sizeof(struct ram_log_oops),
+						&ram_log_oops_par[i]);
+#ifdef CONFIG_ANDROID_RAM_CONSOLE_LOGGER_TAIL
+	for (i = 0; i < RAM_LOG_TAILS; i++)
+		ram_log_tail[i] = ram_log_carve(&next, sizeof(struct ram_log_tail),
+						&ram_log_tail_par[i]);
+#endif
+	ram_log_ring = next;
+	ram_log_ring_size = 0;
+	if (next - (uint8_t *)buffer < buffer_size)
+		ram_log_ring_size = (buffer_size - (next - (uint8_t *)buffer)) &
+				    ~3;
+	if (ram_log_ring_size < sizeof(ram_log_rec_buf)) {
+		pr_err("ram_console: buffer %p, size %zu too small for "
+		       "records\n", buffer, buffer_size);
+		return 0;
+	}
+
+#ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION
+	ram_console_rs_decoder = init_rs(ECC_SYMSIZE, ECC_POLY, 0, 1, ECC_SIZE);
+	if (ram_console_rs_decoder == NULL) {
+		printk(KERN_INFO "ram_console: init_rs failed\n");
+		return 0;
+	}
+#endif
+#ifdef CONFIG_ANDROID_RAM_CONSOLE_RECORDS_SELFTEST
+	ram_log_selftest();
+#endif
+
+	header = ram_log_header;
+	ram_log_decode(header, sizeof(*header), ram_log_header_par);
+	if (header->sig == RAM_LOG_SIG &&
+	    header->block_size == RAM_LOG_BLOCK_SIZE &&
+	    header->ring_size == ram_log_ring_size &&
+	    header->head <= ram_log_ring_size &&
+	    header->tail <= ram_log_ring_size &&
+	    header->count <= ram_log_ring_size / RAM_LOG_REC_SIZE(0)) {
+		printk(KERN_INFO "ram_console: found existing buffer, "
+		       "%u records\n", header->count);
+		ram_log_save_old();
+	} else {
+		printk(KERN_INFO "ram_console: no valid data in buffer "
+		       "(sig = 0x%08x)\n", header->sig);
+	}
+
+	header->sig = RAM_LOG_SIG;
+	header->block_size = RAM_LOG_BLOCK_SIZE;
+	header->ring_size = ram_log_ring_size;
+	header->head = 0;
+	header->tail = 0;
+	header->count = 0;
+	ram_log_update_header();
+
+	for (i = 0; i < 2; i++) {
+		ram_log_live[i]->seq = i;
+		ram_log_reset(ram_log_live[i]);
+	}
+	ram_log_cur = 0;
+	ram_log_seq = 1;
+	for (i = 0; i < RAM_LOG_OOPS_COUNT; i++)
+		ram_log_oops[i]->magic = 0;
+#ifdef CONFIG_ANDROID_RAM_CONSOLE_LOGGER_TAIL
+	for (i = 0; i < RAM_LOG_TAILS; i++)
+		ram_log_tail[i]->magic = 0;
+#endif
+
+	/* Without it the records are stored uncompressed */
+	ram_log_lzo_wrkmem = vmalloc(LZO1X_1_MEM_COMPRESS);
+	if (ram_log_lzo_wrkmem == NULL)
+		printk(KERN_ERR "ram_console: no memory for compression\n");
+
+	kmsg_dump_register(&ram_log_dumper);
+	register_reboot_notifier(&ram_log_reboot_nb);
+
+	ram_console.write = ram_log_write;
+	register_console(&ram_console);
+#ifdef CONFIG_ANDROID_RAM_CONSOLE_ENABLE_VERBOSE
+	console_verbose();
+#endif
+	return 0;
+}
+#endif
+
 static int __init ram_console_init(struct ram_console_buffer *buffer,
 				   size_t buffer_size, char *old_buf)
 {
 #ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION
 	int numerr;
 	uint8_t *par;
+#endif
+#ifdef CONFIG_ANDROID_RAM_CONSOLE_RECORDS
+	return ram_log_init(buffer, buffer_size);
 #endif
 	ram_console_buffer = buffer;
 	ram_console_buffer_size =
@@ -399,7 +1265,11 @@ static int __init ram_console_late_init(void)
 	entry = create_proc_entry("last_kmsg", S_IFREG | S_IRUGO, NULL);
 	if (!entry) {
 		printk(KERN_ERR "ram_console: failed to create proc entry\n");
+#ifdef CONFIG_ANDROID_RAM_CONSOLE_RECORDS
+		vfree(ram_console_old_log);
+#else
 		kfree(ram_console_old_log);
+#endif
 		ram_console_old_log = NULL;
 		return 0;
 	}
@@ -512,6 +512,13 @@ static int ecryptfs_read_super(struct super_block *sb, const char *dev_name)
 		goto out_free;
 	}
 	ecryptfs_set_superblock_lower(sb, path.dentry->d_sb);
+	sb->s_stack_depth = path.dentry->d_sb->s_stack_depth + 1;
+	if (sb->s_stack_depth > FILESYSTEM_MAX_STACK_DEPTH) {
+		rc = -EINVAL;
+		printk(KERN_ERR "eCryptfs: maximum fs stacking depth "
+			"exceeded\n");
+		goto out_free;
+	}
 	sb->s_maxbytes = path.dentry->d_sb->s_maxbytes;
 	sb->s_blocksize = path.dentry->d_sb->s_blocksize;
 	ecryptfs_set_dentry_lower(sb->s_root, path.dentry);
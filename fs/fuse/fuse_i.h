@@ -21,10 +21,20 @@
 #include <linux/rwsem.h>
 #include <linux/rbtree.h>
 #include <linux/poll.h>
+#include <linux/idr.h>
 
-/** Max number of pages that can be used in a single read request */
+/** Default max number of pages that can be used in a single request */
 #define FUSE_MAX_PAGES_PER_REQ 32
 
+/** Upper limit on the number of pages the server may ask for in INIT */
+#define FUSE_MAX_MAX_PAGES 256
+
+/** Max number of backing files registered for passthrough but not
+    yet named in an open reply */
+#define FUSE_MAX_PASSTHROUGH_PENDING 256
+
+#define FUSE_SUPER_MAGIC 0x65735546
+
 /** Bias for fi->writectr, meaning new writepages must not be sent */
 #define FUSE_NOWRITE INT_MIN
 
@@ -97,6 +107,15 @@ struct fuse_inode {
 
 struct fuse_conn;
 
+/** Backing file of a passthrough open */
+struct fuse_passthrough {
+	/** The file opened by the server */
+	struct file *filp;
+
+	/** Credentials of the server, used for the I/O */
+	const struct cred *cred;
+};
+
 /** FUSE specific file data */
 struct fuse_file {
 	/** Fuse connection for this file */
@@ -128,6 +147,9 @@ struct fuse_file {
 
 	/** Wait queue head for poll */
 	wait_queue_head_t poll_wait;
+
+	/** Backing file, if reads and writes are passed through */
+	struct fuse_passthrough passthrough;
 };
 
 /** One input argument of a request */
@@ -276,7 +298,13 @@ struct fuse_req {
 	} misc;
 
 	/** page vector */
-	struct page *pages[FUSE_MAX_PAGES_PER_REQ];
+	struct page **pages;
+
+	/** size of the page vector */
+	unsigned max_pages;
+
+	/** inline page vector, used unless more pages were asked for */
+	struct page *inline_pages[FUSE_MAX_PAGES_PER_REQ];
 
 	/** number of pages in vector */
 	unsigned num_pages;
@@ -332,6 +360,9 @@ struct fuse_conn {
 	/** Maximum write size */
 	unsigned max_write;
 
+	/** Maximum number of pages that can be used in a single request */
+	unsigned max_pages;
+
 	/** Readers of the connection are waiting on this */
 	wait_queue_head_t waitq;
 
@@ -456,6 +487,12 @@ struct fuse_conn {
 	/** Don't apply umask to creation modes */
 	unsigned dont_mask:1;
 
+	/** Cache buffered writes and send them from writeback */
+	unsigned writeback_cache:1;
+
+	/** Can opens hand over a backing file?  Only set in INIT */
+	unsigned passthrough:1;
+
 	/** The number of requests waiting for completion */
 	atomic_t num_waiting;
 
@@ -497,6 +534,12 @@ struct fuse_conn {
 
 	/** Read/write semaphore to hold when accessing sb. */
 	struct rw_semaphore killsb;
+
+	/** Backing files registered for passthrough, protected by lock */
+	struct idr passthrough_idr;
+
+	/** Number of entries in passthrough_idr, protected by lock */
+	unsigned passthrough_pending;
 };
 
 static inline struct fuse_conn *get_fuse_conn_super(struct super_block *sb)
@@ -519,6 +562,22 @@ static inline u64 get_node_id(struct inode *inode)
 	return get_fuse_inode(inode)->nodeid;
 }
 
+/**
+ * Open flags to send with FUSE_OPEN and FUSE_CREATE.  With the
+ * writeback cache, write_begin reads partially written pages through
+ * the writer's own file, and the kernel picks the write offsets, so
+ * the server is asked for read access and no O_APPEND.
+ */
+static inline int fuse_open_flags(struct fuse_conn *fc, int flags)
+{
+	if (fc->writeback_cache) {
+		if ((flags & O_ACCMODE) == O_WRONLY)
+			flags = (flags & ~O_ACCMODE) | O_RDWR;
+		flags &= ~O_APPEND;
+	}
+	return flags;
+}
+
 /** Device operations */
 extern const struct file_operations fuse_dev_operations;
 
@@ -626,7 +685,7 @@ void fuse_ctl_cleanup(void);
  */
 struct fuse_req *fuse_request_alloc(void);
 
-struct fuse_req *fuse_request_alloc_nofs(void);
+struct fuse_req *fuse_request_alloc_nofs(unsigned npages);
 
 /**
  * Free a request
@@ -638,6 +697,11 @@ void fuse_request_free(struct fuse_req *req);
  */
 struct fuse_req *fuse_get_req(struct fuse_conn *fc);
 
+/**
+ * Get a request with room for @npages pages, may fail with -ENOMEM
+ */
+struct fuse_req *fuse_get_req_pages(struct fuse_conn *fc, unsigned npages);
+
 /**
  * Gets a requests for a file operation, always succeeds
  */
@@ -748,4 +812,18 @@ long fuse_do_ioctl(struct file *file, unsigned int cmd, unsigned long arg,
 unsigned fuse_file_poll(struct file *file, poll_table *wait);
 int fuse_dev_release(struct inode *inode, struct file *file);
 
+void fuse_write_update_size(struct inode *inode, loff_t pos);
+
+/* passthrough.c */
+int fuse_passthrough_open(struct fuse_conn *fc, int fd);
+void fuse_passthrough_setup(struct fuse_conn *fc, struct fuse_file *ff,
+			    struct fuse_open_out *openarg, fmode_t mode);
+void fuse_passthrough_release(struct fuse_passthrough *passthrough);
+void fuse_passthrough_cleanup(struct fuse_conn *fc);
+ssize_t fuse_passthrough_read(struct file *file, char __user *buf,
+			      size_t count, loff_t *ppos);
+ssize_t fuse_passthrough_write(struct file *file, const char __user *buf,
+			       size_t count, loff_t *ppos);
+int fuse_passthrough_mmap(struct file *file, struct vm_area_struct *vma);
+
 #endif /* _FS_FUSE_I_H */
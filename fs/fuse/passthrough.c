@@ -0,0 +1,243 @@
+/*
+  FUSE: Filesystem in Userspace
+
+  This program can be distributed under the terms of the GNU GPL.
+  See the file COPYING.
+*/
+
+/*
+ * Passthrough of reads, writes and mmap to a backing file
+ *
+ * A filesystem that merely mirrors another one (like the sdcard daemon)
+ * can hand the kernel the file it opened on the lower filesystem: it
+ * registers the descriptor with FUSE_DEV_IOC_PASSTHROUGH_OPEN and puts
+ * the returned id into fuse_open_out.passthrough_fh.  I/O on the fuse
+ * file is then done on the backing file directly, with the credentials
+ * of the server, instead of being sent to userspace.
+ */
+
+#include "fuse_i.h"
+
+#include <linux/file.h>
+#include <linux/cred.h>
+#include <linux/slab.h>
+
+/*
+ * Register @fd as a backing file and return its id.  The entry is
+ * consumed by the open reply that names it, or dropped at unmount.
+ *
+ * Each entry pins the file and the server's credentials until then, and
+ * I/O on it runs with those credentials, so only a privileged server may
+ * register files, and only so many at a time.
+ */
+int fuse_passthrough_open(struct fuse_conn *fc, int fd)
+{
+	struct fuse_passthrough *passthrough;
+	struct super_block *sb;
+	struct file *filp;
+	int err, id;
+
+	if (!fc->passthrough || !capable(CAP_SYS_ADMIN))
+		return -EPERM;
+
+	filp = fget(fd);
+	if (!filp)
+		return -EBADF;
+
+	err = -EINVAL;
+	if (!S_ISREG(filp->f_path.dentry->d_inode->i_mode))
+		goto out_fput;
+
+	/* No fuse below, its server could be this one and deadlock */
+	sb = filp->f_path.dentry->d_sb;
+	if (sb->s_magic == FUSE_SUPER_MAGIC)
+		goto out_fput;
+
+	/* Nor any other stacked filesystem, the kernel stack is limited */
+	if (sb->s_stack_depth)
+		goto out_fput;
+
+	err = -ENOMEM;
+	passthrough = kmalloc(sizeof(*passthrough), GFP_KERNEL);
+	if (!passthrough)
+		goto out_fput;
+
+	passthrough->filp = filp;
+	passthrough->cred = get_current_cred();
+
+	do {
+		err = -ENOMEM;
+		if (!idr_pre_get(&fc->passthrough_idr, GFP_KERNEL))
+			goto out_put_cred;
+
+		spin_lock(&fc->lock);
+		if (fc->passthrough_pending < FUSE_MAX_PASSTHROUGH_PENDING) {
+			err = idr_get_new_above(&fc->passthrough_idr,
+						passthrough, 1, &id);
+			if (!err)
+				fc->passthrough_pending++;
+		} else
+			err = -EMFILE;
+		spin_unlock(&fc->lock);
+	} while (err == -EAGAIN);
+	if (err)
+		goto out_put_cred;
+
+	return id;
+
+ out_put_cred:
+	put_cred(passthrough->cred);
+	kfree(passthrough);
+ out_fput:
+	fput(filp);
+	return err;
+}
+
+/*
+ * Take over the backing file named in the open reply, if any.  A bad id,
+ * or a backing file not open for all of the fuse file's @mode, is
+ * ignored: the file is then opened without passthrough.  Reads, writes
+ * and mmap go to the backing file, so it must allow whatever the VFS
+ * allowed on the fuse file.
+ */
+void fuse_passthrough_setup(struct fuse_conn *fc, struct fuse_file *ff,
+			    struct fuse_open_out *openarg, fmode_t mode)
+{
+	struct fuse_passthrough *passthrough = NULL;
+	int id = openarg->passthrough_fh;
+
+	if (!fc->passthrough || id <= 0)
+		return;
+
+	spin_lock(&fc->lock);
+	passthrough = idr_find(&fc->passthrough_idr, id);
+	if (passthrough) {
+		idr_remove(&fc->passthrough_idr, id);
+		fc->passthrough_pending--;
+	}
+	spin_unlock(&fc->lock);
+
+	if (!passthrough)
+		return;
+
+	mode &= FMODE_READ | FMODE_WRITE;
+	if ((passthrough->filp->f_mode & mode) != mode) {
+		fuse_passthrough_release(passthrough);
+		kfree(passthrough);
+		return;
+	}
+
+	ff->passthrough = *passthrough;
+	kfree(passthrough);
+}
+
+void fuse_passthrough_release(struct fuse_passthrough *passthrough)
+{
+	if (passthrough->filp) {
+		fput(passthrough->filp);
+		passthrough->filp = NULL;
+	}
+	if (passthrough->cred) {
+		put_cred(passthrough->cred);
+		passthrough->cred = NULL;
+	}
+}
+
+static int fuse_passthrough_drop(int id, void *p, void *data)
+{
+	struct fuse_passthrough *passthrough = p;
+
+	fuse_passthrough_release(passthrough);
+	kfree(passthrough);
+	return 0;
+}
+
+/* Drop the backing files that were registered but never opened */
+void fuse_passthrough_cleanup(struct fuse_conn *fc)
+{
+	idr_for_each(&fc->passthrough_idr, fuse_passthrough_drop, NULL);
+	idr_remove_all(&fc->passthrough_idr);
+	idr_destroy(&fc->passthrough_idr);
+}
+
+ssize_t fuse_passthrough_read(struct file *file, char __user *buf,
+			      size_t count, loff_t *ppos)
+{
+	struct fuse_file *ff = file->private_data;
+	struct inode *inode = file->f_path.dentry->d_inode;
+	const struct cred *old_cred;
+	ssize_t res;
+
+	if (is_bad_inode(inode))
+		return -EIO;
+
+	old_cred = override_creds(ff->passthrough.cred);
+	res = vfs_read(ff->passthrough.filp, buf, count, ppos);
+	revert_creds(old_cred);
+
+	fuse_invalidate_attr(inode); /* atime changed */
+
+	return res;
+}
+
+ssize_t fuse_passthrough_write(struct file *file, const char __user *buf,
+			       size_t count, loff_t *ppos)
+{
+	struct fuse_file *ff = file->private_data;
+	struct file *backing = ff->passthrough.filp;
+	struct inode *inode = file->f_path.dentry->d_inode;
+	const struct cred *old_cred;
+	ssize_t res;
+
+	if (is_bad_inode(inode))
+		return -EIO;
+
+	/* Serialize against other writers through fuse, for O_APPEND */
+	mutex_lock(&inode->i_mutex);
+	if (file->f_flags & O_APPEND)
+		*ppos = i_size_read(backing->f_path.dentry->d_inode);
+
+	old_cred = override_creds(ff->passthrough.cred);
+	res = vfs_write(backing, buf, count, ppos);
+	revert_creds(old_cred);
+
+	if (res > 0)
+		fuse_write_update_size(inode, *ppos);
+	mutex_unlock(&inode->i_mutex);
+
+	fuse_invalidate_attr(inode);
+
+	return res;
+}
+
+/*
+ * Map the backing file instead: the vma then refers to it, and faults
+ * are served from its page cache.
+ */
+int fuse_passthrough_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct fuse_file *ff = file->private_data;
+	struct file *backing = ff->passthrough.filp;
+	const struct cred *old_cred;
+	int err;
+
+	if (!backing->f_op || !backing->f_op->mmap)
+		return -ENODEV;
+
+	get_file(backing);
+	vma->vm_file = backing;
+
+	old_cred = override_creds(ff->passthrough.cred);
+	err = backing->f_op->mmap(backing, vma);
+	revert_creds(old_cred);
+
+	if (err) {
+		/* mmap_region() drops the reference to the fuse file */
+		vma->vm_file = file;
+		fput(backing);
+		return err;
+	}
+
+	fput(file);
+	return 0;
+}
@@ -375,27 +375,36 @@ mpage_readpages(struct address_space *mapping, struct list_head *pages,
 				unsigned nr_pages, get_block_t get_block)
 {
 	struct bio *bio = NULL;
-	unsigned page_idx;
+	unsigned page_idx, batch_idx = 0;
 	sector_t last_block_in_bio = 0;
 	struct buffer_head map_bh;
 	unsigned long first_logical_block = 0;
+	struct pagevec pvec;
+	int i;
 
 	map_bh.b_state = 0;
 	map_bh.b_size = 0;
+	pagevec_init(&pvec, 0);
 	for (page_idx = 0; page_idx < nr_pages; page_idx++) {
 		struct page *page = list_entry(pages->prev, struct page, lru);
 
 		prefetchw(&page->flags);
 		list_del(&page->lru);
-		if (!add_to_page_cache_lru(page, mapping,
-					page->index, GFP_KERNEL)) {
-			bio = do_mpage_readpage(bio, page,
-					nr_pages - page_idx,
+		if (pagevec_add(&pvec, page) && page_idx + 1 < nr_pages)
+			continue;
+
+		/* Add them to the page cache in one go, then read them */
+		add_to_page_cache_lru_batch(&pvec, mapping, GFP_KERNEL);
+		for (i = 0; i < pagevec_count(&pvec); i++) {
+			bio = do_mpage_readpage(bio, pvec.pages[i],
+					nr_pages - batch_idx - i,
 					&last_block_in_bio, &map_bh,
 					&first_logical_block,
 					get_block);
+			page_cache_release(pvec.pages[i]);
 		}
-		page_cache_release(page);
+		pagevec_reinit(&pvec);
+		batch_idx = page_idx + 1;
 	}
 	BUG_ON(!list_empty(pages));
 	if (bio)
@@ -440,6 +440,7 @@ int ubifs_budget_space(struct ubifs_info *c, struct ubifs_budget_req *req)
 {
 	int uninitialized_var(cmt_retries), uninitialized_var(wb_retries);
 	int err, idx_growth, data_growth, dd_growth, retried = 0;
+	ktime_t start;
 
 	ubifs_assert(req->new_page <= 1);
 	ubifs_assert(req->dirtied_page <= 1);
@@ -494,7 +495,9 @@ again:
 		return err;
 	}
 
+	start = ktime_get();
 	err = make_free_space(c);
+	ubifs_stall_add(c, &c->stalls[UBIFS_STALL_BUDGET], start);
 	cond_resched();
 	if (err == -EAGAIN) {
 		dbg_budg("try again");
@@ -40,7 +40,9 @@
  * purpose of this two-step approach is to prevent the commit from causing any
  * latency blips. Note that in any case, the commit does not prevent lookups
  * (as permitted by the TNC mutex), or access to VFS data structures e.g. page
- * cache.
+ * cache. For the same reason, the write-buffers are synchronized before the
+ * commit semaphore is taken, so that commit start has little or nothing left
+ * to write.
  */
 
 #include <linux/freezer.h>
@@ -61,6 +63,7 @@ static int do_commit(struct ubifs_info *c)
 	int err, new_ltail_lnum, old_ltail_lnum, i;
 	struct ubifs_zbranch zroot;
 	struct ubifs_lp_stats lst;
+	ktime_t start = ktime_get();
 
 	dbg_cmt("start");
 	if (c->ro_media) {
@@ -98,6 +101,7 @@ static int do_commit(struct ubifs_info *c)
 	ubifs_get_lp_stats(c, &lst);
 
 	up_write(&c->commit_sem);
+	ubifs_stall_add(c, &c->cmt_start_time, start);
 
 	err = ubifs_tnc_end_commit(c);
 	if (err)
@@ -166,6 +170,7 @@ static int do_commit(struct ubifs_info *c)
 	dbg_cmt("commit end");
 	spin_unlock(&c->cs_lock);
 
+	ubifs_stall_add(c, &c->cmt_time, start);
 	return 0;
 
 out_up:
@@ -180,6 +185,26 @@ out:
 	return err;
 }
 
+/**
+ * pre_sync_wbufs - synchronize write-buffers ahead of a commit.
+ * @c: UBIFS file-system description object
+ *
+ * 'do_commit()' synchronizes the write-buffers while the journal is blocked.
+ * This function does it beforehand, with the journal still running, so that
+ * there is less or nothing left to write then. Errors are left to
+ * 'do_commit()' to find.
+ */
+static void pre_sync_wbufs(struct ubifs_info *c)
+{
+	int i;
+
+	if (c->ro_media || !c->jheads)
+		return;
+
+	for (i = 0; i < c->jhead_cnt; i++)
+		ubifs_wbuf_sync(&c->jheads[i].wbuf);
+}
+
 /**
  * run_bg_commit - run background commit if it is needed.
  * @c: UBIFS file-system description object
@@ -199,6 +224,7 @@ static int run_bg_commit(struct ubifs_info *c)
 		goto out;
 	spin_unlock(&c->cs_lock);
 
+	pre_sync_wbufs(c);
 	down_write(&c->commit_sem);
 	spin_lock(&c->cs_lock);
 	if (c->cmt_state == COMMIT_REQUIRED)
@@ -209,6 +235,9 @@ static int run_bg_commit(struct ubifs_info *c)
 		goto out_cmt_unlock;
 	spin_unlock(&c->cs_lock);
 
+	spin_lock(&c->stats_lock);
+	c->bg_cmt_cnt += 1;
+	spin_unlock(&c->stats_lock);
 	return do_commit(c);
 
 out_cmt_unlock:
@@ -218,6 +247,71 @@ out:
 	return 0;
 }
 
+/**
+ * bg_gc_timeout - find out when background GC should run.
+ * @c: UBIFS file-system description object
+ *
+ * This function returns zero if the background thread should garbage-collect
+ * a LEB now, the time (in jiffies) to wait until the journal becomes idle if
+ * it should do so later, and %MAX_SCHEDULE_TIMEOUT if it need not.
+ */
+static long bg_gc_timeout(struct ubifs_info *c)
+{
+	unsigned long idle = c->jnl_last_write + BG_GC_IDLE;
+
+	if (!c->bg_gc_on || c->lst.empty_lebs >= c->bg_gc_lebs ||
+	    c->bg_gc_stuck > 1 || c->ro_media)
+		return MAX_SCHEDULE_TIMEOUT;
+	if (time_before(jiffies, idle))
+		return idle - jiffies;
+	return 0;
+}
+
+/**
+ * bg_gc - garbage-collect one LEB in background.
+ * @c: UBIFS file-system description object
+ *
+ * This function makes one empty LEB out of dirty ones. If GC needs a commit
+ * to make progress, it has the background thread run one, but if that does
+ * not help either, or there is nothing to collect, background GC stops until
+ * the next journal write.
+ */
+static void bg_gc(struct ubifs_info *c)
+{
+	int lnum, err;
+
+	down_read(&c->commit_sem);
+	lnum = ubifs_garbage_collect(c, 1);
+	up_read(&c->commit_sem);
+
+	if (lnum == -EAGAIN) {
+		if (++c->bg_gc_stuck > 1)
+			return;
+		dbg_gc("background GC needs a commit");
+		ubifs_request_bg_commit(c);
+		c->need_bgt = 1;
+		return;
+	}
+	if (lnum < 0) {
+		if (lnum != -ENOSPC)
+			ubifs_err("background GC failed, error %d", lnum);
+		c->bg_gc_stuck = 2;
+		return;
+	}
+
+	c->bg_gc_stuck = 0;
+	dbg_gc("background GC freed LEB %d", lnum);
+	err = ubifs_return_leb(c, lnum);
+	if (err) {
+		ubifs_ro_mode(c, err);
+		return;
+	}
+
+	spin_lock(&c->stats_lock);
+	c->bg_gc_cnt += 1;
+	spin_unlock(&c->stats_lock);
+}
+
 /**
  * ubifs_bg_thread - UBIFS background thread function.
  * @info: points to the file-system description object
@@ -225,10 +319,9 @@ out:
  * This function implements various file-system background activities:
  * o when a write-buffer timer expires it synchronizes the appropriate
  *   write-buffer;
- * o when the journal is about to be full, it starts in-advance commit.
- *
- * Note, other stuff like background garbage collection may be added here in
- * future.
+ * o when the journal is about to be full, it starts in-advance commit;
+ * o when the journal is idle and there are few empty LEBs, it garbage-collects
+ *   dirty LEBs.
  */
 int ubifs_bg_thread(void *info)
 {
@@ -238,6 +331,7 @@ int ubifs_bg_thread(void *info)
 	dbg_msg("background thread \"%s\" started, PID %d",
 		c->bgt_name, current->pid);
 	set_freezable();
+	c->jnl_last_write = jiffies;
 
 	while (1) {
 		if (kthread_should_stop())
@@ -249,6 +343,8 @@ int ubifs_bg_thread(void *info)
 		set_current_state(TASK_INTERRUPTIBLE);
 		/* Check if there is something to do */
 		if (!c->need_bgt) {
+			long timeout = bg_gc_timeout(c);
+
 			/*
 			 * Nothing prevents us from going sleep now and
 			 * be never woken up and block the task which
@@ -256,7 +352,13 @@ int ubifs_bg_thread(void *info)
 			 */
 			if (kthread_should_stop())
 				break;
-			schedule();
+			if (timeout) {
+				schedule_timeout(timeout);
+				continue;
+			}
+			__set_current_state(TASK_RUNNING);
+			bg_gc(c);
+			cond_resched();
 			continue;
 		} else
 			__set_current_state(TASK_RUNNING);
@@ -379,6 +481,7 @@ int ubifs_run_commit(struct ubifs_info *c)
 
 	/* Ok, the commit is indeed needed */
 
+	pre_sync_wbufs(c);
 	down_write(&c->commit_sem);
 	spin_lock(&c->cs_lock);
 	/*
@@ -71,6 +71,44 @@ static struct ubifs_compressor zlib_compr = {
 };
 #endif
 
+/* Reserved, see UBIFS_COMPR_ZSTD */
+static struct ubifs_compressor zstd_compr = {
+	.compr_type = UBIFS_COMPR_ZSTD,
+	.name = "zstd",
+};
+
+#ifdef CONFIG_UBIFS_FS_LZ4
+static DEFINE_MUTEX(lz4_mutex);
+
+static struct ubifs_compressor lz4_compr = {
+	.compr_type = UBIFS_COMPR_LZ4,
+	.comp_mutex = &lz4_mutex,
+	.name = "lz4",
+	.capi_name = "lz4",
+};
+#else
+static struct ubifs_compressor lz4_compr = {
+	.compr_type = UBIFS_COMPR_LZ4,
+	.name = "lz4",
+};
+#endif
+
+#ifdef CONFIG_UBIFS_FS_LZ4HC
+static DEFINE_MUTEX(lz4hc_mutex);
+
+static struct ubifs_compressor lz4hc_compr = {
+	.compr_type = UBIFS_COMPR_LZ4HC,
+	.comp_mutex = &lz4hc_mutex,
+	.name = "lz4hc",
+	.capi_name = "lz4hc",
+};
+#else
+static struct ubifs_compressor lz4hc_compr = {
+	.compr_type = UBIFS_COMPR_LZ4HC,
+	.name = "lz4hc",
+};
+#endif
+
 /* All UBIFS compressors */
 struct ubifs_compressor *ubifs_compressors[UBIFS_COMPR_TYPES_CNT];
 
@@ -90,7 +128,9 @@ struct ubifs_compressor *ubifs_compressors[UBIFS_COMPR_TYPES_CNT];
  * compression error occurred.
  *
  * Note, if the input buffer was not compressed, it is copied to the output
- * buffer and %UBIFS_COMPR_NONE is returned in @compr_type.
+ * buffer and %UBIFS_COMPR_NONE is returned in @compr_type. Data compressed
+ * with LZ4HC is returned as %UBIFS_COMPR_LZ4, because it is the same format
+ * and this way any LZ4-capable UBIFS can read it.
  */
 void ubifs_compress(const void *in_buf, int in_len, void *out_buf, int *out_len,
 		    int *compr_type)
@@ -125,6 +165,8 @@ void ubifs_compress(const void *in_buf, int in_len, void *out_buf, int *out_len,
 	if (in_len - *out_len < UBIFS_MIN_COMPRESS_DIFF)
 		goto no_compr;
 
+	if (*compr_type == UBIFS_COMPR_LZ4HC)
+		*compr_type = UBIFS_COMPR_LZ4;
 	return;
 
 no_compr:
@@ -233,9 +275,22 @@ int __init ubifs_compressors_init(void)
 	if (err)
 		goto out_lzo;
 
+	err = compr_init(&lz4_compr);
+	if (err)
+		goto out_zlib;
+
+	err = compr_init(&lz4hc_compr);
+	if (err)
+		goto out_lz4;
+
 	ubifs_compressors[UBIFS_COMPR_NONE] = &none_compr;
+	ubifs_compressors[UBIFS_COMPR_ZSTD] = &zstd_compr;
 	return 0;
 
+out_lz4:
+	compr_exit(&lz4_compr);
+out_zlib:
+	compr_exit(&zlib_compr);
 out_lzo:
 	compr_exit(&lzo_compr);
 	return err;
@@ -248,4 +303,6 @@ void ubifs_compressors_exit(void)
 {
 	compr_exit(&lzo_compr);
 	compr_exit(&zlib_compr);
+	compr_exit(&lz4_compr);
+	compr_exit(&lz4hc_compr);
 }
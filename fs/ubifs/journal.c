@@ -116,6 +116,7 @@ static int reserve_space(struct ubifs_info *c, int jhead, int len)
 {
 	int err = 0, err1, retries = 0, avail, lnum, offs, squeeze;
 	struct ubifs_wbuf *wbuf = &c->jheads[jhead].wbuf;
+	ktime_t start;
 
 	/*
 	 * Typically, the base head has smaller nodes written to it, so it is
@@ -161,7 +162,9 @@ again:
 	dbg_jnl("no free space in jhead %s, run GC", dbg_jhead(jhead));
 	mutex_unlock(&wbuf->io_mutex);
 
+	start = ktime_get();
 	lnum = ubifs_garbage_collect(c, 0);
+	ubifs_stall_add(c, &c->stalls[UBIFS_STALL_GC], start);
 	if (lnum < 0) {
 		err = lnum;
 		if (err != -ENOSPC)
@@ -317,12 +320,21 @@ static int write_head(struct ubifs_info *c, int jhead, void *buf, int len,
 static int make_reservation(struct ubifs_info *c, int jhead, int len)
 {
 	int err, cmt_retries = 0, nospc_retries = 0;
+	ktime_t start;
 
 again:
-	down_read(&c->commit_sem);
+	if (!down_read_trylock(&c->commit_sem)) {
+		/* Commit start holds it for writing */
+		start = ktime_get();
+		down_read(&c->commit_sem);
+		ubifs_stall_add(c, &c->stalls[UBIFS_STALL_CMT_SEM], start);
+	}
 	err = reserve_space(c, jhead, len);
-	if (!err)
+	if (!err) {
+		c->jnl_last_write = jiffies;
+		c->bg_gc_stuck = 0;
 		return 0;
+	}
 	up_read(&c->commit_sem);
 
 	if (err == -ENOSPC) {
@@ -368,7 +380,9 @@ again:
 		cmt_retries);
 	cmt_retries += 1;
 
+	start = ktime_get();
 	err = ubifs_run_commit(c);
+	ubifs_stall_add(c, &c->stalls[UBIFS_STALL_COMMIT], start);
 	if (err)
 		return err;
 	goto again;
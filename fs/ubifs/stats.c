@@ -0,0 +1,187 @@
+/*
+ * This file is part of UBIFS.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * This file accounts the time writers spend waiting for UBIFS to make free
+ * space or to commit, and how long the commits take. The statistics of each
+ * mounted file-system are in /proc/fs/ubifs/ubiX_Y/stats, and writing to
+ * this file resets them.
+ */
+
+#include <linux/module.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
+#include "ubifs.h"
+
+/**
+ * ubifs_stall_add - account a stall.
+ * @c: UBIFS file-system description object
+ * @st: the statistics to account it in
+ * @start: time the stall started
+ */
+void ubifs_stall_add(struct ubifs_info *c, struct ubifs_stall *st,
+		     ktime_t start)
+{
+	u64 ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	spin_lock(&c->stats_lock);
+	st->count += 1;
+	st->total_ns += ns;
+	if (ns > st->max_ns)
+		st->max_ns = ns;
+	spin_unlock(&c->stats_lock);
+}
+
+#ifdef CONFIG_PROC_FS
+
+static struct proc_dir_entry *ubifs_proc_root;
+
+static const char * const stall_names[UBIFS_STALL_CNT] = {
+	[UBIFS_STALL_BUDGET]  = "budget",
+	[UBIFS_STALL_CMT_SEM] = "commit_start",
+	[UBIFS_STALL_GC]      = "journal_gc",
+	[UBIFS_STALL_COMMIT]  = "journal_full",
+};
+
+static void show_stall(struct seq_file *m, const char *name,
+		       const struct ubifs_stall *st)
+{
+	seq_printf(m, "%-14s %8lu %10llu %8llu %8llu\n", name, st->count,
+		   div_u64(st->total_ns, NSEC_PER_MSEC),
+		   st->count ? div_u64(div_u64(st->total_ns, st->count),
+				       NSEC_PER_USEC) : 0,
+		   div_u64(st->max_ns, NSEC_PER_USEC));
+}
+
+static int stats_show(struct seq_file *m, void *v)
+{
+	struct ubifs_info *c = m->private;
+	struct ubifs_stall stalls[UBIFS_STALL_CNT], cmt_start, cmt;
+	int i;
+
+	spin_lock(&c->stats_lock);
+	memcpy(stalls, c->stalls, sizeof(stalls));
+	cmt_start = c->cmt_start_time;
+	cmt = c->cmt_time;
+	spin_unlock(&c->stats_lock);
+
+	seq_printf(m, "%-14s %8s %10s %8s %8s\n", "stall", "count",
+		   "total_ms", "avg_us", "max_us");
+	for (i = 0; i < UBIFS_STALL_CNT; i++)
+		show_stall(m, stall_names[i], &stalls[i]);
+
+	seq_printf(m, "\n%-14s %8s %10s %8s %8s\n", "commit", "count",
+		   "total_ms", "avg_us", "max_us");
+	show_stall(m, "journal_locked", &cmt_start);
+	show_stall(m, "total", &cmt);
+	seq_printf(m, "background commits: %lu\n", c->bg_cmt_cnt);
+
+	seq_printf(m, "\nbackground GC: %lu LEBs freed, keeps %d empty LEBs "
+		   "(%d now)\n", c->bg_gc_cnt, c->bg_gc_lebs, c->lst.empty_lebs);
+	return 0;
+}
+
+static int stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, stats_show, PDE(inode)->data);
+}
+
+static ssize_t stats_write(struct file *file, const char __user *buf,
+			   size_t count, loff_t *ppos)
+{
+	struct ubifs_info *c = ((struct seq_file *)file->private_data)->private;
+
+	spin_lock(&c->stats_lock);
+	memset(c->stalls, 0, sizeof(c->stalls));
+	memset(&c->cmt_start_time, 0, sizeof(struct ubifs_stall));
+	memset(&c->cmt_time, 0, sizeof(struct ubifs_stall));
+	c->bg_cmt_cnt = c->bg_gc_cnt = 0;
+	spin_unlock(&c->stats_lock);
+	return count;
+}
+
+static const struct file_operations stats_fops = {
+	.owner   = THIS_MODULE,
+	.open    = stats_open,
+	.read    = seq_read,
+	.write   = stats_write,
+	.llseek  = seq_lseek,
+	.release = single_release,
+};
+
+/**
+ * ubifs_stats_init_fs - create the statistics file of a file-system.
+ * @c: UBIFS file-system description object
+ *
+ * Failures are not fatal, the statistics are just not shown then.
+ */
+void ubifs_stats_init_fs(struct ubifs_info *c)
+{
+	char name[sizeof("ubi_") + 2 * 11];
+
+	if (!ubifs_proc_root)
+		return;
+
+	sprintf(name, "ubi%d_%d", c->vi.ubi_num, c->vi.vol_id);
+	c->stats_dir = proc_mkdir(name, ubifs_proc_root);
+	if (!c->stats_dir)
+		goto out;
+	if (!proc_create_data("stats", S_IRUGO | S_IWUSR, c->stats_dir,
+			      &stats_fops, c)) {
+		remove_proc_entry(name, ubifs_proc_root);
+		c->stats_dir = NULL;
+		goto out;
+	}
+	return;
+
+out:
+	ubifs_warn("cannot create /proc/fs/ubifs/%s", name);
+}
+
+/**
+ * ubifs_stats_exit_fs - remove the statistics file of a file-system.
+ * @c: UBIFS file-system description object
+ */
+void ubifs_stats_exit_fs(struct ubifs_info *c)
+{
+	if (!c->stats_dir)
+		return;
+	remove_proc_entry("stats", c->stats_dir);
+	remove_proc_entry(c->stats_dir->name, ubifs_proc_root);
+	c->stats_dir = NULL;
+}
+
+/**
+ * ubifs_stats_init - create the /proc/fs/ubifs directory.
+ */
+void __init ubifs_stats_init(void)
+{
+	ubifs_proc_root = proc_mkdir("fs/ubifs", NULL);
+	if (!ubifs_proc_root)
+		ubifs_warn("cannot create /proc/fs/ubifs");
+}
+
+/**
+ * ubifs_stats_exit - remove the /proc/fs/ubifs directory.
+ */
+void ubifs_stats_exit(void)
+{
+	if (ubifs_proc_root)
+		remove_proc_entry("fs/ubifs", NULL);
+}
+
+#endif /* CONFIG_PROC_FS */
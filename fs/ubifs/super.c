@@ -432,6 +432,9 @@ static int ubifs_show_options(struct seq_file *s, struct vfsmount *mnt)
 			   ubifs_compr_name(c->mount_opts.compr_type));
 	}
 
+	if (c->mount_opts.bg_gc)
+		seq_printf(s, ",bg_gc=%d", c->bg_gc_lebs);
+
 	return 0;
 }
 
@@ -690,6 +693,9 @@ static int init_constants_sb(struct ubifs_info *c)
 	if (c->max_bud_bytes < tmp64 + c->leb_size)
 		c->max_bud_bytes = tmp64 + c->leb_size;
 
+	if (!c->mount_opts.bg_gc)
+		c->bg_gc_lebs = min(BG_GC_LEBS, c->main_lebs >> 4);
+
 	err = ubifs_calc_lpt_geom(c);
 	if (err)
 		return err;
@@ -904,6 +910,7 @@ static int check_volume_empty(struct ubifs_info *c)
  * Opt_chk_data_crc: check CRCs when reading data nodes
  * Opt_no_chk_data_crc: do not check CRCs when reading data nodes
  * Opt_override_compr: override default compressor
+ * Opt_bg_gc: how many empty LEBs background GC keeps
  * Opt_err: just end of array marker
  */
 enum {
@@ -914,6 +921,7 @@ enum {
 	Opt_chk_data_crc,
 	Opt_no_chk_data_crc,
 	Opt_override_compr,
+	Opt_bg_gc,
 	Opt_err,
 };
 
@@ -925,6 +933,7 @@ static const match_table_t tokens = {
 	{Opt_chk_data_crc, "chk_data_crc"},
 	{Opt_no_chk_data_crc, "no_chk_data_crc"},
 	{Opt_override_compr, "compr=%s"},
+	{Opt_bg_gc, "bg_gc=%u"},
 	{Opt_err, NULL},
 };
 
@@ -1014,6 +1023,10 @@ static int ubifs_parse_options(struct ubifs_info *c, char *options,
 				c->mount_opts.compr_type = UBIFS_COMPR_LZO;
 			else if (!strcmp(name, "zlib"))
 				c->mount_opts.compr_type = UBIFS_COMPR_ZLIB;
+			else if (!strcmp(name, "lz4"))
+				c->mount_opts.compr_type = UBIFS_COMPR_LZ4;
+			else if (!strcmp(name, "lz4hc"))
+				c->mount_opts.compr_type = UBIFS_COMPR_LZ4HC;
 			else {
 				ubifs_err("unknown compressor \"%s\"", name);
 				kfree(name);
@@ -1024,6 +1037,16 @@ static int ubifs_parse_options(struct ubifs_info *c, char *options,
 			c->default_compr = c->mount_opts.compr_type;
 			break;
 		}
+		case Opt_bg_gc:
+		{
+			int lebs;
+
+			if (match_int(&args[0], &lebs) || lebs < 0)
+				return -EINVAL;
+			c->mount_opts.bg_gc = 1;
+			c->bg_gc_lebs = lebs;
+			break;
+		}
 		default:
 		{
 			unsigned long flag;
@@ -1368,7 +1391,10 @@ static int mount_ubifs(struct ubifs_info *c)
 	if (err)
 		goto out_infos;
 
+	ubifs_stats_init_fs(c);
+
 	c->always_chk_crc = 0;
+	c->bg_gc_on = !mounted_read_only;
 
 	ubifs_msg("mounted UBI device %d, volume %d, name \"%s\"",
 		  c->vi.ubi_num, c->vi.vol_id, c->vi.name);
@@ -1483,6 +1509,7 @@ static void ubifs_umount(struct ubifs_info *c)
 		c->vi.vol_id);
 
 	dbg_debugfs_exit_fs(c);
+	ubifs_stats_exit_fs(c);
 	spin_lock(&ubifs_infos_lock);
 	list_del(&c->infos_list);
 	spin_unlock(&ubifs_infos_lock);
@@ -1637,6 +1664,7 @@ static int ubifs_remount_rw(struct ubifs_info *c)
 	c->vfs_sb->s_flags &= ~MS_RDONLY;
 	c->remounting_rw = 0;
 	c->always_chk_crc = 0;
+	c->bg_gc_on = 1;
 	err = dbg_check_space_info(c);
 	mutex_unlock(&c->umount_mutex);
 	return err;
@@ -1673,6 +1701,7 @@ static void ubifs_remount_ro(struct ubifs_info *c)
 	ubifs_assert(!(c->vfs_sb->s_flags & MS_RDONLY));
 
 	mutex_lock(&c->umount_mutex);
+	c->bg_gc_on = 0;
 	if (c->bgt) {
 		kthread_stop(c->bgt);
 		c->bgt = NULL;
@@ -1910,6 +1939,7 @@ static int ubifs_fill_super(struct super_block *sb, void *data, int silent)
 	spin_lock_init(&c->buds_lock);
 	spin_lock_init(&c->space_lock);
 	spin_lock_init(&c->orphan_lock);
+	spin_lock_init(&c->stats_lock);
 	init_rwsem(&c->commit_sem);
 	mutex_init(&c->lp_mutex);
 	mutex_init(&c->tnc_mutex);
@@ -2151,12 +2181,12 @@ static int __init ubifs_init(void)
 	BUILD_BUG_ON(UBIFS_REF_NODE_SZ != 64);
 
 	/*
-	 * We use 2 bit wide bit-fields to store compression type, which should
+	 * We use 3 bit wide bit-fields to store compression type, which should
 	 * be amended if more compressors are added. The bit-fields are:
 	 * @compr_type in 'struct ubifs_inode', @default_compr in
 	 * 'struct ubifs_info' and @compr_type in 'struct ubifs_mount_opts'.
 	 */
-	BUILD_BUG_ON(UBIFS_COMPR_TYPES_CNT > 4);
+	BUILD_BUG_ON(UBIFS_COMPR_TYPES_CNT > 8);
 
 	/*
 	 * We require that PAGE_CACHE_SIZE is greater-than-or-equal-to
@@ -2193,6 +2223,7 @@ static int __init ubifs_init(void)
 	if (err)
 		goto out_compr;
 
+	ubifs_stats_init();
 	return 0;
 
 out_compr:
@@ -2212,6 +2243,7 @@ static void __exit ubifs_exit(void)
 	ubifs_assert(list_empty(&ubifs_infos));
 	ubifs_assert(atomic_long_read(&ubifs_clean_zn_cnt) == 0);
 
+	ubifs_stats_exit();
 	dbg_debugfs_exit();
 	ubifs_compressors_exit();
 	unregister_shrinker(&ubifs_shrinker_info);
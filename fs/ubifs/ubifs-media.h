@@ -332,12 +332,21 @@ enum {
  * UBIFS_COMPR_NONE: no compression
  * UBIFS_COMPR_LZO: LZO compression
  * UBIFS_COMPR_ZLIB: ZLIB compression
+ * UBIFS_COMPR_ZSTD: ZSTD compression of mainline UBIFS, not supported here
+ * UBIFS_COMPR_LZ4: LZ4 compression
+ * UBIFS_COMPR_LZ4HC: LZ4 high compression mode
  * UBIFS_COMPR_TYPES_CNT: count of supported compression types
+ *
+ * The value of UBIFS_COMPR_ZSTD is only reserved, so that LZ4 data is never
+ * mistaken for ZSTD data or the other way round.
  */
 enum {
 	UBIFS_COMPR_NONE,
 	UBIFS_COMPR_LZO,
 	UBIFS_COMPR_ZLIB,
+	UBIFS_COMPR_ZSTD,
+	UBIFS_COMPR_LZ4,
+	UBIFS_COMPR_LZ4HC,
 	UBIFS_COMPR_TYPES_CNT,
 };
 
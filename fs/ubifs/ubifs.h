@@ -36,6 +36,7 @@
 #include <linux/mtd/ubi.h>
 #include <linux/pagemap.h>
 #include <linux/backing-dev.h>
+#include <linux/ktime.h>
 #include "ubifs-media.h"
 
 /* Version of this UBIFS implementation */
@@ -100,6 +101,15 @@
 #define WBUF_TIMEOUT_SOFTLIMIT 3
 #define WBUF_TIMEOUT_HARDLIMIT 5
 
+/*
+ * The background thread garbage-collects dirty LEBs once there have been no
+ * journal writes for this long, until there are at least as many empty LEBs
+ * as asked by the "bg_gc" mount option, by default %BG_GC_LEBS, but not more
+ * than a sixteenth of the main area.
+ */
+#define BG_GC_IDLE (HZ/2)
+#define BG_GC_LEBS 4
+
 /* Maximum possible inode number (only 32-bit inodes are supported now) */
 #define MAX_INUM 0xFFFFFFFF
 
@@ -394,7 +404,7 @@ struct ubifs_inode {
 	unsigned int dirty:1;
 	unsigned int xattr:1;
 	unsigned int bulk_read:1;
-	unsigned int compr_type:2;
+	unsigned int compr_type:3;
 	struct mutex ui_mutex;
 	spinlock_t ui_lock;
 	loff_t synced_i_size;
@@ -905,6 +915,35 @@ struct ubifs_orphan {
 	int new;
 };
 
+/*
+ * What the writers may have to wait for (see 'struct ubifs_stall').
+ *
+ * UBIFS_STALL_BUDGET: write-back, GC and commit run to make free space when
+ *                     budgeting fails
+ * UBIFS_STALL_CMT_SEM: the commit start, which blocks the journal
+ * UBIFS_STALL_GC: GC run when a journal head needs a new LEB
+ * UBIFS_STALL_COMMIT: a commit run or waited for because the journal is full
+ */
+enum {
+	UBIFS_STALL_BUDGET,
+	UBIFS_STALL_CMT_SEM,
+	UBIFS_STALL_GC,
+	UBIFS_STALL_COMMIT,
+	UBIFS_STALL_CNT
+};
+
+/**
+ * struct ubifs_stall - time spent in one kind of stall.
+ * @count: how many times it happened
+ * @total_ns: total time in nanoseconds
+ * @max_ns: the longest one in nanoseconds
+ */
+struct ubifs_stall {
+	unsigned long count;
+	u64 total_ns;
+	u64 max_ns;
+};
+
 /**
  * struct ubifs_mount_opts - UBIFS-specific mount options information.
  * @unmount_mode: selected unmount mode (%0 default, %1 normal, %2 fast)
@@ -916,13 +955,16 @@ struct ubifs_orphan {
  *                  specified in @compr_type)
  * @compr_type: compressor type to override the superblock compressor with
  *              (%UBIFS_COMPR_NONE, etc)
+ * @bg_gc: if the empty LEBs kept by background GC were specified (%0 default,
+ *         %1 specified in @c->bg_gc_lebs)
  */
 struct ubifs_mount_opts {
 	unsigned int unmount_mode:2;
 	unsigned int bulk_read:2;
 	unsigned int chk_data_crc:2;
 	unsigned int override_compr:1;
-	unsigned int compr_type:2;
+	unsigned int compr_type:3;
+	unsigned int bg_gc:1;
 };
 
 struct ubifs_debug_info;
@@ -1096,6 +1138,21 @@ struct ubifs_debug_info;
  * @need_bgt: if background thread should run
  * @need_wbuf_sync: if write-buffers have to be synchronized
  *
+ * @bg_gc_lebs: how many empty LEBs background GC keeps, %0 if it is disabled
+ * @bg_gc_on: non-zero once the file-system is mounted read-write and ready
+ *            for background GC
+ * @bg_gc_stuck: how many times in a row background GC could not make progress;
+ *               it stops at %2 until journal writes reset this
+ * @jnl_last_write: time (in jiffies) of the last journal write reservation
+ *
+ * @stats_lock: protects @stalls, @cmt_start_time and @cmt_time
+ * @stalls: time writers spent waiting, by reason (%UBIFS_STALL_BUDGET, etc)
+ * @cmt_start_time: time the commits blocked the journal
+ * @cmt_time: total time of the commits
+ * @bg_cmt_cnt: count of commits run by the background thread
+ * @bg_gc_cnt: count of LEBs freed by background GC
+ * @stats_dir: the /proc/fs/ubifs directory of this file-system
+ *
  * @gc_lnum: LEB number used for garbage collection
  * @sbuf: a buffer of LEB size used by GC and replay for scanning
  * @idx_gc: list of index LEBs that have been garbage collected
@@ -1214,7 +1271,7 @@ struct ubifs_info {
 	unsigned int big_lpt:1;
 	unsigned int no_chk_data_crc:1;
 	unsigned int bulk_read:1;
-	unsigned int default_compr:2;
+	unsigned int default_compr:3;
 	unsigned int rw_incompat:1;
 
 	struct mutex tnc_mutex;
@@ -1327,6 +1384,19 @@ struct ubifs_info {
 	int need_bgt;
 	int need_wbuf_sync;
 
+	int bg_gc_lebs;
+	int bg_gc_on;
+	int bg_gc_stuck;
+	unsigned long jnl_last_write;
+
+	spinlock_t stats_lock;
+	struct ubifs_stall stalls[UBIFS_STALL_CNT];
+	struct ubifs_stall cmt_start_time;
+	struct ubifs_stall cmt_time;
+	unsigned long bg_cmt_cnt;
+	unsigned long bg_gc_cnt;
+	struct proc_dir_entry *stats_dir;
+
 	int gc_lnum;
 	void *sbuf;
 	struct list_head idx_gc;
@@ -1608,6 +1678,21 @@ void ubifs_destroy_idx_gc(struct ubifs_info *c);
 int ubifs_get_idx_gc_leb(struct ubifs_info *c);
 int ubifs_garbage_collect_leb(struct ubifs_info *c, struct ubifs_lprops *lp);
 
+/* stats.c */
+void ubifs_stall_add(struct ubifs_info *c, struct ubifs_stall *st,
+		     ktime_t start);
+#ifdef CONFIG_PROC_FS
+void __init ubifs_stats_init(void);
+void ubifs_stats_exit(void);
+void ubifs_stats_init_fs(struct ubifs_info *c);
+void ubifs_stats_exit_fs(struct ubifs_info *c);
+#else
+static inline void ubifs_stats_init(void) {}
+static inline void ubifs_stats_exit(void) {}
+static inline void ubifs_stats_init_fs(struct ubifs_info *c) {}
+static inline void ubifs_stats_exit_fs(struct ubifs_info *c) {}
+#endif
+
 /* orphan.c */
 int ubifs_add_orphan(struct ubifs_info *c, ino_t inum);
 void ubifs_delete_orphan(struct ubifs_info *c, ino_t inum);
@@ -58,6 +58,7 @@ static int yaffs_CheckpointErase(yaffs_Device *dev)
 	}
 
 	dev->blocksInCheckpoint = 0;
+	dev->checkpointBlocksCounted = 0;
 
 	return 1;
 }
@@ -169,6 +170,7 @@ int yaffs_CheckpointOpen(yaffs_Device *dev, int forWriting)
 		/* A checkpoint block list of 1 checkpoint block per 16 block is (hopefully)
 		 * going to be way more than we need */
 		dev->blocksInCheckpoint = 0;
+		dev->checkpointBlocksCounted = 0;
 		dev->checkpointMaxBlocks = (dev->internalEndBlock - dev->internalStartBlock)/16 + 2;
 		dev->checkpointBlockList = YMALLOC(sizeof(int) * dev->checkpointMaxBlocks);
 		if(!dev->checkpointBlockList)
@@ -181,6 +183,30 @@ int yaffs_CheckpointOpen(yaffs_Device *dev, int forWriting)
 	return 1;
 }
 
+/* Reopens the checkpoint written last to add an increment to it. Writing
+ * carries on from the page after the last one written, in the same stream.
+ */
+int yaffs_CheckpointOpenAppend(yaffs_Device *dev)
+{
+	dev->checkpointOpenForWrite = 1;
+
+	if (!dev->writeChunkWithTagsToNAND || !yaffs_CheckpointSpaceOk(dev))
+		return 0;
+
+	if (!dev->checkpointBuffer)
+		dev->checkpointBuffer = YMALLOC_DMA(dev->totalBytesPerChunk);
+	if (!dev->checkpointBuffer)
+		return 0;
+
+	dev->checkpointByteCount = 0;
+	dev->checkpointSum = 0;
+	dev->checkpointXor = 0;
+	memset(dev->checkpointBuffer, 0, dev->nDataBytesPerChunk);
+	dev->checkpointByteOffset = 0;
+
+	return 1;
+}
+
 int yaffs_GetCheckpointSum(yaffs_Device *dev, __u32 *sum)
 {
 	__u32 compositeSum;
@@ -375,8 +401,11 @@ int yaffs_CheckpointClose(yaffs_Device *dev)
 		dev->checkpointBlockList = NULL;
 	}
 
-	dev->nFreeChunks -= dev->blocksInCheckpoint * dev->nChunksPerBlock;
-	dev->nErasedBlocks -= dev->blocksInCheckpoint;
+	/* Only the blocks added since the last close are still counted as free */
+	dev->nFreeChunks -= (dev->blocksInCheckpoint - dev->checkpointBlocksCounted) *
+				dev->nChunksPerBlock;
+	dev->nErasedBlocks -= dev->blocksInCheckpoint - dev->checkpointBlocksCounted;
+	dev->checkpointBlocksCounted = dev->blocksInCheckpoint;
 
 
 	T(YAFFS_TRACE_CHECKPOINT, (TSTR("checkpoint byte count %d" TENDSTR),
@@ -20,6 +20,8 @@
 
 int yaffs_CheckpointOpen(yaffs_Device *dev, int forWriting);
 
+int yaffs_CheckpointOpenAppend(yaffs_Device *dev);
+
 int yaffs_CheckpointWrite(yaffs_Device *dev, const void *data, int nBytes);
 
 int yaffs_CheckpointRead(yaffs_Device *dev, void *data, int nBytes);
@@ -121,16 +121,19 @@ static uint32_t YCALCBLOCKS(uint64_t partition_size, uint32_t block_size)
 unsigned int yaffs_traceMask = YAFFS_TRACE_BAD_BLOCKS;
 unsigned int yaffs_wr_attempts = YAFFS_WR_ATTEMPTS;
 unsigned int yaffs_auto_checkpoint = 1;
+unsigned int yaffs_checkpoint_interval = 30;
 
 /* Module Parameters */
 #if (LINUX_VERSION_CODE > KERNEL_VERSION(2, 5, 0))
 module_param(yaffs_traceMask, uint, 0644);
 module_param(yaffs_wr_attempts, uint, 0644);
 module_param(yaffs_auto_checkpoint, uint, 0644);
+module_param(yaffs_checkpoint_interval, uint, 0644);
 #else
 MODULE_PARM(yaffs_traceMask, "i");
 MODULE_PARM(yaffs_wr_attempts, "i");
 MODULE_PARM(yaffs_auto_checkpoint, "i");
+MODULE_PARM(yaffs_checkpoint_interval, "i");
 #endif
 
 #if (LINUX_VERSION_CODE < KERNEL_VERSION(2, 6, 25))
@@ -241,6 +244,10 @@ static void yaffs_delete_inode(struct inode *);
 static void yaffs_clear_inode(struct inode *);
 
 static int yaffs_readpage(struct file *file, struct page *page);
+#if (LINUX_VERSION_CODE > KERNEL_VERSION(2, 6, 17))
+static int yaffs_readpages(struct file *file, struct address_space *mapping,
+				struct list_head *pages, unsigned nr_pages);
+#endif
 #if (LINUX_VERSION_CODE > KERNEL_VERSION(2, 5, 0))
 static int yaffs_writepage(struct page *page, struct writeback_control *wbc);
 #else
@@ -273,6 +280,9 @@ static int yaffs_follow_link(struct dentry *dentry, struct nameidata *nd);
 
 static struct address_space_operations yaffs_file_address_operations = {
 	.readpage = yaffs_readpage,
+#if (LINUX_VERSION_CODE > KERNEL_VERSION(2, 6, 17))
+	.readpages = yaffs_readpages,
+#endif
 	.writepage = yaffs_writepage,
 #if (YAFFS_USE_WRITE_BEGIN_END > 0)
 	.write_begin = yaffs_write_begin,
@@ -782,6 +792,96 @@ static int yaffs_readpage(struct file *f, struct page *pg)
 	return yaffs_readpage_unlock(f, pg);
 }
 
+#if (LINUX_VERSION_CODE > KERNEL_VERSION(2, 6, 17))
+
+/* Number of pages read in one go by readpages */
+#define YAFFS_READPAGES_BATCH	4
+
+static int yaffs_readpages_filler(void *data, struct page *pg)
+{
+	return yaffs_readpage_unlock((struct file *)data, pg);
+}
+
+static void yaffs_readpages_batch(yaffs_Object *obj, struct page **batch,
+				int nPages)
+{
+	yaffs_Device *dev = obj->myDev;
+	unsigned char *pg_buf;
+	int ret;
+	int i;
+
+	yaffs_GrossLock(dev);
+
+	ret = yaffs_ReadChunksFromFile(obj, dev->readPagesBuffer,
+				(loff_t)batch[0]->index << PAGE_CACHE_SHIFT,
+				nPages << PAGE_CACHE_SHIFT);
+
+	for (i = 0; i < nPages; i++) {
+		struct page *pg = batch[i];
+
+		if (ret >= 0) {
+			pg_buf = kmap(pg);
+			memcpy(pg_buf,
+				dev->readPagesBuffer + (i << PAGE_CACHE_SHIFT),
+				PAGE_CACHE_SIZE);
+			flush_dcache_page(pg);
+			kunmap(pg);
+			SetPageUptodate(pg);
+		} else {
+			SetPageError(pg);
+		}
+		unlock_page(pg);
+		page_cache_release(pg);
+	}
+
+	yaffs_GrossUnlock(dev);
+}
+
+/* Readahead hands us a list of pages in a go. Read runs of consecutive
+ * pages together so that yaffs_ReadChunksFromFile() can fetch chunks that
+ * are consecutive on NAND with one multi-page MTD read.
+ */
+static int yaffs_readpages(struct file *f, struct address_space *mapping,
+				struct list_head *pages, unsigned nr_pages)
+{
+	yaffs_Object *obj = yaffs_DentryToObject(f->f_dentry);
+	struct page *batch[YAFFS_READPAGES_BATCH];
+	int nBatch = 0;
+	unsigned i;
+
+	T(YAFFS_TRACE_OS, ("yaffs_readpages %u pages\n", nr_pages));
+
+	if (!obj->myDev->readPagesBuffer)
+		return read_cache_pages(mapping, pages,
+					yaffs_readpages_filler, f);
+
+	for (i = 0; i < nr_pages; i++) {
+		struct page *pg = list_entry(pages->prev, struct page, lru);
+
+		list_del(&pg->lru);
+		if (add_to_page_cache_lru(pg, mapping, pg->index,
+					GFP_KERNEL)) {
+			page_cache_release(pg);
+			continue;
+		}
+
+		if (nBatch > 0 &&
+		    (nBatch == YAFFS_READPAGES_BATCH ||
+		     pg->index != batch[nBatch - 1]->index + 1)) {
+			yaffs_readpages_batch(obj, batch, nBatch);
+			nBatch = 0;
+		}
+		batch[nBatch++] = pg;
+	}
+
+	if (nBatch > 0)
+		yaffs_readpages_batch(obj, batch, nBatch);
+
+	return 0;
+}
+
+#endif
+
 /* writepage inspired by/stolen from smbfs */
 
 #if (LINUX_VERSION_CODE > KERNEL_VERSION(2, 5, 0))
@@ -1754,6 +1854,8 @@ static int yaffs_do_sync_fs(struct super_block *sb)
 		if (dev) {
 			yaffs_FlushEntireDeviceCache(dev);
 			yaffs_CheckpointSave(dev);
+			dev->checkpointPageWrites = dev->nPageWrites;
+			dev->checkpointTime = jiffies;
 		}
 
 		yaffs_GrossUnlock(dev);
@@ -1763,6 +1865,30 @@ static int yaffs_do_sync_fs(struct super_block *sb)
 	return 0;
 }
 
+/* Any write invalidates the checkpoint, so after an unclean shutdown the
+ * next mount has to scan the whole device. To make that rarer, save a
+ * checkpoint once writing has stopped: write_super runs every writeback
+ * period while the super block is dirty, so checkpoint if no pages were
+ * written since the previous call and the last checkpoint is at least
+ * yaffs_checkpoint_interval seconds old.
+ */
+static void yaffs_periodic_checkpoint(struct super_block *sb)
+{
+	yaffs_Device *dev = yaffs_SuperToDevice(sb);
+	int quiet;
+
+	yaffs_GrossLock(dev);
+	quiet = (dev->nPageWrites == dev->checkpointPageWrites);
+	dev->checkpointPageWrites = dev->nPageWrites;
+	yaffs_GrossUnlock(dev);
+
+	if (quiet && time_after_eq(jiffies, dev->checkpointTime +
+				yaffs_checkpoint_interval * HZ)) {
+		T(YAFFS_TRACE_CHECKPOINT, ("yaffs_periodic_checkpoint\n"));
+		yaffs_do_sync_fs(sb);
+	}
+}
+
 
 #if (LINUX_VERSION_CODE > KERNEL_VERSION(2, 6, 17))
 static void yaffs_write_super(struct super_block *sb)
@@ -1774,6 +1900,8 @@ static int yaffs_write_super(struct super_block *sb)
 	T(YAFFS_TRACE_OS, ("yaffs_write_super\n"));
 	if (yaffs_auto_checkpoint >= 2)
 		yaffs_do_sync_fs(sb);
+	else if (yaffs_auto_checkpoint >= 1 && yaffs_checkpoint_interval)
+		yaffs_periodic_checkpoint(sb);
 #if (LINUX_VERSION_CODE < KERNEL_VERSION(2, 6, 18))
 	return 0;
 #endif
@@ -1913,6 +2041,8 @@ static void yaffs_put_super(struct super_block *sb)
 		dev->spareBuffer = NULL;
 	}
 
+	kfree(dev->readPagesBuffer);
+
 	kfree(dev);
 }
 
@@ -1942,6 +2072,7 @@ typedef struct {
 	int skip_checkpoint_read;
 	int skip_checkpoint_write;
 	int no_cache;
+	int n_caches;
 	int empty_lost_and_found_overridden;
 	int empty_lost_and_found;
 } yaffs_options;
@@ -1974,6 +2105,8 @@ static int yaffs_parse_options(yaffs_options *options, const char *options_str)
 			options->inband_tags = 1;
 		else if (!strcmp(cur_opt, "no-cache"))
 			options->no_cache = 1;
+		else if (!strncmp(cur_opt, "cache=", 6))
+			options->n_caches = simple_strtoul(cur_opt + 6, NULL, 0);
 		else if (!strcmp(cur_opt, "no-checkpoint-read"))
 			options->skip_checkpoint_read = 1;
 		else if (!strcmp(cur_opt, "no-checkpoint-write"))
@@ -2198,7 +2331,12 @@ static struct super_block *yaffs_internal_read_super(int yaffsVersion,
 	dev->nChunksPerBlock = YAFFS_CHUNKS_PER_BLOCK;
 	dev->totalBytesPerChunk = YAFFS_BYTES_PER_CHUNK;
 	dev->nReservedBlocks = 5;
-	dev->nShortOpCaches = (options.no_cache) ? 0 : 10;
+	if (options.no_cache)
+		dev->nShortOpCaches = 0;
+	else if (options.n_caches > 0)
+		dev->nShortOpCaches = options.n_caches;
+	else
+		dev->nShortOpCaches = 10;
 	dev->inbandTags = options.inband_tags;
 
 	/* ... and the functions. */
@@ -2214,6 +2352,14 @@ static struct super_block *yaffs_internal_read_super(int yaffsVersion,
 #if (LINUX_VERSION_CODE > KERNEL_VERSION(2, 6, 17))
 		dev->totalBytesPerChunk = mtd->writesize;
 		dev->nChunksPerBlock = mtd->erasesize / mtd->writesize;
+
+		/* Multi-chunk reads for readpages need whole chunks per page */
+		if (!options.inband_tags &&
+		    PAGE_CACHE_SIZE % dev->totalBytesPerChunk == 0) {
+			dev->readChunksFromNAND = nandmtd2_ReadChunksFromNAND;
+			dev->readPagesBuffer = kmalloc(YAFFS_READPAGES_BATCH *
+						PAGE_CACHE_SIZE, GFP_KERNEL);
+		}
 #else
 		dev->totalBytesPerChunk = mtd->oobblock;
 		dev->nChunksPerBlock = mtd->erasesize / mtd->oobblock;
@@ -2270,6 +2416,7 @@ static struct super_block *yaffs_internal_read_super(int yaffsVersion,
 	yaffs_GrossLock(dev);
 
 	err = yaffs_GutsInitialise(dev);
+	dev->checkpointTime = jiffies;
 
 	T(YAFFS_TRACE_OS,
 	  ("yaffs_read_super: guts initialised %s\n",
@@ -2423,6 +2570,7 @@ static char *yaffs_dump_dev(char *buf, yaffs_Device * dev)
 	buf += sprintf(buf, "nFreeChunks........ %d\n", dev->nFreeChunks);
 	buf += sprintf(buf, "nPageWrites........ %d\n", dev->nPageWrites);
 	buf += sprintf(buf, "nPageReads......... %d\n", dev->nPageReads);
+	buf += sprintf(buf, "nMultiChunkReads... %d\n", dev->nMultiChunkReads);
 	buf += sprintf(buf, "nBlockErasures..... %d\n", dev->nBlockErasures);
 	buf += sprintf(buf, "nGCCopies.......... %d\n", dev->nGCCopies);
 	buf += sprintf(buf, "garbageCollections. %d\n", dev->garbageCollections);
@@ -2435,7 +2583,17 @@ static char *yaffs_dump_dev(char *buf, yaffs_Device * dev)
 	buf += sprintf(buf, "eccUnfixed......... %d\n", dev->eccUnfixed);
 	buf += sprintf(buf, "tagsEccFixed....... %d\n", dev->tagsEccFixed);
 	buf += sprintf(buf, "tagsEccUnfixed..... %d\n", dev->tagsEccUnfixed);
+	buf += sprintf(buf, "mountTotalMs....... %u\n", dev->mountTotalMs);
+	buf += sprintf(buf, "mountInitMs........ %u\n", dev->mountInitMs);
+	buf += sprintf(buf, "mountCheckpointMs.. %u\n", dev->mountCheckpointMs);
+	buf += sprintf(buf, "mountIncrements.... %d\n", dev->mountIncrements);
+	buf += sprintf(buf, "mountReplayMs...... %u\n", dev->mountReplayMs);
+	buf += sprintf(buf, "mountReplayBlocks.. %d\n", dev->mountReplayBlocks);
+	buf += sprintf(buf, "mountScanMs........ %u\n", dev->mountScanMs);
+	buf += sprintf(buf, "mountFixupMs....... %u\n", dev->mountFixupMs);
+	buf += sprintf(buf, "cpIncrements....... %d\n", dev->checkpointIncrements);
 	buf += sprintf(buf, "cacheHits.......... %d\n", dev->cacheHits);
+	buf += sprintf(buf, "dirtyCaches........ %d\n", dev->srDirtyCaches);
 	buf += sprintf(buf, "nDeletedFiles...... %d\n", dev->nDeletedFiles);
 	buf += sprintf(buf, "nUnlinkedFiles..... %d\n", dev->nUnlinkedFiles);
 	buf +=
@@ -89,6 +89,7 @@ static int yaffs_AllocateChunk(yaffs_Device *dev, int useReserve,
 				yaffs_BlockInfo **blockUsedPtr);
 
 static void yaffs_VerifyFreeChunks(yaffs_Device *dev);
+static int yaffs_CountFreeChunks(yaffs_Device *dev);
 
 static void yaffs_CheckObjectDetailsLoaded(yaffs_Object *in);
 
@@ -1841,6 +1842,22 @@ static int yaffs_PruneFileStructure(yaffs_Device *dev,
 	return YAFFS_OK;
 }
 
+/* Frees a whole tnode tree, leaving the chunks it points to alone. */
+static void yaffs_FreeTnodeTree(yaffs_Device *dev, yaffs_Tnode *tn,
+				__u32 level)
+{
+	int i;
+
+	if (!tn)
+		return;
+
+	if (level > 0)
+		for (i = 0; i < YAFFS_NTNODES_INTERNAL; i++)
+			yaffs_FreeTnodeTree(dev, tn->internal[i], level - 1);
+
+	yaffs_FreeTnode(dev, tn);
+}
+
 /*-------------------- End of File Structure functions.-------------------*/
 
 /* yaffs_CreateFreeObjects creates a bunch more objects and
@@ -1920,6 +1937,7 @@ static yaffs_Object *yaffs_AllocateEmptyObject(yaffs_Device *dev)
 		tn->variantType = YAFFS_OBJECT_TYPE_UNKNOWN;
 		YINIT_LIST_HEAD(&(tn->hardLinks));
 		YINIT_LIST_HEAD(&(tn->hashLink));
+		YINIT_LIST_HEAD(&tn->cachedChunks);
 		YINIT_LIST_HEAD(&tn->siblings);
 
 
@@ -2003,6 +2021,9 @@ static void yaffs_FreeObject(yaffs_Object *tn)
 	}
 #endif
 
+	/* Don't leave cache entries pointing at a freed object */
+	yaffs_InvalidateWholeChunkCache(tn);
+
 	yaffs_UnhashObject(tn);
 
 #ifdef VALGRIND_TEST
@@ -3855,52 +3876,111 @@ int yaffs_UpdateObjectHeader(yaffs_Object *in, const YCHAR *name, int force,
  *   In Linux, the page cache provides read buffering aand the short op cache provides write
  *   buffering.
  *
- *   There are a limited number (~10) of cache chunks per device so that we don't
- *   need a very intelligent search.
+ *   The cache entries are indexed so that it can be sized in the hundreds:
+ *   - In use entries hang off a hash of (object, chunkId). Unused entries sit
+ *     on dev->srFreeCaches.
+ *   - dev->srLruCaches holds the in use entries, least recently used first.
+ *   - Each object lists its own entries with the dirty ones at the front, so
+ *     flushing an object only walks its dirty entries.
  */
 
-static int yaffs_ObjectHasCachedWriteData(yaffs_Object *obj)
+static Y_INLINE struct ylist_head *yaffs_ChunkCacheBucket(yaffs_Device *dev,
+							const yaffs_Object *obj,
+							int chunkId)
+{
+	__u32 n = obj->objectId * 37 + (__u32) chunkId;
+
+	return &dev->srCacheBucket[n % YAFFS_NCACHE_BUCKETS];
+}
+
+static void yaffs_AttachChunkCache(yaffs_ChunkCache *cache, yaffs_Object *obj,
+				int chunkId)
 {
 	yaffs_Device *dev = obj->myDev;
-	int i;
-	yaffs_ChunkCache *cache;
-	int nCaches = obj->myDev->nShortOpCaches;
 
-	for (i = 0; i < nCaches; i++) {
-		cache = &dev->srCache[i];
-		if (cache->object == obj &&
-		    cache->dirty)
-			return 1;
+	cache->object = obj;
+	cache->chunkId = chunkId;
+	cache->dirty = 0;
+	cache->locked = 0;
+	cache->nBytes = 0;
+
+	ylist_del(&cache->hashLink);
+	ylist_add(&cache->hashLink, yaffs_ChunkCacheBucket(dev, obj, chunkId));
+	ylist_add_tail(&cache->lruLink, &dev->srLruCaches);
+	ylist_add_tail(&cache->objLink, &obj->cachedChunks);
+}
+
+static void yaffs_SetChunkCacheDirty(yaffs_Device *dev, yaffs_ChunkCache *cache)
+{
+	if (!cache->dirty) {
+		cache->dirty = 1;
+		dev->srDirtyCaches++;
+		ylist_del(&cache->objLink);
+		ylist_add(&cache->objLink, &cache->object->cachedChunks);
 	}
+}
 
-	return 0;
+static void yaffs_ClearChunkCacheDirty(yaffs_Device *dev, yaffs_ChunkCache *cache)
+{
+	if (cache->dirty) {
+		cache->dirty = 0;
+		dev->srDirtyCaches--;
+		ylist_del(&cache->objLink);
+		ylist_add_tail(&cache->objLink, &cache->object->cachedChunks);
+	}
+}
+
+/* Detach a cache entry from its object and put it back on the free list. */
+static void yaffs_ReleaseChunkCache(yaffs_Device *dev, yaffs_ChunkCache *cache)
+{
+	if (!cache->object)
+		return;
+
+	if (cache->dirty)
+		dev->srDirtyCaches--;
+	cache->dirty = 0;
+	cache->object = NULL;
+
+	ylist_del_init(&cache->objLink);
+	ylist_del_init(&cache->lruLink);
+	ylist_del(&cache->hashLink);
+	ylist_add(&cache->hashLink, &dev->srFreeCaches);
+}
+
+static int yaffs_ObjectHasCachedWriteData(yaffs_Object *obj)
+{
+	yaffs_ChunkCache *cache;
+
+	if (ylist_empty(&obj->cachedChunks))
+		return 0;
+
+	cache = ylist_entry(obj->cachedChunks.next, yaffs_ChunkCache, objLink);
+
+	return cache->dirty;
 }
 
 
 static void yaffs_FlushFilesChunkCache(yaffs_Object *obj)
 {
 	yaffs_Device *dev = obj->myDev;
-	int lowest = -99;	/* Stop compiler whining. */
-	int i;
+	struct ylist_head *i;
 	yaffs_ChunkCache *cache;
+	yaffs_ChunkCache *c;
 	int chunkWritten = 0;
-	int nCaches = obj->myDev->nShortOpCaches;
 
-	if (nCaches > 0) {
+	if (dev->nShortOpCaches > 0) {
 		do {
 			cache = NULL;
 
-			/* Find the dirty cache for this object with the lowest chunk id. */
-			for (i = 0; i < nCaches; i++) {
-				if (dev->srCache[i].object == obj &&
-				    dev->srCache[i].dirty) {
-					if (!cache
-					    || dev->srCache[i].chunkId <
-					    lowest) {
-						cache = &dev->srCache[i];
-						lowest = cache->chunkId;
-					}
-				}
+			/* Find the dirty cache for this object with the lowest chunk id.
+			 * Dirty entries are at the front of the object's list.
+			 */
+			ylist_for_each(i, &obj->cachedChunks) {
+				c = ylist_entry(i, yaffs_ChunkCache, objLink);
+				if (!c->dirty)
+					break;
+				if (!cache || c->chunkId < cache->chunkId)
+					cache = c;
 			}
 
 			if (cache && !cache->locked) {
@@ -3912,8 +3992,7 @@ static void yaffs_FlushFilesChunkCache(yaffs_Object *obj)
 								 cache->data,
 								 cache->nBytes,
 								 1);
-				cache->dirty = 0;
-				cache->object = NULL;
+				yaffs_ReleaseChunkCache(dev, cache);
 			}
 
 		} while (cache && chunkWritten > 0);
@@ -3935,25 +4014,17 @@ static void yaffs_FlushFilesChunkCache(yaffs_Object *obj)
 
 void yaffs_FlushEntireDeviceCache(yaffs_Device *dev)
 {
-	yaffs_Object *obj;
 	int nCaches = dev->nShortOpCaches;
 	int i;
 
-	/* Find a dirty object in the cache and flush it...
-	 * until there are no further dirty objects.
+	/* Flush every object that has a dirty cache entry. Flushing an object
+	 * cleans all of its entries, so each object is only written once.
 	 */
-	do {
-		obj = NULL;
-		for (i = 0; i < nCaches && !obj; i++) {
-			if (dev->srCache[i].object &&
-			    dev->srCache[i].dirty)
-				obj = dev->srCache[i].object;
-
-		}
-		if (obj)
-			yaffs_FlushFilesChunkCache(obj);
-
-	} while (obj);
+	for (i = 0; i < nCaches && dev->srDirtyCaches > 0; i++) {
+		if (dev->srCache[i].object &&
+		    dev->srCache[i].dirty)
+			yaffs_FlushFilesChunkCache(dev->srCache[i].object);
+	}
 
 }
 
@@ -3965,14 +4036,9 @@ void yaffs_FlushEntireDeviceCache(yaffs_Device *dev)
  */
 static yaffs_ChunkCache *yaffs_GrabChunkCacheWorker(yaffs_Device *dev)
 {
-	int i;
-
-	if (dev->nShortOpCaches > 0) {
-		for (i = 0; i < dev->nShortOpCaches; i++) {
-			if (!dev->srCache[i].object)
-				return &dev->srCache[i];
-		}
-	}
+	if (dev->nShortOpCaches > 0 && !ylist_empty(&dev->srFreeCaches))
+		return ylist_entry(dev->srFreeCaches.next, yaffs_ChunkCache,
+				hashLink);
 
 	return NULL;
 }
@@ -3980,10 +4046,8 @@ static yaffs_ChunkCache *yaffs_GrabChunkCacheWorker(yaffs_Device *dev)
 static yaffs_ChunkCache *yaffs_GrabChunkCache(yaffs_Device *dev)
 {
 	yaffs_ChunkCache *cache;
-	yaffs_Object *theObj;
-	int usage;
-	int i;
-	int pushout;
+	yaffs_ChunkCache *c;
+	struct ylist_head *i;
 
 	if (dev->nShortOpCaches > 0) {
 		/* Try find a non-dirty one... */
@@ -3991,33 +4055,32 @@ static yaffs_ChunkCache *yaffs_GrabChunkCache(yaffs_Device *dev)
 		cache = yaffs_GrabChunkCacheWorker(dev);
 
 		if (!cache) {
-			/* They were all dirty, find the last recently used object and flush
-			 * its cache, then  find again.
+			/* They were all in use. Take the least recently used clean
+			 * one, else flush the object owning the least recently used
+			 * dirty one and find again.
 			 * NB what's here is not very accurate, we actually flush the object
 			 * the last recently used page.
 			 */
 
-			/* With locking we can't assume we can use entry zero */
+			/* With locking we can't assume we can use the list head */
 
-			theObj = NULL;
-			usage = -1;
-			cache = NULL;
-			pushout = -1;
+			yaffs_ChunkCache *victim = NULL;
 
-			for (i = 0; i < dev->nShortOpCaches; i++) {
-				if (dev->srCache[i].object &&
-				    !dev->srCache[i].locked &&
-				    (dev->srCache[i].lastUse < usage || !cache)) {
-					usage = dev->srCache[i].lastUse;
-					theObj = dev->srCache[i].object;
-					cache = &dev->srCache[i];
-					pushout = i;
+			ylist_for_each(i, &dev->srLruCaches) {
+				c = ylist_entry(i, yaffs_ChunkCache, lruLink);
+				if (c->locked)
+					continue;
+				if (!c->dirty) {
+					yaffs_ReleaseChunkCache(dev, c);
+					return yaffs_GrabChunkCacheWorker(dev);
 				}
+				if (!victim)
+					victim = c;
 			}
 
-			if (!cache || cache->dirty) {
+			if (victim) {
 				/* Flush and try again */
-				yaffs_FlushFilesChunkCache(theObj);
+				yaffs_FlushFilesChunkCache(victim->object);
 				cache = yaffs_GrabChunkCacheWorker(dev);
 			}
 
@@ -4033,14 +4096,19 @@ static yaffs_ChunkCache *yaffs_FindChunkCache(const yaffs_Object *obj,
 					      int chunkId)
 {
 	yaffs_Device *dev = obj->myDev;
-	int i;
+	struct ylist_head *bucket;
+	struct ylist_head *i;
+	yaffs_ChunkCache *cache;
+
 	if (dev->nShortOpCaches > 0) {
-		for (i = 0; i < dev->nShortOpCaches; i++) {
-			if (dev->srCache[i].object == obj &&
-			    dev->srCache[i].chunkId == chunkId) {
+		bucket = yaffs_ChunkCacheBucket(dev, obj, chunkId);
+		ylist_for_each(i, bucket) {
+			cache = ylist_entry(i, yaffs_ChunkCache, hashLink);
+			if (cache->object == obj &&
+			    cache->chunkId == chunkId) {
 				dev->cacheHits++;
 
-				return &dev->srCache[i];
+				return cache;
 			}
 		}
 	}
@@ -4053,21 +4121,11 @@ static void yaffs_UseChunkCache(yaffs_Device *dev, yaffs_ChunkCache *cache,
 {
 
 	if (dev->nShortOpCaches > 0) {
-		if (dev->srLastUse < 0 || dev->srLastUse > 100000000) {
-			/* Reset the cache usages */
-			int i;
-			for (i = 1; i < dev->nShortOpCaches; i++)
-				dev->srCache[i].lastUse = 0;
-
-			dev->srLastUse = 0;
-		}
-
-		dev->srLastUse++;
-
-		cache->lastUse = dev->srLastUse;
+		ylist_del(&cache->lruLink);
+		ylist_add_tail(&cache->lruLink, &dev->srLruCaches);
 
 		if (isAWrite)
-			cache->dirty = 1;
+			yaffs_SetChunkCacheDirty(dev, cache);
 	}
 }
 
@@ -4081,7 +4139,7 @@ static void yaffs_InvalidateChunkCache(yaffs_Object *object, int chunkId)
 		yaffs_ChunkCache *cache = yaffs_FindChunkCache(object, chunkId);
 
 		if (cache)
-			cache->object = NULL;
+			yaffs_ReleaseChunkCache(object->myDev, cache);
 	}
 }
 
@@ -4090,14 +4148,15 @@ static void yaffs_InvalidateChunkCache(yaffs_Object *object, int chunkId)
  */
 static void yaffs_InvalidateWholeChunkCache(yaffs_Object *in)
 {
-	int i;
 	yaffs_Device *dev = in->myDev;
+	yaffs_ChunkCache *cache;
 
 	if (dev->nShortOpCaches > 0) {
 		/* Invalidate it. */
-		for (i = 0; i < dev->nShortOpCaches; i++) {
-			if (dev->srCache[i].object == in)
-				dev->srCache[i].object = NULL;
+		while (!ylist_empty(&in->cachedChunks)) {
+			cache = ylist_entry(in->cachedChunks.next,
+					yaffs_ChunkCache, objLink);
+			yaffs_ReleaseChunkCache(dev, cache);
 		}
 	}
 }
@@ -4495,6 +4554,247 @@ static int yaffs_ReadCheckpointObjects(yaffs_Device *dev)
 	return ok ? 1 : 0;
 }
 
+/* Checkpoint increments.
+ *
+ * The checkpoint is not erased when the file system changes after it has
+ * been written in full. Instead later saves append an increment to it that
+ * holds the device and block state, the numbers of all the objects and only
+ * the objects that changed. On mount the increments are applied over the
+ * checkpoint in turn and then yaffs_ScanAfterCheckpoint() replays what was
+ * written after the last of them, if anything.
+ *
+ * An object changed if the digest of what would be checkpointed for it
+ * differs from the one taken when it was last saved.
+ */
+
+static __u32 yaffs_CheckpointDigest(__u32 sum, const void *data, int nBytes)
+{
+	const __u8 *b = (const __u8 *)data;
+
+	/* FNV-1a */
+	while (nBytes-- > 0)
+		sum = (sum ^ *b++) * 16777619;
+
+	return sum;
+}
+
+static __u32 yaffs_CheckpointTnodeDigest(yaffs_Device *dev, yaffs_Tnode *tn,
+					__u32 level, int chunkOffset, __u32 sum)
+{
+	int i;
+	int tnodeSize = (dev->tnodeWidth * YAFFS_NTNODES_LEVEL0)/8;
+
+	if (tnodeSize < sizeof(yaffs_Tnode))
+		tnodeSize = sizeof(yaffs_Tnode);
+
+	if (!tn)
+		return sum;
+
+	if (level > 0) {
+		for (i = 0; i < YAFFS_NTNODES_INTERNAL; i++) {
+			if (tn->internal[i])
+				sum = yaffs_CheckpointTnodeDigest(dev,
+						tn->internal[i], level - 1,
+						(chunkOffset<<YAFFS_TNODES_INTERNAL_BITS) + i,
+						sum);
+		}
+	} else {
+		__u32 baseOffset = chunkOffset <<  YAFFS_TNODES_LEVEL0_BITS;
+
+		sum = yaffs_CheckpointDigest(sum, &baseOffset, sizeof(baseOffset));
+		sum = yaffs_CheckpointDigest(sum, tn, tnodeSize);
+	}
+
+	return sum;
+}
+
+static __u32 yaffs_CheckpointObjectDigest(yaffs_Object *obj)
+{
+	yaffs_CheckpointObject cp;
+	__u32 sum = 2166136261U;
+
+	memset(&cp, 0, sizeof(cp));
+	yaffs_ObjectToCheckpointObject(&cp, obj);
+	sum = yaffs_CheckpointDigest(sum, &cp, sizeof(cp));
+
+	if (obj->variantType == YAFFS_OBJECT_TYPE_FILE)
+		sum = yaffs_CheckpointTnodeDigest(obj->myDev,
+					obj->variant.fileVariant.top,
+					obj->variant.fileVariant.topLevel,
+					0, sum);
+
+	/* 0 is kept for objects never checkpointed */
+	return sum ? sum : 1;
+}
+
+/* Takes the digest of every object and returns how many objects there are.
+ * Unless all is set, the objects that changed since their last digest get
+ * cpMark set and are counted in *nChanged.
+ */
+static int yaffs_CheckpointMarkObjects(yaffs_Device *dev, int all, int *nChanged)
+{
+	yaffs_Object *obj;
+	struct ylist_head *lh;
+	__u32 sum;
+	int nObjects = 0;
+	int i;
+
+	*nChanged = 0;
+
+	for (i = 0; i < YAFFS_NOBJECT_BUCKETS; i++) {
+		ylist_for_each(lh, &dev->objectBucket[i].list) {
+			obj = ylist_entry(lh, yaffs_Object, hashLink);
+			obj->cpMark = 0;
+			if (obj->deferedFree)
+				continue;
+
+			nObjects++;
+			sum = yaffs_CheckpointObjectDigest(obj);
+			if (!all && sum != obj->cpSum) {
+				obj->cpMark = 1;
+				(*nChanged)++;
+			}
+			obj->cpSum = sum;
+		}
+	}
+
+	return nObjects;
+}
+
+/* Drops an object from RAM only. Used when a checkpoint increment shows it
+ * is gone or that its number now belongs to another kind of object.
+ */
+static void yaffs_CheckpointForgetObject(yaffs_Object *obj)
+{
+	yaffs_Device *dev = obj->myDev;
+	yaffs_Object *hl;
+	struct ylist_head *lh;
+	struct ylist_head *n;
+
+	switch (obj->variantType) {
+	case YAFFS_OBJECT_TYPE_FILE:
+		yaffs_FreeTnodeTree(dev, obj->variant.fileVariant.top,
+				obj->variant.fileVariant.topLevel);
+		obj->variant.fileVariant.top = NULL;
+		break;
+	case YAFFS_OBJECT_TYPE_DIRECTORY:
+		/* Children that still exist are placed again by the increment */
+		ylist_for_each_safe(lh, n, &obj->variant.directoryVariant.children)
+			yaffs_AddObjectToDirectory(dev->lostNFoundDir,
+				ylist_entry(lh, yaffs_Object, siblings));
+		break;
+	case YAFFS_OBJECT_TYPE_SYMLINK:
+		if (obj->variant.symLinkVariant.alias)
+			YFREE(obj->variant.symLinkVariant.alias);
+		obj->variant.symLinkVariant.alias = NULL;
+		break;
+	case YAFFS_OBJECT_TYPE_HARDLINK:
+		ylist_del_init(&obj->hardLinks);
+		break;
+	default:
+		break;
+	}
+
+	if (obj->variantType != YAFFS_OBJECT_TYPE_HARDLINK) {
+		ylist_for_each_safe(lh, n, &obj->hardLinks) {
+			hl = ylist_entry(lh, yaffs_Object, hardLinks);
+			hl->variant.hardLinkVariant.equivalentObject = NULL;
+			ylist_del_init(lh);
+		}
+	}
+
+	if (obj->parent)
+		yaffs_RemoveObjectFromDirectory(obj);
+	yaffs_FreeObject(obj);
+}
+
+/* Reads the changed objects of an increment over the ones in RAM. */
+static int yaffs_ReadCheckpointChangedObjects(yaffs_Device *dev)
+{
+	yaffs_Object *obj;
+	yaffs_CheckpointObject cp;
+	int ok = 1;
+	int done = 0;
+	yaffs_Object *hardList = NULL;
+
+	while (ok && !done) {
+		ok = (yaffs_CheckpointRead(dev, &cp, sizeof(cp)) == sizeof(cp));
+		if (cp.structType != sizeof(cp))
+			ok = 0;
+
+		if (ok && cp.objectId == ~0) {
+			done = 1;
+			continue;
+		} else if (!ok)
+			continue;
+
+		T(YAFFS_TRACE_CHECKPOINT, (TSTR("Checkpoint increment object %d parent %d type %d chunk %d " TENDSTR),
+			cp.objectId, cp.parentId, cp.variantType, cp.hdrChunk));
+
+		obj = yaffs_FindObjectByNumber(dev, cp.objectId);
+		if (obj && obj->variantType != cp.variantType) {
+			yaffs_CheckpointForgetObject(obj);
+			obj = NULL;
+		}
+
+		if (!obj) {
+			obj = yaffs_CreateNewObject(dev, cp.objectId, cp.variantType);
+			if (obj && obj->variantType == YAFFS_OBJECT_TYPE_HARDLINK) {
+				obj->hardLinks.next = (struct ylist_head *) hardList;
+				hardList = obj;
+			}
+		} else if (obj->variantType == YAFFS_OBJECT_TYPE_FILE) {
+			/* The tnodes come again in full */
+			yaffs_FreeTnodeTree(dev, obj->variant.fileVariant.top,
+					obj->variant.fileVariant.topLevel);
+			obj->variant.fileVariant.top = yaffs_GetTnode(dev);
+			obj->variant.fileVariant.topLevel = 0;
+			if (!obj->variant.fileVariant.top)
+				ok = 0;
+		} else if (obj->variantType == YAFFS_OBJECT_TYPE_SYMLINK) {
+			/* Loaded again from the header */
+			if (obj->variant.symLinkVariant.alias)
+				YFREE(obj->variant.symLinkVariant.alias);
+			obj->variant.symLinkVariant.alias = NULL;
+		}
+
+		if (!obj)
+			ok = 0;
+		if (ok)
+			ok = yaffs_CheckpointObjectToObject(obj, &cp);
+		if (ok && obj->variantType == YAFFS_OBJECT_TYPE_FILE)
+			ok = yaffs_ReadCheckpointTnodes(obj);
+		if (ok)
+			obj->cpMark = 1;
+	}
+
+	if (ok)
+		yaffs_HardlinkFixup(dev, hardList);
+
+	return ok ? 1 : 0;
+}
+
+/* Forgets the objects an increment did not list and clears cpMark */
+static void yaffs_CheckpointForgetUnlisted(yaffs_Device *dev)
+{
+	yaffs_Object *obj;
+	struct ylist_head *lh;
+	struct ylist_head *n;
+	int i;
+
+	for (i = 0; i < YAFFS_NOBJECT_BUCKETS; i++) {
+		ylist_for_each_safe(lh, n, &dev->objectBucket[i].list) {
+			obj = ylist_entry(lh, yaffs_Object, hashLink);
+			if (!obj->cpMark && !obj->fake) {
+				T(YAFFS_TRACE_CHECKPOINT, (TSTR("Checkpoint increment drops object %d" TENDSTR),
+					obj->objectId));
+				yaffs_CheckpointForgetObject(obj);
+			} else
+				obj->cpMark = 0;
+		}
+	}
+}
+
 static int yaffs_WriteCheckpointSum(yaffs_Device *dev)
 {
 	__u32 checkpointSum;
@@ -4565,6 +4865,15 @@ static int yaffs_WriteCheckpointData(yaffs_Device *dev)
 	if (!yaffs_CheckpointClose(dev))
 		ok = 0;
 
+	if (ok) {
+		int nChanged;
+
+		yaffs_CheckpointMarkObjects(dev, 1, &nChanged);
+	}
+	dev->checkpointIsBase = ok;
+	dev->checkpointCanAppend = ok;
+	dev->checkpointIncrements = 0;
+
 	if (ok)
 		dev->isCheckpointed = 1;
 	else
@@ -4573,6 +4882,136 @@ static int yaffs_WriteCheckpointData(yaffs_Device *dev)
 	return dev->isCheckpointed;
 }
 
+/* Appends an increment to the checkpoint. Returns 0 if it cannot, so that a
+ * full checkpoint is written instead.
+ */
+static int yaffs_WriteCheckpointIncrement(yaffs_Device *dev)
+{
+	yaffs_CheckpointIncrement inc;
+	yaffs_CheckpointObject cp;
+	yaffs_Object *obj;
+	struct ylist_head *lh;
+	int nChanged;
+	int i;
+	int ok;
+
+	if (!dev->checkpointCanAppend || dev->skipCheckpointWrite ||
+	    !dev->isYaffs2 ||
+	    dev->blocksInCheckpoint >= yaffs_CalcCheckpointBlocksRequired(dev))
+		return 0;
+
+	memset(&inc, 0, sizeof(inc));
+	inc.structType = sizeof(inc);
+	inc.magic = YAFFS_MAGIC;
+	inc.version = YAFFS_CHECKPOINT_VERSION;
+	inc.blocksCounted = dev->checkpointBlocksCounted;
+	inc.nObjects = yaffs_CheckpointMarkObjects(dev, 0, &nChanged);
+
+	T(YAFFS_TRACE_CHECKPOINT, (TSTR("write checkpoint increment, %d of %d objects changed" TENDSTR),
+		nChanged, inc.nObjects));
+
+	if (!yaffs_CheckpointOpenAppend(dev)) {
+		dev->checkpointCanAppend = 0;
+		return 0;
+	}
+
+	ok = (yaffs_CheckpointWrite(dev, &inc, sizeof(inc)) == sizeof(inc));
+	if (ok)
+		ok = yaffs_WriteCheckpointDevice(dev);
+
+	for (i = 0; ok && i < YAFFS_NOBJECT_BUCKETS; i++) {
+		ylist_for_each(lh, &dev->objectBucket[i].list) {
+			obj = ylist_entry(lh, yaffs_Object, hashLink);
+			if (ok && !obj->deferedFree)
+				ok = (yaffs_CheckpointWrite(dev, &obj->objectId, sizeof(obj->objectId)) ==
+					sizeof(obj->objectId));
+		}
+	}
+
+	for (i = 0; ok && i < YAFFS_NOBJECT_BUCKETS; i++) {
+		ylist_for_each(lh, &dev->objectBucket[i].list) {
+			obj = ylist_entry(lh, yaffs_Object, hashLink);
+			if (ok && obj->cpMark) {
+				yaffs_ObjectToCheckpointObject(&cp, obj);
+				cp.structType = sizeof(cp);
+				ok = (yaffs_CheckpointWrite(dev, &cp, sizeof(cp)) == sizeof(cp));
+				if (ok && obj->variantType == YAFFS_OBJECT_TYPE_FILE)
+					ok = yaffs_WriteCheckpointTnodes(obj);
+			}
+			obj->cpMark = 0;
+		}
+	}
+
+	/* Dump end of list */
+	memset(&cp, 0xFF, sizeof(yaffs_CheckpointObject));
+	cp.structType = sizeof(cp);
+
+	if (ok)
+		ok = (yaffs_CheckpointWrite(dev, &cp, sizeof(cp)) == sizeof(cp));
+	if (ok)
+		ok = yaffs_WriteCheckpointSum(dev);
+
+	if (!yaffs_CheckpointClose(dev))
+		ok = 0;
+
+	if (ok) {
+		dev->checkpointIncrements++;
+		dev->isCheckpointed = 1;
+	} else
+		dev->checkpointCanAppend = 0;
+
+	return ok;
+}
+
+/* Applies the next increment of the checkpoint being read. Returns 1 if one
+ * was applied, 0 if there are no more and -1 if one is damaged, which leaves
+ * the objects in RAM of no use.
+ */
+static int yaffs_ReadCheckpointIncrement(yaffs_Device *dev)
+{
+	yaffs_CheckpointIncrement inc;
+	yaffs_Object *obj;
+	__u32 objectId;
+	__u32 i;
+	int ok;
+
+	/* Increments start on a page of their own */
+	dev->checkpointByteOffset = dev->nDataBytesPerChunk;
+	dev->checkpointSum = 0;
+	dev->checkpointXor = 0;
+
+	ok = (yaffs_CheckpointRead(dev, &inc, sizeof(inc)) == sizeof(inc));
+	if (!ok || inc.structType != sizeof(inc) ||
+	    inc.magic != YAFFS_MAGIC ||
+	    inc.version != YAFFS_CHECKPOINT_VERSION)
+		return 0;
+
+	T(YAFFS_TRACE_CHECKPOINT, (TSTR("read checkpoint increment, %d objects" TENDSTR),
+		inc.nObjects));
+
+	ok = yaffs_ReadCheckpointDevice(dev);
+	if (ok)
+		dev->checkpointBlocksCounted = inc.blocksCounted;
+
+	for (i = 0; ok && i < inc.nObjects; i++) {
+		ok = (yaffs_CheckpointRead(dev, &objectId, sizeof(objectId)) == sizeof(objectId));
+		obj = ok ? yaffs_FindObjectByNumber(dev, objectId) : NULL;
+		if (obj)
+			obj->cpMark = 1;
+	}
+
+	if (ok)
+		ok = yaffs_ReadCheckpointChangedObjects(dev);
+	if (ok)
+		ok = yaffs_ReadCheckpointSum(dev);
+	if (ok)
+		yaffs_CheckpointForgetUnlisted(dev);
+
+	T(YAFFS_TRACE_CHECKPOINT, (TSTR("read checkpoint increment %d" TENDSTR), ok));
+
+	return ok ? 1 : -1;
+}
+
 static int yaffs_ReadCheckpointData(yaffs_Device *dev)
 {
 	int ok = 1;
@@ -4607,6 +5046,14 @@ static int yaffs_ReadCheckpointData(yaffs_Device *dev)
 		T(YAFFS_TRACE_CHECKPOINT, (TSTR("read checkpoint checksum %d" TENDSTR), ok));
 	}
 
+	if (ok) {
+		int applied;
+
+		while ((applied = yaffs_ReadCheckpointIncrement(dev)) > 0)
+			dev->mountIncrements++;
+		ok = (applied == 0);
+	}
+
 	if (!yaffs_CheckpointClose(dev))
 		ok = 0;
 
@@ -4621,6 +5068,23 @@ static int yaffs_ReadCheckpointData(yaffs_Device *dev)
 
 static void yaffs_InvalidateCheckpoint(yaffs_Device *dev)
 {
+	/* A full checkpoint stays on NAND while it does not take up more room
+	 * than a new one would: mount replays what was written after it and
+	 * the next save appends an increment.
+	 */
+	if (dev->checkpointIsBase &&
+	    dev->blocksInCheckpoint <= yaffs_CalcCheckpointBlocksRequired(dev)) {
+		if (dev->isCheckpointed) {
+			dev->isCheckpointed = 0;
+			if (dev->superBlock && dev->markSuperBlockDirty)
+				dev->markSuperBlockDirty(dev->superBlock);
+		}
+		return;
+	}
+
+	dev->checkpointIsBase = 0;
+	dev->checkpointCanAppend = 0;
+
 	if (dev->isCheckpointed ||
 			dev->blocksInCheckpoint > 0) {
 		dev->isCheckpointed = 0;
@@ -4640,7 +5104,8 @@ int yaffs_CheckpointSave(yaffs_Device *dev)
 	yaffs_VerifyBlocks(dev);
 	yaffs_VerifyFreeChunks(dev);
 
-	if (!dev->isCheckpointed) {
+	if (!dev->isCheckpointed && !yaffs_WriteCheckpointIncrement(dev)) {
+		dev->checkpointIsBase = 0;
 		yaffs_InvalidateCheckpoint(dev);
 		yaffs_WriteCheckpointData(dev);
 	}
@@ -4720,14 +5185,10 @@ int yaffs_ReadDataFromFile(yaffs_Object *in, __u8 *buffer, loff_t offset,
 
 				if (!cache) {
 					cache = yaffs_GrabChunkCache(in->myDev);
-					cache->object = in;
-					cache->chunkId = chunk;
-					cache->dirty = 0;
-					cache->locked = 0;
+					yaffs_AttachChunkCache(cache, in, chunk);
 					yaffs_ReadChunkDataFromObject(in, chunk,
 								      cache->
 								      data);
-					cache->nBytes = 0;
 				}
 
 				yaffs_UseChunkCache(dev, cache, 0);
@@ -4746,28 +5207,86 @@ int yaffs_ReadDataFromFile(yaffs_Object *in, __u8 *buffer, loff_t offset,
 				yaffs_ReadChunkDataFromObject(in, chunk,
 							      localBuffer);
 
-				memcpy(buffer, &localBuffer[start], nToCopy);
+				memcpy(buffer, &localBuffer[start], nToCopy);
+
+
+				yaffs_ReleaseTempBuffer(dev, localBuffer,
+							__LINE__);
+			}
+
+		} else {
+
+			/* A full chunk. Read directly into the supplied buffer. */
+			yaffs_ReadChunkDataFromObject(in, chunk, buffer);
+
+		}
+
+		n -= nToCopy;
+		offset += nToCopy;
+		buffer += nToCopy;
+		nDone += nToCopy;
+
+	}
+
+	return nDone;
+}
+
+/* Read whole chunks, like yaffs_ReadDataFromFile(), but fetch runs of chunks
+ * that sit on consecutive pages of one block with a single NAND read.
+ * offset and nBytes must be multiples of the chunk size, otherwise this
+ * just falls back to yaffs_ReadDataFromFile().
+ */
+int yaffs_ReadChunksFromFile(yaffs_Object *in, __u8 *buffer, loff_t offset,
+			int nBytes)
+{
+	yaffs_Device *dev = in->myDev;
+	yaffs_ChunkCache *cache;
+	int chunkSize = dev->nDataBytesPerChunk;
+	int nChunks;
+	int chunk;
+	__u32 start;
+	int i;
+	int theChunk;
+	int runLength;
+
+	yaffs_AddrToChunk(dev, offset, &chunk, &start);
+	chunk++;
 
+	if (start || (nBytes % chunkSize) || dev->inbandTags)
+		return yaffs_ReadDataFromFile(in, buffer, offset, nBytes);
 
-				yaffs_ReleaseTempBuffer(dev, localBuffer,
-							__LINE__);
-			}
+	nChunks = nBytes / chunkSize;
 
-		} else {
+	for (i = 0; i < nChunks; i += runLength) {
+		runLength = 1;
 
-			/* A full chunk. Read directly into the supplied buffer. */
-			yaffs_ReadChunkDataFromObject(in, chunk, buffer);
+		/* The short op cache may hold newer data than NAND */
+		cache = yaffs_FindChunkCache(in, chunk + i);
+		if (cache) {
+			yaffs_UseChunkCache(dev, cache, 0);
+			memcpy(buffer + i * chunkSize, cache->data, chunkSize);
+			continue;
+		}
 
+		theChunk = yaffs_FindChunkInFile(in, chunk + i, NULL);
+		if (theChunk < 0) {
+			/* get sane (zero) data if you read a hole */
+			memset(buffer + i * chunkSize, 0, chunkSize);
+			continue;
 		}
 
-		n -= nToCopy;
-		offset += nToCopy;
-		buffer += nToCopy;
-		nDone += nToCopy;
+		while (i + runLength < nChunks &&
+		       (theChunk + runLength) % dev->nChunksPerBlock != 0 &&
+		       !yaffs_FindChunkCache(in, chunk + i + runLength) &&
+		       yaffs_FindChunkInFile(in, chunk + i + runLength, NULL) ==
+				theChunk + runLength)
+			runLength++;
 
+		yaffs_ReadChunksFromNAND(dev, theChunk, runLength,
+					buffer + i * chunkSize);
 	}
 
-	return nDone;
+	return nBytes;
 }
 
 int yaffs_WriteDataToFile(yaffs_Object *in, const __u8 *buffer, loff_t offset,
@@ -4850,10 +5369,7 @@ int yaffs_WriteDataToFile(yaffs_Object *in, const __u8 *buffer, loff_t offset,
 				    && yaffs_CheckSpaceForAllocation(in->
 								     myDev)) {
 					cache = yaffs_GrabChunkCache(in->myDev);
-					cache->object = in;
-					cache->chunkId = chunk;
-					cache->dirty = 0;
-					cache->locked = 0;
+					yaffs_AttachChunkCache(cache, in, chunk);
 					yaffs_ReadChunkDataFromObject(in, chunk,
 								      cache->
 								      data);
@@ -4885,7 +5401,7 @@ int yaffs_WriteDataToFile(yaffs_Object *in, const __u8 *buffer, loff_t offset,
 						     cache->chunkId,
 						     cache->data, cache->nBytes,
 						     1);
-						cache->dirty = 0;
+						yaffs_ClearChunkCacheDirty(dev, cache);
 					}
 
 				} else {
@@ -6750,6 +7266,457 @@ static int yaffs_ScanBackwards(yaffs_Device *dev)
 	return YAFFS_OK;
 }
 
+/* Clears the entries of a file that point into blocks erased since the
+ * checkpoint.
+ */
+static void yaffs_DropErasedChunksWorker(yaffs_Object *in, yaffs_Tnode *tn,
+					__u32 level)
+{
+	yaffs_Device *dev = in->myDev;
+	int theChunk;
+	int live;
+	int i;
+	int j;
+
+	if (!tn)
+		return;
+
+	if (level > 0) {
+		for (i = 0; i < YAFFS_NTNODES_INTERNAL; i++)
+			yaffs_DropErasedChunksWorker(in, tn->internal[i], level - 1);
+		return;
+	}
+
+	for (i = 0; i < YAFFS_NTNODES_LEVEL0; i++) {
+		theChunk = yaffs_GetChunkGroupBase(dev, tn, i);
+		if (!theChunk)
+			continue;
+
+		live = 0;
+		for (j = 0; !live && j < dev->chunkGroupSize; j++)
+			live = yaffs_CheckChunkBit(dev,
+					(theChunk + j) / dev->nChunksPerBlock,
+					(theChunk + j) % dev->nChunksPerBlock);
+		if (!live) {
+			yaffs_PutLevel0Tnode(dev, tn, i, 0);
+			in->nDataChunks--;
+		}
+	}
+}
+
+/* Applies an object header found by yaffs_ScanAfterCheckpoint(). Returns 0
+ * if the header cannot be replayed over what is in RAM.
+ */
+static int yaffs_ReplayObjectHeader(yaffs_Device *dev, int chunk,
+				int objectId, __u8 *chunkData,
+				yaffs_Object **hardList)
+{
+	yaffs_BlockInfo *bi = yaffs_GetBlockInfo(dev, chunk / dev->nChunksPerBlock);
+	yaffs_ObjectHeader *oh = (yaffs_ObjectHeader *) chunkData;
+	yaffs_Object *in;
+	yaffs_Object *parent = NULL;
+	yaffs_Object *shadowed;
+	int created;
+	int isNew;
+	int itsUnlinked = 0;
+	int isShrink;
+	__u32 fileSize;
+
+	yaffs_ReadChunkWithTagsFromNAND(dev, chunk, chunkData, NULL);
+
+	if (dev->inbandTags) {
+		/* Fix up the header if they got corrupted by inband tags */
+		oh->shadowsObject = oh->inbandShadowsObject;
+		oh->isShrink = oh->inbandIsShrink;
+	}
+
+	in = yaffs_FindObjectByNumber(dev, objectId);
+	created = !in;
+	isNew = !in || !in->hdrChunk;
+	if (created)
+		in = yaffs_CreateNewObject(dev, objectId, oh->type);
+
+	if (!in || in->variantType != oh->type) {
+		T(YAFFS_TRACE_SCAN,
+		  (TSTR("Replay of object %d type %d does not fit" TENDSTR),
+		   objectId, oh->type));
+		return 0;
+	}
+
+	if (objectId != YAFFS_OBJECTID_ROOT &&
+	    objectId != YAFFS_OBJECTID_LOSTNFOUND) {
+		parent = yaffs_FindOrCreateObjectByNumber(dev, oh->parentObjectId,
+					YAFFS_OBJECT_TYPE_DIRECTORY);
+		if (!parent)
+			return 0;
+
+		if (parent->variantType == YAFFS_OBJECT_TYPE_UNKNOWN) {
+			parent->variantType = YAFFS_OBJECT_TYPE_DIRECTORY;
+			YINIT_LIST_HEAD(&parent->variant.directoryVariant.children);
+		} else if (parent->variantType != YAFFS_OBJECT_TYPE_DIRECTORY) {
+			parent = dev->lostNFoundDir;
+		}
+
+		itsUnlinked = (parent == dev->deletedDir ||
+			       parent == dev->unlinkedDir);
+
+		/* Deleted objects do not come back, so the number was reused */
+		if (!isNew && !itsUnlinked &&
+		    (in->parent == dev->deletedDir ||
+		     in->parent == dev->unlinkedDir))
+			return 0;
+
+		if (oh->shadowsObject > 0) {
+			shadowed = yaffs_FindObjectByNumber(dev, oh->shadowsObject);
+			if (shadowed && shadowed != in &&
+			    shadowed->parent != dev->deletedDir &&
+			    shadowed->parent != dev->unlinkedDir) {
+				/* Renamed over, the way a scan treats it */
+				if (yaffs_IsNonEmptyDirectory(shadowed))
+					return 0;
+				yaffs_AddObjectToDirectory(dev->unlinkedDir,
+							shadowed);
+			}
+		}
+	}
+
+	if (in->hdrChunk > 0 && in->hdrChunk != chunk)
+		yaffs_DeleteChunk(dev, in->hdrChunk, 1, __LINE__);
+
+	in->hdrChunk = chunk;
+	in->valid = 1;
+	in->lazyLoaded = 0;
+	in->dirty = 0;
+	in->cpMark = 0;
+
+	in->yst_mode = oh->yst_mode;
+#ifdef CONFIG_YAFFS_WINCE
+	in->win_atime[0] = oh->win_atime[0];
+	in->win_ctime[0] = oh->win_ctime[0];
+	in->win_mtime[0] = oh->win_mtime[0];
+	in->win_atime[1] = oh->win_atime[1];
+	in->win_ctime[1] = oh->win_ctime[1];
+	in->win_mtime[1] = oh->win_mtime[1];
+#else
+	in->yst_uid = oh->yst_uid;
+	in->yst_gid = oh->yst_gid;
+	in->yst_atime = oh->yst_atime;
+	in->yst_mtime = oh->yst_mtime;
+	in->yst_ctime = oh->yst_ctime;
+	in->yst_rdev = oh->yst_rdev;
+#endif
+
+	if (!parent)
+		return 1;
+
+	yaffs_SetObjectName(in, oh->name);
+	if (in->parent != parent)
+		yaffs_AddObjectToDirectory(parent, in);
+
+	if (oh->isShrink)
+		bi->hasShrinkHeader = 1;
+
+	isShrink = oh->isShrink || itsUnlinked;
+	fileSize = itsUnlinked ? 0 : oh->fileSize;
+
+	switch (in->variantType) {
+	case YAFFS_OBJECT_TYPE_FILE:
+		if (isShrink &&
+		    fileSize < in->variant.fileVariant.fileSize) {
+			yaffs_PruneResizedChunks(in, fileSize);
+			in->variant.fileVariant.fileSize = fileSize;
+			yaffs_PruneFileStructure(dev, &in->variant.fileVariant);
+		} else if (in->variant.fileVariant.fileSize < fileSize) {
+			in->variant.fileVariant.fileSize = fileSize;
+		}
+		break;
+	case YAFFS_OBJECT_TYPE_HARDLINK:
+		if (created && !itsUnlinked) {
+			in->variant.hardLinkVariant.equivalentObjectId =
+				oh->equivalentObjectId;
+			in->hardLinks.next = (struct ylist_head *) *hardList;
+			*hardList = in;
+		}
+		break;
+	case YAFFS_OBJECT_TYPE_SYMLINK:
+		if (!in->variant.symLinkVariant.alias) {
+			in->variant.symLinkVariant.alias =
+				yaffs_CloneString(oh->alias);
+			if (!in->variant.symLinkVariant.alias)
+				return 0;
+		}
+		break;
+	default:
+		break;
+	}
+
+	return 1;
+}
+
+/*
+ * yaffs_ScanAfterCheckpoint brings what was restored from the checkpoint up
+ * to date with what was written after it was saved, which is the case when
+ * the device was not unmounted cleanly.
+ *
+ * The first page of each block tells which blocks were erased or written
+ * since: what the checkpoint has in blocks erased since is dropped, and the
+ * blocks written since, together with the rest of the block that was being
+ * allocated from, are replayed in sequence order. Newer data chunks replace
+ * older ones and object headers update their objects, as in a forwards scan.
+ *
+ * Returns YAFFS_FAIL if the replay cannot follow what it finds. The caller
+ * then scans the whole device.
+ */
+static int yaffs_ScanAfterCheckpoint(yaffs_Device *dev)
+{
+	yaffs_ExtendedTags tags;
+	yaffs_BlockState state;
+	yaffs_BlockInfo *bi;
+	yaffs_BlockIndex *blockIndex;
+	yaffs_Object *hardList = NULL;
+	yaffs_Object *in;
+	struct ylist_head *lh;
+	struct ylist_head *n;
+	__u32 sequenceNumber;
+	__u32 checkpointSequence = dev->sequenceNumber;
+	int allocBlock = dev->allocationBlock;
+	int allocStart = 0;
+	int nBlocks = dev->internalEndBlock - dev->internalStartBlock + 1;
+	int nBlocksToScan = 0;
+	int nErased = 0;
+	int nReplayed = 0;
+	int altBlockIndex = 0;
+	int lastUsed;
+	int blk;
+	int chunk;
+	int c;
+	int i;
+	int ok = 1;
+	__u8 *chunkData;
+
+	blockIndex = YMALLOC(nBlocks * sizeof(yaffs_BlockIndex));
+
+	if (!blockIndex) {
+		blockIndex = YMALLOC_ALT(nBlocks * sizeof(yaffs_BlockIndex));
+		altBlockIndex = 1;
+	}
+
+	if (!blockIndex)
+		return YAFFS_FAIL;
+
+	/* Find the blocks that changed since the checkpoint */
+	for (blk = dev->internalStartBlock; ok && blk <= dev->internalEndBlock; blk++) {
+		bi = yaffs_GetBlockInfo(dev, blk);
+
+		if (bi->blockState == YAFFS_BLOCK_STATE_CHECKPOINT ||
+		    bi->blockState == YAFFS_BLOCK_STATE_DEAD)
+			continue;
+
+		yaffs_QueryInitialBlockState(dev, blk, &state, &sequenceNumber);
+		if (state == YAFFS_BLOCK_STATE_NEEDS_SCANNING &&
+		    sequenceNumber == YAFFS_SEQUENCE_BAD_BLOCK)
+			state = YAFFS_BLOCK_STATE_DEAD;
+
+		if (bi->blockState == YAFFS_BLOCK_STATE_EMPTY) {
+			if (state == YAFFS_BLOCK_STATE_EMPTY)
+				continue;
+		} else if (state == YAFFS_BLOCK_STATE_NEEDS_SCANNING &&
+			   sequenceNumber == bi->sequenceNumber) {
+			/* Unchanged, but the allocation block may have grown */
+			if (blk == allocBlock) {
+				allocStart = dev->allocationPage;
+				blockIndex[nBlocksToScan].seq = sequenceNumber;
+				blockIndex[nBlocksToScan].block = blk;
+				nBlocksToScan++;
+			}
+			continue;
+		} else {
+			/* Erased since and maybe written again */
+			yaffs_ClearChunkBits(dev, blk);
+			bi->pagesInUse = 0;
+			bi->softDeletions = 0;
+			bi->hasShrinkHeader = 0;
+			bi->gcPrioritise = 0;
+			nErased++;
+		}
+
+		bi->blockState = YAFFS_BLOCK_STATE_EMPTY;
+		bi->sequenceNumber = sequenceNumber;
+		bi->skipErasedCheck = 0;
+
+		if (state == YAFFS_BLOCK_STATE_DEAD) {
+			bi->blockState = YAFFS_BLOCK_STATE_DEAD;
+		} else if (state == YAFFS_BLOCK_STATE_EMPTY) {
+			/* Nothing more to do */
+		} else if (sequenceNumber == YAFFS_SEQUENCE_CHECKPOINT_DATA) {
+			/* An increment that was cut short */
+			bi->blockState = YAFFS_BLOCK_STATE_CHECKPOINT;
+		} else if (sequenceNumber > checkpointSequence &&
+			   sequenceNumber < YAFFS_HIGHEST_SEQUENCE_NUMBER) {
+			blockIndex[nBlocksToScan].seq = sequenceNumber;
+			blockIndex[nBlocksToScan].block = blk;
+			nBlocksToScan++;
+		} else {
+			T(YAFFS_TRACE_SCAN,
+			  (TSTR("Block %d sequence %d is not newer than the checkpoint"
+			   TENDSTR), blk, sequenceNumber));
+			ok = 0;
+		}
+	}
+
+	/* Forget what was in the blocks erased since */
+	for (i = 0; ok && nErased > 0 && i < YAFFS_NOBJECT_BUCKETS; i++) {
+		ylist_for_each(lh, &dev->objectBucket[i].list) {
+			in = ylist_entry(lh, yaffs_Object, hashLink);
+			if (in->hdrChunk > 0 &&
+			    !yaffs_CheckChunkBit(dev,
+					in->hdrChunk / dev->nChunksPerBlock,
+					in->hdrChunk % dev->nChunksPerBlock)) {
+				/* Gone unless a newer header turns up */
+				in->hdrChunk = 0;
+				in->cpMark = 1;
+			}
+			if (in->variantType == YAFFS_OBJECT_TYPE_FILE)
+				yaffs_DropErasedChunksWorker(in,
+					in->variant.fileVariant.top,
+					in->variant.fileVariant.topLevel);
+		}
+	}
+
+	yaffs_qsort(blockIndex, nBlocksToScan, sizeof(yaffs_BlockIndex), ybicmp);
+
+	chunkData = yaffs_GetTempBuffer(dev, __LINE__);
+
+	dev->allocationBlock = -1;
+
+	/* Replay the blocks written since, oldest first */
+	for (i = 0; ok && i < nBlocksToScan; i++) {
+		YYIELD();
+
+		blk = blockIndex[i].block;
+		bi = yaffs_GetBlockInfo(dev, blk);
+		c = (blk == allocBlock) ? allocStart : 0;
+		lastUsed = c - 1;
+
+		if (bi->blockState != YAFFS_BLOCK_STATE_ALLOCATING)
+			bi->blockState = YAFFS_BLOCK_STATE_NEEDS_SCANNING;
+
+		for (; ok && c < dev->nChunksPerBlock; c++) {
+			chunk = blk * dev->nChunksPerBlock + c;
+
+			yaffs_ReadChunkWithTagsFromNAND(dev, chunk, NULL, &tags);
+
+			if (!tags.chunkUsed)
+				continue;
+
+			lastUsed = c;
+			if (tags.eccResult == YAFFS_ECC_RESULT_UNFIXED)
+				continue;
+
+			yaffs_SetChunkBit(dev, blk, c);
+			bi->pagesInUse++;
+
+			if (tags.chunkId > 0) {
+				/* A data chunk */
+				__u32 endpos = (tags.chunkId - 1) * dev->nDataBytesPerChunk +
+						tags.byteCount;
+
+				in = yaffs_FindOrCreateObjectByNumber(dev,
+						tags.objectId,
+						YAFFS_OBJECT_TYPE_FILE);
+				if (!in ||
+				    yaffs_PutChunkIntoFile(in, tags.chunkId, chunk, 1) != YAFFS_OK)
+					ok = 0;
+				else if (in->variantType == YAFFS_OBJECT_TYPE_FILE &&
+					 in->variant.fileVariant.fileSize < endpos)
+					in->variant.fileVariant.fileSize = endpos;
+			} else {
+				ok = yaffs_ReplayObjectHeader(dev, chunk,
+						tags.objectId, chunkData,
+						&hardList);
+			}
+		}
+
+		if (lastUsed >= 0 && (blk != allocBlock || lastUsed >= allocStart))
+			nReplayed++;
+
+		if (i == nBlocksToScan - 1 &&
+		    lastUsed < dev->nChunksPerBlock - 1) {
+			/* The newest block is the one to carry on allocating from */
+			bi->blockState = YAFFS_BLOCK_STATE_ALLOCATING;
+			dev->allocationBlock = blk;
+			dev->allocationPage = lastUsed + 1;
+			dev->allocationBlockFinder = blk;
+		} else {
+			if (lastUsed < dev->nChunksPerBlock - 1)
+				bi->gcPrioritise = 1;
+			bi->blockState = YAFFS_BLOCK_STATE_FULL;
+
+			if (bi->pagesInUse == 0 && !bi->hasShrinkHeader)
+				yaffs_BlockBecameDirty(dev, blk);
+		}
+
+		if (blockIndex[i].seq > dev->sequenceNumber)
+			dev->sequenceNumber = blockIndex[i].seq;
+	}
+
+	yaffs_ReleaseTempBuffer(dev, chunkData, __LINE__);
+
+	if (altBlockIndex)
+		YFREE_ALT(blockIndex);
+	else
+		YFREE(blockIndex);
+
+	if (ok)
+		yaffs_HardlinkFixup(dev, hardList);
+
+	/* Objects whose header was erased and not written again are gone */
+	for (i = 0; i < YAFFS_NOBJECT_BUCKETS; i++) {
+		ylist_for_each_safe(lh, n, &dev->objectBucket[i].list) {
+			in = ylist_entry(lh, yaffs_Object, hashLink);
+			if (!in->cpMark)
+				continue;
+
+			in->cpMark = 0;
+			if (!ok || in->hdrChunk > 0 || in->fake)
+				continue;
+
+			if (yaffs_IsNonEmptyDirectory(in) ||
+			    (in->variantType != YAFFS_OBJECT_TYPE_HARDLINK &&
+			     !ylist_empty(&in->hardLinks)))
+				ok = 0;
+			else
+				yaffs_AddObjectToDirectory(dev->deletedDir, in);
+		}
+	}
+
+	if (!ok)
+		return YAFFS_FAIL;
+
+	dev->nErasedBlocks = 0;
+	dev->blocksInCheckpoint = 0;
+	for (blk = dev->internalStartBlock; blk <= dev->internalEndBlock; blk++) {
+		bi = yaffs_GetBlockInfo(dev, blk);
+		if (bi->blockState == YAFFS_BLOCK_STATE_EMPTY)
+			dev->nErasedBlocks++;
+		else if (bi->blockState == YAFFS_BLOCK_STATE_CHECKPOINT)
+			dev->blocksInCheckpoint++;
+	}
+	dev->checkpointBlocksCounted = dev->blocksInCheckpoint;
+	dev->nFreeChunks = yaffs_CountFreeChunks(dev);
+	dev->oldestDirtySequence = 0;
+
+	if (nErased > 0 || nReplayed > 0)
+		dev->isCheckpointed = 0;
+	dev->mountReplayBlocks = nReplayed;
+
+	T(YAFFS_TRACE_SCAN,
+	  (TSTR("yaffs_ScanAfterCheckpoint replayed %d blocks, %d erased"
+	   TENDSTR), nReplayed, nErased));
+
+	return YAFFS_OK;
+}
+
 /*------------------------------  Directory Functions ----------------------------- */
 
 static void yaffs_VerifyObjectInDirectory(yaffs_Object *obj)
@@ -7291,6 +8258,8 @@ int yaffs_GutsInitialise(yaffs_Device *dev)
 	int init_failed = 0;
 	unsigned x;
 	int bits;
+	unsigned startMs = Y_CURRENT_MSEC;
+	unsigned phaseMs;
 
 	T(YAFFS_TRACE_TRACING, (TSTR("yaffs: yaffs_GutsInitialise()" TENDSTR)));
 
@@ -7301,6 +8270,17 @@ int yaffs_GutsInitialise(yaffs_Device *dev)
 		return YAFFS_FAIL;
 	}
 
+	dev->mountInitMs = 0;
+	dev->mountCheckpointMs = 0;
+	dev->mountScanMs = 0;
+	dev->mountFixupMs = 0;
+	dev->mountReplayMs = 0;
+	dev->mountTotalMs = 0;
+	dev->mountIncrements = 0;
+	dev->mountReplayBlocks = 0;
+	dev->checkpointIsBase = 0;
+	dev->checkpointCanAppend = 0;
+
 	dev->internalStartBlock = dev->startBlock;
 	dev->internalEndBlock = dev->endBlock;
 	dev->blockOffset = 0;
@@ -7465,11 +8445,13 @@ int yaffs_GutsInitialise(yaffs_Device *dev)
 	    dev->nShortOpCaches > 0) {
 		int i;
 		void *buf;
-		int srCacheBytes = dev->nShortOpCaches * sizeof(yaffs_ChunkCache);
+		int srCacheBytes;
 
 		if (dev->nShortOpCaches > YAFFS_MAX_SHORT_OP_CACHES)
 			dev->nShortOpCaches = YAFFS_MAX_SHORT_OP_CACHES;
 
+		srCacheBytes = dev->nShortOpCaches * sizeof(yaffs_ChunkCache);
+
 		dev->srCache =  YMALLOC(srCacheBytes);
 
 		buf = (__u8 *) dev->srCache;
@@ -7477,18 +8459,25 @@ int yaffs_GutsInitialise(yaffs_Device *dev)
 		if (dev->srCache)
 			memset(dev->srCache, 0, srCacheBytes);
 
+		YINIT_LIST_HEAD(&dev->srFreeCaches);
+		YINIT_LIST_HEAD(&dev->srLruCaches);
+		for (i = 0; i < YAFFS_NCACHE_BUCKETS; i++)
+			YINIT_LIST_HEAD(&dev->srCacheBucket[i]);
+
 		for (i = 0; i < dev->nShortOpCaches && buf; i++) {
 			dev->srCache[i].object = NULL;
-			dev->srCache[i].lastUse = 0;
 			dev->srCache[i].dirty = 0;
+			YINIT_LIST_HEAD(&dev->srCache[i].lruLink);
+			YINIT_LIST_HEAD(&dev->srCache[i].objLink);
+			ylist_add_tail(&dev->srCache[i].hashLink,
+					&dev->srFreeCaches);
 			dev->srCache[i].data = buf = YMALLOC_DMA(dev->totalBytesPerChunk);
 		}
 		if (!buf)
 			init_failed = 1;
-
-		dev->srLastUse = 0;
 	}
 
+	dev->srDirtyCaches = 0;
 	dev->cacheHits = 0;
 
 	if (!init_failed) {
@@ -7510,10 +8499,29 @@ int yaffs_GutsInitialise(yaffs_Device *dev)
 		init_failed = 1;
 
 
+	phaseMs = Y_CURRENT_MSEC;
+	dev->mountInitMs = phaseMs - startMs;
+
 	if (!init_failed) {
 		/* Now scan the flash. */
 		if (dev->isYaffs2) {
-			if (yaffs_CheckpointRestore(dev)) {
+			int restored = yaffs_CheckpointRestore(dev);
+
+			dev->mountCheckpointMs = Y_CURRENT_MSEC - phaseMs;
+			phaseMs = Y_CURRENT_MSEC;
+
+			if (restored) {
+				/* Catch up with anything written after it */
+				dev->checkpointIsBase = 1;
+				restored = yaffs_ScanAfterCheckpoint(dev);
+				if (!restored)
+					dev->checkpointIsBase = 0;
+
+				dev->mountReplayMs = Y_CURRENT_MSEC - phaseMs;
+				phaseMs = Y_CURRENT_MSEC;
+			}
+
+			if (restored) {
 				yaffs_CheckObjectDetailsLoaded(dev->rootDir);
 				T(YAFFS_TRACE_ALWAYS,
 				  (TSTR("yaffs: restored from checkpoint" TENDSTR)));
@@ -7551,10 +8559,15 @@ int yaffs_GutsInitialise(yaffs_Device *dev)
 		} else if (!yaffs_Scan(dev))
 				init_failed = 1;
 
+		dev->mountScanMs = Y_CURRENT_MSEC - phaseMs;
+		phaseMs = Y_CURRENT_MSEC;
+
 		yaffs_StripDeletedObjects(dev);
 		yaffs_FixHangingObjects(dev);
 		if(dev->emptyLostAndFound)
 			yaffs_EmptyLostAndFound(dev);
+
+		dev->mountFixupMs = Y_CURRENT_MSEC - phaseMs;
 	}
 
 	if (init_failed) {
@@ -7582,6 +8595,16 @@ int yaffs_GutsInitialise(yaffs_Device *dev)
 	if (!dev->isCheckpointed && dev->blocksInCheckpoint > 0)
 		yaffs_InvalidateCheckpoint(dev);
 
+	dev->mountTotalMs = Y_CURRENT_MSEC - startMs;
+
+	T(YAFFS_TRACE_ALWAYS,
+	  (TSTR("yaffs: mount took %u ms: init %u, checkpoint %u (%d increments), "
+	  "replay %u (%d blocks), scan %u, fixup %u" TENDSTR),
+	  dev->mountTotalMs, dev->mountInitMs,
+	  dev->mountCheckpointMs, dev->mountIncrements,
+	  dev->mountReplayMs, dev->mountReplayBlocks,
+	  dev->mountScanMs, dev->mountFixupMs));
+
 	T(YAFFS_TRACE_TRACING,
 	  (TSTR("yaffs: yaffs_GutsInitialise() done.\n" TENDSTR)));
 	return YAFFS_OK;
@@ -7654,9 +8677,7 @@ int yaffs_GetNumberOfFreeChunks(yaffs_Device *dev)
 	/* This is what we report to the outside world */
 
 	int nFree;
-	int nDirtyCacheChunks;
 	int blocksForCheckpoint;
-	int i;
 
 #if 1
 	nFree = dev->nFreeChunks;
@@ -7666,14 +8687,9 @@ int yaffs_GetNumberOfFreeChunks(yaffs_Device *dev)
 
 	nFree += dev->nDeletedFiles;
 
-	/* Now count the number of dirty chunks in the cache and subtract those */
-
-	for (nDirtyCacheChunks = 0, i = 0; i < dev->nShortOpCaches; i++) {
-		if (dev->srCache[i].dirty)
-			nDirtyCacheChunks++;
-	}
+	/* Now subtract the number of dirty chunks in the cache */
 
-	nFree -= nDirtyCacheChunks;
+	nFree -= dev->srDirtyCaches;
 
 	nFree -= ((dev->nReservedBlocks + 1) * dev->nChunksPerBlock);
 
@@ -63,7 +63,7 @@
 
 #define YAFFS_OBJECT_SPACE		0x40000
 
-#define YAFFS_CHECKPOINT_VERSION 	3
+#define YAFFS_CHECKPOINT_VERSION 	4
 
 #ifdef CONFIG_YAFFS_UNICODE
 #define YAFFS_MAX_NAME_LENGTH		127
@@ -88,7 +88,8 @@
 
 /* */
 
-#define YAFFS_MAX_SHORT_OP_CACHES	20
+#define YAFFS_MAX_SHORT_OP_CACHES	512
+#define YAFFS_NCACHE_BUCKETS		128
 
 #define YAFFS_N_TEMP_BUFFERS		6
 
@@ -115,10 +116,12 @@
 typedef struct {
 	struct yaffs_ObjectStruct *object;
 	int chunkId;
-	int lastUse;
 	int dirty;
 	int nBytes;		/* Only valid if the cache is dirty */
 	int locked;		/* Can't push out or flush while locked. */
+	struct ylist_head hashLink;	/* (object, chunkId) bucket, or the free list */
+	struct ylist_head lruLink;	/* Least recently used first */
+	struct ylist_head objLink;	/* The object's cached chunks, dirty ones first */
 #ifdef CONFIG_YAFFS_YAFFS2
 	__u8 *data;
 #else
@@ -425,9 +428,11 @@ struct yaffs_ObjectStruct {
 				 */
 	__u8 beingCreated:1;	/* This object is still being created so skip some checks. */
 	__u8 isShadowed:1;      /* This object is shadowed on the way to being renamed. */
+	__u8 cpMark:1;		/* Scratch flag for checkpoint increments and replay */
 
 	__u8 serial;		/* serial number of chunk in NAND. Cached here */
 	__u16 sum;		/* sum of the name to speed searching */
+	__u32 cpSum;		/* Digest of the object as last checkpointed, 0 if never */
 
 	struct yaffs_DeviceStruct *myDev;       /* The device I'm on */
 
@@ -435,6 +440,8 @@ struct yaffs_ObjectStruct {
 
 	struct ylist_head hardLinks;    /* all the equivalent hard linked objects */
 
+	struct ylist_head cachedChunks; /* short op cache entries, dirty ones first */
+
 	/* directory structure stuff */
 	/* also used for linking up the free list */
 	struct yaffs_ObjectStruct *parent;
@@ -590,6 +597,9 @@ struct yaffs_DeviceStruct {
 	int (*markNANDBlockBad) (struct yaffs_DeviceStruct *dev, int blockNo);
 	int (*queryNANDBlock) (struct yaffs_DeviceStruct *dev, int blockNo,
 			       yaffs_BlockState *state, __u32 *sequenceNumber);
+	/* Optional: read the data of nChunks consecutive chunks, no tags */
+	int (*readChunksFromNAND) (struct yaffs_DeviceStruct *dev,
+				   int chunkInNAND, int nChunks, __u8 *data);
 #endif
 
 	int isYaffs2;
@@ -644,6 +654,7 @@ struct yaffs_DeviceStruct {
 				 */
 	void (*putSuperFunc) (struct super_block *sb);
         struct ylist_head searchContexts;
+	__u8 *readPagesBuffer;	/* Bounce buffer for readpages */
 
 #endif
 
@@ -651,6 +662,20 @@ struct yaffs_DeviceStruct {
 
 	int isCheckpointed;
 
+	/* How long the last mount took, in milliseconds, broken down by phase */
+	unsigned mountInitMs;		/* Setting up blocks, tnodes and objects */
+	unsigned mountCheckpointMs;	/* Trying to restore the checkpoint */
+	unsigned mountScanMs;		/* Scanning NAND, zero if the checkpoint was used */
+	unsigned mountFixupMs;		/* Stripping deleted and fixing hanging objects */
+	unsigned mountReplayMs;		/* Replaying blocks written after the checkpoint */
+	unsigned mountTotalMs;
+	int mountIncrements;		/* Checkpoint increments applied */
+	int mountReplayBlocks;		/* Blocks replayed on top of the checkpoint */
+
+	/* Periodic checkpointing state, maintained by the OS glue */
+	int checkpointPageWrites;	/* nPageWrites when last polled */
+	unsigned long checkpointTime;	/* When the checkpoint was last saved */
+
 
 	/* Stuff to support block offsetting to support start block zero */
 	int internalStartBlock;
@@ -676,6 +701,12 @@ struct yaffs_DeviceStruct {
 
 	int nCheckpointBlocksRequired; /* Number of blocks needed to store current checkpoint set */
 
+	/* Incremental checkpointing */
+	int checkpointIsBase;		/* The checkpoint on NAND is kept when written past */
+	int checkpointCanAppend;	/* An increment can be added to the checkpoint */
+	int checkpointBlocksCounted;	/* Checkpoint blocks taken out of nErasedBlocks */
+	int checkpointIncrements;	/* Increments since the last full checkpoint */
+
 	/* Block Info */
 	yaffs_BlockInfo *blockInfo;
 	__u8 *chunkBits;	/* bitmap of chunks in use */
@@ -720,6 +751,7 @@ struct yaffs_DeviceStruct {
 	/* Statistcs */
 	int nPageWrites;
 	int nPageReads;
+	int nMultiChunkReads;
 	int nBlockErasures;
 	int nErasureFailures;
 	int nGCCopies;
@@ -749,7 +781,10 @@ struct yaffs_DeviceStruct {
 	int doingBufferedBlockRewrite;
 
 	yaffs_ChunkCache *srCache;
-	int srLastUse;
+	struct ylist_head srCacheBucket[YAFFS_NCACHE_BUCKETS];
+	struct ylist_head srFreeCaches;	/* Unused cache entries */
+	struct ylist_head srLruCaches;	/* In use cache entries, least recently used first */
+	int srDirtyCaches;		/* Number of dirty cache entries */
 
 	int cacheHits;
 
@@ -816,6 +851,18 @@ typedef struct {
 	__u32 head;
 } yaffs_CheckpointValidity;
 
+/* Each increment appended to a checkpoint starts with this. It is followed by
+ * the device and block state, the ids of all objects, the objects that
+ * changed since the previous increment and a checksum.
+ */
+typedef struct {
+	int structType;
+	__u32 magic;
+	__u32 version;
+	__u32 blocksCounted;	/* Checkpoint blocks already out of the free counts */
+	__u32 nObjects;		/* Object ids that follow the block state */
+} yaffs_CheckpointIncrement;
+
 
 /*----------------------- YAFFS Functions -----------------------*/
 
@@ -842,6 +889,8 @@ int yaffs_GetAttributes(yaffs_Object *obj, struct iattr *attr);
 /* File operations */
 int yaffs_ReadDataFromFile(yaffs_Object *obj, __u8 *buffer, loff_t offset,
 				int nBytes);
+int yaffs_ReadChunksFromFile(yaffs_Object *obj, __u8 *buffer, loff_t offset,
+			int nBytes);
 int yaffs_WriteDataToFile(yaffs_Object *obj, const __u8 *buffer, loff_t offset,
 				int nBytes, int writeThrough);
 int yaffs_ResizeFile(yaffs_Object *obj, loff_t newSize);
@@ -187,6 +187,32 @@ int nandmtd2_ReadChunkWithTagsFromNAND(yaffs_Device *dev, int chunkInNAND,
 		return YAFFS_FAIL;
 }
 
+int nandmtd2_ReadChunksFromNAND(yaffs_Device *dev, int chunkInNAND,
+				int nChunks, __u8 *data)
+{
+	struct mtd_info *mtd = (struct mtd_info *)(dev->genericDevice);
+	loff_t addr = ((loff_t) chunkInNAND) * dev->totalBytesPerChunk;
+	size_t len = nChunks * dev->totalBytesPerChunk;
+	size_t retlen = 0;
+	int retval;
+
+	T(YAFFS_TRACE_MTD,
+	  (TSTR("nandmtd2_ReadChunksFromNAND chunk %d count %d data %p"
+	    TENDSTR), chunkInNAND, nChunks, data));
+
+	/* Chunks carrying inband tags are not contiguous file data */
+	if (dev->inbandTags)
+		return YAFFS_FAIL;
+
+	retval = mtd->read(mtd, addr, len, &retlen, data);
+
+	/* Leave any ECC trouble to the chunk by chunk path */
+	if (retval == 0 && retlen == len)
+		return YAFFS_OK;
+	else
+		return YAFFS_FAIL;
+}
+
 int nandmtd2_MarkNANDBlockBad(struct yaffs_DeviceStruct *dev, int blockNo)
 {
 	struct mtd_info *mtd = (struct mtd_info *)(dev->genericDevice);
@@ -53,6 +53,35 @@ int yaffs_ReadChunkWithTagsFromNAND(yaffs_Device *dev, int chunkInNAND,
 	return result;
 }
 
+/* Read the data of nChunks consecutive chunks in one go if the device can,
+ * else (or if that fails) chunk by chunk so that ECC problems get handled
+ * the normal way.
+ */
+int yaffs_ReadChunksFromNAND(yaffs_Device *dev, int chunkInNAND,
+				int nChunks, __u8 *buffer)
+{
+	int result = YAFFS_OK;
+	int i;
+
+	if (nChunks > 1 && dev->readChunksFromNAND) {
+		dev->nMultiChunkReads++;
+		if (dev->readChunksFromNAND(dev, chunkInNAND - dev->chunkOffset,
+					nChunks, buffer) == YAFFS_OK) {
+			dev->nPageReads += nChunks;
+			return YAFFS_OK;
+		}
+	}
+
+	for (i = 0; i < nChunks; i++) {
+		if (yaffs_ReadChunkWithTagsFromNAND(dev, chunkInNAND + i,
+				buffer + i * dev->nDataBytesPerChunk,
+				NULL) != YAFFS_OK)
+			result = YAFFS_FAIL;
+	}
+
+	return result;
+}
+
 int yaffs_WriteChunkWithTagsToNAND(yaffs_Device *dev,
 						   int chunkInNAND,
 						   const __u8 *buffer,
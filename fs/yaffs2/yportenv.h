@@ -85,6 +85,9 @@
 #define Y_TIME_CONVERT(x) (x)
 #endif
 
+/* Millisecond clock, only used for timing */
+#define Y_CURRENT_MSEC jiffies_to_msecs(jiffies)
+
 #define yaffs_SumCompare(x, y) ((x) == (y))
 #define yaffs_strcmp(a, b) strcmp(a, b)
 
@@ -158,6 +161,10 @@
 
 #endif
 
+#ifndef Y_CURRENT_MSEC
+#define Y_CURRENT_MSEC 0
+#endif
+
 /* see yaffs_fs.c */
 extern unsigned int yaffs_traceMask;
 extern unsigned int yaffs_wr_attempts;
@@ -608,15 +608,20 @@
   	*(.initcall5.init)						\
   	*(.initcall5s.init)						\
 	*(.initcallrootfs.init)						\
+	VMLINUX_SYMBOL(__initcall6_start) = .;				\
   	*(.initcall6.init)						\
   	*(.initcall6s.init)						\
+	VMLINUX_SYMBOL(__initcall7_start) = .;				\
   	*(.initcall7.init)						\
   	*(.initcall7s.init)
 
 #define INIT_CALLS							\
 		VMLINUX_SYMBOL(__initcall_start) = .;			\
 		INITCALLS						\
-		VMLINUX_SYMBOL(__initcall_end) = .;
+		VMLINUX_SYMBOL(__initcall_end) = .;			\
+		VMLINUX_SYMBOL(__parallel_initcall_start) = .;		\
+		*(.initcallparallel.init)				\
+		VMLINUX_SYMBOL(__parallel_initcall_end) = .;
 
 #define CON_INITCALL							\
 		VMLINUX_SYMBOL(__con_initcall_start) = .;		\
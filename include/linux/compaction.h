@@ -18,10 +18,15 @@ extern int sysctl_compaction_handler(struct ctl_table *table, int write,
 extern int sysctl_extfrag_threshold;
 extern int sysctl_extfrag_handler(struct ctl_table *table, int write,
 			void __user *buffer, size_t *length, loff_t *ppos);
+extern int sysctl_compact_daemon_order;
+extern int sysctl_compact_daemon_centisecs;
+extern int sysctl_compact_daemon_cpu_percent;
 
 extern int fragmentation_index(struct zone *zone, unsigned int order);
 extern unsigned long try_to_compact_pages(struct zonelist *zonelist,
 			int order, gfp_t gfp_mask, nodemask_t *mask);
+extern void wakeup_kcompactd(struct zone *zone, int order);
+extern void wakeup_kcompactd_node(pg_data_t *pgdat);
 
 /* Do not skip compaction more than 64 times */
 #define COMPACT_MAX_DEFER_SHIFT 6
@@ -59,6 +64,14 @@ static inline unsigned long try_to_compact_pages(struct zonelist *zonelist,
 	return COMPACT_CONTINUE;
 }
 
+static inline void wakeup_kcompactd(struct zone *zone, int order)
+{
+}
+
+static inline void wakeup_kcompactd_node(pg_data_t *pgdat)
+{
+}
+
 static inline void defer_compaction(struct zone *zone)
 {
 }
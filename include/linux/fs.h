@@ -898,6 +898,9 @@ struct file_ra_state {
 
 	unsigned int ra_pages;		/* Maximum readahead window */
 	unsigned int mmap_miss;		/* Cache miss stat for mmap accesses */
+	unsigned short ra_hit;		/* Decaying count of readahead pages
+					   used, for adaptive readahead */
+	unsigned short ra_miss;		/* ... and of those left unused */
 	loff_t prev_pos;		/* Cache last read() position */
 };
 
@@ -1367,6 +1370,11 @@ struct super_block {
 	   Cannot be worse than a second */
 	u32		   s_time_gran;
 
+	/*
+	 * Indicates how deep in a filesystem stack this SB is
+	 */
+	int s_stack_depth;
+
 	/*
 	 * The next field is for VFS *only*. No filesystems have any business
 	 * even looking at it. You had been warned.
@@ -1386,6 +1394,12 @@ struct super_block {
 	char *s_options;
 };
 
+/*
+ * Maximum number of layers of fs stack.  Needs to be limited to
+ * prevent kernel stack overflow
+ */
+#define FILESYSTEM_MAX_STACK_DEPTH 2
+
 extern struct timespec current_fs_time(struct super_block *sb);
 
 /*
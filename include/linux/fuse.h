@@ -37,12 +37,18 @@
  *
  * 7.14
  *  - add splice support to fuse device
+ *  - add FUSE_WRITEBACK_CACHE and FUSE_MAX_PAGES init flags and the
+ *    max_pages field of fuse_init_out; the INIT reply is variable length,
+ *    so servers that send the shorter reply are unaffected
+ *  - add FUSE_PASSTHROUGH init flag, the passthrough_fh field of
+ *    fuse_open_out (formerly padding) and FUSE_DEV_IOC_PASSTHROUGH_OPEN
  */
 
 #ifndef _LINUX_FUSE_H
 #define _LINUX_FUSE_H
 
 #include <linux/types.h>
+#include <linux/ioctl.h>
 
 /*
  * Version negotiation:
@@ -145,6 +151,9 @@ struct fuse_file_lock {
  *
  * FUSE_EXPORT_SUPPORT: filesystem handles lookups of "." and ".."
  * FUSE_DONT_MASK: don't apply umask to file mode on create operations
+ * FUSE_WRITEBACK_CACHE: use writeback cache for buffered writes
+ * FUSE_MAX_PAGES: init_out.max_pages contains the max number of req pages
+ * FUSE_PASSTHROUGH: open_out.passthrough_fh may name a backing file
  */
 #define FUSE_ASYNC_READ		(1 << 0)
 #define FUSE_POSIX_LOCKS	(1 << 1)
@@ -153,6 +162,9 @@ struct fuse_file_lock {
 #define FUSE_EXPORT_SUPPORT	(1 << 4)
 #define FUSE_BIG_WRITES		(1 << 5)
 #define FUSE_DONT_MASK		(1 << 6)
+#define FUSE_WRITEBACK_CACHE	(1 << 16)
+#define FUSE_MAX_PAGES		(1 << 22)
+#define FUSE_PASSTHROUGH	(1 << 31)
 
 /**
  * CUSE INIT request/reply flags
@@ -354,7 +366,7 @@ struct fuse_create_in {
 struct fuse_open_out {
 	__u64	fh;
 	__u32	open_flags;
-	__u32	padding;
+	__u32	passthrough_fh;
 };
 
 struct fuse_release_in {
@@ -457,6 +469,9 @@ struct fuse_init_out {
 	__u16   max_background;
 	__u16   congestion_threshold;
 	__u32	max_write;
+	__u32	reserved;
+	__u16	max_pages;
+	__u16	padding;
 };
 
 #define CUSE_INIT_INFO_MAX 4096
@@ -568,4 +583,14 @@ struct fuse_notify_inval_entry_out {
 	__u32	padding;
 };
 
+/*
+ * Device ioctls
+ *
+ * FUSE_DEV_IOC_PASSTHROUGH_OPEN: register the file descriptor pointed to
+ * by the argument as a backing file; returns the id to put in
+ * fuse_open_out.passthrough_fh
+ */
+#define FUSE_DEV_IOC_MAGIC		229
+#define FUSE_DEV_IOC_PASSTHROUGH_OPEN	_IOW(FUSE_DEV_IOC_MAGIC, 126, __u32)
+
 #endif /* _LINUX_FUSE_H */
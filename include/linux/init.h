@@ -151,6 +151,32 @@ extern void (*late_time_init)(void);
 
 extern int initcall_debug;
 
+/*
+ * An initcall that may run alongside the other device initcalls, once
+ * those it depends on, named by function, have returned.
+ */
+struct parallel_initcall {
+	initcall_t fn;
+	const char *name;
+	const char **deps;
+	int nr_deps;
+};
+
+#ifdef CONFIG_PARALLEL_INITCALLS
+/* Defined in init/parallel_initcalls.c */
+extern void parallel_initcalls_start(void);
+extern void parallel_initcalls_wait(void);
+extern void *initcall_event_start(initcall_t fn);
+extern void initcall_event_end(void *event, int result);
+extern void initcall_timeline_close(void);
+#else
+static inline void parallel_initcalls_start(void) { }
+static inline void parallel_initcalls_wait(void) { }
+static inline void *initcall_event_start(initcall_t fn) { return 0; }
+static inline void initcall_event_end(void *event, int result) { }
+static inline void initcall_timeline_close(void) { }
+#endif
+
 #endif
   
 #ifndef MODULE
@@ -204,6 +230,29 @@ extern int initcall_debug;
 
 #define __initcall(fn) device_initcall(fn)
 
+/*
+ * parallel_initcall(fn, deps...) - a device initcall that does not care
+ * about running in link order.  It is started on a worker thread when
+ * the device initcalls begin, after the initcalls named in deps (other
+ * parallel initcalls, as strings) have returned, and all of them have
+ * returned before the late initcalls.
+ */
+#ifdef CONFIG_PARALLEL_INITCALLS
+#define parallel_initcall(initfn, ...)					\
+	static const char *__parallel_initcall_deps_##initfn[] __initdata = \
+		{ __VA_ARGS__ };					\
+	static struct parallel_initcall __parallel_initcall_##initfn __used \
+	__attribute__((__section__(".initcallparallel.init"))) = {	\
+		.fn	 = initfn,					\
+		.name	 = #initfn,					\
+		.deps	 = __parallel_initcall_deps_##initfn,		\
+		.nr_deps = sizeof(__parallel_initcall_deps_##initfn) /	\
+			   sizeof(__parallel_initcall_deps_##initfn[0]),\
+	}
+#else
+#define parallel_initcall(fn, ...)	device_initcall(fn)
+#endif
+
 #define __exitcall(fn) \
 	static exitcall_t __exitcall_##fn __exit_call = fn
 
@@ -281,6 +330,7 @@ void __init parse_early_options(char *cmdline);
 #define fs_initcall(fn)			module_init(fn)
 #define device_initcall(fn)		module_init(fn)
 #define late_initcall(fn)		module_init(fn)
+#define parallel_initcall(fn, ...)	module_init(fn)
 
 #define security_initcall(fn)		module_init(fn)
 
@@ -988,6 +988,21 @@ static inline void sync_mm_rss(struct task_struct *task, struct mm_struct *mm)
 }
 #endif
 
+#ifdef CONFIG_VMSCAN_STATS
+/*
+ * Direct reclaim latencies, in power of 2 microsecond buckets, the last
+ * one collecting everything from about a quarter of a second up.
+ */
+#define RECLAIM_LATENCY_BUCKETS 20
+
+struct reclaim_latency {
+	unsigned long count;
+	u64 total_ns;
+	u64 max_ns;
+	unsigned long hist[RECLAIM_LATENCY_BUCKETS];
+};
+#endif
+
 /*
  * A callback you can register to apply pressure to ageable caches.
  *
@@ -1010,6 +1025,9 @@ struct shrinker {
 	/* These are for internal use */
 	struct list_head list;
 	long nr;	/* objs pending delete */
+#ifdef CONFIG_VMSCAN_STATS
+	struct reclaim_latency latency;	/* of calls in direct reclaim */
+#endif
 };
 #define DEFAULT_SEEKS 2 /* A good number if you don't know better. */
 extern void register_shrinker(struct shrinker *);
@@ -1330,6 +1348,7 @@ void page_cache_async_readahead(struct address_space *mapping,
 				unsigned long size);
 
 unsigned long max_sane_readahead(unsigned long nr);
+extern int sysctl_readahead_adaptive;
 unsigned long ra_submit(struct file_ra_state *ra,
 			struct address_space *mapping,
 			struct file *filp);
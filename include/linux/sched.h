@@ -1179,6 +1179,20 @@ struct sched_rt_entity {
 
 struct rcu_node;
 
+#ifdef CONFIG_SCHED_BFS_SKIPLIST
+#define BFS_SL_LEVELS	8
+
+/* A task's place on the BFS per cpu run queue skip lists */
+struct bfs_sl_node {
+	u64 value;	/* deadline, or queueing order for realtime tasks */
+	int class;	/* prio for realtime tasks, MAX_RT_PRIO otherwise */
+	int levels;	/* levels the node is linked on */
+	int cpu;	/* cpu whose list the task is queued on */
+	struct bfs_sl_node *next[BFS_SL_LEVELS];
+	struct bfs_sl_node *prev[BFS_SL_LEVELS];	/* prev[0] NULL if not queued */
+};
+#endif
+
 struct task_struct {
 	volatile long state;	/* -1 unrunnable, 0 runnable, >0 stopped */
 	void *stack;
@@ -1207,6 +1221,9 @@ struct task_struct {
 	int time_slice;
 	u64 deadline;
 	struct list_head run_list;
+#ifdef CONFIG_SCHED_BFS_SKIPLIST
+	struct bfs_sl_node sl_node;
+#endif
 	u64 last_ran;
 	u64 sched_time; /* sched_clock time spent running */
 #ifdef CONFIG_SMP
@@ -1541,6 +1558,19 @@ struct task_struct {
 #ifdef CONFIG_SCHED_BFS
 extern bool grunqueue_is_locked(void);
 extern void grq_unlock_wait(void);
+#ifdef CONFIG_SCHED_BFS_LOCKSTAT
+/* Global runqueue lock statistics, see /proc/grq_lockstat */
+struct grq_lockstat {
+	unsigned long long acquired;	/* times grq.lock was taken */
+	unsigned long long contended;	/* of which had to spin first */
+	u64 wait_ns;			/* total time spent spinning */
+	u64 hold_ns;			/* total time it was held */
+	u64 max_hold_ns;		/* longest single hold */
+};
+
+extern void grq_lockstat_read(struct grq_lockstat *stat);
+extern void grq_lockstat_reset(void);
+#endif
 extern void cpu_scaling(int cpu);
 extern void cpu_nonscaling(int cpu);
 #define tsk_seruntime(t)		((t)->sched_time)
@@ -2031,11 +2061,21 @@ extern unsigned int sysctl_sched_compat_yield;
 
 #ifdef CONFIG_SCHED_AUTOGROUP
 extern unsigned int sysctl_sched_autogroup_enabled;
+extern int sysctl_sched_autogroup_bg_oom_adj;
+#ifdef CONFIG_CFS_BANDWIDTH
+extern int sysctl_sched_autogroup_bg_period_us;
+extern int sysctl_sched_autogroup_bg_quota_us;
+
+int sched_autogroup_bandwidth_handler(struct ctl_table *table, int write,
+		void __user *buffer, size_t *lenp,
+		loff_t *ppos);
+#endif
 
 extern void sched_autogroup_create_attach(struct task_struct *p);
 extern void sched_autogroup_detach(struct task_struct *p);
 extern void sched_autogroup_fork(struct signal_struct *sig);
 extern void sched_autogroup_exit(struct signal_struct *sig);
+extern void sched_autogroup_oom_adj(struct task_struct *p);
 #ifdef CONFIG_PROC_FS
 extern void proc_sched_autogroup_show_task(struct task_struct *p, struct seq_file *m);
 extern int proc_sched_autogroup_set_nice(struct task_struct *p, int *nice);
@@ -2045,6 +2085,7 @@ static inline void sched_autogroup_create_attach(struct task_struct *p) { }
 static inline void sched_autogroup_detach(struct task_struct *p) { }
 static inline void sched_autogroup_fork(struct signal_struct *sig) { }
 static inline void sched_autogroup_exit(struct signal_struct *sig) { }
+static inline void sched_autogroup_oom_adj(struct task_struct *p) { }
 #endif
 
 #ifdef CONFIG_RT_MUTEXES
@@ -2609,6 +2650,13 @@ extern void sched_move_task(struct task_struct *tsk);
 extern int sched_group_set_shares(struct task_group *tg, unsigned long shares);
 extern unsigned long sched_group_shares(struct task_group *tg);
 #endif
+#ifdef CONFIG_CFS_BANDWIDTH
+extern int sched_group_set_cfs_quota(struct task_group *tg, long cfs_quota_us);
+extern long sched_group_cfs_quota(struct task_group *tg);
+extern int sched_group_set_cfs_period(struct task_group *tg,
+				      long cfs_period_us);
+extern long sched_group_cfs_period(struct task_group *tg);
+#endif
 #ifdef CONFIG_RT_GROUP_SCHED
 extern int sched_group_set_rt_runtime(struct task_group *tg,
 				      long rt_runtime_us);
@@ -0,0 +1,198 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM vmscan
+
+#if !defined(_TRACE_VMSCAN_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_VMSCAN_H
+
+#include <linux/types.h>
+#include <linux/tracepoint.h>
+#include <linux/mm.h>
+
+/**
+ * mm_vmscan_direct_reclaim_begin - an allocation starts direct reclaim
+ * @order:		order of the allocation
+ * @may_writepage:	whether reclaim may write dirty pages
+ * @gfp_flags:		GFP flags of the allocation
+ */
+TRACE_EVENT(mm_vmscan_direct_reclaim_begin,
+
+	TP_PROTO(int order, int may_writepage, gfp_t gfp_flags),
+
+	TP_ARGS(order, may_writepage, gfp_flags),
+
+	TP_STRUCT__entry(
+		__field(	int,	order		)
+		__field(	int,	may_writepage	)
+		__field(	gfp_t,	gfp_flags	)
+	),
+
+	TP_fast_assign(
+		__entry->order		= order;
+		__entry->may_writepage	= may_writepage;
+		__entry->gfp_flags	= gfp_flags;
+	),
+
+	TP_printk("order=%d may_writepage=%d gfp_flags=%#x",
+		__entry->order,
+		__entry->may_writepage,
+		__entry->gfp_flags)
+);
+
+/**
+ * mm_vmscan_direct_reclaim_end - direct reclaim is done
+ * @nr_reclaimed:	pages reclaimed
+ * @delta_ns:		time it took
+ */
+TRACE_EVENT(mm_vmscan_direct_reclaim_end,
+
+	TP_PROTO(unsigned long nr_reclaimed, u64 delta_ns),
+
+	TP_ARGS(nr_reclaimed, delta_ns),
+
+	TP_STRUCT__entry(
+		__field(	unsigned long,	nr_reclaimed	)
+		__field(	u64,		delta_ns	)
+	),
+
+	TP_fast_assign(
+		__entry->nr_reclaimed	= nr_reclaimed;
+		__entry->delta_ns	= delta_ns;
+	),
+
+	TP_printk("nr_reclaimed=%lu delta_ns=%llu",
+		__entry->nr_reclaimed,
+		(unsigned long long)__entry->delta_ns)
+);
+
+/**
+ * mm_vmscan_shrink_zone - the LRU lists of a zone were scanned
+ * @zone:		the zone
+ * @priority:		scanning priority, lower scans more
+ * @nr_reclaimed:	pages reclaimed
+ * @delta_ns:		time it took
+ */
+TRACE_EVENT(mm_vmscan_shrink_zone,
+
+	TP_PROTO(struct zone *zone, int priority, unsigned long nr_reclaimed,
+		 u64 delta_ns),
+
+	TP_ARGS(zone, priority, nr_reclaimed, delta_ns),
+
+	TP_STRUCT__entry(
+		__field(	int,		nid		)
+		__field(	int,		zid		)
+		__field(	int,		priority	)
+		__field(	unsigned long,	nr_reclaimed	)
+		__field(	u64,		delta_ns	)
+	),
+
+	TP_fast_assign(
+		__entry->nid		= zone_to_nid(zone);
+		__entry->zid		= zone_idx(zone);
+		__entry->priority	= priority;
+		__entry->nr_reclaimed	= nr_reclaimed;
+		__entry->delta_ns	= delta_ns;
+	),
+
+	TP_printk("nid=%d zid=%d priority=%d nr_reclaimed=%lu delta_ns=%llu",
+		__entry->nid,
+		__entry->zid,
+		__entry->priority,
+		__entry->nr_reclaimed,
+		(unsigned long long)__entry->delta_ns)
+);
+
+/**
+ * mm_vmscan_shrink_slab - a shrinker was called
+ * @shrinker:		the shrinker
+ * @nr_scanned:		objects it was asked to scan
+ * @nr_freed:		objects it freed
+ * @delta_ns:		time it took, counting its calls to size the cache
+ */
+TRACE_EVENT(mm_vmscan_shrink_slab,
+
+	TP_PROTO(struct shrinker *shrinker, unsigned long nr_scanned,
+		 unsigned long nr_freed, u64 delta_ns),
+
+	TP_ARGS(shrinker, nr_scanned, nr_freed, delta_ns),
+
+	TP_STRUCT__entry(
+		__field(	void *,		shrink		)
+		__field(	unsigned long,	nr_scanned	)
+		__field(	unsigned long,	nr_freed	)
+		__field(	u64,		delta_ns	)
+	),
+
+	TP_fast_assign(
+		__entry->shrink		= shrinker->shrink;
+		__entry->nr_scanned	= nr_scanned;
+		__entry->nr_freed	= nr_freed;
+		__entry->delta_ns	= delta_ns;
+	),
+
+	TP_printk("shrinker=%pf nr_scanned=%lu nr_freed=%lu delta_ns=%llu",
+		__entry->shrink,
+		__entry->nr_scanned,
+		__entry->nr_freed,
+		(unsigned long long)__entry->delta_ns)
+);
+
+/**
+ * mm_vmscan_pageout - reclaim wrote a dirty page
+ * @page:		the page
+ * @result:		the pageout_t result
+ * @delta_ns:		time it took
+ */
+TRACE_EVENT(mm_vmscan_pageout,
+
+	TP_PROTO(struct page *page, int result, u64 delta_ns),
+
+	TP_ARGS(page, result, delta_ns),
+
+	TP_STRUCT__entry(
+		__field(	unsigned long,	pfn		)
+		__field(	int,		result		)
+		__field(	u64,		delta_ns	)
+	),
+
+	TP_fast_assign(
+		__entry->pfn		= page_to_pfn(page);
+		__entry->result		= result;
+		__entry->delta_ns	= delta_ns;
+	),
+
+	TP_printk("pfn=%lu result=%s delta_ns=%llu",
+		__entry->pfn,
+		__print_symbolic(__entry->result,
+				 { 0, "keep" },
+				 { 1, "activate" },
+				 { 2, "success" },
+				 { 3, "clean" }),
+		(unsigned long long)__entry->delta_ns)
+);
+
+/**
+ * mm_vmscan_congestion_wait - reclaim waited for writeback
+ * @delta_ns:		time it waited
+ */
+TRACE_EVENT(mm_vmscan_congestion_wait,
+
+	TP_PROTO(u64 delta_ns),
+
+	TP_ARGS(delta_ns),
+
+	TP_STRUCT__entry(
+		__field(	u64,		delta_ns	)
+	),
+
+	TP_fast_assign(
+		__entry->delta_ns	= delta_ns;
+	),
+
+	TP_printk("delta_ns=%llu", (unsigned long long)__entry->delta_ns)
+);
+
+#endif /* _TRACE_VMSCAN_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
@@ -8,6 +8,8 @@
 #include <linux/dirent.h>
 #include <linux/syscalls.h>
 #include <linux/utime.h>
+#include <linux/async.h>
+#include <linux/ktime.h>
 
 static __initdata char *message;
 static void __init error(char *x)
@@ -374,6 +376,8 @@ static __initdata int (*actions[])(void) = {
 	[Reset]		= do_reset,
 };
 
+static __initdata unsigned long unpacked_bytes;
+
 static int __init write_buffer(char *buf, unsigned len)
 {
 	count = len;
@@ -381,6 +385,7 @@ static int __init write_buffer(char *buf, unsigned len)
 
 	while (!actions[state]())
 		;
+	unpacked_bytes += len - count;
 	return len - count;
 }
 
@@ -416,6 +421,10 @@ static char * __init unpack_to_rootfs(char *buf, unsigned len)
 	int written, res;
 	decompress_fn decompress;
 	const char *compress_name;
+	const char *method = "cpio";
+	unsigned in_len = len;
+	ktime_t start = ktime_get();
+	s64 us;
 	static __initdata char msg_buf[64];
 
 	header_buf = kmalloc(110, GFP_KERNEL);
@@ -428,6 +437,7 @@ static char * __init unpack_to_rootfs(char *buf, unsigned len)
 	state = Start;
 	this_header = 0;
 	message = NULL;
+	unpacked_bytes = 0;
 	while (!message && len) {
 		loff_t saved_offset = this_header;
 		if (*buf == '0' && !(this_header & 3)) {
@@ -446,6 +456,7 @@ static char * __init unpack_to_rootfs(char *buf, unsigned len)
 		this_header = 0;
 		decompress = decompress_method(buf, len, &compress_name);
 		if (decompress) {
+			method = compress_name;
 			res = decompress(buf, len, NULL, flush_buffer, NULL,
 				   &my_inptr, error);
 			if (res)
@@ -469,6 +480,12 @@ static char * __init unpack_to_rootfs(char *buf, unsigned len)
 	kfree(name_buf);
 	kfree(symlink_buf);
 	kfree(header_buf);
+
+	us = ktime_to_us(ktime_sub(ktime_get(), start));
+	printk(KERN_INFO "initramfs: unpacked %lu KiB from %u KiB of %s "
+	       "in %lld us, %llu KiB/s\n", unpacked_bytes >> 10, in_len >> 10,
+	       method, us, div64_u64((u64)unpacked_bytes * USEC_PER_SEC,
+				     max_t(s64, us, 1)) >> 10);
 	return message;
 }
 
@@ -568,7 +585,23 @@ static void __init clean_rootfs(void)
 }
 #endif
 
-static int __init populate_rootfs(void)
+/*
+ * The rootfs is populated asynchronously, alongside the device
+ * initcalls.  Anything that looks at files before init runs has to
+ * call wait_for_initramfs() first.
+ */
+static int initramfs_async = 1;
+static int __init initramfs_async_setup(char *str)
+{
+	initramfs_async = simple_strtol(str, NULL, 0) != 0;
+	return 1;
+}
+__setup("initramfs_async=", initramfs_async_setup);
+
+static LIST_HEAD(initramfs_domain);
+static int initramfs_done;
+
+static void __init do_populate_rootfs(void)
 {
 	char *err = unpack_to_rootfs(__initramfs_start,
 			 __initramfs_end - __initramfs_start);
@@ -582,7 +615,7 @@ static int __init populate_rootfs(void)
 			initrd_end - initrd_start);
 		if (!err) {
 			free_initrd();
-			return 0;
+			return;
 		} else {
 			clean_rootfs();
 			unpack_to_rootfs(__initramfs_start,
@@ -606,6 +639,41 @@ static int __init populate_rootfs(void)
 		free_initrd();
 #endif
 	}
+}
+
+static void __init async_populate_rootfs(void *unused, async_cookie_t cookie)
+{
+	do_populate_rootfs();
+	printk(KERN_INFO "initramfs: rootfs ready %lld us after boot\n",
+	       ktime_to_us(ktime_get()));
+	initramfs_done = 1;
+}
+
+/*
+ * Wait until the rootfs is populated.  Free to call from any context
+ * once it is, which callers can't tell, so only sleeping ones may.
+ */
+void wait_for_initramfs(void)
+{
+	ktime_t start;
+
+	if (initramfs_done)
+		return;
+
+	start = ktime_get();
+	async_synchronize_full_domain(&initramfs_domain);
+	printk(KERN_INFO "initramfs: %pS waited %lld us for the rootfs\n",
+	       __builtin_return_address(0),
+	       ktime_to_us(ktime_sub(ktime_get(), start)));
+}
+
+static int __init populate_rootfs(void)
+{
+	if (initramfs_async)
+		async_schedule_domain(async_populate_rootfs, NULL,
+				      &initramfs_domain);
+	else
+		async_populate_rootfs(NULL, 0);
 	return 0;
 }
 rootfs_initcall(populate_rootfs);
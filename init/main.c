@@ -849,14 +849,15 @@ static void __init do_ctors(void)
 int initcall_debug;
 core_param(initcall_debug, initcall_debug, bool, 0644);
 
-static char msgbuf[64];
-static struct boot_trace_call call;
-static struct boot_trace_ret ret;
-
 int do_one_initcall(initcall_t fn)
 {
+	/* Not static, initcalls may run in parallel */
+	char msgbuf[64];
+	struct boot_trace_call call;
+	struct boot_trace_ret ret;
 	int count = preempt_count();
 	ktime_t calltime, delta, rettime;
+	void *event;
 
 	if (initcall_debug) {
 		call.caller = task_pid_nr(current);
@@ -866,7 +867,9 @@ int do_one_initcall(initcall_t fn)
 		enable_boot_trace();
 	}
 
+	event = initcall_event_start(fn);
 	ret.result = fn();
+	initcall_event_end(event, ret.result);
 
 	if (initcall_debug) {
 		disable_boot_trace();
@@ -900,13 +903,21 @@ int do_one_initcall(initcall_t fn)
 
 
 extern initcall_t __initcall_start[], __initcall_end[], __early_initcall_end[];
+extern initcall_t __initcall6_start[], __initcall7_start[];
 
 static void __init do_initcalls(void)
 {
 	initcall_t *fn;
 
-	for (fn = __early_initcall_end; fn < __initcall_end; fn++)
+	for (fn = __early_initcall_end; fn < __initcall_end; fn++) {
+		if (fn == __initcall6_start)
+			parallel_initcalls_start();
+		if (fn == __initcall7_start)
+			parallel_initcalls_wait();
 		do_one_initcall(*fn);
+	}
+	parallel_initcalls_wait();
+	initcall_timeline_close();
 
 	/* Make sure there is no pending stuff from the initcall sequence */
 	flush_scheduled_work();
@@ -1027,6 +1038,9 @@ static int __init kernel_init(void * unused)
 
 	do_basic_setup();
 
+	/* The initramfs is unpacked alongside the initcalls */
+	wait_for_initramfs();
+
 	/* Open the /dev/console on the rootfs, this should never fail */
 	if (sys_open((const char __user *) "/dev/console", O_RDWR, 0) < 0)
 		printk(KERN_WARNING "Warning: unable to open an initial console.\n");
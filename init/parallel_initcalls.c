@@ -0,0 +1,331 @@
+/*
+ * init/parallel_initcalls.c
+ *
+ * Runs the initcalls declared with parallel_initcall() on a pool of
+ * kernel threads, each once the initcalls it depends on have returned,
+ * and keeps a timeline of all the initcalls of the boot for debugfs.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/sched.h>
+#include <linux/kthread.h>
+#include <linux/mutex.h>
+#include <linux/wait.h>
+#include <linux/slab.h>
+#include <linux/ktime.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/err.h>
+
+extern struct parallel_initcall __parallel_initcall_start[],
+	__parallel_initcall_end[];
+extern initcall_t __initcall_start[], __initcall_end[];
+
+static int initcall_threads = 4;
+core_param(initcall_threads, initcall_threads, int, 0444);
+
+enum {
+	PARALLEL_PENDING,
+	PARALLEL_RUNNING,
+	PARALLEL_DONE,
+};
+
+/*
+ * Scheduling state, protected by parallel_lock.  parallel_gen changes
+ * whenever an initcall returns or a worker exits, which is what waiters
+ * wait for.  parallel_workers counts the worker threads which may still
+ * look at parallel_state.
+ */
+static DEFINE_MUTEX(parallel_lock);
+static DECLARE_WAIT_QUEUE_HEAD(parallel_wait);
+static int *parallel_state;
+static int parallel_total, parallel_running, parallel_done;
+static int parallel_workers;
+static unsigned long parallel_gen;
+static int parallel_started;
+
+static struct parallel_initcall *parallel_find(const char *name)
+{
+	struct parallel_initcall *pc;
+
+	for (pc = __parallel_initcall_start; pc < __parallel_initcall_end; pc++)
+		if (!strcmp(pc->name, name))
+			return pc;
+	return NULL;
+}
+
+static int parallel_ready(struct parallel_initcall *pc)
+{
+	int i;
+
+	for (i = 0; i < pc->nr_deps; i++) {
+		struct parallel_initcall *dep = parallel_find(pc->deps[i]);
+
+		if (dep && parallel_state[dep - __parallel_initcall_start] !=
+		    PARALLEL_DONE)
+			return 0;
+	}
+	return 1;
+}
+
+/*
+ * Picks the next initcall whose dependencies have all returned, waiting
+ * for running ones if need be.  Returns NULL when none is left.
+ */
+static struct parallel_initcall *parallel_next(void)
+{
+	struct parallel_initcall *pc, *found;
+	unsigned long gen;
+
+	mutex_lock(&parallel_lock);
+	for (;;) {
+		struct parallel_initcall *first = NULL;
+
+		found = NULL;
+		for (pc = __parallel_initcall_start;
+		     pc < __parallel_initcall_end; pc++) {
+			if (parallel_state[pc - __parallel_initcall_start] !=
+			    PARALLEL_PENDING)
+				continue;
+			if (!first)
+				first = pc;
+			if (parallel_ready(pc)) {
+				found = pc;
+				break;
+			}
+		}
+		if (found || !first)
+			break;
+		if (!parallel_running) {
+			printk(KERN_WARNING "initcall: dependency cycle, "
+			       "running %s anyway\n", first->name);
+			found = first;
+			break;
+		}
+
+		gen = parallel_gen;
+		mutex_unlock(&parallel_lock);
+		wait_event(parallel_wait, ACCESS_ONCE(parallel_gen) != gen);
+		mutex_lock(&parallel_lock);
+	}
+	if (found) {
+		parallel_state[found - __parallel_initcall_start] =
+			PARALLEL_RUNNING;
+		parallel_running++;
+	}
+	mutex_unlock(&parallel_lock);
+	return found;
+}
+
+static void parallel_complete(struct parallel_initcall *pc)
+{
+	mutex_lock(&parallel_lock);
+	parallel_state[pc - __parallel_initcall_start] = PARALLEL_DONE;
+	parallel_running--;
+	parallel_done++;
+	parallel_gen++;
+	mutex_unlock(&parallel_lock);
+	wake_up_all(&parallel_wait);
+}
+
+static void parallel_run(void)
+{
+	struct parallel_initcall *pc;
+
+	while ((pc = parallel_next()) != NULL) {
+		do_one_initcall(pc->fn);
+		parallel_complete(pc);
+	}
+}
+
+/*
+ * Not __init: a worker is still on its way out, after it has dropped out
+ * of parallel_workers, when init memory may be freed.
+ */
+static int parallel_worker(void *unused)
+{
+	parallel_run();
+
+	mutex_lock(&parallel_lock);
+	parallel_workers--;
+	parallel_gen++;
+	mutex_unlock(&parallel_lock);
+	wake_up_all(&parallel_wait);
+	return 0;
+}
+
+void __init parallel_initcalls_start(void)
+{
+	struct parallel_initcall *pc;
+	int i, threads;
+
+	if (parallel_started)
+		return;
+	parallel_started = 1;
+
+	parallel_total = __parallel_initcall_end - __parallel_initcall_start;
+	if (!parallel_total)
+		return;
+
+	parallel_state = kcalloc(parallel_total, sizeof(*parallel_state),
+				 GFP_KERNEL);
+	if (!parallel_state)
+		panic("can't allocate parallel initcall state");
+
+	for (pc = __parallel_initcall_start; pc < __parallel_initcall_end; pc++)
+		for (i = 0; i < pc->nr_deps; i++)
+			if (!parallel_find(pc->deps[i]))
+				printk(KERN_WARNING "initcall: %s depends on "
+				       "%s, which is not a parallel initcall\n",
+				       pc->name, pc->deps[i]);
+
+	/* The rest is left to the init thread in parallel_initcalls_wait() */
+	threads = min(initcall_threads, parallel_total);
+	for (i = 0; i < threads; i++) {
+		struct task_struct *p;
+
+		mutex_lock(&parallel_lock);
+		parallel_workers++;
+		mutex_unlock(&parallel_lock);
+
+		p = kthread_run(parallel_worker, NULL, "kinitcall/%d", i);
+		if (IS_ERR(p)) {
+			printk(KERN_WARNING "initcall: cannot start worker %d\n",
+			       i);
+			mutex_lock(&parallel_lock);
+			parallel_workers--;
+			mutex_unlock(&parallel_lock);
+			break;
+		}
+	}
+}
+
+void __init parallel_initcalls_wait(void)
+{
+	parallel_initcalls_start();
+	if (!parallel_total)
+		return;
+
+	/*
+	 * Lend a hand, then wait for the ones still running, and for the
+	 * workers to stop looking at parallel_state and the initcall table.
+	 */
+	parallel_run();
+	wait_event(parallel_wait, ACCESS_ONCE(parallel_done) == parallel_total &&
+		   !ACCESS_ONCE(parallel_workers));
+
+	kfree(parallel_state);
+	parallel_state = NULL;
+	parallel_total = 0;
+}
+
+/*
+ * The timeline.  Events are claimed with an atomic index, so initcalls
+ * may start and end concurrently; it stops recording once the boot
+ * initcalls are over.
+ */
+struct initcall_event {
+	initcall_t fn;
+	s64 start;
+	s64 end;
+	pid_t pid;
+	int start_cpu;
+	int end_cpu;
+	int result;
+};
+
+static struct initcall_event *initcall_events;
+static int initcall_events_max;
+static atomic_t initcall_events_nr = ATOMIC_INIT(0);
+static int initcall_timeline_closed;
+
+void *initcall_event_start(initcall_t fn)
+{
+	struct initcall_event *event;
+	int i;
+
+	if (initcall_timeline_closed)
+		return NULL;
+
+	if (!initcall_events) {
+		/* The boot initcalls and the parallel ones, once */
+		initcall_events_max = (__initcall_end - __initcall_start) +
+			(__parallel_initcall_end - __parallel_initcall_start);
+		initcall_events = kcalloc(initcall_events_max,
+					  sizeof(*initcall_events), GFP_KERNEL);
+		if (!initcall_events) {
+			initcall_timeline_closed = 1;
+			return NULL;
+		}
+	}
+
+	i = atomic_inc_return(&initcall_events_nr) - 1;
+	if (i >= initcall_events_max)
+		return NULL;
+
+	event = &initcall_events[i];
+	event->fn = fn;
+	event->pid = task_pid_nr(current);
+	event->start_cpu = raw_smp_processor_id();
+	event->start = ktime_to_ns(ktime_get());
+	return event;
+}
+
+void initcall_event_end(void *data, int result)
+{
+	struct initcall_event *event = data;
+
+	if (!event)
+		return;
+	event->end = ktime_to_ns(ktime_get());
+	event->end_cpu = raw_smp_processor_id();
+	event->result = result;
+}
+
+#ifdef CONFIG_DEBUG_FS
+static int initcall_timeline_show(struct seq_file *m, void *v)
+{
+	int i, nr = min(atomic_read(&initcall_events_nr), initcall_events_max);
+
+	seq_printf(m, "# start_us end_us duration_us cpus pid result initcall\n");
+	for (i = 0; i < nr; i++) {
+		struct initcall_event *event = &initcall_events[i];
+
+		seq_printf(m, "%lld %lld %lld %d-%d %d %d %pF\n",
+			   div_s64(event->start, NSEC_PER_USEC),
+			   div_s64(event->end, NSEC_PER_USEC),
+			   div_s64(event->end - event->start, NSEC_PER_USEC),
+			   event->start_cpu, event->end_cpu, event->pid,
+			   event->result, event->fn);
+	}
+	return 0;
+}
+
+static int initcall_timeline_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, initcall_timeline_show, NULL);
+}
+
+static const struct file_operations initcall_timeline_fops = {
+	.open		= initcall_timeline_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+#endif
+
+void __init initcall_timeline_close(void)
+{
+	initcall_timeline_closed = 1;
+#ifdef CONFIG_DEBUG_FS
+	if (initcall_events)
+		debugfs_create_file("initcall_timeline", S_IRUGO, NULL, NULL,
+				    &initcall_timeline_fops);
+#endif
+}
@@ -37,6 +37,7 @@
 #include <linux/ratelimit.h>
 #include <linux/kmsg_dump.h>
 #include <linux/syslog.h>
+#include <linux/workqueue.h>
 
 #include <asm/uaccess.h>
 
@@ -143,6 +144,39 @@ EXPORT_SYMBOL(console_set_on_cmdline);
 /* Flag: console code may call schedule() */
 static int console_may_schedule;
 
+/* Work for printk_tick() */
+static DEFINE_PER_CPU(int, printk_pending);
+#define PRINTK_PENDING_KLOGD	0x01
+#define PRINTK_PENDING_CONSOLE	0x02
+
+#ifdef CONFIG_PRINTK_DEFERRED_CONSOLE
+/* Writes out the log buffer when printk() left it to it */
+static void console_flush_fn(struct work_struct *work)
+{
+	/*
+	 * While the consoles are suspended this takes and drops
+	 * console_sem without writing anything; resume_console()
+	 * writes out the backlog.
+	 */
+	acquire_console_sem();
+	release_console_sem();
+}
+static DECLARE_WORK(console_flush_work, console_flush_fn);
+
+/*
+ * console_flush_work runs on its own thread: on keventd a slow console
+ * would hold up every other work item queued behind it.
+ */
+static struct workqueue_struct *console_flush_wq;
+
+static int __init console_flush_init(void)
+{
+	console_flush_wq = create_singlethread_workqueue("kconsoled");
+	return console_flush_wq ? 0 : -ENOMEM;
+}
+core_initcall(console_flush_init);
+#endif
+
 #define MAX_CHARS_PER_RELEASE_LOOP 128
 
 #ifdef CONFIG_PRINTK
@@ -698,7 +732,7 @@ static int have_callable_console(void)
 
 asmlinkage int printk(const char *fmt, ...)
 {
-#if 0
+#ifdef CONFIG_PRINTK_MESSAGES
 	va_list args;
 	int r;
 
@@ -776,6 +810,36 @@ static char printk_buf[1024];
 
 int printk_delay_msec __read_mostly;
 
+#ifdef CONFIG_PRINTK_DEFERRED_CONSOLE
+static int printk_deferred = 1;
+module_param_named(deferred, printk_deferred, bool, S_IRUGO | S_IWUSR);
+
+/*
+ * Leave the consoles to kconsoled?  Not while oopsing, the thread may
+ * never run again, nor when going down, it may not run before the end.
+ */
+static inline int printk_defer_console(void)
+{
+	return printk_deferred && console_flush_wq && !oops_in_progress &&
+		system_state == SYSTEM_RUNNING;
+}
+
+/*
+ * Deferred messages are formatted on the printing cpu's own buffer
+ * before logbuf_lock is taken, so the lock only covers the copy into
+ * log_buf. printk_formatting catches printk() recursing meanwhile.
+ */
+static DEFINE_PER_CPU(char[sizeof(printk_buf)], printk_cpu_buf);
+static DEFINE_PER_CPU(int, printk_formatting);
+#define printk_formatting_here()	__get_cpu_var(printk_formatting)
+#else
+static inline int printk_defer_console(void)
+{
+	return 0;
+}
+#define printk_formatting_here()	0
+#endif
+
 static inline void printk_delay(void)
 {
 	if (unlikely(printk_delay_msec)) {
@@ -790,11 +854,17 @@ static inline void printk_delay(void)
 
 asmlinkage int vprintk(const char *fmt, va_list args)
 {
-#if 0
+	/*
+	 * printk() is compiled out in this tree unless CONFIG_PRINTK_MESSAGES
+	 * is set; writing the consoles from the caller was too slow.
+	 */
+#ifdef CONFIG_PRINTK_MESSAGES
 	int printed_len = 0;
 	int current_log_level = default_message_loglevel;
 	unsigned long flags;
 	int this_cpu;
+	int defer;
+	char *buf = printk_buf;
 	char *p;
 
 	boot_delay_msec();
@@ -808,7 +878,7 @@ asmlinkage int vprintk(const char *fmt, va_list args)
 	/*
 	 * Ouch, printk recursed into itself!
 	 */
-	if (unlikely(printk_cpu == this_cpu)) {
+	if (unlikely(printk_cpu == this_cpu || printk_formatting_here())) {
 		/*
 		 * If a crash is occurring during printk() on this CPU,
 		 * then try to get the crash message out but make sure
@@ -823,24 +893,37 @@ asmlinkage int vprintk(const char *fmt, va_list args)
 		zap_locks();
 	}
 
+	/* The recursion message goes out through printk_buf */
+	defer = printk_defer_console() && !recursion_bug;
+#ifdef CONFIG_PRINTK_DEFERRED_CONSOLE
+	if (defer) {
+		buf = __get_cpu_var(printk_cpu_buf);
+		__get_cpu_var(printk_formatting) = 1;
+		printed_len = vscnprintf(buf, sizeof(printk_buf), fmt, args);
+		__get_cpu_var(printk_formatting) = 0;
+	}
+#endif
+
 	lockdep_off();
 	spin_lock(&logbuf_lock);
 	printk_cpu = this_cpu;
 
-	if (recursion_bug) {
-		recursion_bug = 0;
-		strcpy(printk_buf, recursion_bug_msg);
-		printed_len = strlen(recursion_bug_msg);
+	if (!defer) {
+		if (recursion_bug) {
+			recursion_bug = 0;
+			strcpy(printk_buf, recursion_bug_msg);
+			printed_len = strlen(recursion_bug_msg);
+		}
+		/* Emit the output into the temporary buffer */
+		printed_len += vscnprintf(printk_buf + printed_len,
+				sizeof(printk_buf) - printed_len, fmt, args);
 	}
-	/* Emit the output into the temporary buffer */
-	printed_len += vscnprintf(printk_buf + printed_len,
-				  sizeof(printk_buf) - printed_len, fmt, args);
 
 #ifdef	CONFIG_DEBUG_LL
-	printascii(printk_buf);
+	printascii(buf);
 #endif
 
-	p = printk_buf;
+	p = buf;
 
 	/* Do we have a loglevel in the string? */
 	if (p[0] == '<') {
@@ -912,8 +995,16 @@ asmlinkage int vprintk(const char *fmt, va_list args)
 	 * The acquire_console_semaphore_for_printk() function
 	 * will release 'logbuf_lock' regardless of whether it
 	 * actually gets the semaphore or not.
+	 *
+	 * In deferred mode kconsoled does that instead. Its work is
+	 * queued from printk_tick(), as the runqueue lock may be held
+	 * here.
 	 */
-	if (acquire_console_semaphore_for_printk(this_cpu))
+	if (defer) {
+		printk_cpu = UINT_MAX;
+		spin_unlock(&logbuf_lock);
+		__raw_get_cpu_var(printk_pending) |= PRINTK_PENDING_CONSOLE;
+	} else if (acquire_console_semaphore_for_printk(this_cpu))
 		release_console_sem();
 
 	lockdep_on();
@@ -1078,6 +1169,11 @@ void suspend_console(void)
 		return;
 	printk("Suspending console(s) (use no_console_suspend to debug)\n");
 	acquire_console_sem();
+#ifdef CONFIG_PRINTK_DEFERRED_CONSOLE
+	/* Write out what kconsoled has not got to yet */
+	release_console_sem();
+	acquire_console_sem();
+#endif
 	console_suspended = 1;
 	up(&console_sem);
 }
@@ -1129,13 +1225,18 @@ int is_console_locked(void)
 	return console_locked;
 }
 
-static DEFINE_PER_CPU(int, printk_pending);
-
 void printk_tick(void)
 {
-	if (__get_cpu_var(printk_pending)) {
+	int pending = __get_cpu_var(printk_pending);
+
+	if (pending) {
 		__get_cpu_var(printk_pending) = 0;
-		wake_up_interruptible(&log_wait);
+		if (pending & PRINTK_PENDING_KLOGD)
+			wake_up_interruptible(&log_wait);
+#ifdef CONFIG_PRINTK_DEFERRED_CONSOLE
+		if (pending & PRINTK_PENDING_CONSOLE)
+			queue_work(console_flush_wq, &console_flush_work);
+#endif
 	}
 }
 
@@ -1147,7 +1248,7 @@ int printk_needs_cpu(int cpu)
 void wake_up_klogd(void)
 {
 	if (waitqueue_active(&log_wait))
-		__raw_get_cpu_var(printk_pending) = 1;
+		__raw_get_cpu_var(printk_pending) |= PRINTK_PENDING_KLOGD;
 }
 
 /**
@@ -233,6 +233,95 @@ static void destroy_rt_bandwidth(struct rt_bandwidth *rt_b)
 }
 #endif
 
+#ifdef CONFIG_CFS_BANDWIDTH
+/*
+ * CFS group bandwidth. Like the RT group runtime it is enforced per
+ * cpu: each of the group's cfs_rqs may run for 'quota' every 'period'
+ * and is throttled until the next period once it has used that up.
+ */
+struct cfs_bandwidth {
+	/* nests inside the rq lock: */
+	raw_spinlock_t		lock;
+	ktime_t			period;
+	u64			quota;
+	struct hrtimer		period_timer;
+
+	/* statistics, see cpu.stat */
+	u64			nr_periods;
+	u64			nr_throttled;
+	u64			throttled_time;
+};
+
+static int do_sched_cfs_period_timer(struct cfs_bandwidth *cfs_b, int overrun);
+
+static enum hrtimer_restart sched_cfs_period_timer(struct hrtimer *timer)
+{
+	struct cfs_bandwidth *cfs_b =
+		container_of(timer, struct cfs_bandwidth, period_timer);
+	ktime_t now;
+	int overrun;
+	int idle = 0;
+
+	for (;;) {
+		now = hrtimer_cb_get_time(timer);
+		overrun = hrtimer_forward(timer, now, cfs_b->period);
+
+		if (!overrun)
+			break;
+
+		idle = do_sched_cfs_period_timer(cfs_b, overrun);
+	}
+
+	return idle ? HRTIMER_NORESTART : HRTIMER_RESTART;
+}
+
+/* Default period of a newly created group: 100ms */
+#define DEF_CFS_PERIOD		(100 * NSEC_PER_MSEC)
+
+static void init_cfs_bandwidth(struct cfs_bandwidth *cfs_b)
+{
+	raw_spin_lock_init(&cfs_b->lock);
+	cfs_b->period = ns_to_ktime(DEF_CFS_PERIOD);
+	cfs_b->quota = RUNTIME_INF;
+
+	hrtimer_init(&cfs_b->period_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	cfs_b->period_timer.function = sched_cfs_period_timer;
+}
+
+/* Called with the rq lock held, once the group starts using runtime */
+static void start_cfs_bandwidth(struct cfs_bandwidth *cfs_b)
+{
+	ktime_t now;
+
+	if (hrtimer_active(&cfs_b->period_timer))
+		return;
+
+	raw_spin_lock(&cfs_b->lock);
+	for (;;) {
+		unsigned long delta;
+		ktime_t soft, hard;
+
+		if (hrtimer_active(&cfs_b->period_timer))
+			break;
+
+		now = hrtimer_cb_get_time(&cfs_b->period_timer);
+		hrtimer_forward(&cfs_b->period_timer, now, cfs_b->period);
+
+		soft = hrtimer_get_softexpires(&cfs_b->period_timer);
+		hard = hrtimer_get_expires(&cfs_b->period_timer);
+		delta = ktime_to_ns(ktime_sub(hard, soft));
+		__hrtimer_start_range_ns(&cfs_b->period_timer, soft, delta,
+				HRTIMER_MODE_ABS_PINNED, 0);
+	}
+	raw_spin_unlock(&cfs_b->lock);
+}
+
+static void destroy_cfs_bandwidth(struct cfs_bandwidth *cfs_b)
+{
+	hrtimer_cancel(&cfs_b->period_timer);
+}
+#endif /* CONFIG_CFS_BANDWIDTH */
+
 /*
  * sched_domains_mutex serializes calls to arch_init_sched_domains,
  * detach_destroy_domains and partition_sched_domains.
@@ -259,6 +348,10 @@ struct task_group {
 	unsigned long shares;
 #endif
 
+#ifdef CONFIG_CFS_BANDWIDTH
+	struct cfs_bandwidth cfs_bandwidth;
+#endif
+
 #ifdef CONFIG_RT_GROUP_SCHED
 	struct sched_rt_entity **rt_se;
 	struct rt_rq **rt_rq;
@@ -377,6 +470,17 @@ struct cfs_rq {
 	 */
 	unsigned long rq_weight;
 #endif
+
+#ifdef CONFIG_CFS_BANDWIDTH
+	/*
+	 * runtime is this cpu's copy of tg->cfs_bandwidth.quota, runtime_used
+	 * what has been run of it in the current period.
+	 */
+	u64 runtime;
+	u64 runtime_used;
+	u64 throttled_at;
+	int throttled;
+#endif
 #endif
 };
 
@@ -7538,6 +7642,9 @@ static void init_cfs_rq(struct cfs_rq *cfs_rq, struct rq *rq)
 	INIT_LIST_HEAD(&cfs_rq->tasks);
 #ifdef CONFIG_FAIR_GROUP_SCHED
 	cfs_rq->rq = rq;
+#endif
+#ifdef CONFIG_CFS_BANDWIDTH
+	cfs_rq->runtime = RUNTIME_INF;
 #endif
 	cfs_rq->min_vruntime = (u64)(-(1LL << 20));
 }
@@ -7707,6 +7814,10 @@ void __init sched_init(void)
 			global_rt_period(), global_rt_runtime());
 #endif /* CONFIG_RT_GROUP_SCHED */
 
+#ifdef CONFIG_CFS_BANDWIDTH
+	init_cfs_bandwidth(&init_task_group.cfs_bandwidth);
+#endif
+
 #ifdef CONFIG_CGROUP_SCHED
 	list_add(&init_task_group.list, &task_groups);
 	INIT_LIST_HEAD(&init_task_group.children);
@@ -8005,6 +8116,10 @@ static void free_fair_sched_group(struct task_group *tg)
 {
 	int i;
 
+#ifdef CONFIG_CFS_BANDWIDTH
+	destroy_cfs_bandwidth(&tg->cfs_bandwidth);
+#endif
+
 	for_each_possible_cpu(i) {
 		if (tg->cfs_rq)
 			kfree(tg->cfs_rq[i]);
@@ -8024,6 +8139,11 @@ int alloc_fair_sched_group(struct task_group *tg, struct task_group *parent)
 	struct rq *rq;
 	int i;
 
+#ifdef CONFIG_CFS_BANDWIDTH
+	/* before anything can fail: free_fair_sched_group() cancels it */
+	init_cfs_bandwidth(&tg->cfs_bandwidth);
+#endif
+
 	tg->cfs_rq = kzalloc(sizeof(cfs_rq) * nr_cpu_ids, GFP_KERNEL);
 	if (!tg->cfs_rq)
 		goto err;
@@ -8384,6 +8504,102 @@ unsigned long sched_group_shares(struct task_group *tg)
 }
 #endif
 
+#ifdef CONFIG_CFS_BANDWIDTH
+static DEFINE_MUTEX(cfs_constraints_mutex);
+
+/* Periods shorter than a tick or longer than a second make little sense */
+static const u64 min_cfs_period = NSEC_PER_MSEC;
+static const u64 max_cfs_period = NSEC_PER_SEC;
+
+static int tg_set_cfs_bandwidth(struct task_group *tg, u64 period, u64 quota)
+{
+	struct cfs_bandwidth *cfs_b = &tg->cfs_bandwidth;
+	int i;
+
+	/*
+	 * The root group's tasks are queued directly on rq->cfs, there is
+	 * no group entity to throttle.
+	 */
+	if (tg == &root_task_group)
+		return -EINVAL;
+
+	if (period < min_cfs_period || period > max_cfs_period)
+		return -EINVAL;
+
+	if (quota != RUNTIME_INF && quota < min_cfs_period)
+		return -EINVAL;
+
+	mutex_lock(&cfs_constraints_mutex);
+	raw_spin_lock_irq(&cfs_b->lock);
+	cfs_b->period = ns_to_ktime(period);
+	cfs_b->quota = quota;
+	raw_spin_unlock_irq(&cfs_b->lock);
+
+	for_each_possible_cpu(i) {
+		struct cfs_rq *cfs_rq = tg->cfs_rq[i];
+		struct rq *rq = rq_of(cfs_rq);
+
+		raw_spin_lock_irq(&rq->lock);
+		cfs_rq->runtime = quota;
+		cfs_rq->runtime_used = 0;
+		if (cfs_rq_throttled(cfs_rq)) {
+			update_rq_clock(rq);
+			unthrottle_cfs_rq(cfs_rq);
+		}
+		raw_spin_unlock_irq(&rq->lock);
+	}
+	mutex_unlock(&cfs_constraints_mutex);
+
+	return 0;
+}
+
+int sched_group_set_cfs_quota(struct task_group *tg, long cfs_quota_us)
+{
+	u64 quota, period;
+
+	period = ktime_to_ns(tg->cfs_bandwidth.period);
+	quota = (u64)cfs_quota_us * NSEC_PER_USEC;
+	if (cfs_quota_us < 0)
+		quota = RUNTIME_INF;
+
+	return tg_set_cfs_bandwidth(tg, period, quota);
+}
+
+long sched_group_cfs_quota(struct task_group *tg)
+{
+	u64 quota_us;
+
+	if (tg->cfs_bandwidth.quota == RUNTIME_INF)
+		return -1;
+
+	quota_us = tg->cfs_bandwidth.quota;
+	do_div(quota_us, NSEC_PER_USEC);
+	return quota_us;
+}
+
+int sched_group_set_cfs_period(struct task_group *tg, long cfs_period_us)
+{
+	u64 quota, period;
+
+	if (cfs_period_us <= 0)
+		return -EINVAL;
+
+	period = (u64)cfs_period_us * NSEC_PER_USEC;
+	quota = tg->cfs_bandwidth.quota;
+
+	return tg_set_cfs_bandwidth(tg, period, quota);
+}
+
+long sched_group_cfs_period(struct task_group *tg)
+{
+	u64 period_us;
+
+	period_us = ktime_to_ns(tg->cfs_bandwidth.period);
+	do_div(period_us, NSEC_PER_USEC);
+	return period_us;
+}
+#endif /* CONFIG_CFS_BANDWIDTH */
+
 #ifdef CONFIG_RT_GROUP_SCHED
 /*
  * Ensure that the real time constraints are schedulable.
@@ -8766,6 +8982,49 @@ static u64 cpu_shares_read_u64(struct cgroup *cgrp, struct cftype *cft)
 }
 #endif /* CONFIG_FAIR_GROUP_SCHED */
 
+#ifdef CONFIG_CFS_BANDWIDTH
+static int cpu_cfs_quota_write_s64(struct cgroup *cgrp, struct cftype *cftype,
+				   s64 cfs_quota_us)
+{
+	return sched_group_set_cfs_quota(cgroup_tg(cgrp), cfs_quota_us);
+}
+
+static s64 cpu_cfs_quota_read_s64(struct cgroup *cgrp, struct cftype *cft)
+{
+	return sched_group_cfs_quota(cgroup_tg(cgrp));
+}
+
+static int cpu_cfs_period_write_u64(struct cgroup *cgrp, struct cftype *cftype,
+				    u64 cfs_period_us)
+{
+	return sched_group_set_cfs_period(cgroup_tg(cgrp), cfs_period_us);
+}
+
+static u64 cpu_cfs_period_read_u64(struct cgroup *cgrp, struct cftype *cft)
+{
+	return sched_group_cfs_period(cgroup_tg(cgrp));
+}
+
+static int cpu_stats_show(struct cgroup *cgrp, struct cftype *cft,
+			  struct cgroup_map_cb *cb)
+{
+	struct cfs_bandwidth *cfs_b = &cgroup_tg(cgrp)->cfs_bandwidth;
+	u64 nr_periods, nr_throttled, throttled_time;
+
+	raw_spin_lock_irq(&cfs_b->lock);
+	nr_periods = cfs_b->nr_periods;
+	nr_throttled = cfs_b->nr_throttled;
+	throttled_time = cfs_b->throttled_time;
+	raw_spin_unlock_irq(&cfs_b->lock);
+
+	cb->fill(cb, "nr_periods", nr_periods);
+	cb->fill(cb, "nr_throttled", nr_throttled);
+	cb->fill(cb, "throttled_time", throttled_time);
+
+	return 0;
+}
+#endif /* CONFIG_CFS_BANDWIDTH */
+
 #ifdef CONFIG_RT_GROUP_SCHED
 static int cpu_rt_runtime_write(struct cgroup *cgrp, struct cftype *cft,
 				s64 val)
@@ -8798,6 +9057,22 @@ static struct cftype cpu_files[] = {
 		.write_u64 = cpu_shares_write_u64,
 	},
 #endif
+#ifdef CONFIG_CFS_BANDWIDTH
+	{
+		.name = "cfs_quota_us",
+		.read_s64 = cpu_cfs_quota_read_s64,
+		.write_s64 = cpu_cfs_quota_write_s64,
+	},
+	{
+		.name = "cfs_period_us",
+		.read_u64 = cpu_cfs_period_read_u64,
+		.write_u64 = cpu_cfs_period_write_u64,
+	},
+	{
+		.name = "stat",
+		.read_map = cpu_stats_show,
+	},
+#endif
 #ifdef CONFIG_RT_GROUP_SCHED
 	{
 		.name = "rt_runtime_us",
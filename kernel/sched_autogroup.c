@@ -5,10 +5,27 @@
 #include <linux/kallsyms.h>
 #include <linux/utsname.h>
 
-unsigned int __read_mostly sysctl_sched_autogroup_enabled = 1;
+unsigned int __read_mostly sysctl_sched_autogroup_enabled = AUTOGROUP_SESSION;
 static struct autogroup autogroup_default;
 static atomic_t autogroup_seq_nr;
 
+/*
+ * In AUTOGROUP_OOM_ADJ mode processes are not grouped by session but by
+ * importance: those whose oom_adj is at least sysctl_sched_autogroup_bg_oom_adj
+ * (background services and hidden apps, on Android) share one background
+ * group with a low weight and, with CONFIG_CFS_BANDWIDTH, a hard cap of
+ * sysctl_sched_autogroup_bg_quota_us every sysctl_sched_autogroup_bg_period_us.
+ * Everything else stays in the default group.
+ */
+int __read_mostly sysctl_sched_autogroup_bg_oom_adj = 5;
+#ifdef CONFIG_CFS_BANDWIDTH
+int sysctl_sched_autogroup_bg_period_us = 100000;
+int sysctl_sched_autogroup_bg_quota_us = 25000;
+#endif
+#define AUTOGROUP_BG_NICE	10
+
+static struct autogroup *autogroup_background;
+
 static void autogroup_init(struct task_struct *init_task)
 {
 	autogroup_default.tg = &init_task_group;
@@ -103,20 +120,19 @@ autogroup_task_group(struct task_struct *p, struct task_group *tg)
 	return tg;
 }
 
-static void
-autogroup_move_group(struct task_struct *p, struct autogroup *ag)
+/*
+ * Called with siglock held. Returns the group the caller has to drop a
+ * reference to once siglock is released, if any.
+ */
+static struct autogroup *
+__autogroup_move_group(struct task_struct *p, struct autogroup *ag)
 {
 	struct autogroup *prev;
 	struct task_struct *t;
-	unsigned long flags;
-
-	BUG_ON(!lock_task_sighand(p, &flags));
 
 	prev = p->signal->autogroup;
-	if (prev == ag) {
-		unlock_task_sighand(p, &flags);
-		return;
-	}
+	if (prev == ag)
+		return NULL;
 
 	p->signal->autogroup = autogroup_kref_get(ag);
 
@@ -125,14 +141,33 @@ autogroup_move_group(struct task_struct *p, struct autogroup *ag)
 		sched_move_task(t);
 	} while_each_thread(p, t);
 
+	return prev;
+}
+
+static void
+autogroup_move_group(struct task_struct *p, struct autogroup *ag)
+{
+	struct autogroup *prev;
+	unsigned long flags;
+
+	BUG_ON(!lock_task_sighand(p, &flags));
+	prev = __autogroup_move_group(p, ag);
 	unlock_task_sighand(p, &flags);
-	autogroup_kref_put(prev);
+
+	if (prev)
+		autogroup_kref_put(prev);
 }
 
 /* Allocates GFP_KERNEL, cannot be called under any spinlock */
 void sched_autogroup_create_attach(struct task_struct *p)
 {
-	struct autogroup *ag = autogroup_create();
+	struct autogroup *ag;
+
+	/* Sessions mean nothing in oom_adj mode */
+	if (ACCESS_ONCE(sysctl_sched_autogroup_enabled) == AUTOGROUP_OOM_ADJ)
+		return;
+
+	ag = autogroup_create();
 
 	autogroup_move_group(p, ag);
 	/* drop extra refrence added by autogroup_create() */
@@ -161,6 +196,106 @@ void sched_autogroup_exit(struct signal_struct *sig)
 	autogroup_kref_put(sig->autogroup);
 }
 
+/*
+ * Called when the oom_adj of p has been changed: in AUTOGROUP_OOM_ADJ mode
+ * move its process into the background group or back out of it.
+ */
+void sched_autogroup_oom_adj(struct task_struct *p)
+{
+	struct autogroup *ag, *prev;
+	unsigned long flags;
+
+	if (ACCESS_ONCE(sysctl_sched_autogroup_enabled) != AUTOGROUP_OOM_ADJ)
+		return;
+
+	if (!autogroup_background)
+		return;
+
+	/* It may have exited since its oom_adj was written */
+	if (!lock_task_sighand(p, &flags))
+		return;
+
+	if (p->signal->oom_adj >= sysctl_sched_autogroup_bg_oom_adj)
+		ag = autogroup_background;
+	else
+		ag = &autogroup_default;
+	prev = __autogroup_move_group(p, ag);
+	unlock_task_sighand(p, &flags);
+
+	if (prev)
+		autogroup_kref_put(prev);
+}
+
+#ifdef CONFIG_CFS_BANDWIDTH
+static DEFINE_MUTEX(autogroup_bandwidth_mutex);
+
+static int autogroup_set_bandwidth(struct task_group *tg, int period_us,
+				   int quota_us)
+{
+	int err;
+
+	err = sched_group_set_cfs_period(tg, period_us);
+	if (!err)
+		err = sched_group_set_cfs_quota(tg, quota_us);
+
+	return err;
+}
+
+int sched_autogroup_bandwidth_handler(struct ctl_table *table, int write,
+		void __user *buffer, size_t *lenp, loff_t *ppos)
+{
+	int old_period, old_quota;
+	int ret;
+
+	mutex_lock(&autogroup_bandwidth_mutex);
+	old_period = sysctl_sched_autogroup_bg_period_us;
+	old_quota = sysctl_sched_autogroup_bg_quota_us;
+
+	ret = proc_dointvec(table, write, buffer, lenp, ppos);
+	if (!ret && write && autogroup_background) {
+		ret = autogroup_set_bandwidth(autogroup_background->tg,
+					      sysctl_sched_autogroup_bg_period_us,
+					      sysctl_sched_autogroup_bg_quota_us);
+		if (ret) {
+			sysctl_sched_autogroup_bg_period_us = old_period;
+			sysctl_sched_autogroup_bg_quota_us = old_quota;
+			autogroup_set_bandwidth(autogroup_background->tg,
+						old_period, old_quota);
+		}
+	}
+	mutex_unlock(&autogroup_bandwidth_mutex);
+
+	return ret;
+}
+#endif /* CONFIG_CFS_BANDWIDTH */
+
+static int __init autogroup_background_init(void)
+{
+	struct autogroup *ag = autogroup_create();
+
+	if (ag == &autogroup_default) {
+		autogroup_kref_put(ag);
+		return -ENOMEM;
+	}
+
+	sched_group_set_shares(ag->tg, prio_to_weight[AUTOGROUP_BG_NICE + 20]);
+	ag->nice = AUTOGROUP_BG_NICE;
+#ifdef CONFIG_CFS_BANDWIDTH
+	mutex_lock(&autogroup_bandwidth_mutex);
+	if (autogroup_set_bandwidth(ag->tg, sysctl_sched_autogroup_bg_period_us,
+				    sysctl_sched_autogroup_bg_quota_us))
+		printk(KERN_WARNING "autogroup: invalid background bandwidth "
+		       "%d/%d us\n", sysctl_sched_autogroup_bg_quota_us,
+		       sysctl_sched_autogroup_bg_period_us);
+	mutex_unlock(&autogroup_bandwidth_mutex);
+#endif
+	/* The reference from autogroup_create() keeps it around for good */
+	autogroup_background = ag;
+
+	return 0;
+}
+late_initcall(autogroup_background_init);
+
 static int __init setup_autogroup(char *str)
 {
 	sysctl_sched_autogroup_enabled = 0;
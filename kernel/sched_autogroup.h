@@ -1,5 +1,10 @@
 #ifdef CONFIG_SCHED_AUTOGROUP
 
+/* sysctl_sched_autogroup_enabled */
+#define AUTOGROUP_DISABLED	0
+#define AUTOGROUP_SESSION	1	/* one group per session */
+#define AUTOGROUP_OOM_ADJ	2	/* background group by oom_adj */
+
 struct autogroup {
 	struct kref		kref;
 	struct task_group	*tg;
@@ -165,8 +165,12 @@ struct global_rq {
 	unsigned long nr_running;
 	unsigned long nr_uninterruptible;
 	unsigned long long nr_switches;
+#ifdef CONFIG_SCHED_BFS_SKIPLIST
+	u64 sl_order; /* Queueing order of realtime tasks */
+#else
 	struct list_head queue[PRIO_LIMIT];
 	DECLARE_BITMAP(prio_bitmap, PRIO_LIMIT + 1);
+#endif
 #ifdef CONFIG_SMP
 	unsigned long qnr; /* queued not running */
 	cpumask_t cpu_idle_map;
@@ -234,6 +238,11 @@ struct rq {
 	cpumask_t cache_siblings;
 #endif
 	u64 last_niffy; /* Last time this RQ updated grq.niffies */
+#ifdef CONFIG_SCHED_BFS_SKIPLIST
+	/* Tasks queued on this CPU, modified under grq lock */
+	struct bfs_sl_node sl_head;
+	unsigned int sl_seed;
+#endif
 #endif
 #ifdef CONFIG_IRQ_TIME_ACCOUNTING
 	u64 prev_irq_time;
@@ -440,22 +449,77 @@ static inline bool task_running(struct task_struct *p)
 	return p->oncpu;
 }
 
+#ifdef CONFIG_SCHED_BFS_LOCKSTAT
+/*
+ * grq.lock contention accounting. Each CPU only ever updates its own
+ * counters and only while holding grq.lock, which is also released on
+ * the CPU that took it, so readers holding grq.lock see them stable.
+ */
+struct grq_lockstat_cpu {
+	struct grq_lockstat stat;
+	u64 locked_at;
+};
+
+static DEFINE_PER_CPU(struct grq_lockstat_cpu, grq_lockstat);
+
+/* Enter with interrupts disabled */
+static inline void grq_lockstat_lock(void)
+{
+	struct grq_lockstat_cpu *ls;
+	u64 start;
+
+	if (likely(raw_spin_trylock(&grq.lock))) {
+		ls = &__get_cpu_var(grq_lockstat);
+		ls->locked_at = sched_clock();
+	} else {
+		start = sched_clock();
+		raw_spin_lock(&grq.lock);
+		ls = &__get_cpu_var(grq_lockstat);
+		ls->locked_at = sched_clock();
+		ls->stat.contended++;
+		ls->stat.wait_ns += ls->locked_at - start;
+	}
+	ls->stat.acquired++;
+}
+
+static inline void grq_lockstat_release(void)
+{
+	struct grq_lockstat_cpu *ls = &__get_cpu_var(grq_lockstat);
+	u64 held = sched_clock() - ls->locked_at;
+
+	ls->stat.hold_ns += held;
+	if (held > ls->stat.max_hold_ns)
+		ls->stat.max_hold_ns = held;
+}
+#else
+static inline void grq_lockstat_lock(void)
+{
+	raw_spin_lock(&grq.lock);
+}
+
+static inline void grq_lockstat_release(void)
+{
+}
+#endif
+
 static inline void grq_lock(void)
 	__acquires(grq.lock)
 {
-	raw_spin_lock(&grq.lock);
+	grq_lockstat_lock();
 }
 
 static inline void grq_unlock(void)
 	__releases(grq.lock)
 {
+	grq_lockstat_release();
 	raw_spin_unlock(&grq.lock);
 }
 
 static inline void grq_lock_irq(void)
 	__acquires(grq.lock)
 {
-	raw_spin_lock_irq(&grq.lock);
+	local_irq_disable();
+	grq_lockstat_lock();
 }
 
 static inline void time_lock_grq(struct rq *rq)
@@ -468,18 +532,21 @@ static inline void time_lock_grq(struct rq *rq)
 static inline void grq_unlock_irq(void)
 	__releases(grq.lock)
 {
+	grq_lockstat_release();
 	raw_spin_unlock_irq(&grq.lock);
 }
 
 static inline void grq_lock_irqsave(unsigned long *flags)
 	__acquires(grq.lock)
 {
-	raw_spin_lock_irqsave(&grq.lock, *flags);
+	local_irq_save(*flags);
+	grq_lockstat_lock();
 }
 
 static inline void grq_unlock_irqrestore(unsigned long *flags)
 	__releases(grq.lock)
 {
+	grq_lockstat_release();
 	raw_spin_unlock_irqrestore(&grq.lock, *flags);
 }
 
@@ -643,6 +710,99 @@ static inline bool deadline_after(u64 deadline, u64 time)
  * A task that is currently running will have ->oncpu set but not on the
  * grq run list.
  */
+#ifdef CONFIG_SCHED_BFS_SKIPLIST
+/*
+ * With CONFIG_SCHED_BFS_SKIPLIST the queued tasks are kept on a skip list
+ * per CPU instead, ordered by priority for realtime tasks and by virtual
+ * deadline for the rest, and queued on the list of the CPU they last ran
+ * on. The lists are only changed and read under grq lock. The first task
+ * of a list is the best it has to offer, so earliest_deadline_task() can
+ * rule a whole CPU out by comparing that one key, without walking the tasks
+ * queued there.
+ */
+static inline bool task_queued(struct task_struct *p)
+{
+	return p->sl_node.prev[0] != NULL;
+}
+
+static inline bool sl_before(int class, u64 value, int bclass, u64 bvalue)
+{
+	return class < bclass || (class == bclass && value < bvalue);
+}
+
+/* One node in four goes up a level */
+static int sl_random_levels(struct rq *rq)
+{
+	unsigned int r = rq->sl_seed;
+	int levels = 1;
+
+	r ^= r << 13;
+	r ^= r >> 17;
+	r ^= r << 5;
+	rq->sl_seed = r;
+
+	while (levels < BFS_SL_LEVELS && !(r & 3)) {
+		levels++;
+		r >>= 2;
+	}
+	return levels;
+}
+
+/*
+ * Tasks go after those with an equal key. Tasks put at the head are the idle
+ * task boosted to realtime, which gets a queueing order before all others.
+ */
+static void sl_enqueue(struct task_struct *p, bool head)
+{
+	struct bfs_sl_node *update[BFS_SL_LEVELS];
+	struct bfs_sl_node *node = &p->sl_node;
+	struct rq *rq = task_rq(p);
+	struct bfs_sl_node *x = &rq->sl_head;
+	int i;
+
+	if (rt_task(p)) {
+		node->class = p->prio;
+		node->value = head ? 0 : ++grq.sl_order;
+	} else {
+		node->class = MAX_RT_PRIO;
+		node->value = p->deadline;
+	}
+
+	for (i = BFS_SL_LEVELS - 1; i >= 0; i--) {
+		while (x->next[i] &&
+		       !sl_before(node->class, node->value,
+				  x->next[i]->class, x->next[i]->value))
+			x = x->next[i];
+		update[i] = x;
+	}
+
+	node->levels = sl_random_levels(rq);
+	node->cpu = cpu_of(rq);
+	for (i = 0; i < node->levels; i++) {
+		node->next[i] = update[i]->next[i];
+		node->prev[i] = update[i];
+		if (node->next[i])
+			node->next[i]->prev[i] = node;
+		update[i]->next[i] = node;
+	}
+}
+
+/*
+ * Removing from the runqueue. Enter with grq locked.
+ */
+static void dequeue_task(struct task_struct *p)
+{
+	struct bfs_sl_node *node = &p->sl_node;
+	int i;
+
+	for (i = 0; i < node->levels; i++) {
+		node->prev[i]->next[i] = node->next[i];
+		if (node->next[i])
+			node->next[i]->prev[i] = node->prev[i];
+	}
+	node->prev[0] = NULL;
+}
+#else
 static inline bool task_queued(struct task_struct *p)
 {
 	return (!list_empty(&p->run_list));
@@ -670,6 +830,7 @@ static void dequeue_task(struct task_struct *p)
 			__clear_bit(prio, grq.prio_bitmap);
 	}
 }
+#endif
 
 /*
  * To determine if it's safe for a task of SCHED_IDLEPRIO to actually run as
@@ -695,7 +856,9 @@ static bool isoprio_suitable(void)
  */
 static void enqueue_task(struct task_struct *p)
 {
+#ifndef CONFIG_SCHED_BFS_SKIPLIST
 	int prio;
+#endif
 	if (!rt_task(p)) {
 		/* Check it hasn't gotten rt from PI */
 		if ((idleprio_task(p) && idleprio_suitable(p)) ||
@@ -704,6 +867,9 @@ static void enqueue_task(struct task_struct *p)
 		else
 			p->prio = NORMAL_PRIO;
 	}
+#ifdef CONFIG_SCHED_BFS_SKIPLIST
+	sl_enqueue(p, false);
+#else
 	prio = p->prio;
 	if (p->prio < NORMAL_PRIO)  {
 		__set_bit(prio, grq.prio_bitmap);
@@ -717,13 +883,16 @@ static void enqueue_task(struct task_struct *p)
 		__set_bit(prio, grq.prio_bitmap);
 		list_add_tail(&p->run_list, grq.queue + prio);
 	}
+#endif
 	sched_info_queued(p);
 }
 
 /* Only idle task does this as a real time task*/
 static inline void enqueue_task_head(struct task_struct *p)
 {
+#ifndef CONFIG_SCHED_BFS_SKIPLIST
 	int prio;
+#endif
 	if (!rt_task(p)) {
 		if ((idleprio_task(p) && idleprio_suitable(p)) ||
 		   (iso_task(p) && isoprio_suitable()))
@@ -731,6 +900,9 @@ static inline void enqueue_task_head(struct task_struct *p)
 		else
 			p->prio = NORMAL_PRIO;
 	}
+#ifdef CONFIG_SCHED_BFS_SKIPLIST
+	sl_enqueue(p, true);
+#else
 	prio = p->prio;
 	if (p->prio < NORMAL_PRIO)  {
 		__set_bit(prio, grq.prio_bitmap);
@@ -744,6 +916,7 @@ static inline void enqueue_task_head(struct task_struct *p)
 		__set_bit(prio, grq.prio_bitmap);
 		list_add(&p->run_list, grq.queue + prio);
 	}
+#endif
 	sched_info_queued(p);
 }
 
@@ -1658,6 +1831,9 @@ void sched_fork(struct task_struct *p, int clone_flags)
 	p->prio = curr->normal_prio;
 
 	INIT_LIST_HEAD(&p->run_list);
+#ifdef CONFIG_SCHED_BFS_SKIPLIST
+	p->sl_node.prev[0] = NULL;
+#endif
 #if defined(CONFIG_SCHEDSTATS) || defined(CONFIG_TASK_DELAY_ACCT)
 	if (unlikely(sched_info_on()))
 		memset(&p->sched_info, 0, sizeof(p->sched_info));
@@ -2903,6 +3079,67 @@ static inline void swap_queue(struct list_head *queue)
  * Finally if no SCHED_NORMAL tasks are found, SCHED_IDLEPRIO tasks are
  * selected by the earliest deadline.
  */
+#ifdef CONFIG_SCHED_BFS_SKIPLIST
+/*
+ * Looks at the lists of all CPUs, this one first, and walks each only while
+ * its tasks could beat the best found so far, so a list whose first task is
+ * no better is left after one compare. Affinity and
+ * the sticky bias are applied as below; the bias only makes a deadline later,
+ * so stopping at the first key no better than the best is safe.
+ */
+static inline struct
+task_struct *earliest_deadline_task(struct rq *rq, int cpu, struct task_struct *idle)
+{
+	struct task_struct *edt = NULL;
+	int best_class = PRIO_LIMIT;
+	u64 best_value = ~0ULL;
+	struct bfs_sl_node *node;
+	struct task_struct *p;
+	int i, other;
+	u64 value;
+
+	for (i = 0; i < nr_cpu_ids; i++) {
+		struct rq *orq;
+
+		other = cpu + i;
+		if (other >= nr_cpu_ids)
+			other -= nr_cpu_ids;
+		if (!cpu_possible(other))
+			continue;
+		orq = cpu_rq(other);
+
+		for (node = orq->sl_head.next[0]; node; node = node->next[0]) {
+			if (!sl_before(node->class, node->value,
+				       best_class, best_value))
+				break;
+
+			p = container_of(node, struct task_struct, sl_node);
+			if (needs_other_cpu(p, cpu))
+				continue;
+
+			value = node->value;
+			if (node->class >= MAX_RT_PRIO &&
+			    task_sticky(p) && task_rq(p) != rq) {
+				if (scaling_rq(rq))
+					continue;
+				value = p->deadline << locality_diff(p, rq);
+			}
+
+			if (sl_before(node->class, value, best_class, best_value)) {
+				best_class = node->class;
+				best_value = value;
+				edt = p;
+			}
+		}
+	}
+
+	if (!edt)
+		return idle;
+
+	take_task(cpu, edt);
+	return edt;
+}
+#else
 static inline struct
 task_struct *earliest_deadline_task(struct rq *rq, int cpu, struct task_struct *idle)
 {
@@ -2973,6 +3210,7 @@ out_take:
 	take_task(cpu, edt);
 	return edt;
 }
+#endif
 
 /*
  * Print scheduling while atomic bug:
@@ -4438,6 +4676,7 @@ SYSCALL_DEFINE0(sched_yield)
 	 * Since we are going to call schedule() anyway, there's
 	 * no need to preempt or enable interrupts:
 	 */
+	grq_lockstat_release();
 	__release(grq.lock);
 	spin_release(&grq.lock.dep_map, 1, _THIS_IP_);
 	do_raw_spin_unlock(&grq.lock);
@@ -7104,6 +7343,88 @@ int in_sched_functions(unsigned long addr)
 		&& addr < (unsigned long)__sched_text_end);
 }
 
+#ifdef CONFIG_SCHED_BFS_LOCKSTAT
+/**
+ * grq_lockstat_read - sum the grq.lock statistics of all cpus
+ * @stat: where to store the totals; max_hold_ns is the largest per cpu
+ */
+void grq_lockstat_read(struct grq_lockstat *stat)
+{
+	unsigned long flags;
+	int cpu;
+
+	memset(stat, 0, sizeof(*stat));
+	grq_lock_irqsave(&flags);
+	for_each_possible_cpu(cpu) {
+		struct grq_lockstat *cs = &per_cpu(grq_lockstat, cpu).stat;
+
+		stat->acquired += cs->acquired;
+		stat->contended += cs->contended;
+		stat->wait_ns += cs->wait_ns;
+		stat->hold_ns += cs->hold_ns;
+		stat->max_hold_ns = max(stat->max_hold_ns, cs->max_hold_ns);
+	}
+	grq_unlock_irqrestore(&flags);
+}
+EXPORT_SYMBOL_GPL(grq_lockstat_read);
+
+void grq_lockstat_reset(void)
+{
+	unsigned long flags;
+	int cpu;
+
+	grq_lock_irqsave(&flags);
+	for_each_possible_cpu(cpu)
+		memset(&per_cpu(grq_lockstat, cpu).stat, 0,
+		       sizeof(struct grq_lockstat));
+	grq_unlock_irqrestore(&flags);
+}
+EXPORT_SYMBOL_GPL(grq_lockstat_reset);
+
+static int grq_lockstat_show(struct seq_file *m, void *v)
+{
+	struct grq_lockstat stat;
+
+	grq_lockstat_read(&stat);
+	seq_printf(m, "acquired %llu\ncontended %llu\n"
+		   "wait_ns %llu\nhold_ns %llu\nmax_hold_ns %llu\n",
+		   stat.acquired, stat.contended,
+		   (unsigned long long)stat.wait_ns,
+		   (unsigned long long)stat.hold_ns,
+		   (unsigned long long)stat.max_hold_ns);
+	return 0;
+}
+
+static int grq_lockstat_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, grq_lockstat_show, NULL);
+}
+
+/* Any write resets the counters */
+static ssize_t grq_lockstat_write(struct file *file, const char __user *buf,
+				  size_t count, loff_t *ppos)
+{
+	grq_lockstat_reset();
+	return count;
+}
+
+static const struct file_operations grq_lockstat_fops = {
+	.open		= grq_lockstat_open,
+	.read		= seq_read,
+	.write		= grq_lockstat_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init grq_lockstat_init(void)
+{
+	proc_create("grq_lockstat", S_IRUGO | S_IWUSR, NULL,
+		    &grq_lockstat_fops);
+	return 0;
+}
+subsys_initcall(grq_lockstat_init);
+#endif /* CONFIG_SCHED_BFS_LOCKSTAT */
+
 void __init sched_init(void)
 {
 	int i;
@@ -7140,6 +7461,10 @@ void __init sched_init(void)
 		rq->online = false;
 		rq->cpu = i;
 		rq_attach_root(rq, &def_root_domain);
+#ifdef CONFIG_SCHED_BFS_SKIPLIST
+		memset(&rq->sl_head, 0, sizeof(rq->sl_head));
+		rq->sl_seed = 2654435761U * (i + 1);
+#endif
 #endif
 		atomic_set(&rq->nr_iowait, 0);
 	}
@@ -7176,10 +7501,14 @@ void __init sched_init(void)
 	}
 #endif
 
+#ifdef CONFIG_SCHED_BFS_SKIPLIST
+	grq.sl_order = 0;
+#else
 	for (i = 0; i < PRIO_LIMIT; i++)
 		INIT_LIST_HEAD(grq.queue + i);
 	/* delimiter for bitsearch */
 	__set_bit(PRIO_LIMIT, grq.prio_bitmap);
+#endif
 
 #ifdef CONFIG_PREEMPT_NOTIFIERS
 	INIT_HLIST_HEAD(&init_task.preempt_notifiers);
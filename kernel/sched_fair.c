@@ -516,6 +516,53 @@ __update_curr(struct cfs_rq *cfs_rq, struct sched_entity *curr,
 	update_min_vruntime(cfs_rq);
 }
 
+#ifdef CONFIG_CFS_BANDWIDTH
+static inline int cfs_rq_throttled(struct cfs_rq *cfs_rq)
+{
+	return cfs_rq->throttled;
+}
+
+/*
+ * Charge the running group for its runtime. Once it exceeds its quota
+ * it is marked throttled and the current task is rescheduled, the
+ * group entity itself is taken off the runqueue in put_prev_task_fair().
+ */
+static void account_cfs_rq_runtime(struct cfs_rq *cfs_rq,
+				   unsigned long delta_exec)
+{
+	struct cfs_bandwidth *cfs_b;
+
+	if (cfs_rq->runtime == RUNTIME_INF)
+		return;
+
+	cfs_b = &cfs_rq->tg->cfs_bandwidth;
+	cfs_rq->runtime_used += delta_exec;
+	start_cfs_bandwidth(cfs_b);
+
+	if (cfs_rq->runtime_used <= cfs_rq->runtime)
+		return;
+
+	if (!cfs_rq->throttled) {
+		cfs_rq->throttled = 1;
+		cfs_rq->throttled_at = rq_of(cfs_rq)->clock;
+		raw_spin_lock(&cfs_b->lock);
+		cfs_b->nr_throttled++;
+		raw_spin_unlock(&cfs_b->lock);
+	}
+	resched_task(rq_of(cfs_rq)->curr);
+}
+#else
+static inline int cfs_rq_throttled(struct cfs_rq *cfs_rq)
+{
+	return 0;
+}
+
+static inline void account_cfs_rq_runtime(struct cfs_rq *cfs_rq,
+					  unsigned long delta_exec)
+{
+}
+#endif /* CONFIG_CFS_BANDWIDTH */
+
 static void update_curr(struct cfs_rq *cfs_rq)
 {
 	struct sched_entity *curr = cfs_rq->curr;
@@ -536,6 +583,7 @@ static void update_curr(struct cfs_rq *cfs_rq)
 
 	__update_curr(cfs_rq, curr, delta_exec);
 	curr->exec_start = now;
+	account_cfs_rq_runtime(cfs_rq, delta_exec);
 
 	if (entity_is_task(curr)) {
 		struct task_struct *curtask = task_of(curr);
@@ -841,6 +889,119 @@ dequeue_entity(struct cfs_rq *cfs_rq, struct sched_entity *se, int flags)
 		se->vruntime -= min_vruntime;
 }
 
+#ifdef CONFIG_CFS_BANDWIDTH
+/* Take a throttled group's entity, and any parents it leaves empty, off */
+static void throttle_cfs_rq(struct cfs_rq *cfs_rq)
+{
+	struct sched_entity *se = cfs_rq->tg->se[cpu_of(rq_of(cfs_rq))];
+
+	for_each_sched_entity(se) {
+		if (!se->on_rq)
+			break;
+		cfs_rq = cfs_rq_of(se);
+		dequeue_entity(cfs_rq, se, DEQUEUE_SLEEP);
+		if (cfs_rq->load.weight)
+			break;
+	}
+}
+
+/* Called with the rq lock held and the rq clock updated */
+static void unthrottle_cfs_rq(struct cfs_rq *cfs_rq)
+{
+	struct rq *rq = rq_of(cfs_rq);
+	struct cfs_bandwidth *cfs_b = &cfs_rq->tg->cfs_bandwidth;
+	struct sched_entity *se = cfs_rq->tg->se[cpu_of(rq)];
+
+	cfs_rq->throttled = 0;
+	raw_spin_lock(&cfs_b->lock);
+	cfs_b->throttled_time += rq->clock - cfs_rq->throttled_at;
+	raw_spin_unlock(&cfs_b->lock);
+
+	if (!cfs_rq->nr_running)
+		return;
+
+	for_each_sched_entity(se) {
+		if (se->on_rq)
+			break;
+		cfs_rq = cfs_rq_of(se);
+		enqueue_entity(cfs_rq, se, ENQUEUE_WAKEUP);
+		if (cfs_rq_throttled(cfs_rq))
+			break;
+	}
+
+	resched_task(rq->curr);
+}
+
+/* Hand each cfs_rq of the group its quota for the new period(s) */
+static int do_sched_cfs_period_timer(struct cfs_bandwidth *cfs_b, int overrun)
+{
+	struct task_group *tg =
+		container_of(cfs_b, struct task_group, cfs_bandwidth);
+	int i, idle = 1;
+
+	for_each_online_cpu(i) {
+		struct cfs_rq *cfs_rq = tg->cfs_rq[i];
+		struct rq *rq = rq_of(cfs_rq);
+		u64 runtime;
+
+		raw_spin_lock(&rq->lock);
+		runtime = cfs_rq->runtime;
+		if (runtime != RUNTIME_INF && cfs_rq->runtime_used) {
+			cfs_rq->runtime_used -= min(cfs_rq->runtime_used,
+						    overrun * runtime);
+			if (cfs_rq->throttled &&
+			    cfs_rq->runtime_used < runtime) {
+				update_rq_clock(rq);
+				unthrottle_cfs_rq(cfs_rq);
+			}
+			idle = 0;
+		} else if (cfs_rq->nr_running)
+			idle = 0;
+		raw_spin_unlock(&rq->lock);
+	}
+
+	if (!idle) {
+		raw_spin_lock(&cfs_b->lock);
+		cfs_b->nr_periods += overrun;
+		raw_spin_unlock(&cfs_b->lock);
+	}
+
+	return idle;
+}
+
+/* A task in a throttled group must not be picked as a buddy */
+static int throttled_hierarchy(struct sched_entity *se)
+{
+	for_each_sched_entity(se) {
+		if (cfs_rq_throttled(cfs_rq_of(se)))
+			return 1;
+	}
+
+	return 0;
+}
+
+static void check_cfs_rq_throttle(struct task_struct *prev)
+{
+	struct sched_entity *se = &prev->se;
+
+	for_each_sched_entity(se) {
+		struct cfs_rq *cfs_rq = cfs_rq_of(se);
+
+		if (cfs_rq_throttled(cfs_rq))
+			throttle_cfs_rq(cfs_rq);
+	}
+}
+#else
+static inline int throttled_hierarchy(struct sched_entity *se)
+{
+	return 0;
+}
+
+static inline void check_cfs_rq_throttle(struct task_struct *prev)
+{
+}
+#endif /* CONFIG_CFS_BANDWIDTH */
+
 /*
  * Preempt the current task with a newly woken task if needed:
  */
@@ -1056,6 +1217,9 @@ enqueue_task_fair(struct rq *rq, struct task_struct *p, int flags)
 			break;
 		cfs_rq = cfs_rq_of(se);
 		enqueue_entity(cfs_rq, se, flags);
+		/* A throttled group is put back when it is unthrottled */
+		if (cfs_rq_throttled(cfs_rq))
+			break;
 		flags = ENQUEUE_WAKEUP;
 	}
 
@@ -1073,6 +1237,9 @@ static void dequeue_task_fair(struct rq *rq, struct task_struct *p, int flags)
 	struct sched_entity *se = &p->se;
 
 	for_each_sched_entity(se) {
+		/* The entity of a throttled group is already off its parent */
+		if (!se->on_rq)
+			break;
 		cfs_rq = cfs_rq_of(se);
 		dequeue_entity(cfs_rq, se, flags);
 		/* Don't dequeue parent if it has other entities besides us */
@@ -1635,16 +1802,22 @@ wakeup_preempt_entity(struct sched_entity *curr, struct sched_entity *se)
 static void set_last_buddy(struct sched_entity *se)
 {
 	if (likely(task_of(se)->policy != SCHED_IDLE)) {
-		for_each_sched_entity(se)
+		for_each_sched_entity(se) {
+			if (!se->on_rq)
+				break;
 			cfs_rq_of(se)->last = se;
+		}
 	}
 }
 
 static void set_next_buddy(struct sched_entity *se)
 {
 	if (likely(task_of(se)->policy != SCHED_IDLE)) {
-		for_each_sched_entity(se)
+		for_each_sched_entity(se) {
+			if (!se->on_rq)
+				break;
 			cfs_rq_of(se)->next = se;
+		}
 	}
 }
 
@@ -1667,6 +1840,10 @@ static void check_preempt_wakeup(struct rq *rq, struct task_struct *p, int wake_
 	if (unlikely(se == pse))
 		return;
 
+	/* It cannot run before its group is unthrottled */
+	if (unlikely(throttled_hierarchy(pse)))
+		return;
+
 	if (sched_feat(NEXT_BUDDY) && scale && !(wake_flags & WF_FORK))
 		set_next_buddy(pse);
 
@@ -1750,6 +1927,8 @@ static void put_prev_task_fair(struct rq *rq, struct task_struct *prev)
 		cfs_rq = cfs_rq_of(se);
 		put_prev_entity(cfs_rq, se);
 	}
+
+	check_cfs_rq_throttle(prev);
 }
 
 #ifdef CONFIG_SMP
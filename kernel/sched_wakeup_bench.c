@@ -0,0 +1,196 @@
+/*
+ * Scheduler wakeup storm benchmark
+ *
+ * Runs pairs of kernel threads that do nothing but wake each other
+ * through a pair of completions, so nearly all of the time is spent in
+ * try_to_wake_up() and schedule(). After the run it prints the number
+ * of wakeups per second and, on BFS with CONFIG_SCHED_BFS_LOCKSTAT,
+ * how often the global runqueue lock was taken and contended and how
+ * long it was waited for and held meanwhile (the statistics in
+ * /proc/grq_lockstat are reset when the run starts). Load it, read
+ * the results from the kernel log, change whatever is being evaluated
+ * (e.g. CONFIG_SCHED_BFS_SKIPLIST) and load it again.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/sched.h>
+#include <linux/kthread.h>
+#include <linux/completion.h>
+#include <linux/delay.h>
+#include <linux/slab.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/err.h>
+
+static unsigned int nr_pairs;
+module_param(nr_pairs, uint, 0444);
+MODULE_PARM_DESC(nr_pairs, "Thread pairs to run (default: twice the online cpus)");
+
+static unsigned int duration_ms = 5000;
+module_param(duration_ms, uint, 0444);
+MODULE_PARM_DESC(duration_ms, "Length of the run in milliseconds");
+
+struct bench_pair {
+	struct completion ping;
+	struct completion pong;
+	struct task_struct *thread[2];
+	unsigned long wakeups;
+};
+
+static int bench_stop;
+
+static void bench_wait_stop(void)
+{
+	set_current_state(TASK_INTERRUPTIBLE);
+	while (!kthread_should_stop()) {
+		schedule();
+		set_current_state(TASK_INTERRUPTIBLE);
+	}
+	__set_current_state(TASK_RUNNING);
+}
+
+static int bench_ping(void *data)
+{
+	struct bench_pair *pair = data;
+
+	while (!ACCESS_ONCE(bench_stop)) {
+		complete(&pair->ping);
+		wait_for_completion(&pair->pong);
+		pair->wakeups += 2;
+	}
+	bench_wait_stop();
+	return 0;
+}
+
+static int bench_pong(void *data)
+{
+	struct bench_pair *pair = data;
+
+	while (!ACCESS_ONCE(bench_stop)) {
+		wait_for_completion(&pair->ping);
+		complete(&pair->pong);
+	}
+	bench_wait_stop();
+	return 0;
+}
+
+/* Let every thread run out of its loop, then reap them */
+static void bench_stop_pairs(struct bench_pair *pairs, unsigned int n)
+{
+	unsigned int i;
+	int t;
+
+	ACCESS_ONCE(bench_stop) = 1;
+	for (i = 0; i < n; i++) {
+		complete_all(&pairs[i].ping);
+		complete_all(&pairs[i].pong);
+	}
+	for (i = 0; i < n; i++)
+		for (t = 0; t < 2; t++)
+			if (pairs[i].thread[t])
+				kthread_stop(pairs[i].thread[t]);
+}
+
+static int __init sched_wakeup_bench_init(void)
+{
+	static int (* const fn[2])(void *) = { bench_pong, bench_ping };
+	struct bench_pair *pairs;
+#ifdef CONFIG_SCHED_BFS_LOCKSTAT
+	struct grq_lockstat stat;
+#endif
+	unsigned long long wakeups = 0;
+	ktime_t start;
+	s64 ns;
+	unsigned int i;
+	int t, err = 0;
+
+	if (!nr_pairs)
+		nr_pairs = 2 * num_online_cpus();
+	if (!duration_ms)
+		duration_ms = 1;
+
+	pairs = kcalloc(nr_pairs, sizeof(*pairs), GFP_KERNEL);
+	if (!pairs)
+		return -ENOMEM;
+
+	bench_stop = 0;
+	for (i = 0; i < nr_pairs; i++) {
+		init_completion(&pairs[i].ping);
+		init_completion(&pairs[i].pong);
+	}
+
+#ifdef CONFIG_SCHED_BFS_LOCKSTAT
+	grq_lockstat_reset();
+#endif
+	start = ktime_get();
+
+	for (i = 0; i < nr_pairs; i++) {
+		for (t = 0; t < 2; t++) {
+			struct task_struct *p;
+
+			p = kthread_run(fn[t], &pairs[i], "wakebench/%u%c",
+					i, t ? 'a' : 'b');
+			if (IS_ERR(p)) {
+				err = PTR_ERR(p);
+				goto out;
+			}
+			pairs[i].thread[t] = p;
+		}
+	}
+
+	msleep(duration_ms);
+	bench_stop_pairs(pairs, nr_pairs);
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+#ifdef CONFIG_SCHED_BFS_LOCKSTAT
+	grq_lockstat_read(&stat);
+#endif
+
+	for (i = 0; i < nr_pairs; i++)
+		wakeups += pairs[i].wakeups;
+
+	printk(KERN_INFO "sched_wakeup_bench: %u pairs on %u cpus: "
+	       "%llu wakeups in %lld ms, %llu/s\n",
+	       nr_pairs, num_online_cpus(), wakeups,
+	       (long long)div_s64(ns, NSEC_PER_MSEC),
+	       div64_u64(wakeups * NSEC_PER_SEC, max_t(s64, ns, 1)));
+
+#ifdef CONFIG_SCHED_BFS_LOCKSTAT
+	printk(KERN_INFO "sched_wakeup_bench: run queues: %s\n",
+#ifdef CONFIG_SCHED_BFS_SKIPLIST
+	       "per cpu skip lists"
+#else
+	       "global"
+#endif
+	       );
+	printk(KERN_INFO "sched_wakeup_bench: grq.lock %llu acquired, "
+	       "%llu contended, avg wait %llu ns, avg hold %llu ns, "
+	       "max hold %llu ns\n",
+	       stat.acquired, stat.contended,
+	       div64_u64(stat.wait_ns, max(stat.contended, 1ULL)),
+	       div64_u64(stat.hold_ns, max(stat.acquired, 1ULL)),
+	       (unsigned long long)stat.max_hold_ns);
+#endif
+
+	kfree(pairs);
+	return 0;
+
+out:
+	bench_stop_pairs(pairs, nr_pairs);
+	kfree(pairs);
+	return err;
+}
+
+static void __exit sched_wakeup_bench_exit(void)
+{
+}
+
+module_init(sched_wakeup_bench_init);
+module_exit(sched_wakeup_bench_exit);
+
+MODULE_DESCRIPTION("Scheduler wakeup storm benchmark");
+MODULE_LICENSE("GPL");
@@ -273,6 +273,7 @@ static int max_sched_shares_ratelimit = NSEC_PER_SEC; /* 1 second */
 #ifdef CONFIG_COMPACTION
 static int min_extfrag_threshold;
 static int max_extfrag_threshold = 1000;
+static int max_compact_daemon_order = MAX_ORDER - 1;
 #endif
 
 static struct ctl_table kern_table[] = {
@@ -397,10 +398,33 @@ static struct ctl_table kern_table[] = {
 		.data           = &sysctl_sched_autogroup_enabled,
 		.maxlen         = sizeof(unsigned int),
 		.mode           = 0644,
-		.proc_handler   = proc_dointvec,
+		.proc_handler   = proc_dointvec_minmax,
 		.extra1         = &zero,
-		.extra2         = &one,
+		.extra2         = &two,
+	},
+	{
+		.procname	= "sched_autogroup_bg_oom_adj",
+		.data		= &sysctl_sched_autogroup_bg_oom_adj,
+		.maxlen		= sizeof(int),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec,
+	},
+#ifdef CONFIG_CFS_BANDWIDTH
+	{
+		.procname	= "sched_autogroup_bg_period_us",
+		.data		= &sysctl_sched_autogroup_bg_period_us,
+		.maxlen		= sizeof(int),
+		.mode		= 0644,
+		.proc_handler	= sched_autogroup_bandwidth_handler,
 	},
+	{
+		.procname	= "sched_autogroup_bg_quota_us",
+		.data		= &sysctl_sched_autogroup_bg_quota_us,
+		.maxlen		= sizeof(int),
+		.mode		= 0644,
+		.proc_handler	= sched_autogroup_bandwidth_handler,
+	},
+#endif
 #endif
 #ifdef CONFIG_PROVE_LOCKING
 	{
@@ -1193,6 +1217,32 @@ static struct ctl_table vm_table[] = {
 		.extra1		= &min_extfrag_threshold,
 		.extra2		= &max_extfrag_threshold,
 	},
+	{
+		.procname	= "compact_daemon_order",
+		.data		= &sysctl_compact_daemon_order,
+		.maxlen		= sizeof(int),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &zero,
+		.extra2		= &max_compact_daemon_order,
+	},
+	{
+		.procname	= "compact_daemon_centisecs",
+		.data		= &sysctl_compact_daemon_centisecs,
+		.maxlen		= sizeof(int),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &one,
+	},
+	{
+		.procname	= "compact_daemon_cpu_percent",
+		.data		= &sysctl_compact_daemon_cpu_percent,
+		.maxlen		= sizeof(int),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &one,
+		.extra2		= &one_hundred,
+	},
 
 #endif /* CONFIG_COMPACTION */
 	{
@@ -1218,6 +1268,15 @@ static struct ctl_table vm_table[] = {
 		.mode		= 0644,
 		.proc_handler	= &proc_dointvec
 	},
+	{
+		.procname	= "readahead_adaptive",
+		.data		= &sysctl_readahead_adaptive,
+		.maxlen		= sizeof(sysctl_readahead_adaptive),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &zero,
+		.extra2		= &one,
+	},
 	{
 		.procname	= "percpu_pagelist_fraction",
 		.data		= &percpu_pagelist_fraction,
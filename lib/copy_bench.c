@@ -0,0 +1,290 @@
+/*
+ * Memory copy bandwidth benchmark
+ *
+ * Times memcpy, memmove, copy_page, copy_to_user and copy_from_user
+ * over a range of sizes and of source/destination misalignments,
+ * checking the copied data as it goes, and prints the bandwidth of
+ * each. The user copies go to an anonymous mapping in the address
+ * space of the process loading the module, so they are skipped when
+ * the benchmark is built in. Load it, read the results
+ * from the kernel log, change whatever copy tuning is being evaluated
+ * and load it again.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/string.h>
+#include <linux/vmalloc.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/sched.h>
+#include <linux/mm.h>
+#include <linux/mman.h>
+#include <linux/uaccess.h>
+
+#define BENCH_MAX_SIZE	(64 * 1024)
+/* Room for the largest misalignment */
+#define BENCH_SLACK	64
+
+static unsigned int bytes_per_test = 8 * 1024 * 1024;
+module_param(bytes_per_test, uint, 0444);
+MODULE_PARM_DESC(bytes_per_test, "Bytes copied for each size/alignment measured");
+
+static const size_t bench_sizes[] = {
+	16, 64, 256, 1024, 4096, 16384, BENCH_MAX_SIZE,
+};
+
+static const struct {
+	unsigned int src;
+	unsigned int dst;
+} bench_aligns[] = {
+	{ 0, 0 }, { 0, 1 }, { 1, 0 }, { 2, 3 }, { 4, 0 }, { 0, 32 },
+};
+
+static u8 *src_buf;
+static u8 *dst_buf;
+
+static void bench_fill(u8 *buf, size_t len, u8 seed)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		buf[i] = (u8)(seed + i * 7);
+}
+
+/* Bandwidth in KB/s, for n bytes copied in ns nanoseconds */
+static unsigned long bench_kbps(u64 n, s64 ns)
+{
+	if (ns <= 0)
+		ns = 1;
+	return (unsigned long)div64_u64(n * 1000000000ULL, (u64)ns * 1024);
+}
+
+enum bench_op { BENCH_MEMCPY, BENCH_MEMMOVE };
+
+static int bench_one(enum bench_op op, size_t size, unsigned int sa,
+		     unsigned int da)
+{
+	unsigned int loops = max_t(unsigned int, bytes_per_test / size, 1);
+	u8 *src = src_buf + sa;
+	u8 *dst = dst_buf + da;
+	ktime_t start;
+	s64 ns;
+	unsigned int i;
+
+	bench_fill(src, size, size + sa);
+	memset(dst, 0, size);
+
+	start = ktime_get();
+	for (i = 0; i < loops; i++) {
+		if (op == BENCH_MEMCPY)
+			memcpy(dst, src, size);
+		else
+			memmove(dst, src, size);
+	}
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	if (memcmp(dst, src, size)) {
+		printk(KERN_ERR "copy_bench: %s size %zu align %u/%u "
+		       "copied wrongly\n",
+		       op == BENCH_MEMCPY ? "memcpy" : "memmove", size, sa, da);
+		return -EIO;
+	}
+
+	printk(KERN_INFO "copy_bench: %-8s size %6zu align %2u/%-2u %8lu KB/s\n",
+	       op == BENCH_MEMCPY ? "memcpy" : "memmove", size, sa, da,
+	       bench_kbps((u64)loops * size, ns));
+
+	cond_resched();
+	return 0;
+}
+
+/* memmove within one buffer, overlapping so it has to copy backwards */
+static int bench_memmove_overlap(size_t size)
+{
+	unsigned int loops = max_t(unsigned int, bytes_per_test / size, 1);
+	ktime_t start;
+	s64 ns;
+	unsigned int i;
+
+	start = ktime_get();
+	for (i = 0; i < loops; i++)
+		memmove(src_buf + 8, src_buf, size);
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	printk(KERN_INFO "copy_bench: %-8s size %6zu overlap +8  %8lu KB/s\n",
+	       "memmove", size, bench_kbps((u64)loops * size, ns));
+	return 0;
+}
+
+static int bench_copy_page(void)
+{
+	unsigned int loops = max_t(unsigned int, bytes_per_test / PAGE_SIZE, 1);
+	void *from = (void *)__get_free_page(GFP_KERNEL);
+	void *to = (void *)__get_free_page(GFP_KERNEL);
+	ktime_t start;
+	s64 ns;
+	unsigned int i;
+	int ret = 0;
+
+	if (!from || !to) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	bench_fill(from, PAGE_SIZE, 0x5a);
+
+	start = ktime_get();
+	for (i = 0; i < loops; i++)
+		copy_page(to, from);
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	if (memcmp(to, from, PAGE_SIZE)) {
+		printk(KERN_ERR "copy_bench: copy_page copied wrongly\n");
+		ret = -EIO;
+		goto out;
+	}
+
+	printk(KERN_INFO "copy_bench: %-8s size %6lu               %8lu KB/s\n",
+	       "copy_page", PAGE_SIZE, bench_kbps((u64)loops * PAGE_SIZE, ns));
+out:
+	free_page((unsigned long)from);
+	free_page((unsigned long)to);
+	return ret;
+}
+
+enum bench_uop { BENCH_TO_USER, BENCH_FROM_USER };
+
+static int bench_user_one(enum bench_uop op, u8 __user *ubuf, size_t size,
+			  unsigned int sa, unsigned int da)
+{
+	unsigned int loops = max_t(unsigned int, bytes_per_test / size, 1);
+	const char *name = op == BENCH_TO_USER ? "to_user" : "from_user";
+	ktime_t start;
+	s64 ns;
+	unsigned int i;
+	unsigned long left = 0;
+
+	/* Source and destination of the timed copy, user side included */
+	bench_fill(src_buf + sa, size, size + sa);
+	if (op == BENCH_FROM_USER &&
+	    copy_to_user(ubuf + sa, src_buf + sa, size))
+		return -EFAULT;
+
+	start = ktime_get();
+	for (i = 0; i < loops; i++) {
+		if (op == BENCH_TO_USER)
+			left |= copy_to_user(ubuf + da, src_buf + sa, size);
+		else
+			left |= copy_from_user(dst_buf + da, ubuf + sa, size);
+	}
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	if (op == BENCH_TO_USER && !left)
+		left = copy_from_user(dst_buf + da, ubuf + da, size);
+	if (left || memcmp(dst_buf + da, src_buf + sa, size)) {
+		printk(KERN_ERR "copy_bench: %s size %zu align %u/%u "
+		       "copied wrongly\n", name, size, sa, da);
+		return -EIO;
+	}
+
+	printk(KERN_INFO "copy_bench: %-8s size %6zu align %2u/%-2u %8lu KB/s\n",
+	       name, size, sa, da, bench_kbps((u64)loops * size, ns));
+
+	cond_resched();
+	return 0;
+}
+
+static int bench_user(void)
+{
+	struct mm_struct *mm = current->mm;
+	size_t len = PAGE_ALIGN(BENCH_MAX_SIZE + BENCH_SLACK);
+	unsigned long addr;
+	int s, a;
+	int err = 0;
+
+	if (!mm) {
+		printk(KERN_INFO "copy_bench: no user context, "
+		       "skipping user copies\n");
+		return 0;
+	}
+
+	down_write(&mm->mmap_sem);
+	addr = do_mmap(NULL, 0, len, PROT_READ | PROT_WRITE,
+		       MAP_ANONYMOUS | MAP_PRIVATE, 0);
+	up_write(&mm->mmap_sem);
+	if (IS_ERR_VALUE(addr))
+		return (int)addr;
+
+	for (s = 0; s < ARRAY_SIZE(bench_sizes) && !err; s++)
+		for (a = 0; a < ARRAY_SIZE(bench_aligns) && !err; a++)
+			err = bench_user_one(BENCH_TO_USER,
+					     (u8 __user *)addr, bench_sizes[s],
+					     bench_aligns[a].src,
+					     bench_aligns[a].dst);
+
+	for (s = 0; s < ARRAY_SIZE(bench_sizes) && !err; s++)
+		for (a = 0; a < ARRAY_SIZE(bench_aligns) && !err; a++)
+			err = bench_user_one(BENCH_FROM_USER,
+					     (u8 __user *)addr, bench_sizes[s],
+					     bench_aligns[a].src,
+					     bench_aligns[a].dst);
+
+	down_write(&mm->mmap_sem);
+	do_munmap(mm, addr, len);
+	up_write(&mm->mmap_sem);
+	return err;
+}
+
+static int __init copy_bench_init(void)
+{
+	int s, a;
+	int err = 0;
+
+	src_buf = vmalloc(BENCH_MAX_SIZE + BENCH_SLACK);
+	dst_buf = vmalloc(BENCH_MAX_SIZE + BENCH_SLACK);
+	if (!src_buf || !dst_buf) {
+		err = -ENOMEM;
+		goto out;
+	}
+
+	printk(KERN_INFO "copy_bench: %u bytes per measurement\n",
+	       bytes_per_test);
+
+	for (s = 0; s < ARRAY_SIZE(bench_sizes) && !err; s++)
+		for (a = 0; a < ARRAY_SIZE(bench_aligns) && !err; a++)
+			err = bench_one(BENCH_MEMCPY, bench_sizes[s],
+					bench_aligns[a].src,
+					bench_aligns[a].dst);
+
+	for (s = 0; s < ARRAY_SIZE(bench_sizes) && !err; s++)
+		err = bench_one(BENCH_MEMMOVE, bench_sizes[s], 0, 0);
+
+	for (s = 0; s < ARRAY_SIZE(bench_sizes) && !err; s++)
+		err = bench_memmove_overlap(bench_sizes[s]);
+
+	if (!err)
+		err = bench_copy_page();
+
+	if (!err)
+		err = bench_user();
+
+out:
+	vfree(src_buf);
+	vfree(dst_buf);
+	return err;
+}
+
+static void __exit copy_bench_exit(void)
+{
+}
+
+module_init(copy_bench_init);
+module_exit(copy_bench_exit);
+
+MODULE_DESCRIPTION("Memory copy bandwidth benchmark");
+MODULE_LICENSE("GPL");
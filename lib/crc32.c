@@ -26,6 +26,7 @@
 #include <linux/compiler.h>
 #include <linux/types.h>
 #include <linux/init.h>
+#include <linux/irqflags.h>
 #include <asm/atomic.h>
 #include "crc32defs.h"
 #if CRC_LE_BITS == 8
@@ -51,20 +52,25 @@ static inline u32
 crc32_body(u32 crc, unsigned char const *buf, size_t len, const u32 (*tab)[256])
 {
 # ifdef __LITTLE_ENDIAN
-#  define DO_CRC(x) crc = tab[0][(crc ^ (x)) & 255] ^ (crc >> 8)
-#  define DO_CRC4 crc = tab[3][(crc) & 255] ^ \
-		tab[2][(crc >> 8) & 255] ^ \
-		tab[1][(crc >> 16) & 255] ^ \
-		tab[0][(crc >> 24) & 255]
+#  define DO_CRC(x) crc = t0[(crc ^ (x)) & 255] ^ (crc >> 8)
+#  define DO_CRC4 (t3[(q) & 255] ^ t2[(q >> 8) & 255] ^ \
+		   t1[(q >> 16) & 255] ^ t0[(q >> 24) & 255])
+#  define DO_CRC8 (t7[(q) & 255] ^ t6[(q >> 8) & 255] ^ \
+		   t5[(q >> 16) & 255] ^ t4[(q >> 24) & 255])
 # else
-#  define DO_CRC(x) crc = tab[0][((crc >> 24) ^ (x)) & 255] ^ (crc << 8)
-#  define DO_CRC4 crc = tab[0][(crc) & 255] ^ \
-		tab[1][(crc >> 8) & 255] ^ \
-		tab[2][(crc >> 16) & 255] ^ \
-		tab[3][(crc >> 24) & 255]
+#  define DO_CRC(x) crc = t0[((crc >> 24) ^ (x)) & 255] ^ (crc << 8)
+#  define DO_CRC4 (t0[(q) & 255] ^ t1[(q >> 8) & 255] ^ \
+		   t2[(q >> 16) & 255] ^ t3[(q >> 24) & 255])
+#  define DO_CRC8 (t4[(q) & 255] ^ t5[(q >> 8) & 255] ^ \
+		   t6[(q >> 16) & 255] ^ t7[(q >> 24) & 255])
 # endif
 	const u32 *b;
 	size_t    rem_len;
+	const u32 *t0 = tab[0], *t1 = tab[1], *t2 = tab[2], *t3 = tab[3];
+# if CRC32_SLICES == 8
+	const u32 *t4 = tab[4], *t5 = tab[5], *t6 = tab[6], *t7 = tab[7];
+# endif
+	u32 q;
 
 	/* Align it */
 	if (unlikely((long)buf & 3 && len)) {
@@ -72,13 +78,24 @@ crc32_body(u32 crc, unsigned char const *buf, size_t len, const u32 (*tab)[256])
 			DO_CRC(*buf++);
 		} while ((--len) && ((long)buf)&3);
 	}
+# if CRC32_SLICES == 4
 	rem_len = len & 3;
-	/* load data 32 bits wide, xor data 32 bits wide. */
 	len = len >> 2;
+# else
+	rem_len = len & 7;
+	len = len >> 3;
+# endif
+	/* load data 32 bits wide, xor data 32 bits wide. */
 	b = (const u32 *)buf;
 	for (--b; len; --len) {
-		crc ^= *++b; /* use pre increment for speed */
-		DO_CRC4;
+		q = crc ^ *++b; /* use pre increment for speed */
+# if CRC32_SLICES == 4
+		crc = DO_CRC4;
+# else
+		crc = DO_CRC8;
+		q = *++b;
+		crc ^= DO_CRC4;
+# endif
 	}
 	len = rem_len;
 	/* And the last few bytes */
@@ -91,60 +108,88 @@ crc32_body(u32 crc, unsigned char const *buf, size_t len, const u32 (*tab)[256])
 	return crc;
 #undef DO_CRC
 #undef DO_CRC4
+#undef DO_CRC8
 }
 #endif
 /**
- * crc32_le() - Calculate bitwise little-endian Ethernet AUTODIN II CRC32
- * @crc: seed value for computation.  ~0 for Ethernet, sometimes 0 for
- *	other uses, or the previous crc32 value if computing incrementally.
+ * crc32_le_generic() - Calculate bitwise little-endian CRC32 with any
+ *	polynomial, one of CRCPOLY_LE or CRC32C_POLY_LE
+ * @crc: seed value for computation.
  * @p: pointer to buffer over which CRC is run
  * @len: length of buffer @p
+ * @tab: table for @polynomial, unused when CRC_LE_BITS is 1
+ * @polynomial: bit-reversed CRC polynomial
  */
-u32 __pure crc32_le(u32 crc, unsigned char const *p, size_t len);
-
-#if CRC_LE_BITS == 1
-/*
- * In fact, the table-based code will work in this case, but it can be
- * simplified by inlining the table in ?: form.
- */
-
-u32 __pure crc32_le(u32 crc, unsigned char const *p, size_t len)
+static inline u32 __pure crc32_le_generic(u32 crc, unsigned char const *p,
+					  size_t len, const u32 (*tab)[256],
+					  u32 polynomial)
 {
+#if CRC_LE_BITS == 1
+	/*
+	 * In fact, the table-based code will work in this case, but it can be
+	 * simplified by inlining the table in ?: form.
+	 */
 	int i;
 	while (len--) {
 		crc ^= *p++;
 		for (i = 0; i < 8; i++)
-			crc = (crc >> 1) ^ ((crc & 1) ? CRCPOLY_LE : 0);
+			crc = (crc >> 1) ^ ((crc & 1) ? polynomial : 0);
 	}
-	return crc;
-}
-#else				/* Table-based approach */
-
-u32 __pure crc32_le(u32 crc, unsigned char const *p, size_t len)
-{
-# if CRC_LE_BITS == 8
-	const u32      (*tab)[] = crc32table_le;
-
+#elif CRC_LE_BITS == 8
 	crc = __cpu_to_le32(crc);
 	crc = crc32_body(crc, p, len, tab);
-	return __le32_to_cpu(crc);
-# elif CRC_LE_BITS == 4
+	crc = __le32_to_cpu(crc);
+#elif CRC_LE_BITS == 4
 	while (len--) {
 		crc ^= *p++;
-		crc = (crc >> 4) ^ crc32table_le[crc & 15];
-		crc = (crc >> 4) ^ crc32table_le[crc & 15];
+		crc = (crc >> 4) ^ tab[0][crc & 15];
+		crc = (crc >> 4) ^ tab[0][crc & 15];
 	}
-	return crc;
-# elif CRC_LE_BITS == 2
+#elif CRC_LE_BITS == 2
 	while (len--) {
 		crc ^= *p++;
-		crc = (crc >> 2) ^ crc32table_le[crc & 3];
-		crc = (crc >> 2) ^ crc32table_le[crc & 3];
-		crc = (crc >> 2) ^ crc32table_le[crc & 3];
-		crc = (crc >> 2) ^ crc32table_le[crc & 3];
+		crc = (crc >> 2) ^ tab[0][crc & 3];
+		crc = (crc >> 2) ^ tab[0][crc & 3];
+		crc = (crc >> 2) ^ tab[0][crc & 3];
+		crc = (crc >> 2) ^ tab[0][crc & 3];
 	}
+#endif
 	return crc;
-# endif
+}
+
+/**
+ * crc32_le() - Calculate bitwise little-endian Ethernet AUTODIN II CRC32
+ * @crc: seed value for computation.  ~0 for Ethernet, sometimes 0 for
+ *	other uses, or the previous crc32 value if computing incrementally.
+ * @p: pointer to buffer over which CRC is run
+ * @len: length of buffer @p
+ */
+#if CRC_LE_BITS == 1
+u32 __pure crc32_le(u32 crc, unsigned char const *p, size_t len)
+{
+	return crc32_le_generic(crc, p, len, NULL, CRCPOLY_LE);
+}
+
+/**
+ * __crc32c_le() - Calculate bitwise little-endian Castagnoli CRC32c
+ * @crc: seed value for computation, or the previous crc32c value if
+ *	computing incrementally.
+ * @p: pointer to buffer over which CRC is run
+ * @len: length of buffer @p
+ */
+u32 __pure __crc32c_le(u32 crc, unsigned char const *p, size_t len)
+{
+	return crc32_le_generic(crc, p, len, NULL, CRC32C_POLY_LE);
+}
+#else
+u32 __pure crc32_le(u32 crc, unsigned char const *p, size_t len)
+{
+	return crc32_le_generic(crc, p, len, crc32table_le, CRCPOLY_LE);
+}
+
+u32 __pure __crc32c_le(u32 crc, unsigned char const *p, size_t len)
+{
+	return crc32_le_generic(crc, p, len, crc32ctable_le, CRC32C_POLY_LE);
 }
 #endif
 
@@ -207,6 +252,7 @@ u32 __pure crc32_be(u32 crc, unsigned char const *p, size_t len)
 
 EXPORT_SYMBOL(crc32_le);
 EXPORT_SYMBOL(crc32_be);
+EXPORT_SYMBOL(__crc32c_le);
 
 /*
  * A brief CRC tutorial.
@@ -335,6 +381,144 @@ EXPORT_SYMBOL(crc32_be);
  * the same way on decoding, it doesn't make a difference.
  */
 
+#ifdef CONFIG_CRC32_SELFTEST
+
+#include <linux/ktime.h>
+#include <linux/math64.h>
+
+#define CRC32_TEST_BUF_SIZE	4096
+#define CRC32_BENCH_LOOPS	256
+
+static u8 __initdata crc32_test_buf[CRC32_TEST_BUF_SIZE];
+
+/*
+ * Expected values for crc32_le(), crc32_be() and __crc32c_le() over
+ * crc32_test_buf[start .. start + length), computed bit at a time.
+ */
+static struct crc32_test {
+	u32 crc;	/* initial crc value */
+	u32 start;	/* offset in crc32_test_buf */
+	u32 length;
+	u32 crc_le;
+	u32 crc_be;
+	u32 crc32c_le;
+} crc32_test[] __initdata = {
+	{0x00000000,  634,    0, 0x00000000, 0x00000000, 0x00000000},
+	{0x36af971e, 3794,    1, 0x2734ee3d, 0xf5c94508, 0x83c57899},
+	{0x4d99d19c,  592,    3, 0x0ae8d904, 0xe3cd8f8f, 0x25f9f923},
+	{0xffffffff, 2860,    4, 0x4e7212bc, 0x7d210411, 0xccac935c},
+	{0x3ce0216c, 3687,    7, 0xdb44ea7c, 0x72e82ed5, 0xb1620a92},
+	{0x0639f08b, 2032,    8, 0xbc9505ec, 0x94e30742, 0xbfdbecbd},
+	{0x00000000, 2950,    9, 0x972453d7, 0x8aa04dc9, 0xdffcee8b},
+	{0x19a90675,  157,   15, 0x96b07e05, 0x1de39eb6, 0x25e184df},
+	{0x82490b3b, 1330,   16, 0x4a29d4a8, 0xdcefd295, 0xf69c3d0f},
+	{0xffffffff, 1353,   31, 0x043705a4, 0x31baedeb, 0x5176f8d2},
+	{0x0e9ba56d, 3453,   63, 0xab210276, 0x97a04cf2, 0xedead68e},
+	{0xb0c9049e, 2141,   64, 0xb29ff047, 0x390e5e0f, 0x13ef8a5f},
+	{0x00000000, 3869,  100, 0x42d32719, 0xbae932bb, 0x3be56cd4},
+	{0x78015f97, 3611,  255, 0xd5aec706, 0x085f90fd, 0xc6e9a0e1},
+	{0x99e90c3b, 1519,  512, 0xe13ec7fe, 0x962ed9c9, 0x4ba9ee21},
+	{0xffffffff,    3, 1000, 0xe40fd3e9, 0x0a319c26, 0x9617e199},
+	{0x86502637,  517, 2047, 0xde4c8aaf, 0x083d089a, 0x5d754961},
+	{0x7c47ba50,    1, 4000, 0x05f7a72b, 0xa92a5511, 0xb1b2eff6},
+	{0x00000000,  415, 2992, 0xad430a22, 0x4b995424, 0x336f29e0},
+	{0x723deaa9,  826, 1178, 0x15e19dbf, 0x98a55467, 0x0e4840a6},
+	{0x1ee979f5, 1368,  333, 0xa5bdc607, 0x5aaf1947, 0xa67a5835},
+	{0xffffffff, 2152,  144, 0x9da2696f, 0xb9000f88, 0xd6acdb18},
+	{0x28d7c5d4, 2980,  458, 0xcfb4c1f0, 0xc9422c3a, 0x8d05fd27},
+	{0x6e6f79d6,   82, 1797, 0x39c351f6, 0x3580ec24, 0xe62a5c93},
+	{0x00000000, 3775,  202, 0xb2d0b6e5, 0xf293977c, 0x3cb42060},
+	{0x5a605483, 2275,  156, 0x819e4699, 0x9a0a4777, 0xded43efd},
+	{0x77cf2f4c,  668,  928, 0x06300f00, 0x95a77809, 0x03926a24},
+	{0xffffffff, 2016, 1268, 0x5b0c0061, 0xce5c3f5b, 0xb7ea06f0},
+	{0xd079a78d, 2189,  686, 0x2ecd579e, 0x6a6f59db, 0x00f05979},
+	{0x9372b5c2, 2328, 1225, 0x6437b314, 0x03aa3bb8, 0xa0e3d687},
+	{0x00000000,  168, 2358, 0x34c4934e, 0xf7142af0, 0x1c050447},
+	{0x4a4b5db1, 2404,  135, 0x7645871c, 0x64c9eb93, 0x608c0541},
+	{0x5458af07, 1181,  939, 0x3e3ac0f9, 0xd77f52e3, 0xb07620dd},
+	{0xffffffff,  999,  322, 0xb1e6ed7d, 0xf4fc2828, 0xc98d50a9},
+	{0xd762da4d,  820, 2715, 0x879e73e4, 0x1b0a7b61, 0xf5aa088e},
+	{0xb256dbba, 1747, 1185, 0xd28d8e52, 0x929eca2f, 0xe8c26e2b},
+	{0x00000000, 3249,  285, 0x62c83a8c, 0x4ad6f8f5, 0x9021066e},
+	{0xd00c4cd8,   37, 1952, 0xb28f60cd, 0xeff7809d, 0xf6a520e4},
+	{0x29b425c3, 1824,  737, 0x402014b6, 0xda848b1b, 0xd97f1c95},
+	{0xffffffff,  186, 2876, 0x8dd4c59b, 0xc2ecf7e4, 0xeb36e4fb},
+};
+
+/* Same generator as the one used to compute crc32_test[] */
+static void __init crc32_test_fill(void)
+{
+	u32 seed = 0x12345678;
+	int i;
+
+	for (i = 0; i < CRC32_TEST_BUF_SIZE; i++) {
+		seed = seed * 1103515245 + 12345;
+		crc32_test_buf[i] = seed >> 16;
+	}
+}
+
+static void __init crc32_bench(const char *name,
+			       u32 __pure (*fn)(u32, unsigned char const *,
+						size_t))
+{
+	u64 bytes = (u64)CRC32_BENCH_LOOPS * CRC32_TEST_BUF_SIZE;
+	volatile u32 crc = 0;
+	ktime_t start;
+	s64 ns;
+	int i;
+
+	local_irq_disable();
+	start = ktime_get();
+	for (i = 0; i < CRC32_BENCH_LOOPS; i++)
+		crc = fn(crc, crc32_test_buf, CRC32_TEST_BUF_SIZE);
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	local_irq_enable();
+
+	printk(KERN_INFO "crc32: %s: %llu bytes in %lld nsec, %llu KB/s\n",
+	       name, (unsigned long long)bytes, (long long)ns,
+	       (unsigned long long)div64_u64(bytes * 1000000000ULL,
+					     max_t(s64, ns, 1) * 1024));
+}
+
+static int __init crc32test_init(void)
+{
+	int i;
+	int errors = 0;
+
+	crc32_test_fill();
+
+	for (i = 0; i < ARRAY_SIZE(crc32_test); i++) {
+		const struct crc32_test *t = &crc32_test[i];
+		const u8 *p = crc32_test_buf + t->start;
+
+		if (crc32_le(t->crc, p, t->length) != t->crc_le)
+			errors++;
+		if (crc32_be(t->crc, p, t->length) != t->crc_be)
+			errors++;
+		if (__crc32c_le(t->crc, p, t->length) != t->crc32c_le)
+			errors++;
+	}
+
+	printk(KERN_INFO "crc32: CRC_LE_BITS = %d, CRC_BE_BITS = %d, "
+	       "%d slices\n", CRC_LE_BITS, CRC_BE_BITS, CRC32_SLICES);
+
+	if (errors) {
+		printk(KERN_WARNING "crc32: %d self tests failed\n", errors);
+		return 0;
+	}
+	printk(KERN_INFO "crc32: self tests passed\n");
+
+	crc32_bench("crc32_le", crc32_le);
+	crc32_bench("crc32_be", crc32_be);
+	crc32_bench("crc32c_le", __crc32c_le);
+
+	return 0;
+}
+
+module_init(crc32test_init);
+
+#endif /* CONFIG_CRC32_SELFTEST */
+
 #ifdef UNITTEST
 
 #include <stdlib.h>
@@ -6,6 +6,13 @@
 #define CRCPOLY_LE 0xedb88320
 #define CRCPOLY_BE 0x04c11db7
 
+/*
+ * This is the CRC32c polynomial, as outlined by Castagnoli.
+ * x^32+x^28+x^27+x^26+x^25+x^23+x^22+x^20+x^19+x^18+x^14+x^13+x^11+x^10+x^9+
+ * x^8+x^6+x^0
+ */
+#define CRC32C_POLY_LE 0x82F63B78
+
 /* How many bits at a time to use.  Requires a table of 4<<CRC_xx_BITS bytes. */
 /* For less performance-sensitive, use 4 */
 #ifndef CRC_LE_BITS 
@@ -15,6 +22,19 @@
 # define CRC_BE_BITS 8
 #endif
 
+/*
+ * With 8 bits at a time, how many bytes the main loop folds per step:
+ * 4 or 8, using as many 1KB tables.  8 ("slicing-by-8") is faster on
+ * anything with a decent data cache, 4 keeps the tables at 4KB.
+ */
+#ifndef CRC32_SLICES
+# ifdef CONFIG_CRC32_SLICEBY4
+#  define CRC32_SLICES 4
+# else
+#  define CRC32_SLICES 8
+# endif
+#endif
+
 /*
  * Little-endian CRC computation.  Used with serial bit streams sent
  * lsbit-first.  Be sure to use cpu_to_le32() to append the computed CRC.
@@ -30,3 +50,7 @@
 #if CRC_BE_BITS > 8 || CRC_BE_BITS < 1 || CRC_BE_BITS & CRC_BE_BITS-1
 # error CRC_BE_BITS must be a power of 2 between 1 and 8
 #endif
+
+#if CRC32_SLICES != 4 && CRC32_SLICES != 8
+# error CRC32_SLICES must be 4 or 8
+#endif
@@ -102,6 +102,8 @@ STATIC inline int INIT unlz4(u8 *input, int in_len,
 
 		if (fill)
 			fill(inp, 4);
+		else if (size < 4)
+			break;	/* end of the buffer */
 
 		chunksize = get_unaligned_le32(inp);
 		if (chunksize == ARCHIVE_MAGICNUMBER) {
@@ -111,6 +113,14 @@ STATIC inline int INIT unlz4(u8 *input, int in_len,
 				*posp += 4;
 			continue;
 		}
+
+		/*
+		 * An archive in memory may be followed by zero padding, or
+		 * by another one as in an initramfs: stop before either and
+		 * let *posp tell the caller where.
+		 */
+		if (!fill && chunksize == 0)
+			break;
 		inp += 4;
 		size -= 4;
 
@@ -14,6 +14,9 @@
 #include <linux/backing-dev.h>
 #include <linux/sysctl.h>
 #include <linux/sysfs.h>
+#include <linux/kthread.h>
+#include <linux/freezer.h>
+#include <linux/timer.h>
 #include "internal.h"
 
 /*
@@ -38,6 +41,8 @@ struct compact_control {
 	unsigned int order;		/* order a direct compactor needs */
 	int migratetype;		/* MOVABLE, RECLAIMABLE etc */
 	struct zone *zone;
+
+	bool kcompactd;			/* Background compaction by kcompactd */
 };
 
 static unsigned long release_freepages(struct list_head *freelist)
@@ -354,6 +359,16 @@ static int compact_finished(struct zone *zone,
 	if (cc->free_pfn <= cc->migrate_pfn)
 		return COMPACT_COMPLETE;
 
+	/* kcompactd: Is the zone's reserve of high-order pages back? */
+	if (cc->kcompactd) {
+		if (kthread_should_stop())
+			return COMPACT_PARTIAL;
+		if (zone_watermark_ok(zone, cc->order, high_wmark_pages(zone),
+				      0, 0))
+			return COMPACT_PARTIAL;
+		return COMPACT_CONTINUE;
+	}
+
 	/* Compaction run is not finished if the watermark is not met */
 	if (!zone_watermark_ok(zone, cc->order, watermark, 0, 0))
 		return COMPACT_CONTINUE;
@@ -604,3 +619,222 @@ void compaction_unregister_node(struct node *node)
 	return sysdev_remove_file(&node->sysdev, &attr_compact);
 }
 #endif /* CONFIG_SYSFS && CONFIG_NUMA */
+
+int sysctl_compact_daemon_order = PAGE_ALLOC_COSTLY_ORDER;
+int sysctl_compact_daemon_centisecs = 50;
+int sysctl_compact_daemon_cpu_percent = 10;
+
+/*
+ * kcompactd keeps enough free pages of sysctl_compact_daemon_order and
+ * above around that order-2+ allocations, which are never directly
+ * compacted for, do not have to fail or reclaim. A zone is worth
+ * compacting when it falls short of the high watermark at that order
+ * although it has the free pages to meet it, and its fragmentation index
+ * says fragmentation rather than lack of memory is why.
+ */
+static bool kcompactd_zone_suitable(struct zone *zone, int order)
+{
+	unsigned long watermark = high_wmark_pages(zone);
+	int fragindex;
+
+	if (zone_watermark_ok(zone, order, watermark, 0, 0))
+		return false;
+
+	/* Migration needs free pages to copy to, as in direct compaction */
+	if (!zone_watermark_ok(zone, 0, watermark + (2UL << order), 0, 0))
+		return false;
+
+	fragindex = fragmentation_index(zone, order);
+	return fragindex < 0 || fragindex > sysctl_extfrag_threshold;
+}
+
+/* Returns true if a zone could not be brought up to its watermark */
+static bool kcompactd_do_work(pg_data_t *pgdat, int order)
+{
+	bool woken = false, failed = false;
+	int zoneid;
+
+	for (zoneid = 0; zoneid < MAX_NR_ZONES; zoneid++) {
+		struct zone *zone = &pgdat->node_zones[zoneid];
+		struct compact_control cc = {
+			.nr_freepages = 0,
+			.nr_migratepages = 0,
+			.order = order,
+			.migratetype = MIGRATE_MOVABLE,
+			.zone = zone,
+			.kcompactd = true,
+		};
+
+		if (!populated_zone(zone) ||
+		    !kcompactd_zone_suitable(zone, order))
+			continue;
+
+		if (!woken) {
+			count_vm_event(KCOMPACTD_WAKE);
+			lru_add_drain();
+			woken = true;
+		}
+
+		INIT_LIST_HEAD(&cc.freepages);
+		INIT_LIST_HEAD(&cc.migratepages);
+
+		compact_zone(zone, &cc);
+
+		VM_BUG_ON(!list_empty(&cc.freepages));
+		VM_BUG_ON(!list_empty(&cc.migratepages));
+
+		if (zone_watermark_ok(zone, order, high_wmark_pages(zone),
+				      0, 0)) {
+			count_vm_event(KCOMPACTD_SUCCESS);
+		} else {
+			count_vm_event(KCOMPACTD_FAIL);
+			failed = true;
+		}
+	}
+
+	return failed;
+}
+
+/* Polls a node that was left short of high-order pages */
+static void kcompactd_poll(unsigned long data)
+{
+	pg_data_t *pgdat = (pg_data_t *)data;
+
+	if (!pgdat->kcompactd_max_order)
+		pgdat->kcompactd_max_order = sysctl_compact_daemon_order;
+	wake_up_interruptible(&pgdat->kcompactd_wait);
+}
+
+static void kcompactd_kick(pg_data_t *pgdat, int order)
+{
+	if (!pgdat->kcompactd || !sysctl_compact_daemon_order)
+		return;
+	if (!waitqueue_active(&pgdat->kcompactd_wait))
+		return;
+	/* Backing off after a failure, kcompactd_poll() will check again */
+	if (timer_pending(&pgdat->kcompactd_timer))
+		return;
+
+	if (pgdat->kcompactd_max_order < order)
+		pgdat->kcompactd_max_order = order;
+	wake_up_interruptible(&pgdat->kcompactd_wait);
+}
+
+/*
+ * The background compaction daemon. It sleeps until a high-order
+ * allocation drops into the slow path or kswapd has balanced the node.
+ * After compacting it sleeps long enough to keep its share of a CPU under
+ * sysctl_compact_daemon_cpu_percent, ignoring wakeups meanwhile. Only when
+ * compaction left a zone short of its watermark does it poll again, on a
+ * deferrable timer every sysctl_compact_daemon_centisecs, backing off
+ * exponentially while compaction keeps failing.
+ */
+static int kcompactd(void *p)
+{
+	pg_data_t *pgdat = p;
+	const struct cpumask *cpumask = cpumask_of_node(pgdat->node_id);
+	unsigned int defer_shift = 0;
+
+	if (!cpumask_empty(cpumask))
+		set_cpus_allowed_ptr(current, cpumask);
+	set_freezable();
+	set_user_nice(current, 19);
+
+	while (!kthread_should_stop()) {
+		unsigned long interval, start, busy, pause;
+		int order, pct;
+		bool failed;
+
+		wait_event_freezable(pgdat->kcompactd_wait,
+				pgdat->kcompactd_max_order ||
+				kthread_should_stop());
+		if (kthread_should_stop())
+			break;
+
+		order = max(pgdat->kcompactd_max_order,
+			    sysctl_compact_daemon_order);
+		pgdat->kcompactd_max_order = 0;
+		if (!sysctl_compact_daemon_order)
+			continue;
+
+		start = jiffies;
+		failed = kcompactd_do_work(pgdat, order);
+		busy = jiffies - start;
+
+		pct = sysctl_compact_daemon_cpu_percent;
+		pause = busy * (100 - pct) / pct;
+		if (failed) {
+			if (defer_shift < COMPACT_MAX_DEFER_SHIFT)
+				defer_shift++;
+			interval = msecs_to_jiffies(
+					sysctl_compact_daemon_centisecs * 10);
+			mod_timer(&pgdat->kcompactd_timer, jiffies +
+				  (max(pause, interval) << defer_shift));
+		} else {
+			defer_shift = 0;
+			del_timer(&pgdat->kcompactd_timer);
+		}
+
+		if (pause) {
+			schedule_timeout_interruptible(pause);
+			try_to_freeze();
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * wakeup_kcompactd - Kick background compaction for a high-order allocation
+ * @zone: The zone the allocation fell below the low watermark in
+ * @order: The order of the allocation
+ *
+ * Called from the allocator slow path. Wakeups while kcompactd is busy,
+ * pausing or backing off are dropped, that is what rate limits it.
+ */
+void wakeup_kcompactd(struct zone *zone, int order)
+{
+	/*
+	 * Order-1 allocations rarely fail for fragmentation, and above
+	 * PAGE_ALLOC_COSTLY_ORDER direct compaction takes over
+	 */
+	if (order < 2 || order > PAGE_ALLOC_COSTLY_ORDER)
+		return;
+
+	kcompactd_kick(zone->zone_pgdat, order);
+}
+
+/**
+ * wakeup_kcompactd_node - Kick background compaction after reclaim
+ * @pgdat: The node kswapd has balanced
+ *
+ * Called by kswapd before it goes to sleep, as the pages it freed may be
+ * what a fragmented zone needed to be worth compacting.
+ */
+void wakeup_kcompactd_node(pg_data_t *pgdat)
+{
+	kcompactd_kick(pgdat, sysctl_compact_daemon_order);
+}
+
+static int __init kcompactd_init(void)
+{
+	int nid;
+
+	for_each_node_state(nid, N_HIGH_MEMORY) {
+		pg_data_t *pgdat = NODE_DATA(nid);
+
+		init_timer_deferrable(&pgdat->kcompactd_timer);
+		pgdat->kcompactd_timer.data = (unsigned long)pgdat;
+		pgdat->kcompactd_timer.function = kcompactd_poll;
+
+		pgdat->kcompactd = kthread_run(kcompactd, pgdat,
+					       "kcompactd%d", nid);
+		if (IS_ERR(pgdat->kcompactd)) {
+			printk(KERN_ERR "Failed to start kcompactd on node %d\n",
+			       nid);
+			pgdat->kcompactd = NULL;
+		}
+	}
+	return 0;
+}
+module_init(kcompactd_init)
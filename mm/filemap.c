@@ -465,6 +465,115 @@ int add_to_page_cache_lru(struct page *page, struct address_space *mapping,
 }
 EXPORT_SYMBOL_GPL(add_to_page_cache_lru);
 
+/**
+ * add_to_page_cache_lru_batch - add new pages to the pagecache and the LRU
+ * @pvec:	the pages, with their ->index set
+ * @mapping:	the pages' address_space
+ * @gfp_mask:	page allocation mode
+ *
+ * This does what add_to_page_cache_lru() does for each page in @pvec, but
+ * inserts them all under one tree_lock hold and adds them to the LRU under
+ * one lru_lock hold, which is what readahead wants. The pages which were
+ * added are left locked in @pvec, and the caller still owns its reference
+ * to them. The others are released and removed from @pvec.
+ *
+ * All of @pvec is in the page cache, locked, before any of it is read, so
+ * this is only for ->readpages implementations which read the pages
+ * themselves. A ->readpage which looks up the following pages with
+ * find_or_create_page() or the like would deadlock on them.
+ */
+void add_to_page_cache_lru_batch(struct pagevec *pvec,
+		struct address_space *mapping, gfp_t gfp_mask)
+{
+	int swap_backed = mapping_cap_swap_backed(mapping);
+	int error[PAGEVEC_SIZE];
+	struct pagevec lru_pvec;
+	struct page *page;
+	int i, nr = 0;
+
+	/* Charging may reclaim, so do it before taking the lock */
+	for (i = 0; i < pagevec_count(pvec); i++) {
+		page = pvec->pages[i];
+		if (swap_backed)
+			SetPageSwapBacked(page);
+		if (mem_cgroup_cache_charge(page, current->mm,
+					    gfp_mask & GFP_RECLAIM_MASK)) {
+			page_cache_release(page);
+			continue;
+		}
+		__set_page_locked(page);
+		pvec->pages[nr++] = page;
+	}
+	pvec->nr = nr;
+	nr = 0;
+
+	if (radix_tree_preload(gfp_mask & ~__GFP_HIGHMEM)) {
+		for (i = 0; i < pagevec_count(pvec); i++) {
+			page = pvec->pages[i];
+			mem_cgroup_uncharge_cache_page(page);
+			__clear_page_locked(page);
+			page_cache_release(page);
+		}
+		pagevec_reinit(pvec);
+		return;
+	}
+
+	spin_lock_irq(&mapping->tree_lock);
+	for (i = 0; i < pagevec_count(pvec); i++) {
+		page = pvec->pages[i];
+		page_cache_get(page);
+		page->mapping = mapping;
+		error[i] = radix_tree_insert(&mapping->page_tree, page->index,
+					     page);
+		if (likely(!error[i])) {
+			mapping->nrpages++;
+			__inc_zone_page_state(page, NR_FILE_PAGES);
+			if (PageSwapBacked(page))
+				__inc_zone_page_state(page, NR_SHMEM);
+		} else
+			page->mapping = NULL;
+	}
+	spin_unlock_irq(&mapping->tree_lock);
+	radix_tree_preload_end();
+	count_vm_event(PGRA_TREE_LOCK);
+
+	pagevec_init(&lru_pvec, 0);
+	for (i = 0; i < pagevec_count(pvec); i++) {
+		page = pvec->pages[i];
+		if (unlikely(error[i])) {
+			mem_cgroup_uncharge_cache_page(page);
+			page_cache_release(page);
+			/*
+			 * Only the first insertion was preloaded, the others
+			 * mostly share its node. If one needed a node of its
+			 * own and the atomic allocation failed, retry it alone.
+			 */
+			if (error[i] == -ENOMEM) {
+				error[i] = add_to_page_cache_locked(page,
+						mapping, page->index, gfp_mask);
+				count_vm_event(PGRA_TREE_LOCK);
+			}
+			if (error[i]) {
+				__clear_page_locked(page);
+				page_cache_release(page);
+				continue;
+			}
+		}
+		page_cache_get(page);
+		pagevec_add(&lru_pvec, page);
+		pvec->pages[nr++] = page;
+	}
+	pvec->nr = nr;
+
+	if (nr) {
+		____pagevec_lru_add(&lru_pvec, swap_backed ?
+				    LRU_INACTIVE_ANON : LRU_INACTIVE_FILE);
+		count_vm_event(PGRA_LRU_LOCK);
+		count_vm_events(PGRA_PAGES, nr);
+	}
+}
+EXPORT_SYMBOL_GPL(add_to_page_cache_lru_batch);
+
 #ifdef CONFIG_NUMA
 struct page *__page_cache_alloc(gfp_t gfp)
 {
@@ -1506,8 +1615,9 @@ static void do_sync_mmap_readahead(struct vm_area_struct *vma,
 	/*
 	 * mmap read-around
 	 */
-	ra_pages = max_sane_readahead(ra->ra_pages);
+	ra_pages = ra_adaptive_max(ra, max_sane_readahead(ra->ra_pages));
 	if (ra_pages) {
+		ra_account_window(mapping, ra, ra->start, ra->size, offset);
 		ra->start = max_t(long, 0, offset - ra_pages/2);
 		ra->size = ra_pages;
 		ra->async_size = 0;
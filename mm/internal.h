@@ -252,6 +252,10 @@ int __get_user_pages(struct task_struct *tsk, struct mm_struct *mm,
 #define ZONE_RECLAIM_SUCCESS	1
 #endif
 
+void ra_account_window(struct address_space *mapping, struct file_ra_state *ra,
+		       pgoff_t start, unsigned long size, pgoff_t offset);
+unsigned long ra_adaptive_max(struct file_ra_state *ra, unsigned long max);
+
 extern int hwpoison_filter(struct page *p);
 
 extern u32 hwpoison_filter_dev_major;
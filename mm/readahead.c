@@ -18,6 +18,8 @@
 #include <linux/pagevec.h>
 #include <linux/pagemap.h>
 
+#include "internal.h"
+
 unsigned long max_readahead_pages = VM_MAX_READAHEAD * 1024 / PAGE_CACHE_SIZE;
 
 static int __init readahead(char *str)
@@ -57,10 +59,94 @@ void
 file_ra_state_init(struct file_ra_state *ra, struct address_space *mapping)
 {
 	ra->ra_pages = mapping->backing_dev_info->ra_pages;
+	ra->ra_hit = ra->ra_miss = 0;
 	ra->prev_pos = -1;
 }
 EXPORT_SYMBOL_GPL(file_ra_state_init);
 
+int sysctl_readahead_adaptive __read_mostly;
+
+/*
+ * Adaptive readahead.
+ *
+ * When a new readahead window replaces the old one, the pages of the old
+ * window before the current read position are looked up: those which were
+ * referenced, activated or mapped since count as hits, those left untouched
+ * or already evicted as misses. The counts decay, so that they follow the
+ * recent behaviour of the file, and scale its maximum window.
+ */
+#define RA_HISTORY_MIN	32
+#define RA_HISTORY_MAX	1024
+
+void ra_account_window(struct address_space *mapping, struct file_ra_state *ra,
+		       pgoff_t start, unsigned long size, pgoff_t offset)
+{
+	struct page *pages[PAGEVEC_SIZE];
+	unsigned long hit = 0, miss;
+	pgoff_t index = start, end = start + size;
+	unsigned int i, nr;
+
+	if (!sysctl_readahead_adaptive || !size)
+		return;
+
+	/* Still reading the window, the rest of it is yet to be seen */
+	if (offset > start && offset < end)
+		end = offset;
+
+	while (index < end) {
+		nr = find_get_pages(mapping, index,
+				    min_t(unsigned long, end - index,
+					  PAGEVEC_SIZE), pages);
+		if (!nr)
+			break;
+		for (i = 0; i < nr; i++) {
+			struct page *page = pages[i];
+
+			if (page->index < end &&
+			    (PageReferenced(page) || PageActive(page) ||
+			     page_mapped(page)))
+				hit++;
+			page_cache_release(page);
+		}
+		index = pages[nr - 1]->index + 1;
+	}
+	miss = end - start - hit;
+
+	count_vm_events(PGRA_HIT, hit);
+	count_vm_events(PGRA_MISS, miss);
+
+	hit += ra->ra_hit;
+	miss += ra->ra_miss;
+	while (hit + miss > RA_HISTORY_MAX) {
+		hit >>= 1;
+		miss >>= 1;
+	}
+	ra->ra_hit = hit;
+	ra->ra_miss = miss;
+}
+
+unsigned long ra_adaptive_max(struct file_ra_state *ra, unsigned long max)
+{
+	unsigned long total = ra->ra_hit + ra->ra_miss;
+
+	if (!sysctl_readahead_adaptive || total < RA_HISTORY_MIN || !max)
+		return max;
+
+	if (ra->ra_miss * 4 > total * 3) {
+		count_vm_event(PGRA_SHRINK);
+		return max(max / 4, 1UL);
+	}
+	if (ra->ra_miss * 2 > total) {
+		count_vm_event(PGRA_SHRINK);
+		return max(max / 2, 1UL);
+	}
+	if (ra->ra_miss * 10 < total) {
+		count_vm_event(PGRA_GROW);
+		return max_sane_readahead(max * 2);
+	}
+	return max;
+}
+
 #define list_to_page(head) (list_entry((head)->prev, struct page, lru))
 
 /*
@@ -150,6 +236,11 @@ static int read_pages(struct address_space *mapping, struct file *filp,
 		goto out;
 	}
 
+	/*
+	 * Not add_to_page_cache_lru_batch(): ->readpage may look up the
+	 * following pages (e.g. UBIFS bulk read) and would then sleep on
+	 * their page locks, which are ours, were they in the cache already.
+	 */
 	for (page_idx = 0; page_idx < nr_pages; page_idx++) {
 		struct page *page = list_to_page(pages);
 		list_del(&page->lru);
@@ -424,6 +515,10 @@ ondemand_readahead(struct address_space *mapping,
 		   unsigned long req_size)
 {
 	unsigned long max = max_sane_readahead(ra->ra_pages);
+	pgoff_t prev_start = ra->start;
+	unsigned long prev_size = ra->size;
+
+	max = ra_adaptive_max(ra, max);
 
 	/*
 	 * start of file
@@ -498,6 +593,8 @@ initial_readahead:
 	ra->async_size = ra->size > req_size ? ra->size - req_size : ra->size;
 
 readit:
+	ra_account_window(mapping, ra, prev_start, prev_size, offset);
+
 	/*
 	 * Will this read hit the readahead marker made by itself?
 	 * If so, trigger the readahead marker hit now, and merge
@@ -41,6 +41,12 @@
 #include <linux/memcontrol.h>
 #include <linux/delayacct.h>
 #include <linux/sysctl.h>
+#include <linux/ktime.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/math64.h>
+#include <linux/kallsyms.h>
+#include <linux/compaction.h>
 
 #include <asm/tlbflush.h>
 #include <asm/div64.h>
@@ -49,6 +55,9 @@
 
 #include "internal.h"
 
+#define CREATE_TRACE_POINTS
+#include <trace/events/vmscan.h>
+
 struct scan_control {
 	/* Incremented by the number of inactive pages that were scanned */
 	unsigned long nr_scanned;
@@ -131,6 +140,77 @@ long vm_total_pages;	/* The total number of pages which the VM controls */
 static LIST_HEAD(shrinker_list);
 static DECLARE_RWSEM(shrinker_rwsem);
 
+/*
+ * The phases of reclaim which are timed. Their latencies are traced, and
+ * with CONFIG_VMSCAN_STATS accounted when they are part of direct reclaim.
+ */
+enum reclaim_phase {
+	RECLAIM_TOTAL,
+	RECLAIM_SHRINK_ZONE,
+	RECLAIM_SHRINK_SLAB,
+	RECLAIM_PAGEOUT,
+	RECLAIM_CONGESTION_WAIT,
+	NR_RECLAIM_PHASES
+};
+
+static inline u64 reclaim_clock(void)
+{
+	return ktime_to_ns(ktime_get());
+}
+
+/*
+ * Direct reclaim is done by allocating tasks. They set up a reclaim_state,
+ * as kswapd does, and unlike e.g. drop_caches.
+ */
+static inline bool in_direct_reclaim(void)
+{
+	return current->reclaim_state && !current_is_kswapd();
+}
+
+#ifdef CONFIG_VMSCAN_STATS
+static DEFINE_SPINLOCK(reclaim_latency_lock);
+static struct reclaim_latency reclaim_phase_latency[NR_RECLAIM_PHASES];
+
+static void reclaim_latency_add(struct reclaim_latency *lat, u64 ns)
+{
+	u64 us = div_u64(ns, NSEC_PER_USEC);
+	int bucket;
+
+	bucket = us >> 31 ? RECLAIM_LATENCY_BUCKETS - 1 : fls(us);
+	if (bucket >= RECLAIM_LATENCY_BUCKETS)
+		bucket = RECLAIM_LATENCY_BUCKETS - 1;
+
+	spin_lock(&reclaim_latency_lock);
+	lat->count++;
+	lat->total_ns += ns;
+	if (ns > lat->max_ns)
+		lat->max_ns = ns;
+	lat->hist[bucket]++;
+	spin_unlock(&reclaim_latency_lock);
+}
+#endif
+
+/* Returns the time since @start, accounting it to @phase in direct reclaim */
+static u64 reclaim_phase_end(enum reclaim_phase phase, u64 start)
+{
+	u64 delta = reclaim_clock() - start;
+
+#ifdef CONFIG_VMSCAN_STATS
+	if (in_direct_reclaim())
+		reclaim_latency_add(&reclaim_phase_latency[phase], delta);
+#endif
+	return delta;
+}
+
+static void reclaim_congestion_wait(void)
+{
+	u64 start = reclaim_clock();
+
+	congestion_wait(BLK_RW_ASYNC, HZ/10);
+	trace_mm_vmscan_congestion_wait(
+		reclaim_phase_end(RECLAIM_CONGESTION_WAIT, start));
+}
+
 #ifdef CONFIG_CGROUP_MEM_RES_CTLR
 #define scanning_global_lru(sc)	(!(sc)->mem_cgroup)
 #else
@@ -162,6 +242,9 @@ static unsigned long zone_nr_lru_pages(struct zone *zone,
 void register_shrinker(struct shrinker *shrinker)
 {
 	shrinker->nr = 0;
+#ifdef CONFIG_VMSCAN_STATS
+	memset(&shrinker->latency, 0, sizeof(shrinker->latency));
+#endif
 	down_write(&shrinker_rwsem);
 	list_add_tail(&shrinker->list, &shrinker_list);
 	up_write(&shrinker_rwsem);
@@ -204,6 +287,7 @@ unsigned long shrink_slab(unsigned long scanned, gfp_t gfp_mask,
 {
 	struct shrinker *shrinker;
 	unsigned long ret = 0;
+	u64 start;
 
 	if (scanned == 0)
 		scanned = SWAP_CLUSTER_MAX;
@@ -211,10 +295,13 @@ unsigned long shrink_slab(unsigned long scanned, gfp_t gfp_mask,
 	if (!down_read_trylock(&shrinker_rwsem))
 		return 1;	/* Assume we'll be able to shrink next time */
 
+	start = reclaim_clock();
 	list_for_each_entry(shrinker, &shrinker_list, list) {
 		unsigned long long delta;
 		unsigned long total_scan;
 		unsigned long max_pass;
+		unsigned long nr_scanned = 0, nr_freed = 0;
+		u64 shrinker_start = reclaim_clock(), shrinker_ns;
 
 		max_pass = (*shrinker->shrink)(shrinker, 0, gfp_mask);
 		delta = (4 * scanned) / shrinker->seeks;
@@ -250,15 +337,26 @@ unsigned long shrink_slab(unsigned long scanned, gfp_t gfp_mask,
 			if (shrink_ret == -1)
 				break;
 			if (shrink_ret < nr_before)
-				ret += nr_before - shrink_ret;
+				nr_freed += nr_before - shrink_ret;
 			count_vm_events(SLABS_SCANNED, this_scan);
+			nr_scanned += this_scan;
 			total_scan -= this_scan;
 
 			cond_resched();
 		}
 
 		shrinker->nr += total_scan;
+		ret += nr_freed;
+
+		shrinker_ns = reclaim_clock() - shrinker_start;
+		trace_mm_vmscan_shrink_slab(shrinker, nr_scanned, nr_freed,
+					    shrinker_ns);
+#ifdef CONFIG_VMSCAN_STATS
+		if (in_direct_reclaim())
+			reclaim_latency_add(&shrinker->latency, shrinker_ns);
+#endif
 	}
+	reclaim_phase_end(RECLAIM_SHRINK_SLAB, start);
 	up_read(&shrinker_rwsem);
 	return ret;
 }
@@ -722,6 +820,9 @@ static unsigned long shrink_page_list(struct list_head *page_list,
 		}
 
 		if (PageDirty(page)) {
+			pageout_t written;
+			u64 start;
+
 			if (references == PAGEREF_RECLAIM_CLEAN)
 				goto keep_locked;
 			if (!may_enter_fs)
@@ -730,7 +831,11 @@ static unsigned long shrink_page_list(struct list_head *page_list,
 				goto keep_locked;
 
 			/* Page is dirty, try to write it out here */
-			switch (pageout(page, mapping, sync_writeback)) {
+			start = reclaim_clock();
+			written = pageout(page, mapping, sync_writeback);
+			trace_mm_vmscan_pageout(page, written,
+				reclaim_phase_end(RECLAIM_PAGEOUT, start));
+			switch (written) {
 			case PAGE_KEEP:
 				goto keep_locked;
 			case PAGE_ACTIVATE:
@@ -1176,7 +1281,7 @@ static unsigned long shrink_inactive_list(unsigned long max_scan,
 		 */
 		if (nr_freed < nr_taken && !current_is_kswapd() &&
 		    sc->lumpy_reclaim_mode) {
-			congestion_wait(BLK_RW_ASYNC, HZ/10);
+			reclaim_congestion_wait();
 
 			/*
 			 * The attempt at page out may have made some
@@ -1641,6 +1746,8 @@ static void shrink_zone(int priority, struct zone *zone,
 	enum lru_list l;
 	unsigned long nr_reclaimed = sc->nr_reclaimed;
 	unsigned long nr_to_reclaim = sc->nr_to_reclaim;
+	unsigned long nr_before = sc->nr_reclaimed;
+	u64 start = reclaim_clock();
 
 	get_scan_count(zone, sc, nr, priority);
 
@@ -1680,6 +1787,10 @@ static void shrink_zone(int priority, struct zone *zone,
 		shrink_active_list(SWAP_CLUSTER_MAX, zone, sc, priority, 0);
 
 	throttle_vm_writeout(sc->gfp_mask);
+
+	trace_mm_vmscan_shrink_zone(zone, priority,
+				    sc->nr_reclaimed - nr_before,
+				    reclaim_phase_end(RECLAIM_SHRINK_ZONE, start));
 }
 
 /*
@@ -1876,7 +1987,7 @@ static unsigned long do_try_to_free_pages(struct zonelist *zonelist,
 		/* Take a nap, wait for some writeback to complete */
 		if (!sc->hibernation_mode && sc->nr_scanned &&
 		    priority < DEF_PRIORITY - 2)
-			congestion_wait(BLK_RW_ASYNC, HZ/10);
+			reclaim_congestion_wait();
 	}
 
 out:
@@ -1928,8 +2039,18 @@ unsigned long try_to_free_pages(struct zonelist *zonelist, int order,
 		.mem_cgroup = NULL,
 		.nodemask = nodemask,
 	};
+	unsigned long nr_reclaimed;
+	u64 start = reclaim_clock();
 
-	return do_try_to_free_pages(zonelist, &sc);
+	trace_mm_vmscan_direct_reclaim_begin(order, sc.may_writepage,
+					     gfp_mask);
+
+	nr_reclaimed = do_try_to_free_pages(zonelist, &sc);
+
+	trace_mm_vmscan_direct_reclaim_end(nr_reclaimed,
+				reclaim_phase_end(RECLAIM_TOTAL, start));
+
+	return nr_reclaimed;
 }
 
 #ifdef CONFIG_CGROUP_MEM_RES_CTLR
@@ -2331,9 +2452,10 @@ static int kswapd(void *p)
 				 * premature sleep. If not, then go fully
 				 * to sleep until explicitly woken up
 				 */
-				if (!sleeping_prematurely(pgdat, order, remaining))
+				if (!sleeping_prematurely(pgdat, order, remaining)) {
+					wakeup_kcompactd_node(pgdat);
 					schedule();
-				else {
+				} else {
 					if (remaining)
 						count_vm_event(KSWAPD_LOW_WMARK_HIT_QUICKLY);
 					else
@@ -3018,3 +3140,174 @@ void scan_unevictable_unregister_node(struct node *node)
 	sysdev_remove_file(&node->sysdev, &attr_scan_unevictable_pages);
 }
 
+
+#ifdef CONFIG_VMSCAN_STATS
+/*
+ * Direct reclaim latency statistics, in /sys/kernel/debug/vmscan/. The
+ * "direct_reclaim" file shows them for each phase of reclaim, "shrinkers"
+ * for each shrinker. Writing anything to a file resets its statistics.
+ * The percentiles are upper bounds, derived from the power of 2 histogram.
+ */
+static const char * const reclaim_phase_names[NR_RECLAIM_PHASES] = {
+	[RECLAIM_TOTAL]			= "total",
+	[RECLAIM_SHRINK_ZONE]		= "shrink_zone",
+	[RECLAIM_SHRINK_SLAB]		= "shrink_slab",
+	[RECLAIM_PAGEOUT]		= "pageout",
+	[RECLAIM_CONGESTION_WAIT]	= "congestion_wait",
+};
+
+static unsigned long reclaim_percentile(const struct reclaim_latency *lat,
+					int pct)
+{
+	unsigned long long want, seen = 0;
+	int i;
+
+	want = div_u64((u64)lat->count * pct + 99, 100);
+	for (i = 0; i < RECLAIM_LATENCY_BUCKETS - 1; i++) {
+		seen += lat->hist[i];
+		if (seen >= want)
+			break;
+	}
+	return 1UL << i;
+}
+
+static void reclaim_latency_show(struct seq_file *m, const char *name,
+				 const struct reclaim_latency *lat)
+{
+	if (!lat->count) {
+		seq_printf(m, "%-24s %10d\n", name, 0);
+		return;
+	}
+	seq_printf(m, "%-24s %10lu %8llu %8lu %8lu %8llu\n", name, lat->count,
+		   div64_u64(lat->total_ns, (u64)lat->count * NSEC_PER_USEC),
+		   reclaim_percentile(lat, 50), reclaim_percentile(lat, 99),
+		   div_u64(lat->max_ns, NSEC_PER_USEC));
+}
+
+static void reclaim_hist_header(struct seq_file *m)
+{
+	seq_printf(m, "%-24s %10s %8s %8s %8s %8s\n", "", "count", "avg_us",
+		   "p50_us", "p99_us", "max_us");
+}
+
+static int direct_reclaim_show(struct seq_file *m, void *v)
+{
+	struct reclaim_latency lat[NR_RECLAIM_PHASES];
+	int i, p;
+
+	spin_lock(&reclaim_latency_lock);
+	memcpy(lat, reclaim_phase_latency, sizeof(lat));
+	spin_unlock(&reclaim_latency_lock);
+
+	reclaim_hist_header(m);
+	for (p = 0; p < NR_RECLAIM_PHASES; p++)
+		reclaim_latency_show(m, reclaim_phase_names[p], &lat[p]);
+
+	seq_printf(m, "\nhistogram, calls which took less than N us:\n");
+	seq_printf(m, "%-8s", "N");
+	for (p = 0; p < NR_RECLAIM_PHASES; p++)
+		seq_printf(m, " %15s", reclaim_phase_names[p]);
+	seq_putc(m, '\n');
+	for (i = 0; i < RECLAIM_LATENCY_BUCKETS; i++) {
+		if (i < RECLAIM_LATENCY_BUCKETS - 1)
+			seq_printf(m, "%-8lu", 1UL << i);
+		else
+			seq_printf(m, "%-8s", "more");
+		for (p = 0; p < NR_RECLAIM_PHASES; p++)
+			seq_printf(m, " %15lu", lat[p].hist[i]);
+		seq_putc(m, '\n');
+	}
+	return 0;
+}
+
+static int direct_reclaim_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, direct_reclaim_show, NULL);
+}
+
+static ssize_t direct_reclaim_write(struct file *file, const char __user *buf,
+				    size_t count, loff_t *ppos)
+{
+	spin_lock(&reclaim_latency_lock);
+	memset(reclaim_phase_latency, 0, sizeof(reclaim_phase_latency));
+	spin_unlock(&reclaim_latency_lock);
+	return count;
+}
+
+static const struct file_operations direct_reclaim_fops = {
+	.open		= direct_reclaim_open,
+	.read		= seq_read,
+	.write		= direct_reclaim_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int shrinkers_show(struct seq_file *m, void *v)
+{
+	struct shrinker *shrinker;
+	struct reclaim_latency lat;
+	char name[KSYM_SYMBOL_LEN];
+	int i;
+
+	reclaim_hist_header(m);
+	down_read(&shrinker_rwsem);
+	list_for_each_entry(shrinker, &shrinker_list, list) {
+		spin_lock(&reclaim_latency_lock);
+		lat = shrinker->latency;
+		spin_unlock(&reclaim_latency_lock);
+
+		snprintf(name, sizeof(name), "%pf", shrinker->shrink);
+		reclaim_latency_show(m, name, &lat);
+		if (!lat.count)
+			continue;
+		seq_printf(m, "  histogram:");
+		for (i = 0; i < RECLAIM_LATENCY_BUCKETS; i++)
+			seq_printf(m, " %lu", lat.hist[i]);
+		seq_putc(m, '\n');
+	}
+	up_read(&shrinker_rwsem);
+	return 0;
+}
+
+static int shrinkers_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, shrinkers_show, NULL);
+}
+
+static ssize_t shrinkers_write(struct file *file, const char __user *buf,
+			       size_t count, loff_t *ppos)
+{
+	struct shrinker *shrinker;
+
+	down_read(&shrinker_rwsem);
+	spin_lock(&reclaim_latency_lock);
+	list_for_each_entry(shrinker, &shrinker_list, list)
+		memset(&shrinker->latency, 0, sizeof(shrinker->latency));
+	spin_unlock(&reclaim_latency_lock);
+	up_read(&shrinker_rwsem);
+	return count;
+}
+
+static const struct file_operations shrinkers_fops = {
+	.open		= shrinkers_open,
+	.read		= seq_read,
+	.write		= shrinkers_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init vmscan_stats_init(void)
+{
+	struct dentry *dir;
+
+	dir = debugfs_create_dir("vmscan", NULL);
+	if (IS_ERR_OR_NULL(dir))
+		return -ENOMEM;
+	debugfs_create_file("direct_reclaim", S_IRUSR | S_IWUSR, dir, NULL,
+			    &direct_reclaim_fops);
+	debugfs_create_file("shrinkers", S_IRUSR | S_IWUSR, dir, NULL,
+			    &shrinkers_fops);
+	return 0;
+}
+late_initcall(vmscan_stats_init);
+#endif /* CONFIG_VMSCAN_STATS */
@@ -791,6 +791,14 @@ static const char * const vmstat_text[] = {
 
 	"pgrotated",
 
+	"pgra_pages",
+	"pgra_tree_lock",
+	"pgra_lru_lock",
+	"pgra_hit",
+	"pgra_miss",
+	"pgra_shrink",
+	"pgra_grow",
+
 #ifdef CONFIG_COMPACTION
 	"compact_blocks_moved",
 	"compact_pages_moved",
@@ -798,6 +806,9 @@ static const char * const vmstat_text[] = {
 	"compact_stall",
 	"compact_fail",
 	"compact_success",
+	"compact_daemon_wake",
+	"compact_daemon_success",
+	"compact_daemon_fail",
 #endif
 
 #ifdef CONFIG_HUGETLB_PAGE
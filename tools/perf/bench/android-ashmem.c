@@ -0,0 +1,188 @@
+/*
+ * android-ashmem.c
+ *
+ * ashmem: Churn of ashmem regions
+ *
+ * Creates, maps and touches ashmem regions, unpins and re-pins them chunk
+ * by chunk, as the users of purgeable caches do, and destroys them again,
+ * timing each step.
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../builtin.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <linux/types.h>
+
+#define ASHMEM_DEV	"/dev/ashmem"
+
+/* From include/linux/ashmem.h, which is not fit for user space */
+struct ashmem_pin {
+	__u32 offset;
+	__u32 len;
+};
+
+#define __ASHMEMIOC		0x77
+#define ASHMEM_SET_NAME		_IOW(__ASHMEMIOC, 1, char[256])
+#define ASHMEM_SET_SIZE		_IOW(__ASHMEMIOC, 3, size_t)
+#define ASHMEM_PIN		_IOW(__ASHMEMIOC, 7, struct ashmem_pin)
+#define ASHMEM_UNPIN		_IOW(__ASHMEMIOC, 8, struct ashmem_pin)
+#define ASHMEM_WAS_PURGED	1
+
+static int loops = 1000;
+static const char *size_str = "1MB";
+static int chunk_pages = 4;
+
+static const struct option options[] = {
+	OPT_INTEGER('l', "loop", &loops,
+		    "Specify number of regions to churn"),
+	OPT_STRING('s', "size", &size_str, "1MB",
+		   "Specify size of each region. "
+		   "available unit: B, MB, GB (upper and lower)"),
+	OPT_INTEGER('c', "chunk", &chunk_pages,
+		    "Specify pages unpinned and pinned at a time"),
+	OPT_END()
+};
+
+static const char * const bench_android_ashmem_usage[] = {
+	"perf bench android ashmem <options>",
+	NULL
+};
+
+enum {
+	STEP_CREATE,
+	STEP_TOUCH,
+	STEP_UNPIN,
+	STEP_PIN,
+	STEP_DESTROY,
+	NR_STEPS,
+};
+
+static const char * const step_names[NR_STEPS] = {
+	[STEP_CREATE]	= "create+mmap",
+	[STEP_TOUCH]	= "touch",
+	[STEP_UNPIN]	= "unpin",
+	[STEP_PIN]	= "pin",
+	[STEP_DESTROY]	= "munmap+close",
+};
+
+int bench_android_ashmem(int argc, const char **argv,
+			 const char *prefix __used)
+{
+	u64 *samples[NR_STEPS], start, t;
+	unsigned long nr[NR_STEPS], chunks, purged = 0;
+	size_t size, page = sysconf(_SC_PAGESIZE), off, chunk;
+	struct ashmem_pin pin;
+	char *map;
+	int fd, i, s, ret;
+
+	argc = parse_options(argc, argv, options,
+			     bench_android_ashmem_usage, 0);
+
+	size = (size_t)perf_atoll(size_str);
+	if ((s64)size <= 0 || loops < 1 || chunk_pages < 1) {
+		fprintf(stderr, "Invalid parameters\n");
+		return 1;
+	}
+	size = (size + page - 1) & ~(page - 1);
+	chunk = chunk_pages * page;
+	chunks = (size + chunk - 1) / chunk;
+
+	for (s = 0; s < NR_STEPS; s++) {
+		unsigned long max = loops;
+
+		if (s == STEP_UNPIN || s == STEP_PIN)
+			max *= chunks;
+		samples[s] = calloc(max, sizeof(u64));
+		if (!samples[s]) {
+			fprintf(stderr, "Out of memory\n");
+			return 1;
+		}
+		nr[s] = 0;
+	}
+
+	for (i = 0; i < loops; i++) {
+		start = bench_now_ns();
+		fd = open(ASHMEM_DEV, O_RDWR);
+		if (fd < 0) {
+			fprintf(stderr, "cannot open %s: %s\n", ASHMEM_DEV,
+				strerror(errno));
+			return 1;
+		}
+		if (ioctl(fd, ASHMEM_SET_NAME, "perf-bench") < 0 ||
+		    ioctl(fd, ASHMEM_SET_SIZE, size) < 0) {
+			perror("ashmem ioctl");
+			return 1;
+		}
+		map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+			   fd, 0);
+		if (map == MAP_FAILED) {
+			perror("mmap");
+			return 1;
+		}
+		t = bench_now_ns();
+		samples[STEP_CREATE][nr[STEP_CREATE]++] = t - start;
+
+		start = t;
+		for (off = 0; off < size; off += page)
+			map[off] = i;
+		t = bench_now_ns();
+		samples[STEP_TOUCH][nr[STEP_TOUCH]++] = t - start;
+
+		for (off = 0; off < size; off += chunk) {
+			pin.offset = off;
+			pin.len = min(chunk, size - off);
+
+			start = bench_now_ns();
+			ret = ioctl(fd, ASHMEM_UNPIN, &pin);
+			t = bench_now_ns();
+			if (ret < 0) {
+				perror("ASHMEM_UNPIN");
+				return 1;
+			}
+			samples[STEP_UNPIN][nr[STEP_UNPIN]++] = t - start;
+		}
+
+		for (off = 0; off < size; off += chunk) {
+			pin.offset = off;
+			pin.len = min(chunk, size - off);
+
+			start = bench_now_ns();
+			ret = ioctl(fd, ASHMEM_PIN, &pin);
+			t = bench_now_ns();
+			if (ret < 0) {
+				perror("ASHMEM_PIN");
+				return 1;
+			}
+			if (ret == ASHMEM_WAS_PURGED)
+				purged++;
+			samples[STEP_PIN][nr[STEP_PIN]++] = t - start;
+		}
+
+		start = bench_now_ns();
+		munmap(map, size);
+		close(fd);
+		samples[STEP_DESTROY][nr[STEP_DESTROY]++] =
+			bench_now_ns() - start;
+	}
+
+	if (bench_format == BENCH_FORMAT_DEFAULT)
+		printf("# %d regions of %zu bytes, pinned in chunks of %zu "
+		       "bytes, %lu chunks purged\n\n", loops, size, chunk,
+		       purged);
+	for (s = 0; s < NR_STEPS; s++) {
+		bench_latency_print(step_names[s], samples[s], nr[s]);
+		free(samples[s]);
+	}
+	return 0;
+}
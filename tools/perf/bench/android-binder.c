@@ -0,0 +1,401 @@
+/*
+ * android-binder.c
+ *
+ * binder: Round trip transactions over /dev/binder
+ *
+ * A server process becomes the binder context manager and answers every
+ * transaction with a reply carrying the same payload, from one looper
+ * thread per client. Each client process sends transactions to it and
+ * times the round trips.
+ *
+ * Only one process may be the context manager, so this has to run where
+ * servicemanager is not.
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../builtin.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "../../../drivers/staging/android/binder.h"
+
+#define BINDER_DEV	"/dev/binder"
+#define BINDER_VM_SIZE	(1024 * 1024)
+
+static int pairs = 1;
+static int loops = 10000;
+static int payload = 32;
+
+static const struct option options[] = {
+	OPT_INTEGER('p', "pairs", &pairs,
+		    "Specify number of client/server pairs"),
+	OPT_INTEGER('l', "loop", &loops,
+		    "Specify number of transactions per client"),
+	OPT_INTEGER('s', "size", &payload,
+		    "Specify payload size in bytes"),
+	OPT_END()
+};
+
+static const char * const bench_android_binder_usage[] = {
+	"perf bench android binder <options>",
+	NULL
+};
+
+struct binder_cmd_txn {
+	uint32_t cmd;
+	struct binder_transaction_data txn;
+} __attribute__((packed));
+
+struct binder_cmd_free {
+	uint32_t cmd;
+	void *buffer;
+} __attribute__((packed));
+
+struct binder_cmd_cookie {
+	uint32_t cmd;
+	struct binder_ptr_cookie pc;
+} __attribute__((packed));
+
+static int binder_open(void)
+{
+	struct binder_version vers;
+	void *map;
+	int fd;
+
+	fd = open(BINDER_DEV, O_RDWR);
+	if (fd < 0) {
+		fprintf(stderr, "cannot open %s: %s\n", BINDER_DEV,
+			strerror(errno));
+		return -1;
+	}
+
+	if (ioctl(fd, BINDER_VERSION, &vers) < 0 ||
+	    vers.protocol_version != BINDER_CURRENT_PROTOCOL_VERSION) {
+		fprintf(stderr, "binder protocol version mismatch\n");
+		goto out_close;
+	}
+
+	/* The driver copies the transactions it delivers into this */
+	map = mmap(NULL, BINDER_VM_SIZE, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED) {
+		fprintf(stderr, "cannot map %s: %s\n", BINDER_DEV,
+			strerror(errno));
+		goto out_close;
+	}
+	return fd;
+
+out_close:
+	close(fd);
+	return -1;
+}
+
+static int binder_io(int fd, void *wbuf, size_t wsize,
+		     void *rbuf, size_t rsize, size_t *consumed)
+{
+	struct binder_write_read bwr;
+
+	bwr.write_size = wsize;
+	bwr.write_consumed = 0;
+	bwr.write_buffer = (unsigned long)wbuf;
+	bwr.read_size = rsize;
+	bwr.read_consumed = 0;
+	bwr.read_buffer = (unsigned long)rbuf;
+
+	if (ioctl(fd, BINDER_WRITE_READ, &bwr) < 0)
+		return -1;
+	*consumed = bwr.read_consumed;
+	return 0;
+}
+
+/* Size of the payload following a return code, -1 if it is unexpected */
+static int br_payload(uint32_t cmd)
+{
+	switch (cmd) {
+	case BR_NOOP:
+	case BR_TRANSACTION_COMPLETE:
+	case BR_SPAWN_LOOPER:
+		return 0;
+	case BR_TRANSACTION:
+	case BR_REPLY:
+		return sizeof(struct binder_transaction_data);
+	case BR_INCREFS:
+	case BR_ACQUIRE:
+	case BR_RELEASE:
+	case BR_DECREFS:
+		return sizeof(struct binder_ptr_cookie);
+	default:
+		return -1;
+	}
+}
+
+static void *server_thread(void *arg)
+{
+	int fd = (long)arg;
+	char rbuf[256], wbuf[256];
+	size_t wsize, rsize, pos;
+	uint32_t cmd;
+	int len;
+
+	cmd = BC_ENTER_LOOPER;
+	memcpy(wbuf, &cmd, sizeof(cmd));
+	wsize = sizeof(cmd);
+
+	for (;;) {
+		if (binder_io(fd, wbuf, wsize, rbuf, sizeof(rbuf), &rsize) < 0)
+			break;
+		wsize = 0;
+
+		for (pos = 0; pos + sizeof(cmd) <= rsize; pos += len) {
+			memcpy(&cmd, rbuf + pos, sizeof(cmd));
+			pos += sizeof(cmd);
+			len = br_payload(cmd);
+			if (len < 0) {
+				fprintf(stderr, "binder server: unexpected "
+					"return code %#x\n", cmd);
+				exit(1);
+			}
+
+			if (cmd == BR_INCREFS || cmd == BR_ACQUIRE) {
+				struct binder_cmd_cookie ack;
+
+				ack.cmd = cmd == BR_INCREFS ? BC_INCREFS_DONE :
+							      BC_ACQUIRE_DONE;
+				memcpy(&ack.pc, rbuf + pos, sizeof(ack.pc));
+				memcpy(wbuf + wsize, &ack, sizeof(ack));
+				wsize += sizeof(ack);
+			} else if (cmd == BR_TRANSACTION) {
+				struct binder_cmd_txn reply;
+				struct binder_cmd_free bfree;
+
+				/* Echo the payload, then free the buffer */
+				memcpy(&reply.txn, rbuf + pos,
+				       sizeof(reply.txn));
+				reply.cmd = BC_REPLY;
+				reply.txn.flags = 0;
+				reply.txn.offsets_size = 0;
+				reply.txn.data.ptr.offsets = NULL;
+				bfree.cmd = BC_FREE_BUFFER;
+				bfree.buffer = (void *)reply.txn.data.ptr.buffer;
+
+				memcpy(wbuf + wsize, &reply, sizeof(reply));
+				wsize += sizeof(reply);
+				memcpy(wbuf + wsize, &bfree, sizeof(bfree));
+				wsize += sizeof(bfree);
+			}
+		}
+	}
+
+	fprintf(stderr, "binder server: %s\n", strerror(errno));
+	exit(1);
+	return NULL;
+}
+
+static void run_server(int ready_fd)
+{
+	pthread_t thread;
+	int fd, i, ret;
+	char c = 0;
+
+	fd = binder_open();
+	if (fd < 0)
+		exit(1);
+
+	if (ioctl(fd, BINDER_SET_CONTEXT_MGR, 0) < 0) {
+		fprintf(stderr, "cannot become the binder context manager "
+			"(is servicemanager running?): %s\n", strerror(errno));
+		exit(1);
+	}
+
+	for (i = 0; i < pairs; i++) {
+		if (pthread_create(&thread, NULL, server_thread,
+				   (void *)(long)fd)) {
+			fprintf(stderr, "pthread_create failed\n");
+			exit(1);
+		}
+	}
+
+	ret = write(ready_fd, &c, 1);
+	close(ready_fd);
+	if (ret != 1)
+		exit(1);
+
+	/* The parent kills us when the clients are done */
+	for (;;)
+		pause();
+}
+
+static void run_client(u64 *samples, const void *data)
+{
+	struct binder_cmd_free bfree;
+	struct binder_cmd_txn *txn;
+	char rbuf[256], wbuf[256];
+	size_t wsize, rsize, pos;
+	void *reply_buf = NULL;
+	uint32_t cmd;
+	u64 start;
+	int fd, i, len, got_reply;
+
+	fd = binder_open();
+	if (fd < 0)
+		exit(1);
+
+	for (i = 0; i < loops; i++) {
+		/* Free the previous reply along with the next transaction */
+		wsize = 0;
+		if (reply_buf) {
+			bfree.cmd = BC_FREE_BUFFER;
+			bfree.buffer = reply_buf;
+			memcpy(wbuf, &bfree, sizeof(bfree));
+			wsize = sizeof(bfree);
+		}
+
+		txn = (struct binder_cmd_txn *)(wbuf + wsize);
+		memset(txn, 0, sizeof(*txn));
+		txn->cmd = BC_TRANSACTION;
+		txn->txn.target.handle = 0;
+		txn->txn.code = 1;
+		txn->txn.data_size = payload;
+		txn->txn.data.ptr.buffer = data;
+		wsize += sizeof(*txn);
+
+		start = bench_now_ns();
+		got_reply = 0;
+		while (!got_reply) {
+			if (binder_io(fd, wbuf, wsize, rbuf, sizeof(rbuf),
+				      &rsize) < 0) {
+				fprintf(stderr, "binder client: %s\n",
+					strerror(errno));
+				exit(1);
+			}
+			wsize = 0;
+
+			for (pos = 0; pos + sizeof(cmd) <= rsize; pos += len) {
+				memcpy(&cmd, rbuf + pos, sizeof(cmd));
+				pos += sizeof(cmd);
+				len = br_payload(cmd);
+				if (len < 0) {
+					fprintf(stderr, "binder client: "
+						"transaction failed (%#x)\n",
+						cmd);
+					exit(1);
+				}
+				if (cmd == BR_REPLY) {
+					struct binder_transaction_data tr;
+
+					memcpy(&tr, rbuf + pos, sizeof(tr));
+					reply_buf = (void *)tr.data.ptr.buffer;
+					got_reply = 1;
+				}
+			}
+		}
+		samples[i] = bench_now_ns() - start;
+	}
+	exit(0);
+}
+
+int bench_android_binder(int argc, const char **argv,
+			 const char *prefix __used)
+{
+	int ready[2], i, wait_stat, status = 0;
+	pid_t server, *clients;
+	u64 start, total_ns;
+	u64 *samples;
+	void *data;
+	char c;
+
+	argc = parse_options(argc, argv, options,
+			     bench_android_binder_usage, 0);
+
+	if (pairs < 1 || loops < 1 || payload < 0) {
+		fprintf(stderr, "Invalid parameters\n");
+		return 1;
+	}
+
+	/* The clients write their samples here */
+	samples = mmap(NULL, sizeof(u64) * pairs * loops,
+		       PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS,
+		       -1, 0);
+	clients = calloc(pairs, sizeof(pid_t));
+	data = calloc(1, payload + 1);
+	if (samples == MAP_FAILED || !clients || !data) {
+		fprintf(stderr, "Out of memory\n");
+		return 1;
+	}
+
+	if (pipe(ready)) {
+		perror("pipe");
+		return 1;
+	}
+
+	server = fork();
+	if (server < 0) {
+		perror("fork");
+		return 1;
+	}
+	if (!server) {
+		close(ready[0]);
+		run_server(ready[1]);
+	}
+
+	close(ready[1]);
+	if (read(ready[0], &c, 1) != 1) {
+		/* The server has told why */
+		waitpid(server, &wait_stat, 0);
+		return 1;
+	}
+	close(ready[0]);
+
+	start = bench_now_ns();
+	for (i = 0; i < pairs; i++) {
+		clients[i] = fork();
+		if (clients[i] < 0) {
+			perror("fork");
+			exit(1);
+		}
+		if (!clients[i])
+			run_client(samples + (u64)i * loops, data);
+	}
+	for (i = 0; i < pairs; i++) {
+		waitpid(clients[i], &wait_stat, 0);
+		if (!WIFEXITED(wait_stat) || WEXITSTATUS(wait_stat))
+			status = 1;
+	}
+	total_ns = bench_now_ns() - start;
+
+	kill(server, SIGKILL);
+	waitpid(server, &wait_stat, 0);
+
+	if (status)
+		return status;
+
+	if (bench_format == BENCH_FORMAT_DEFAULT) {
+		printf("# %d client/server pairs, %d transactions each, "
+		       "%d bytes of payload\n\n", pairs, loops, payload);
+		printf(" %14s: %llu.%03llu [sec]\n", "Total time",
+		       total_ns / 1000000000ULL,
+		       total_ns / 1000000ULL % 1000);
+		printf(" %14llu transactions/sec\n\n",
+		       (u64)pairs * loops * 1000000000ULL / total_ns);
+	}
+	bench_latency_print("round-trip", samples, (u64)pairs * loops);
+
+	munmap(samples, sizeof(u64) * pairs * loops);
+	free(clients);
+	free(data);
+	return 0;
+}
@@ -4,6 +4,10 @@
 extern int bench_sched_messaging(int argc, const char **argv, const char *prefix);
 extern int bench_sched_pipe(int argc, const char **argv, const char *prefix);
 extern int bench_mem_memcpy(int argc, const char **argv, const char *prefix __used);
+extern int bench_mem_zram(int argc, const char **argv, const char *prefix);
+extern int bench_android_binder(int argc, const char **argv, const char *prefix);
+extern int bench_android_ashmem(int argc, const char **argv, const char *prefix);
+extern int bench_fs_ubifs(int argc, const char **argv, const char *prefix);
 
 #define BENCH_FORMAT_DEFAULT_STR	"default"
 #define BENCH_FORMAT_DEFAULT		0
@@ -14,4 +18,8 @@ extern int bench_mem_memcpy(int argc, const char **argv, const char *prefix __us
 
 extern int bench_format;
 
+extern u64 bench_now_ns(void);
+extern void bench_latency_print(const char *name, u64 *samples,
+				unsigned long nr);
+
 #endif
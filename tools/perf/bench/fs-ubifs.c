@@ -0,0 +1,237 @@
+/*
+ * fs-ubifs.c
+ *
+ * ubifs: Write and read throughput of UBIFS with each compressor
+ *
+ * For each compressor, remounts the UBIFS mounted on the given directory
+ * with compr=<compressor>, writes a file, syncs it, drops the page cache
+ * and reads the file back. Meant to be run on a volume on nandsim, so that
+ * the flash is not the bottleneck and the compressors are compared.
+ */
+
+/* util.h first, for _GNU_SOURCE */
+#include "../util/util.h"
+#include "../perf.h"
+#include "../util/parse-options.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mount.h>
+#include <sys/vfs.h>
+
+#define UBIFS_BLOCK	4096
+#define IO_SIZE		(64 * 1024)
+
+static const char *dir;
+static const char *size_str = "16MB";
+static const char *compressors = "none,lzo,zlib,lz4,lz4hc";
+static int ratio = 50;
+
+static const struct option options[] = {
+	OPT_STRING('d', "dir", &dir, "dir",
+		   "Specify the mount point of the UBIFS to use, "
+		   "it is remounted"),
+	OPT_STRING('s', "size", &size_str, "16MB",
+		   "Specify size of the file to write and read. "
+		   "available unit: B, MB, GB (upper and lower)"),
+	OPT_STRING('c', "compressors", &compressors, "none,lzo,zlib,lz4,lz4hc",
+		   "Specify comma separated compressors to test"),
+	OPT_INTEGER('r', "ratio", &ratio,
+		    "Specify percentage of each block which is zeroes, "
+		    "i.e. compresses well"),
+	OPT_END()
+};
+
+static const char * const bench_fs_ubifs_usage[] = {
+	"perf bench fs ubifs <options>",
+	NULL
+};
+
+static int drop_caches(void)
+{
+	int fd, ret;
+
+	sync();
+	fd = open("/proc/sys/vm/drop_caches", O_WRONLY);
+	if (fd < 0)
+		return -1;
+	ret = write(fd, "3", 1);
+	close(fd);
+	return ret == 1 ? 0 : -1;
+}
+
+static long long used_bytes(void)
+{
+	struct statfs st;
+
+	if (statfs(dir, &st))
+		return -1;
+	return (long long)(st.f_blocks - st.f_bfree) * st.f_bsize;
+}
+
+static double mb_per_sec(u64 bytes, u64 ns)
+{
+	return ns ? (double)bytes * 1000000000.0 / ns / (1024 * 1024) : 0;
+}
+
+/* Returns 0, or -1 with a message printed */
+static int run_one(const char *compr, const char *buf, u64 size)
+{
+	char path[PATH_MAX], opts[64], *rbuf;
+	u64 done, start, write_ns, read_ns;
+	long long before, after;
+	ssize_t ret;
+	int fd;
+
+	snprintf(opts, sizeof(opts), "compr=%s", compr);
+	if (mount("none", dir, "ubifs", MS_REMOUNT, opts)) {
+		fprintf(stderr, "cannot remount %s with %s: %s\n", dir, opts,
+			strerror(errno));
+		return -1;
+	}
+
+	snprintf(path, sizeof(path), "%s/perf-bench-ubifs", dir);
+	unlink(path);
+	if (drop_caches()) {
+		fprintf(stderr, "cannot drop caches: %s\n", strerror(errno));
+		return -1;
+	}
+	before = used_bytes();
+
+	fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+	if (fd < 0) {
+		fprintf(stderr, "cannot create %s: %s\n", path,
+			strerror(errno));
+		return -1;
+	}
+	start = bench_now_ns();
+	for (done = 0; done < size; done += ret) {
+		ret = write(fd, buf, min((u64)IO_SIZE, size - done));
+		if (ret <= 0) {
+			perror("write");
+			close(fd);
+			return -1;
+		}
+	}
+	if (fsync(fd)) {
+		perror("fsync");
+		close(fd);
+		return -1;
+	}
+	write_ns = bench_now_ns() - start;
+	close(fd);
+
+	after = used_bytes();
+	if (drop_caches()) {
+		fprintf(stderr, "cannot drop caches: %s\n", strerror(errno));
+		return -1;
+	}
+
+	rbuf = malloc(IO_SIZE);
+	if (!rbuf) {
+		fprintf(stderr, "cannot allocate the read buffer\n");
+		return -1;
+	}
+	fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		fprintf(stderr, "cannot open %s: %s\n", path,
+			strerror(errno));
+		free(rbuf);
+		return -1;
+	}
+	start = bench_now_ns();
+	for (done = 0; done < size; done += ret) {
+		ret = read(fd, rbuf, IO_SIZE);
+		if (ret <= 0) {
+			perror("read");
+			close(fd);
+			free(rbuf);
+			return -1;
+		}
+	}
+	read_ns = bench_now_ns() - start;
+	close(fd);
+	free(rbuf);
+	unlink(path);
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf(" %14s: write %8.3f MB/s, read %8.3f MB/s",
+		       compr, mb_per_sec(size, write_ns),
+		       mb_per_sec(size, read_ns));
+		if (before >= 0 && after >= before)
+			printf(", %.1f%% of the size on flash",
+			       (double)(after - before) * 100 / size);
+		printf("\n");
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%s %.3f %.3f %lld\n", compr,
+		       mb_per_sec(size, write_ns), mb_per_sec(size, read_ns),
+		       after - before);
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+	return 0;
+}
+
+int bench_fs_ubifs(int argc, const char **argv, const char *prefix __used)
+{
+	char *list, *compr, *saveptr = NULL, *buf;
+	size_t fill;
+	u64 size;
+	int i, j, status = 0;
+
+	argc = parse_options(argc, argv, options, bench_fs_ubifs_usage, 0);
+
+	size = (u64)perf_atoll(size_str);
+	if ((s64)size <= 0 || ratio < 0 || ratio > 100) {
+		fprintf(stderr, "Invalid parameters\n");
+		return 1;
+	}
+	/* No default, the file system is remounted and filled */
+	if (!dir) {
+		fprintf(stderr, "Specify the UBIFS mount point with -d\n");
+		return 1;
+	}
+
+	/* Random bytes do not compress, zeroes do; UBIFS compresses blocks */
+	buf = malloc(IO_SIZE);
+	list = strdup(compressors);
+	if (!buf || !list) {
+		fprintf(stderr, "Out of memory\n");
+		return 1;
+	}
+	fill = UBIFS_BLOCK - UBIFS_BLOCK * ratio / 100;
+	srand(1);
+	for (i = 0; i < IO_SIZE; i += UBIFS_BLOCK) {
+		for (j = 0; j < (int)fill; j++)
+			buf[i + j] = rand();
+		memset(buf + i + fill, 0, UBIFS_BLOCK - fill);
+	}
+
+	if (bench_format == BENCH_FORMAT_DEFAULT)
+		printf("# %llu bytes on %s, %d%% zeroes\n\n",
+		       (unsigned long long)size, dir, ratio);
+
+	for (compr = strtok_r(list, ",", &saveptr); compr;
+	     compr = strtok_r(NULL, ",", &saveptr)) {
+		if (run_one(compr, buf, size))
+			status = 1;
+	}
+
+	free(list);
+	free(buf);
+	return status;
+}
@@ -0,0 +1,73 @@
+/*
+ * latency.c
+ *
+ * Helpers for the suites which time individual operations
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+u64 bench_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	u64 x = *(const u64 *)a, y = *(const u64 *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/*
+ * Print the distribution of @nr latencies, in nsecs. @samples is sorted
+ * in place.
+ */
+void bench_latency_print(const char *name, u64 *samples, unsigned long nr)
+{
+	double sum = 0, p50, p99, avg, max;
+	unsigned long i;
+
+	if (!nr) {
+		if (bench_format == BENCH_FORMAT_DEFAULT)
+			printf(" %14s: no operations\n", name);
+		else
+			printf("%s 0\n", name);
+		return;
+	}
+
+	qsort(samples, nr, sizeof(*samples), cmp_u64);
+	for (i = 0; i < nr; i++)
+		sum += samples[i];
+
+	avg = sum / nr / 1000;
+	p50 = (double)samples[(nr - 1) * 50 / 100] / 1000;
+	p99 = (double)samples[(nr - 1) * 99 / 100] / 1000;
+	max = (double)samples[nr - 1] / 1000;
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf(" %14s: %lu ops, avg %.3f, p50 %.3f, p99 %.3f, "
+		       "max %.3f usecs\n", name, nr, avg, p50, p99, max);
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%s %lu %.3f %.3f %.3f %.3f\n",
+		       name, nr, avg, p50, p99, max);
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+}
@@ -0,0 +1,159 @@
+/*
+ * mem-zram.c
+ *
+ * zram: Page sized I/O to a zram device
+ *
+ * Writes pages to a zram device and reads them back in random order, the
+ * way swap-out and swap-in use it, and times each page. The device must
+ * have its disksize set, and must not be in use as swap: its contents are
+ * overwritten.
+ */
+
+/* util.h first, for _GNU_SOURCE and thus O_DIRECT */
+#include "../util/util.h"
+#include "../perf.h"
+#include "../util/parse-options.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <libgen.h>
+#include <limits.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+static const char *device;
+static int pages = 4096;
+static int ratio = 50;
+
+static const struct option options[] = {
+	OPT_STRING('d', "device", &device, "device",
+		   "Specify zram device to use, its contents are lost"),
+	OPT_INTEGER('p', "pages", &pages,
+		    "Specify number of pages to swap out and in"),
+	OPT_INTEGER('r', "ratio", &ratio,
+		    "Specify percentage of each page which is zeroes, "
+		    "i.e. compresses well"),
+	OPT_END()
+};
+
+static const char * const bench_mem_zram_usage[] = {
+	"perf bench mem zram <options>",
+	NULL
+};
+
+static unsigned long long zram_stat(const char *name)
+{
+	char path[PATH_MAX], *dev;
+	unsigned long long val = 0;
+	FILE *f;
+
+	dev = strdup(device);
+	if (!dev)
+		return 0;
+	snprintf(path, sizeof(path), "/sys/block/%s/%s", basename(dev), name);
+	free(dev);
+
+	f = fopen(path, "r");
+	if (!f)
+		return 0;
+	if (fscanf(f, "%llu", &val) != 1)
+		val = 0;
+	fclose(f);
+	return val;
+}
+
+int bench_mem_zram(int argc, const char **argv, const char *prefix __used)
+{
+	size_t page = sysconf(_SC_PAGESIZE), fill;
+	u64 *out, *in, start;
+	unsigned long long orig, compr;
+	off_t devsize;
+	char *buf;
+	int fd, i, j;
+
+	argc = parse_options(argc, argv, options, bench_mem_zram_usage, 0);
+
+	if (pages < 1 || ratio < 0 || ratio > 100) {
+		fprintf(stderr, "Invalid parameters\n");
+		return 1;
+	}
+	/* No default, the device is overwritten */
+	if (!device) {
+		fprintf(stderr, "Specify the zram device with -d\n");
+		return 1;
+	}
+
+	/* O_EXCL fails if the device is in use as swap */
+	fd = open(device, O_RDWR | O_DIRECT | O_EXCL);
+	if (fd < 0) {
+		fprintf(stderr, "cannot open %s: %s\n", device,
+			strerror(errno));
+		return 1;
+	}
+	devsize = lseek(fd, 0, SEEK_END);
+	if (devsize < (off_t)page) {
+		fprintf(stderr, "%s is not set up, write its disksize first\n",
+			device);
+		close(fd);
+		return 1;
+	}
+	if ((off_t)pages * page > devsize)
+		pages = devsize / page;
+
+	out = calloc(pages, sizeof(u64));
+	in = calloc(pages, sizeof(u64));
+	if (!out || !in || posix_memalign((void **)&buf, page, page)) {
+		fprintf(stderr, "Out of memory\n");
+		return 1;
+	}
+
+	/* Random bytes do not compress, zeroes do */
+	fill = page - page * ratio / 100;
+	srand(1);
+	for (i = 0; i < pages; i++) {
+		for (j = 0; j < (int)fill; j++)
+			buf[j] = rand();
+		memset(buf + fill, 0, page - fill);
+
+		start = bench_now_ns();
+		if (pwrite(fd, buf, page, (off_t)i * page) != (ssize_t)page) {
+			perror("pwrite");
+			return 1;
+		}
+		out[i] = bench_now_ns() - start;
+	}
+
+	orig = zram_stat("orig_data_size");
+	compr = zram_stat("compr_data_size");
+
+	for (i = 0; i < pages; i++) {
+		off_t off = (off_t)(rand() % pages) * page;
+
+		start = bench_now_ns();
+		if (pread(fd, buf, page, off) != (ssize_t)page) {
+			perror("pread");
+			return 1;
+		}
+		in[i] = bench_now_ns() - start;
+	}
+	close(fd);
+
+	if (bench_format == BENCH_FORMAT_DEFAULT) {
+		printf("# %d pages of %zu bytes on %s, %d%% zeroes\n",
+		       pages, page, device, ratio);
+		if (orig)
+			printf("# compressed to %llu of %llu bytes\n",
+			       compr, orig);
+		printf("\n");
+	}
+	bench_latency_print("swap-out", out, pages);
+	bench_latency_print("swap-in", in, pages);
+
+	free(buf);
+	free(out);
+	free(in);
+	return 0;
+}
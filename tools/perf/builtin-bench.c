@@ -13,6 +13,8 @@
  * Available subsystem list:
  *  sched ... scheduler and IPC mechanism
  *  mem   ... memory access performance
+ *  android ... Android specific drivers
+ *  fs    ... file system performance
  *
  */
 
@@ -32,7 +34,10 @@ struct bench_suite {
 	int (*fn)(int, const char **, const char *);
 };
 						\
-/* sentinel: easy for help */
+/*
+ * sentinel: easy for help. "all" stops here, so suites which overwrite a
+ * device or file system go after it and only run when named.
+ */
 #define suite_all { "all", "test all suite (pseudo suite)", NULL }
 
 static struct bench_suite sched_suites[] = {
@@ -53,11 +58,37 @@ static struct bench_suite mem_suites[] = {
 	  "Simple memory copy in various ways",
 	  bench_mem_memcpy },
 	suite_all,
+	{ "zram",
+	  "Page sized swap-out and swap-in on a zram device",
+	  bench_mem_zram },
 	{ NULL,
 	  NULL,
 	  NULL             }
 };
 
+static struct bench_suite android_suites[] = {
+	{ "binder",
+	  "Round trip transactions over /dev/binder",
+	  bench_android_binder },
+	{ "ashmem",
+	  "Churn of ashmem regions: mmap, pin and unpin",
+	  bench_android_ashmem },
+	suite_all,
+	{ NULL,
+	  NULL,
+	  NULL                 }
+};
+
+static struct bench_suite fs_suites[] = {
+	suite_all,
+	{ "ubifs",
+	  "Write and read throughput of UBIFS with each compressor",
+	  bench_fs_ubifs },
+	{ NULL,
+	  NULL,
+	  NULL           }
+};
+
 struct bench_subsys {
 	const char *name;
 	const char *summary;
@@ -71,6 +102,12 @@ static struct bench_subsys subsystems[] = {
 	{ "mem",
 	  "memory access performance",
 	  mem_suites },
+	{ "android",
+	  "Android specific drivers",
+	  android_suites },
+	{ "fs",
+	  "file system performance",
+	  fs_suites },
 	{ "all",		/* sentinel: easy for help */
 	  "test all subsystem (pseudo subsystem)",
 	  NULL },